@@ -1,4 +1,6 @@
 #include <iostream>
+#include <cstdlib>
+#include <cmath>
 #include <GLAD/glad.h>
 #include <GLFWLib/glfw3.h>
 #include "Headers/Shader.h"
@@ -17,28 +19,51 @@
 #include "Headers/EBO.h"
 #include "Headers/FBO.h"
 #include "Headers/RBO.h"
+#include "Headers/OBJBenchmark.h"
+#include "Headers/MeshCache.h"
+#include "Headers/MeshOptimizer.h"
+#include "Headers/MeshBenchmark.h"
+#include "Headers/PackedVertex.h"
+#include "Headers/MeshHandle.h"
+#include "Headers/TerrainChunks.h"
+#include "Headers/TerrainHeightfield.h"
+#include "Headers/TerrainEditor.h"
+#include "Headers/TerrainCache.h"
+#include "Headers/HeightmapIO.h"
+#include "Headers/TerrainBenchmark.h"
 
 /*Function decl.*/
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouseCallback(GLFWwindow* window, double xPosInput, double yPosInput);
-void setOBJModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, std::vector<Vertex>& outVertices,
+MeshHandle setOBJModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, std::vector<Vertex>& outVertices,
     std::vector<unsigned int>& orderedIndices);
+MeshHandle setOBJModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, const Vertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount);
+MeshHandle setPackedModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, const PackedVertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount);
+MeshHandle uploadModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, const Vertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount);
+void setVertexDecodeUniforms(Shader& shader, const VertexDecodeParams& decodeParams);
+void drawTerrain(Shader& shader, const glm::mat4& viewProj, TerrainLODStats& stats, const std::unique_ptr<VAO>& terrainVAO, const MeshHandle& terrainHandle, const TerrainChunkManager& terrainChunks, const TerrainHeightfieldMesh& terrainHeightfield);
+void printTerrainStats(const char* pass, const TerrainLODStats& stats);
 void renderDepthMapVizQuad();
 void createDepthMapFBO(FBO* depthMapFBO, unsigned int& depthMapTexture, unsigned int shadowWidth, unsigned int shadowHeight);
-void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatrix, const unsigned int& SHADOW_WIDTH, const unsigned int& SHADOW_HEIGHT, const std::unique_ptr<FBO>& depthMapFBO, glm::mat4& modelMat, const std::unique_ptr<VAO>& terrainVAO, std::vector<unsigned int>& terrainIndices, GLFWwindow& window, const std::unique_ptr<VAO>& towerVAO, std::vector<unsigned int>& towerIndices, const std::unique_ptr<VAO>& tower2VAO, std::vector<unsigned int>& tower2Indices, const std::unique_ptr<VAO>& tower3VAO, std::vector<unsigned int>& tower3Indices, const std::unique_ptr<VAO>& obeliskVAO, std::vector<unsigned int>& obeliskIndices, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& octaVAO, std::vector<unsigned int>& octaIndices);
-void generateTerrainBuffers(const std::unique_ptr<VAO>& terrainVAO, const std::unique_ptr<VBO>& terrainVBO, const std::unique_ptr<EBO>& terrainIBO, const std::vector<Vertex>& terrainVertices, const std::vector<unsigned int>& terrainIndices);
+void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatrix, const unsigned int& SHADOW_WIDTH, const unsigned int& SHADOW_HEIGHT, const std::unique_ptr<FBO>& depthMapFBO, glm::mat4& modelMat, const std::unique_ptr<VAO>& terrainVAO, const MeshHandle& terrainHandle, const TerrainChunkManager& terrainChunks, const TerrainHeightfieldMesh& terrainHeightfield, GLFWwindow& window, const std::unique_ptr<VAO>& towerVAO, const MeshLODSet& towerLODs, const MeshHandle& towerHandle, const std::unique_ptr<VAO>& tower2VAO, const MeshLODSet& tower2LODs, const MeshHandle& tower2Handle, const std::unique_ptr<VAO>& tower3VAO, const MeshLODSet& tower3LODs, const MeshHandle& tower3Handle, const std::unique_ptr<VAO>& obeliskVAO, const MeshLODSet& obeliskLODs, const MeshHandle& obeliskHandle, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& octaVAO, const MeshHandle& octaHandle);
+MeshHandle generateTerrainBuffers(const std::unique_ptr<VAO>& terrainVAO, const std::unique_ptr<VBO>& terrainVBO, const std::unique_ptr<EBO>& terrainIBO, const Vertex* terrainVertices, size_t vertexCount,
+    const unsigned int* terrainIndices, size_t indexCount);
 void setShaderUniforms(Shader& mainShader, glm::mat4& modelMat, glm::mat4& viewMat, glm::mat4& projMat, glm::vec3& viewPos, glm::mat4& lightSpaceMatrix, glm::vec3& lightDirection, float& biasMin, float& biasMax, float& sunAngle);
 void setupDirectionVectorLine(unsigned int& lineVAO, unsigned int& lineVBO);
 void updateDirectionVectorLine(unsigned int lineVBO, const glm::vec3& lightDirection);
 void generateMainFramebufferWithFBOQuad(const std::unique_ptr<VAO>& fboQuadVAO, const std::unique_ptr<VBO>& fboQuadVBO, std::unique_ptr<FBO>& mainFBO, std::unique_ptr<RBO>& mainRBO, unsigned int& fboTex);
 void generateOcclusionAndGodRaysFramebuffer(std::unique_ptr<FBO>& godRaysFBO, unsigned int& occlusionTexture);
-void createSunBuffers(const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<VBO>& sunVBO, const std::unique_ptr<EBO>& sunEBO, std::vector<unsigned int>& sunIndices);
-void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& currentWidth, int& currentHeight, glm::mat4& projMat, glm::mat4& viewMat, glm::mat4& modelMat, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<VAO>& towerVAO, const std::unique_ptr<VAO>& tower2VAO, const std::unique_ptr<VAO>& tower3VAO, std::vector<unsigned int>& towerIndices, std::vector<unsigned int>& tower2Indices, std::vector<unsigned int>& tower3Indices, const std::unique_ptr<VAO>& obeliskVAO, std::vector<unsigned int>& obeliskIndices, const std::unique_ptr<VAO>& terrainVAO, std::vector<unsigned int>& terrainIndices, glm::vec3& godRaysColor, const std::unique_ptr<FBO>& occlusionFBO);
-std::vector<unsigned int> genPointLightOctahedronBuffers(const std::unique_ptr<VAO>& octaVAO, const std::unique_ptr<VBO>& octaVBO, const std::unique_ptr<EBO>& octaEBO);
+MeshHandle createSunBuffers(const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<VBO>& sunVBO, const std::unique_ptr<EBO>& sunEBO, std::vector<unsigned int>& sunIndices);
+void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& currentWidth, int& currentHeight, glm::mat4& projMat, glm::mat4& viewMat, glm::mat4& modelMat, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& sunVAO, const MeshHandle& sunHandle, const std::unique_ptr<VAO>& towerVAO, const std::unique_ptr<VAO>& tower2VAO, const std::unique_ptr<VAO>& tower3VAO, const MeshLODSet& towerLODs, const MeshLODSet& tower2LODs, const MeshLODSet& tower3LODs, const MeshHandle& towerHandle, const MeshHandle& tower2Handle, const MeshHandle& tower3Handle, const std::unique_ptr<VAO>& obeliskVAO, const MeshLODSet& obeliskLODs, const MeshHandle& obeliskHandle, const std::unique_ptr<VAO>& terrainVAO, const MeshHandle& terrainHandle, const TerrainChunkManager& terrainChunks, const TerrainHeightfieldMesh& terrainHeightfield, glm::vec3& godRaysColor, const std::unique_ptr<FBO>& occlusionFBO);
+MeshHandle genPointLightOctahedronBuffers(const std::unique_ptr<VAO>& octaVAO, const std::unique_ptr<VBO>& octaVBO, const std::unique_ptr<EBO>& octaEBO);
 unsigned int loadTextureFromBMP(const char* path);
 unsigned int loadSRGBTextureFromBMP(const char* path);
 unsigned int loadCubemap(std::vector<std::string>& cubemapFaces);
+int runBenchmarks(int argc, char** argv);
 
 
 /*Helper functions*/
@@ -183,6 +208,26 @@ float fbmOctaves = 0.f;
 float fbmPers = 0.f;
 float consK = 20.f;
 float consM = 20.f;
+/*Noise the single terrain is generated and edited with*/
+TerrainNoiseSettings terrainNoise;
+/*Erosion of the single terrain's heights. Off by default: the streamed chunks sample the bare noise
+  and only meet the single mesh seamlessly while it is uneroded.*/
+TerrainErosionSettings terrainErosion;
+/*Slope and curvature ramps of the single terrain's splat map*/
+TerrainSplatSettings terrainSplatSettings;
+/*Generated terrain, rewritten whenever the seed, size, height scale or noise change*/
+const char* terrainCachePath = "dep/terrain.terrain";
+/*16-bit RAW or PGM heightmap the single terrain is loaded from instead of generated, e.g. a DEM tile;
+  set with --heightmap <path> [minHeight maxHeight]. Its samples span [terrainHeightmapMinHeight,
+  terrainHeightmapMaxHeight], -5 to 5 unless given.*/
+std::string terrainHeightmapPath;
+float terrainHeightmapMinHeight = -5.f;
+float terrainHeightmapMaxHeight = 5.f;
+/*Imported maps up to this many heights can be edited, which keeps them as floats on the CPU; larger ones
+  are drawn, splat-mapped and collided with straight from the mapped file*/
+const size_t terrainEditMaxImportedHeights = size_t(4097) * 4097;
+/*Where H writes the edited terrain*/
+const char* terrainExportPath = "dep/terrain_export.pgm";
 
 /*Building variables*/
 /*Building 1*/
@@ -212,8 +257,82 @@ float rotateTotalTime = 0.f;
 /*Aux*/
 std::unique_ptr<RBO> mainRBO;
 
-int main()
+/*Upload scene meshes as 20-byte PackedVertex instead of the 56-byte Vertex; the vertex shaders decode either.
+  Opt-in: positions are quantized to 16 bits over each mesh's bounds.*/
+bool usePackedVertices = false;
+
+/*Draw the terrain as chunks streamed in around the camera instead of the single terrainWidth x terrainHeight mesh.
+  Opt-in: the single terrain is the one the editor, heightmap import and splat map work on.*/
+bool useStreamingTerrain = false;
+
+/*Keep the single terrain as a 16-bit height texture drawn with one shared grid patch instead of a vertex
+  buffer; both draw with the same splat map. Opt-in: heights are quantized to 16 bits, and a
+  --heightmap import turns it on since large maps only fit this way.*/
+bool useHeightfieldTerrain = false;
+
+/*Mirror the editor's heights in 8x8 tiles for the camera's queries and the frames of imported heights.
+  Opt-in: it costs a second float per height and measures 0.7-1.2x the rows' speed on --bench tiled.*/
+bool useTiledHeightfield = false;
+
+/*Terrain nodes and triangles drawn per pass in the current frame; printed with L*/
+TerrainLODStats terrainShadowStats;
+TerrainLODStats terrainOcclusionStats;
+TerrainLODStats terrainMainStats;
+bool terrainStatsKeyHeld = false;
+
+/*Single terrain editing, set by processInput: R raises, F lowers and G flattens under a brush where the
+  view ray meets the ground (or ahead of the camera when it misses), Up/Down scale the heights, K
+  reseeds the noise and H exports the heights to terrainExportPath. The keys only work with
+  useStreamingTerrain off, which is the default, and on heightmaps up to terrainEditMaxImportedHeights;
+  otherwise the first press says so.*/
+bool terrainBrushActive = false;
+TerrainBrushMode terrainBrushMode = TERRAIN_BRUSH_RAISE;
+float terrainHeightScaleRate = 0.f;
+bool terrainReseedRequested = false;
+bool terrainReseedKeyHeld = false;
+bool terrainExportRequested = false;
+bool terrainExportKeyHeld = false;
+bool terrainEditUnavailableReported = false;
+const float terrainBrushRadius = 4.f;
+const float terrainBrushDistance = 8.f;
+const float terrainBrushReach = 200.f;
+/*Height units per second for raise/lower, fraction per second for flatten*/
+const float terrainBrushRate = 2.f;
+const float terrainFlattenRate = 2.f;
+
+int main(int argc, char** argv)
 {
+    /*Headless benchmarks, no window or GL context.*/
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+    {
+        return runBenchmarks(argc, argv);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--heightmap")
+    {
+        terrainHeightmapPath = argv[2];
+        if (argc > 3)
+        {
+            /*Both bounds or neither; a bad or reversed pair keeps the default range*/
+            auto parseHeight = [](const char* text, float& out) {
+                char* end = nullptr;
+                out = std::strtof(text, &end);
+                return end != text && *end == '\0' && std::isfinite(out);
+            };
+            float minHeight = 0.f;
+            float maxHeight = 0.f;
+            if (argc > 4 && parseHeight(argv[3], minHeight) && parseHeight(argv[4], maxHeight) && minHeight < maxHeight)
+            {
+                terrainHeightmapMinHeight = minHeight;
+                terrainHeightmapMaxHeight = maxHeight;
+            }
+            else
+            {
+                std::cout << "usage: --heightmap <path> [minHeight maxHeight] with minHeight < maxHeight; using "
+                    << terrainHeightmapMinHeight << " to " << terrainHeightmapMaxHeight << std::endl;
+            }
+        }
+    }
+
     glfwInit();
     if (!glfwInit()) {
         std::cout << "Failed to initialize GLFW." << std::endl;
@@ -394,43 +513,135 @@ int main()
 
 
     /*--------------------------------------------TERRAIN VERTICES AND BUFFER GENERATION---------------------------------------------------------*/
-    std::vector<unsigned int> terrainIndices;
-    std::vector<Vertex> terrainVertices;
-    float outMinHeight = 0.f;
-    float outMaxHeight = 0.f;
     int seed = 0;
     perlinNoiseInit(perlinG, seed);
-    generateTerrainVerticesIndices(terrainWidth, terrainHeight, hScale, terrainVertices, terrainIndices, perlinG, outMinHeight, outMaxHeight);
 
     /*OpenGL Objects*/
     std::unique_ptr<VAO> terrainVAO = std::make_unique<VAO>();
     std::unique_ptr<VBO> terrainVBO = std::make_unique<VBO>();
     std::unique_ptr<EBO> terrainEBO = std::make_unique<EBO>();
+    MeshHandle terrainHandle;
+    TerrainHeightfieldMesh terrainHeightfield;
+    TerrainSplatTexture terrainSplat;
+    /*Float heights and the splat map's height range, handed to the editor*/
+    std::vector<float> editHeights;
+    float blendMinHeight = 0.f;
+    float blendMaxHeight = 0.f;
+
+    /*Generated once per set of parameters and mapped from the cache after that. Triangle order only:
+      the splat map and the editor rely on the row-major vertex layout.*/
+    CookedTerrain cookedTerrain;
+    /*An imported heightmap is mapped and streamed a band at a time straight into the height texture,
+      which rebuilds normals on the GPU, so it never exists as a Vertex array. It is drawn as the single
+      terrain, never streamed. A map too large to edit keeps no floats either: its splat map is built a
+      band at a time and the file stays mapped for the camera.*/
+    HeightmapReader terrainHeightmap;
+    if (!terrainHeightmapPath.empty() && !terrainHeightmap.open(terrainHeightmapPath))
+    {
+        std::cout << "TERRAIN: could not read heightmap " << terrainHeightmapPath << ", generating instead" << std::endl;
+    }
+    else if (terrainHeightmap.isOpen() && !heightmapFitsTexture(terrainHeightmap))
+    {
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        std::cout << "TERRAIN: heightmap " << terrainHeightmap.gridWidth() << "x" << terrainHeightmap.gridHeight() << " is larger than GL_MAX_TEXTURE_SIZE "
+            << maxTextureSize << ", generating instead" << std::endl;
+        terrainHeightmap.close();
+    }
+    bool heightmapImported = terrainHeightmap.isOpen();
+    bool terrainEditable = true;
+    if (heightmapImported)
+    {
+        terrainWidth = terrainHeightmap.gridWidth();
+        terrainHeight = terrainHeightmap.gridHeight();
+        useHeightfieldTerrain = true;
+        useStreamingTerrain = false;
+        terrainEditable = (size_t)terrainWidth * terrainHeight <= terrainEditMaxImportedHeights;
+        blendMinHeight = terrainHeightmapMinHeight;
+        blendMaxHeight = terrainHeightmapMaxHeight;
+        if (terrainEditable)
+        {
+            editHeights.resize((size_t)terrainWidth * terrainHeight);
+            uploadHeightmapToHeightfield(terrainHeightmap, blendMinHeight, blendMaxHeight, terrainHeightfield, editHeights.data());
+            terrainHeightmap.close();
+        }
+        else
+        {
+            uploadHeightmapToHeightfield(terrainHeightmap, blendMinHeight, blendMaxHeight, terrainHeightfield, nullptr, &terrainSplat, terrainSplatSettings);
+        }
+        std::cout << "TERRAIN: " << terrainWidth << "x" << terrainHeight << " streamed from " << terrainHeightmapPath
+            << " over [" << blendMinHeight << ", " << blendMaxHeight << "]" << (terrainEditable ? "" : ", too large to edit") << std::endl;
+    }
+    else
+    {
+        TerrainCacheKey terrainCacheKey = makeTerrainCacheKey(seed, terrainWidth, terrainHeight, hScale, MESH_OPTIMIZE_VERTEX_CACHE, terrainNoise, terrainErosion,
+            terrainSplatSettings);
+        cookedTerrain.load(terrainCachePath, terrainCacheKey, perlinG, useHeightfieldTerrain ? TERRAIN_CACHE_HEIGHTS : TERRAIN_CACHE_MESH);
+        std::cout << "TERRAIN: " << (cookedTerrain.fromCache() ? "mapped from " : "generated, cached to ") << terrainCachePath << std::endl;
+        editHeights.assign(cookedTerrain.heightData(), cookedTerrain.heightData() + (size_t)terrainWidth * terrainHeight);
+        blendMinHeight = cookedTerrain.getMinHeight();
+        blendMaxHeight = cookedTerrain.getMaxHeight();
+
+        if (useHeightfieldTerrain)
+        {
+            TerrainHeightfield terrainHeights;
+            quantizeTerrainHeightfield(editHeights, terrainWidth, terrainHeight, blendMinHeight, blendMaxHeight, terrainHeights);
+            terrainHeightfield.upload(terrainHeights);
+        }
+        else
+        {
+            terrainHandle = generateTerrainBuffers(terrainVAO, terrainVBO, terrainEBO, cookedTerrain.vertexData(), cookedTerrain.vertexCount(),
+                cookedTerrain.indexData(), cookedTerrain.indexCount());
+            terrainSplat.upload(cookedTerrain.splatMapData(), terrainWidth, terrainHeight);
+        }
+    }
+    /*Only a cooked mesh carries the splat map; the heightfield builds it from the heights. A map too
+      large to edit built it band by band while uploading.*/
+    if (!cookedTerrain.splatMapData() && terrainEditable)
+    {
+        std::vector<uint32_t> splatTexels;
+        generateTerrainSplatMap(editHeights.data(), terrainWidth, terrainHeight, blendMinHeight, blendMaxHeight, terrainSplatSettings, splatTexels);
+        terrainSplat.upload(splatTexels.data(), terrainWidth, terrainHeight);
+    }
+    cookedTerrain.release();
+    std::unique_ptr<TerrainEditor> terrainEditor;
+    if (terrainEditable)
+    {
+        terrainEditor = std::make_unique<TerrainEditor>(terrainWidth, terrainHeight, hScale, perlinG, std::move(editHeights), blendMinHeight, blendMaxHeight, 0,
+            terrainNoise, terrainErosion, terrainSplatSettings, heightmapImported ? TERRAIN_HEIGHTS_IMPORTED : TERRAIN_HEIGHTS_GENERATED);
+        terrainEditor->setTiledHeights(useTiledHeightfield);
+    }
 
-    generateTerrainBuffers(terrainVAO, terrainVBO, terrainEBO, terrainVertices, terrainIndices);
-
-    std::vector<float> blendMapArray = generateBlendMap(terrainVertices, terrainWidth, terrainHeight, outMinHeight, outMaxHeight);
-    mainCamera.setBlendMap(blendMapArray);
-
-    // Generate the OpenGL texture object
-    GLuint blendMapTexture;
-    glGenTextures(1, &blendMapTexture);
-    glBindTexture(GL_TEXTURE_2D, blendMapTexture);
-
-    // Give the image to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, terrainWidth, terrainHeight, 0, GL_RED, GL_FLOAT, blendMapArray.data());
-
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Generate mipmaps
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // Unbind the texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    /*Streaming chunks sample the same field: noiseOffset puts world (x, z) where the single mesh has
+      vertex (x + width/2, z + height/2), so the streamed world continues it seamlessly*/
+    TerrainChunkSettings terrainChunkSettings;
+    terrainChunkSettings.heightScale = hScale;
+    terrainChunkSettings.noiseFrequency = 1.0f / terrainWidth;
+    terrainChunkSettings.noiseOffset = glm::vec2(terrainWidth / 2, terrainHeight / 2);
+    terrainChunkSettings.texCoordScale = 4.0f / terrainWidth;
+    terrainChunkSettings.packedVertices = usePackedVertices;
+    TerrainChunkManager terrainChunks(terrainChunkSettings, perlinG);
+    /*The chunks have no splat map; the shader weights them by height and slope over the single
+      terrain's ramps, so the two look alike where they meet*/
+    TerrainSplatRamps chunkSplatRamps = makeTerrainSplatRamps(terrainSplatSettings, blendMinHeight, blendMaxHeight);
+
+    /*The camera collides with what is drawn: the streamed field everywhere while streaming, otherwise
+      the single terrain's grid, edits included, or the mapped file of a map too large to edit*/
+    if (useStreamingTerrain)
+    {
+        mainCamera.setTerrainHeightSource([&terrainChunks](const glm::vec3& position) { return terrainChunks.heightAt(position); });
+    }
+    else if (terrainEditor)
+    {
+        mainCamera.setTerrainQuery(terrainEditor->query());
+    }
+    else
+    {
+        mainCamera.setTerrainHeightSource([&terrainHeightmap, blendMinHeight, blendMaxHeight](const glm::vec3& position) {
+            return terrainHeightmap.heightAt(position.x + float(terrainHeightmap.gridWidth() / 2), position.z + float(terrainHeightmap.gridHeight() / 2),
+                blendMinHeight, blendMaxHeight);
+        });
+    }
     /*-------------------------------------------------------------------------------------------------------------------------------------------*/
     
     /*------------------------------------------------- QUAD FOR FRAMEBUFFER---------------------------------------------------------------------*/
@@ -460,11 +671,9 @@ int main()
     /*----------------------------------------------------------OBJ PARSER-----------------------------------------------------------------------*/
 
     /*---------------------------------TOWER BUILDING OBJ--------------------------------*/
-    std::vector<Vertex> towerVertices;
-    std::vector<unsigned int> towerIndices;
-    std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint> towerUnique;
+    CookedMesh towerMesh;
 
-    if (!parseOBJFile("dep/SceneBuildings/towerBuilding.obj", towerVertices, towerIndices, towerUnique))
+    if (!towerMesh.load("dep/SceneBuildings/towerBuilding.obj", "dep/SceneBuildings/towerBuilding.mesh", MESH_OPTIMIZE_ALL))
     {
         std::cout << "OBJ PARSER: FAILED TO LOAD OBJ MODEL\n";
     }
@@ -474,16 +683,16 @@ int main()
     std::unique_ptr<EBO> towerBuilding1EBO = std::make_unique<EBO>();
 
     
-    setOBJModelBufferData(towerBuilding1VAO, towerBuilding1VBO, towerBuilding1EBO, towerVertices, towerIndices);
+    MeshHandle towerHandle = uploadModelBufferData(towerBuilding1VAO, towerBuilding1VBO, towerBuilding1EBO, towerMesh.vertexData(), towerMesh.vertexCount(), towerMesh.indexData(), towerMesh.indexCount());
+    MeshLODSet towerLODs = towerMesh.getLODSet();
+    towerMesh.release();
 
     unsigned int towerDiffuseMap = loadSRGBTextureFromBMP("dep/SceneBuildings/towerBuilding.bmp");
     /*----------------------------------------------------------------------*/
     /*---------------------------TOWER BUILDING 2------------------------------------------*/
-    std::vector<Vertex> tower2Vertices;
-    std::vector<unsigned int> tower2Indices;
-    std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint> tower2Unique;
+    CookedMesh tower2Mesh;
 
-    if (!parseOBJFile("dep/SceneBuildings/towerBuilding2.obj", tower2Vertices, tower2Indices, tower2Unique))
+    if (!tower2Mesh.load("dep/SceneBuildings/towerBuilding2.obj", "dep/SceneBuildings/towerBuilding2.mesh", MESH_OPTIMIZE_ALL))
     {
         std::cout << "OBJ PARSER: FAILED TO LOAD OBJ MODEL\n";
     }
@@ -492,14 +701,14 @@ int main()
     std::unique_ptr<VBO> towerBuilding2VBO = std::make_unique<VBO>();
     std::unique_ptr<EBO> towerBuilding2EBO = std::make_unique<EBO>();
     
-    setOBJModelBufferData(towerBuilding2VAO, towerBuilding2VBO, towerBuilding2EBO, tower2Vertices, tower2Indices);
+    MeshHandle tower2Handle = uploadModelBufferData(towerBuilding2VAO, towerBuilding2VBO, towerBuilding2EBO, tower2Mesh.vertexData(), tower2Mesh.vertexCount(), tower2Mesh.indexData(), tower2Mesh.indexCount());
+    MeshLODSet tower2LODs = tower2Mesh.getLODSet();
+    tower2Mesh.release();
 
     /*---------------------------TOWER BUILDING 3------------------------------------------*/
-    std::vector<Vertex> tower3Vertices;
-    std::vector<unsigned int> tower3Indices;
-    std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint> tower3Unique;
+    CookedMesh tower3Mesh;
 
-    if (!parseOBJFile("dep/SceneBuildings/towerBuilding3.obj", tower3Vertices, tower3Indices, tower3Unique))
+    if (!tower3Mesh.load("dep/SceneBuildings/towerBuilding3.obj", "dep/SceneBuildings/towerBuilding3.mesh", MESH_OPTIMIZE_ALL))
     {
         std::cout << "OBJ PARSER: FAILED TO LOAD OBJ MODEL\n";
     }
@@ -507,16 +716,16 @@ int main()
     std::unique_ptr<VAO> towerBuilding3VAO = std::make_unique<VAO>();
     std::unique_ptr<VBO> towerBuilding3VBO = std::make_unique<VBO>();
     std::unique_ptr<EBO> towerBuilding3EBO = std::make_unique<EBO>();
-    setOBJModelBufferData(towerBuilding3VAO, towerBuilding3VBO, towerBuilding3EBO, tower3Vertices, tower3Indices);
+    MeshHandle tower3Handle = uploadModelBufferData(towerBuilding3VAO, towerBuilding3VBO, towerBuilding3EBO, tower3Mesh.vertexData(), tower3Mesh.vertexCount(), tower3Mesh.indexData(), tower3Mesh.indexCount());
+    MeshLODSet tower3LODs = tower3Mesh.getLODSet();
+    tower3Mesh.release();
     
     /*------------------------------------------------------------------------------------------------------------*/
 
     /*--------------------------MAIN OBJ PARSER MODEL: OBELISK---------------------------------*/
-    std::vector<Vertex> obeliskVertices;
-    std::vector<unsigned int> obeliskIndices;
-    std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint> obeliskUnique;
+    CookedMesh obeliskMesh;
 
-    if (!parseOBJFile("dep/MainObelisk/obelisk.obj", obeliskVertices, obeliskIndices, obeliskUnique))
+    if (!obeliskMesh.load("dep/MainObelisk/obelisk.obj", "dep/MainObelisk/obelisk.mesh", MESH_OPTIMIZE_ALL))
     {
         std::cout << "OBJ PARSER: FAILED TO LOAD OBJ MODEL\n";
     }
@@ -524,7 +733,9 @@ int main()
     std::unique_ptr<VAO> obeliskVAO = std::make_unique<VAO>();
     std::unique_ptr<VBO> obeliskVBO = std::make_unique<VBO>();
     std::unique_ptr<EBO> obeliskEBO = std::make_unique<EBO>();
-    setOBJModelBufferData(obeliskVAO, obeliskVBO, obeliskEBO, obeliskVertices, obeliskIndices);
+    MeshHandle obeliskHandle = uploadModelBufferData(obeliskVAO, obeliskVBO, obeliskEBO, obeliskMesh.vertexData(), obeliskMesh.vertexCount(), obeliskMesh.indexData(), obeliskMesh.indexCount());
+    MeshLODSet obeliskLODs = obeliskMesh.getLODSet();
+    obeliskMesh.release();
 
     unsigned int obeliskDiffuse = loadSRGBTextureFromBMP("dep/Compressed/obeliskDiffuse.bmp");
     unsigned int obeliskEmissive = loadSRGBTextureFromBMP("dep/Compressed/obeliskEmissive.bmp");
@@ -540,7 +751,7 @@ int main()
     0, 1, 2,  // first Triangle
     0, 2, 3   // second Triangle
     };
-    createSunBuffers(sunBillboardVAO, sunBillboardVBO, sunBillboardEBO, sunIndices);
+    MeshHandle sunHandle = createSunBuffers(sunBillboardVAO, sunBillboardVBO, sunBillboardEBO, sunIndices);
 
     /*------------------------------------------------------------------------*/
 
@@ -574,7 +785,7 @@ int main()
     std::unique_ptr<VBO> octaVBO = std::make_unique<VBO>();
     std::unique_ptr<EBO> octaEBO = std::make_unique<EBO>();
 
-    std::vector<unsigned int> octaIndices = genPointLightOctahedronBuffers(octaVAO, octaVBO, octaEBO);
+    MeshHandle octaHandle = genPointLightOctahedronBuffers(octaVAO, octaVBO, octaEBO);
 
     while (!glfwWindowShouldClose(window))
     {
@@ -588,6 +799,74 @@ int main()
         /*Process input and flush buffers.*/
         processInput(window);
 
+        /*Stream terrain chunks around the camera*/
+        if (useStreamingTerrain)
+            terrainChunks.update(mainCamera.Position);
+
+        /*Edit the single terrain and upload only the rectangles that changed*/
+        if (!useStreamingTerrain && terrainEditor)
+        {
+            if (terrainBrushActive)
+            {
+                TerrainRay viewRay;
+                viewRay.origin = mainCamera.Position;
+                viewRay.direction = mainCamera.Front;
+                viewRay.maxDistance = terrainBrushReach;
+                TerrainRayHit pick = terrainEditor->raycaster().raycast(viewRay);
+                glm::vec3 brushCenter = pick.hit ? pick.position
+                    : mainCamera.Position + glm::normalize(glm::vec3(mainCamera.Front.x, 0.f, mainCamera.Front.z)) * terrainBrushDistance;
+                float brushStrength = (terrainBrushMode == TERRAIN_BRUSH_FLATTEN ? terrainFlattenRate : terrainBrushRate) * deltaTime;
+                terrainEditor->applyBrush(terrainBrushMode, brushCenter, terrainBrushRadius, brushStrength);
+            }
+            if (terrainHeightScaleRate != 0.f)
+            {
+                hScale = std::max(0.1f, hScale * (1.f + terrainHeightScaleRate * deltaTime));
+                terrainEditor->setHeightScale(hScale);
+            }
+            if (terrainReseedRequested)
+            {
+                terrainReseedRequested = false;
+                ++seed;
+                std::vector<int> editPerlinG;
+                perlinNoiseInit(editPerlinG, seed);
+                terrainEditor->setNoise(editPerlinG);
+            }
+            if (terrainExportRequested)
+            {
+                terrainExportRequested = false;
+                float exportMinHeight, exportMaxHeight;
+                terrainEditor->heightRange(terrainEditor->bounds(), exportMinHeight, exportMaxHeight);
+                bool exported = writeTerrainHeightmap(terrainExportPath, heightmapFormatFromPath(terrainExportPath), terrainEditor->gridHeights().data(),
+                    terrainEditor->gridWidth(), terrainEditor->gridHeight(), exportMinHeight, exportMaxHeight);
+                std::cout << "TERRAIN: " << (exported ? "exported to " : "could not export to ") << terrainExportPath
+                    << " over [" << exportMinHeight << ", " << exportMaxHeight << "]" << std::endl;
+            }
+            if (terrainEditor->hasEdits())
+            {
+                TerrainEditBatch edits = terrainEditor->takeEdits();
+                if (useHeightfieldTerrain)
+                    uploadTerrainEdits(*terrainEditor, edits, terrainHeightfield, terrainSplat);
+                else
+                    uploadTerrainEdits(*terrainEditor, edits, *terrainVBO, terrainHandle, terrainSplat);
+            }
+        }
+        else if (terrainBrushActive || terrainHeightScaleRate != 0.f || terrainReseedRequested || terrainExportRequested)
+        {
+            terrainReseedRequested = false;
+            terrainExportRequested = false;
+            if (!terrainEditUnavailableReported)
+            {
+                terrainEditUnavailableReported = true;
+                if (useStreamingTerrain)
+                    std::cout << "TERRAIN: editing works on the single terrain, which is not drawn while useStreamingTerrain is set" << std::endl;
+                else
+                    std::cout << "TERRAIN: the imported heightmap has more than " << terrainEditMaxImportedHeights << " heights and cannot be edited" << std::endl;
+            }
+        }
+        terrainShadowStats = TerrainLODStats();
+        terrainOcclusionStats = TerrainLODStats();
+        terrainMainStats = TerrainLODStats();
+
         glClearColor(0.f, 0.f, 0.f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -679,12 +958,12 @@ int main()
         
 
 
-        renderSceneForDepthMap(simpleDepthShader, lightSpaceMatrix, SHADOW_WIDTH, SHADOW_HEIGHT, depthMapFBO, modelMat, terrainVAO, terrainIndices, *window, towerBuilding1VAO, towerIndices, towerBuilding2VAO, tower2Indices, towerBuilding3VAO, tower3Indices, obeliskVAO, obeliskIndices, depthMapLightPos, octaVAO, octaIndices);
+        renderSceneForDepthMap(simpleDepthShader, lightSpaceMatrix, SHADOW_WIDTH, SHADOW_HEIGHT, depthMapFBO, modelMat, terrainVAO, terrainHandle, terrainChunks, terrainHeightfield, *window, towerBuilding1VAO, towerLODs, towerHandle, towerBuilding2VAO, tower2LODs, tower2Handle, towerBuilding3VAO, tower3LODs, tower3Handle, obeliskVAO, obeliskLODs, obeliskHandle, depthMapLightPos, octaVAO, octaHandle);
         /*-----------------------------------------------------------------*/
 
         /*----------------------------RENDER OCCLUSION PASS FOR GODRAYS---------------------------------------------*/
 
-        renderSceneForGodRaysOcclusionMap(godRaysOcclusionShader, currentWidth, currentHeight, projMat, viewMat, modelMat, depthMapLightPos, sunBillboardVAO, towerBuilding1VAO, towerBuilding2VAO, towerBuilding3VAO, towerIndices, tower2Indices, tower3Indices, obeliskVAO, obeliskIndices, terrainVAO, terrainIndices, godRaysColor, godRaysOcclusionFBO);
+        renderSceneForGodRaysOcclusionMap(godRaysOcclusionShader, currentWidth, currentHeight, projMat, viewMat, modelMat, depthMapLightPos, sunBillboardVAO, sunHandle, towerBuilding1VAO, towerBuilding2VAO, towerBuilding3VAO, towerLODs, tower2LODs, tower3LODs, towerHandle, tower2Handle, tower3Handle, obeliskVAO, obeliskLODs, obeliskHandle, terrainVAO, terrainHandle, terrainChunks, terrainHeightfield, godRaysColor, godRaysOcclusionFBO);
 
         /*------------------------------------------------------------MAIN RENDER TO POST PROCESS FBO----------------------------------------------------------------*/
         mainFBO->bind();
@@ -700,6 +979,9 @@ int main()
 
 
 
+        /*LOD selection for the main pass*/
+        MeshLODView mainLODView = makeMeshLODView(viewMat, projMat, currentHeight);
+
         /*TOWER BUILDING 1*/
         setShaderUniforms(mainShader, modelMat, viewMat, projMat, mainCamera.Position, lightSpaceMatrix, dirLightDirection, biasMin, biasMax, sunAngle);
         mainShader.setBool("currentMaterial.hasDiffuseMap", true);
@@ -727,6 +1009,7 @@ int main()
         mainShader.setFloat("pointLight.quadraticK", 0.02f);
 
         towerBuilding1VAO->bind();
+        setVertexDecodeUniforms(mainShader, towerHandle.decode);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, depthMapTexture);
         glActiveTexture(GL_TEXTURE2);
@@ -747,12 +1030,13 @@ int main()
             }
             modelMat = glm::scale(modelMat, glm::vec3(0.5f));
             mainShader.setMat4("modelMat", modelMat);
-            glDrawElements(GL_TRIANGLES, GLsizei(towerIndices.size()), GL_UNSIGNED_INT, nullptr);
+            drawMeshLOD(towerHandle, towerLODs, modelMat, mainLODView);
         }
 
         /*------------------------------------------TOWER BUILDING 2-----------------------------------------*/
 
         towerBuilding2VAO->bind();
+        setVertexDecodeUniforms(mainShader, tower2Handle.decode);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, depthMapTexture);
         glActiveTexture(GL_TEXTURE2);
@@ -766,11 +1050,12 @@ int main()
             glm::mat4 rotationY = glm::rotate(glm::mat4(1.0f), float(-1.59999883), glm::vec3(0.0f, 1.0f, 0.0f));
             modelMat = rotationY * modelMat;
             mainShader.setMat4("modelMat", modelMat);
-            glDrawElements(GL_TRIANGLES, GLsizei(tower2Indices.size()), GL_UNSIGNED_INT, nullptr);
+            drawMeshLOD(tower2Handle, tower2LODs, modelMat, mainLODView);
         }
 
         /*--------------------------------------TOWER BUILDING 3-----------------------*/
         towerBuilding3VAO->bind();
+        setVertexDecodeUniforms(mainShader, tower3Handle.decode);
         modelMat = glm::mat4(1.f);
         // [3] = {x=0.619141638 y=2.00000000 z=-21.7912159 }
         modelMat = glm::translate(modelMat, glm::vec3(0.619141638, 2.00000000 - 1.5f, 21.7912159));
@@ -779,7 +1064,7 @@ int main()
         glm::mat4 rotationY = glm::rotate(glm::mat4(1.0f), float(-3.16999745), glm::vec3(0.0f, 1.0f, 0.0f));
         modelMat = rotationY * modelMat;
         mainShader.setMat4("modelMat", modelMat);
-        glDrawElements(GL_TRIANGLES, GLsizei(tower3Indices.size()), GL_UNSIGNED_INT, nullptr);
+        drawMeshLOD(tower3Handle, tower3LODs, modelMat, mainLODView);
 
         /*----------------------------------Obelisk----------------------------*/
         modelMat = glm::mat4(1.f);
@@ -816,6 +1101,7 @@ int main()
 
         mainShader.setBool("isInstanced", false);
         obeliskVAO->bind();
+        setVertexDecodeUniforms(mainShader, obeliskHandle.decode);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, depthMapTexture);
         glActiveTexture(GL_TEXTURE11);
@@ -826,7 +1112,7 @@ int main()
         glBindTexture(GL_TEXTURE_2D, obeliskRoughness);
         glActiveTexture(GL_TEXTURE14);
         glBindTexture(GL_TEXTURE_2D, obeliskEmissive);
-        glDrawElements(GL_TRIANGLES, GLsizei(obeliskIndices.size()), GL_UNSIGNED_INT, nullptr);
+        drawMeshLOD(obeliskHandle, obeliskLODs, modelMat, mainLODView);
 
 
        /*TERRAIN*/
@@ -846,7 +1132,12 @@ int main()
         terrainShader.setInt("terrainInstance.normalMap2", 7);
         terrainShader.setInt("terrainInstance.AOMap2", 8);
         terrainShader.setInt("terrainInstance.roughnessMap2", 9);
-        terrainShader.setFloat("terrainInstance.blendFactor", 10);
+        terrainShader.setInt("terrainInstance.splatMap", 10);
+        terrainShader.setVec4("terrainInstance.splatSecondSet", TERRAIN_SPLAT_SECOND_SET);
+        terrainShader.setVec2("splatGridSize", float(terrainWidth), float(terrainHeight));
+        terrainShader.setBool("terrainInstance.splatFromSurface", useStreamingTerrain);
+        terrainShader.setVec2("terrainInstance.splatHeightRamp", chunkSplatRamps.minHeight, chunkSplatRamps.heightInverse);
+        terrainShader.setVec2("terrainInstance.splatSlopeRamp", chunkSplatRamps.slopeStart, chunkSplatRamps.slopeInverse);
         terrainShader.setBool("terrainInstance.hasSpecularMap", false);
         terrainShader.setVec3("terrainInstance.tSpecularValues", 0.2f, 0.2f, 0.2f);
         terrainShader.setFloat("terrainInstance.shininess", 32);
@@ -861,7 +1152,6 @@ int main()
         terrainShader.setFloat("uTime", currentFrame);
         terrainShader.setFloat("noiseScale", noiseScale);
         terrainShader.setFloat("heightScale", hScale);
-        terrainVAO->bind();
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, depthMapTexture);
         glActiveTexture(GL_TEXTURE2);
@@ -881,8 +1171,8 @@ int main()
         glActiveTexture(GL_TEXTURE9);
         glBindTexture(GL_TEXTURE_2D, floorRoughnessMap2);
         glActiveTexture(GL_TEXTURE10);
-        glBindTexture(GL_TEXTURE_2D, blendMapTexture);
-        glDrawElements(GL_TRIANGLES, GLsizei(terrainIndices.size()), GL_UNSIGNED_INT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, terrainSplat.textureID());
+        drawTerrain(terrainShader, projMat * viewMat, terrainMainStats, terrainVAO, terrainHandle, terrainChunks, terrainHeightfield);
 
         /* Octahedron */
         rotateTotalTime += deltaTime;
@@ -943,8 +1233,8 @@ int main()
         mainShader.setVec3("pointLight.lightPosition", octahedronPointLightPosition);
 
         octaVAO->bind();
-        GLsizei numberOfIndices = static_cast<GLsizei>(octaIndices.size());
-        glDrawElements(GL_TRIANGLES, numberOfIndices, GL_UNSIGNED_INT, 0);
+        setVertexDecodeUniforms(mainShader, octaHandle.decode);
+        drawMeshElements(octaHandle);
         
         mainShader.setBool("isPointLight", false);
         float factor = glm::clamp((dirLightDirection.y + 0.2f) * 0.25f, 0.0f, 1.0f);
@@ -1121,6 +1411,58 @@ void processInput(GLFWwindow* window)
         stillCamera.Position.y += 0.2f;
         std::cout << stillCamera.Position.y << "\n";
     }
+    /*Terrain stats of the previous frame, once per press*/
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !terrainStatsKeyHeld)
+    {
+        terrainStatsKeyHeld = true;
+        std::cout << "Terrain:\n";
+        printTerrainStats("shadow", terrainShadowStats);
+        printTerrainStats("god-ray occlusion", terrainOcclusionStats);
+        printTerrainStats("main", terrainMainStats);
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+    {
+        terrainStatsKeyHeld = false;
+    }
+
+    /*Terrain editing, applied in the render loop*/
+    terrainBrushActive = true;
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+        terrainBrushMode = TERRAIN_BRUSH_RAISE;
+    else if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+        terrainBrushMode = TERRAIN_BRUSH_LOWER;
+    else if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
+        terrainBrushMode = TERRAIN_BRUSH_FLATTEN;
+    else
+        terrainBrushActive = false;
+
+    terrainHeightScaleRate = 0.f;
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        terrainHeightScaleRate = 0.5f;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        terrainHeightScaleRate = -0.5f;
+
+    /*New seed once per press*/
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && !terrainReseedKeyHeld)
+    {
+        terrainReseedKeyHeld = true;
+        terrainReseedRequested = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE)
+    {
+        terrainReseedKeyHeld = false;
+    }
+
+    /*Heightmap export once per press*/
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !terrainExportKeyHeld)
+    {
+        terrainExportKeyHeld = true;
+        terrainExportRequested = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE)
+    {
+        terrainExportKeyHeld = false;
+    }
 
 }
 
@@ -1171,41 +1513,125 @@ void mouseCallback(GLFWwindow* window, double xPosInput, double yPosInput)
     mainCamera.processMouseMovement(xOffset, yOffset);
 }
 
-void setOBJModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, std::vector<Vertex>& outVertices,
+MeshHandle setOBJModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, std::vector<Vertex>& outVertices,
     std::vector<unsigned int>& orderedIndices)
+{
+    return setOBJModelBufferData(objVAO, objVBO, objIBO, outVertices.data(), outVertices.size(), orderedIndices.data(), orderedIndices.size());
+}
+
+/*Pointer overload so a mapped cooked mesh is uploaded without copying it first*/
+MeshHandle setOBJModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, const Vertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount)
 {
     objVAO->bind();
 
     objVBO->bind();
-    glBufferData(GL_ARRAY_BUFFER, outVertices.size() * sizeof(Vertex), outVertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
 
     objIBO->bind();
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, orderedIndices.size() * sizeof(unsigned int), orderedIndices.data(), GL_STATIC_DRAW);
+    MeshHandle mesh = uploadIndexBuffer(indices, indexCount, vertexCount);
 
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, vPos));
-    glEnableVertexAttribArray(0);
+    setVertexAttributePointers();
+    
+    // Unbind VBO and VAO
+    objVAO->unbind();
+    objVBO->unbind();
+    objIBO->unbind();
+    return mesh;
+}
 
-    // Texture coordinate attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, vTexCoords));
-    glEnableVertexAttribArray(1);
+/*Packed layout: attribute 0 is unorm16 relative to the mesh AABB, attribute 1 half floats, and the
+  tangent frame is one quaternion at PACKED_QTANGENT_LOCATION in place of attributes 2-4*/
+MeshHandle setPackedModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, const PackedVertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount)
+{
+    objVAO->bind();
 
-    // Normal attribute
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vNormals)));
-    glEnableVertexAttribArray(2);
+    objVBO->bind();
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), vertices, GL_STATIC_DRAW);
+
+    objIBO->bind();
+    MeshHandle mesh = uploadIndexBuffer(indices, indexCount, vertexCount);
 
-    // Normal attribute
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vTangent)));
-    glEnableVertexAttribArray(3);
+    setPackedVertexAttributePointers();
 
-    // Normal attribute
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vBiTangent)));
-    glEnableVertexAttribArray(4);
-    
     // Unbind VBO and VAO
     objVAO->unbind();
     objVBO->unbind();
     objIBO->unbind();
+    return mesh;
+}
+
+/*Upload in the format selected by usePackedVertices; the handle carries the index type and what the
+  shaders need to decode the vertices*/
+MeshHandle uploadModelBufferData(const std::unique_ptr<VAO>& objVAO, const std::unique_ptr<VBO>& objVBO, const std::unique_ptr<EBO>& objIBO, const Vertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount)
+{
+    if (!usePackedVertices)
+        return setOBJModelBufferData(objVAO, objVBO, objIBO, vertices, vertexCount, indices, indexCount);
+
+    VertexDecodeParams decodeParams = computePackedVertexParams(vertices, vertexCount);
+    std::vector<PackedVertex> packedVertices = packVertices(vertices, vertexCount, decodeParams);
+    MeshHandle mesh = setPackedModelBufferData(objVAO, objVBO, objIBO, packedVertices.data(), packedVertices.size(), indices, indexCount);
+    mesh.decode = decodeParams;
+    return mesh;
+}
+
+/*Set before every draw: the shader is shared between packed and unpacked meshes*/
+void setVertexDecodeUniforms(Shader& shader, const VertexDecodeParams& decodeParams)
+{
+    shader.setBool("isPackedVertex", decodeParams.packed);
+    shader.setVec3("packedPositionMin", decodeParams.positionMin);
+    shader.setVec3("packedPositionExtent", decodeParams.positionExtent);
+}
+
+/*The streamed chunks when useStreamingTerrain is set, LOD-selected and culled against viewProj,
+  otherwise the single terrain, from its height texture with useHeightfieldTerrain. Adds what was
+  drawn to stats.*/
+void drawTerrain(Shader& shader, const glm::mat4& viewProj, TerrainLODStats& stats, const std::unique_ptr<VAO>& terrainVAO, const MeshHandle& terrainHandle, const TerrainChunkManager& terrainChunks, const TerrainHeightfieldMesh& terrainHeightfield)
+{
+    if (useStreamingTerrain) {
+        shader.setInt("terrainMorphSide", terrainChunks.chunkGridSide());
+        shader.setVec3("terrainMorphCenter", terrainChunks.lodCenterPosition());
+        terrainChunks.draw(viewProj, stats,
+            [&shader](const MeshHandle& chunk) { setVertexDecodeUniforms(shader, chunk.decode); },
+            [&shader](const TerrainLODMorphParams& level) {
+                shader.setBool("isTerrainMorph", true);
+                shader.setInt("terrainMorphStride", level.stride);
+                shader.setVec2("terrainMorphRange", level.morphRange);
+            });
+        /*The shader is shared with the other meshes*/
+        shader.setBool("isTerrainMorph", false);
+        return;
+    }
+    if (useHeightfieldTerrain) {
+        shader.setBool("isHeightfieldTerrain", true);
+        shader.setInt("terrainHeightfield", TERRAIN_HEIGHTFIELD_TEXTURE_UNIT);
+        shader.setInt("heightfieldWidth", terrainHeightfield.gridWidth());
+        shader.setInt("heightfieldHeight", terrainHeightfield.gridHeight());
+        shader.setInt("heightfieldPatchQuads", terrainHeightfield.quadsPerPatch());
+        shader.setInt("heightfieldPatchesPerRow", terrainHeightfield.patchesPerRow());
+        shader.setVec2("heightfieldRange", terrainHeightfield.decodeRange());
+        shader.setFloat("heightfieldTexRepeat", TERRAIN_HEIGHTFIELD_TEX_REPEAT);
+        terrainHeightfield.draw();
+        shader.setBool("isHeightfieldTerrain", false);
+        ++stats.nodes;
+        stats.triangles += terrainHeightfield.triangleCount();
+        stats.fullTriangles += terrainHeightfield.triangleCount();
+        return;
+    }
+    terrainVAO->bind();
+    setVertexDecodeUniforms(shader, terrainHandle.decode);
+    drawMeshElements(terrainHandle);
+    ++stats.nodes;
+    stats.triangles += size_t(terrainHandle.indexCount) / 3;
+    stats.fullTriangles += size_t(terrainHandle.indexCount) / 3;
+}
+
+void printTerrainStats(const char* pass, const TerrainLODStats& stats)
+{
+    std::cout << "  " << pass << ": " << stats.nodes << " nodes (" << stats.culledNodes << " culled), " << stats.triangles << " triangles of "
+        << stats.fullTriangles << " at full density\n";
 }
 
 // TEMP QUAD FOR VIZ DEPTH MAP.
@@ -1276,13 +1702,14 @@ void createDepthMapFBO(FBO* depthMapFBO, unsigned int& depthMapTexture, unsigned
     depthMapFBO->unbind();
 }
 
-void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatrix, const unsigned int& SHADOW_WIDTH, const unsigned int& SHADOW_HEIGHT, const std::unique_ptr<FBO>& depthMapFBO, glm::mat4& modelMat, const std::unique_ptr<VAO>& terrainVAO, std::vector<unsigned int>& terrainIndices, GLFWwindow& window, const std::unique_ptr<VAO>& towerVAO, std::vector<unsigned int>& towerIndices, const std::unique_ptr<VAO>& tower2VAO, std::vector<unsigned int>& tower2Indices, const std::unique_ptr<VAO>& tower3VAO, std::vector<unsigned int>& tower3Indices, const std::unique_ptr<VAO>& obeliskVAO, std::vector<unsigned int>& obeliskIndices, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& octaVAO, std::vector<unsigned int>& octaIndices)
+void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatrix, const unsigned int& SHADOW_WIDTH, const unsigned int& SHADOW_HEIGHT, const std::unique_ptr<FBO>& depthMapFBO, glm::mat4& modelMat, const std::unique_ptr<VAO>& terrainVAO, const MeshHandle& terrainHandle, const TerrainChunkManager& terrainChunks, const TerrainHeightfieldMesh& terrainHeightfield, GLFWwindow& window, const std::unique_ptr<VAO>& towerVAO, const MeshLODSet& towerLODs, const MeshHandle& towerHandle, const std::unique_ptr<VAO>& tower2VAO, const MeshLODSet& tower2LODs, const MeshHandle& tower2Handle, const std::unique_ptr<VAO>& tower3VAO, const MeshLODSet& tower3LODs, const MeshHandle& tower3Handle, const std::unique_ptr<VAO>& obeliskVAO, const MeshLODSet& obeliskLODs, const MeshHandle& obeliskHandle, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& octaVAO, const MeshHandle& octaHandle)
 {
     simpleDepthShader.UseShader();
     glm::mat4 lightProjection, lightView;
     lightProjection = glm::ortho(orthoLeftWidth, orthoRightWidth, orthoBotLength, orthoTopLength, nearPlane, farPlane);
     lightView = glm::lookAt(depthMapLightPos, glm::vec3(0.f), glm::vec3(0.0, 1.0, 0.0));
     lightSpaceMatrix = lightProjection * lightView;
+    MeshLODView lodView = makeMeshLODView(lightView, lightProjection, int(SHADOW_HEIGHT));
 
     depthMapFBO->bind();
     glClear(GL_DEPTH_BUFFER_BIT);
@@ -1296,6 +1723,7 @@ void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatr
 
     /*TOWER 1*/
     towerVAO->bind();
+    setVertexDecodeUniforms(simpleDepthShader, towerHandle.decode);
     for (int i = 0; i < 3; i++)
     {
         modelMat = glm::mat4(1.f);
@@ -1311,11 +1739,12 @@ void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatr
         }
         modelMat = glm::scale(modelMat, glm::vec3(0.5f));
         simpleDepthShader.setMat4("modelMat", modelMat);
-        glDrawElements(GL_TRIANGLES, GLsizei(towerIndices.size()), GL_UNSIGNED_INT, nullptr);
+        drawMeshLOD(towerHandle, towerLODs, modelMat, lodView);
     }
 
     /*TOWER 2*/
     tower2VAO->bind();
+    setVertexDecodeUniforms(simpleDepthShader, tower2Handle.decode);
     for (glm::vec3 location : tower2Locations)
     {
         modelMat = glm::mat4(1.f);
@@ -1324,11 +1753,12 @@ void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatr
         glm::mat4 rotationY = glm::rotate(glm::mat4(1.0f), float(-1.59999883), glm::vec3(0.0f, 1.0f, 0.0f));
         modelMat = rotationY * modelMat;
         simpleDepthShader.setMat4("modelMat", modelMat);
-        glDrawElements(GL_TRIANGLES, GLsizei(tower2Indices.size()), GL_UNSIGNED_INT, nullptr);
+        drawMeshLOD(tower2Handle, tower2LODs, modelMat, lodView);
     }
 
     /*TOWER 3*/
     tower3VAO->bind();
+    setVertexDecodeUniforms(simpleDepthShader, tower3Handle.decode);
     modelMat = glm::mat4(1.f);
     // [3] = {x=0.619141638 y=2.00000000 z=-21.7912159 }
     modelMat = glm::translate(modelMat, glm::vec3(0.619141638, 2.00000000 - 1.5f, 21.7912159));
@@ -1337,10 +1767,11 @@ void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatr
     glm::mat4 rotationY = glm::rotate(glm::mat4(1.0f), float(-3.16999745), glm::vec3(0.0f, 1.0f, 0.0f));
     modelMat = rotationY * modelMat;
     simpleDepthShader.setMat4("modelMat", modelMat);
-    glDrawElements(GL_TRIANGLES, GLsizei(tower3Indices.size()), GL_UNSIGNED_INT, nullptr);
+    drawMeshLOD(tower3Handle, tower3LODs, modelMat, lodView);
 
     /*OBELISK*/
     obeliskVAO->bind();
+    setVertexDecodeUniforms(simpleDepthShader, obeliskHandle.decode);
     modelMat = glm::mat4(1.f);
     float yOffset = obeliskAmplitude * sin(obeliskFrequency * obeliskTime);
     //[3] = {x=0.199999854 y=10.9999943 z=0.00000000 }
@@ -1348,13 +1779,12 @@ void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatr
     obeliskTime += deltaTime;
     modelMat = glm::scale(modelMat, glm::vec3(2.f));
     simpleDepthShader.setMat4("modelMat", modelMat);
-    glDrawElements(GL_TRIANGLES, GLsizei(obeliskIndices.size()), GL_UNSIGNED_INT, nullptr);
+    drawMeshLOD(obeliskHandle, obeliskLODs, modelMat, lodView);
 
     /*TERRAIN*/
     modelMat = glm::mat4(1.f);
     simpleDepthShader.setMat4("modelMat", modelMat);
-    terrainVAO->bind();
-    glDrawElements(GL_TRIANGLES, GLsizei(terrainIndices.size()), GL_UNSIGNED_INT, nullptr);
+    drawTerrain(simpleDepthShader, lightSpaceMatrix, terrainShadowStats, terrainVAO, terrainHandle, terrainChunks, terrainHeightfield);
 
     /*Octahedron*/
     modelMat = glm::mat4(1.f);
@@ -1362,8 +1792,8 @@ void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatr
     modelMat = glm::scale(modelMat, glm::vec3(2.f));
     simpleDepthShader.setMat4("modelMat", modelMat);
     octaVAO->bind();
-    GLsizei numberOfIndices = static_cast<GLsizei>(octaIndices.size());
-    glDrawElements(GL_TRIANGLES, numberOfIndices, GL_UNSIGNED_INT, 0);
+    setVertexDecodeUniforms(simpleDepthShader, octaHandle.decode);
+    drawMeshElements(octaHandle);
 
 
     depthMapFBO->unbind();
@@ -1375,41 +1805,29 @@ void renderSceneForDepthMap(Shader& simpleDepthShader, glm::mat4& lightSpaceMatr
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void generateTerrainBuffers(const std::unique_ptr<VAO>& terrainVAO, const std::unique_ptr<VBO>& terrainVBO, const std::unique_ptr<EBO>& terrainIBO, const std::vector<Vertex>& terrainVertices, const std::vector<unsigned int>& terrainIndices)
+/*Pointers so the cooked terrain is uploaded straight from its mapping*/
+MeshHandle generateTerrainBuffers(const std::unique_ptr<VAO>& terrainVAO, const std::unique_ptr<VBO>& terrainVBO, const std::unique_ptr<EBO>& terrainIBO, const Vertex* terrainVertices, size_t vertexCount,
+    const unsigned int* terrainIndices, size_t indexCount)
 {
+    if (usePackedVertices)
+        return uploadModelBufferData(terrainVAO, terrainVBO, terrainIBO, terrainVertices, vertexCount, terrainIndices, indexCount);
+
     terrainVAO->bind();
 
     terrainVBO->bind();
 
-    glBufferData(GL_ARRAY_BUFFER, terrainVertices.size() * sizeof(Vertex), terrainVertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), terrainVertices, GL_STATIC_DRAW);
 
     terrainIBO->bind();
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrainIndices.size() * sizeof(unsigned int), terrainIndices.data(), GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, vPos));
-    glEnableVertexAttribArray(0);
-
-    // Texture coordinate attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, vTexCoords));
-    glEnableVertexAttribArray(1);
+    MeshHandle mesh = uploadIndexBuffer(terrainIndices, indexCount, vertexCount);
 
-    // Normal attribute
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vNormals)));
-    glEnableVertexAttribArray(2);
-
-    // Normal attribute
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vTangent)));
-    glEnableVertexAttribArray(3);
-
-    // Normal attribute
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vBiTangent)));
-    glEnableVertexAttribArray(4);
+    setVertexAttributePointers();
     
     // Unbind VBO and VAO
     terrainVAO->unbind();
     terrainVBO->unbind();
     terrainIBO->unbind();
+    return mesh;
 }
 
 void setShaderUniforms(Shader& mainShader, glm::mat4& modelMat, glm::mat4& viewMat, glm::mat4& projMat, glm::vec3& viewPos, glm::mat4& lightSpaceMatrix, glm::vec3& lightDirection, float& biasMin, float& biasMax, float& sunAngle)
@@ -1598,7 +2016,7 @@ void generateOcclusionAndGodRaysFramebuffer(std::unique_ptr<FBO>& godRaysFBO, un
     godRaysFBO->unbind();
 }
 
-void createSunBuffers(const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<VBO>& sunVBO, const std::unique_ptr<EBO>& sunEBO, std::vector<unsigned int>& sunIndices)
+MeshHandle createSunBuffers(const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<VBO>& sunVBO, const std::unique_ptr<EBO>& sunEBO, std::vector<unsigned int>& sunIndices)
 {
     float sunVertices[] = {
         // positions   // texCoords
@@ -1613,7 +2031,7 @@ void createSunBuffers(const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<
     glBufferData(GL_ARRAY_BUFFER, sizeof(sunVertices), sunVertices, GL_STATIC_DRAW);
 
     sunEBO->bind();
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sunIndices.size() * sizeof(unsigned int), sunIndices.data(), GL_STATIC_DRAW);
+    MeshHandle mesh = uploadIndexBuffer(sunIndices.data(), sunIndices.size(), 4);
 
     // Position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -1625,9 +2043,10 @@ void createSunBuffers(const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<
     sunVAO->unbind();
     sunVBO->unbind();
     sunEBO->unbind();
+    return mesh;
 }
 
-void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& currentWidth, int& currentHeight, glm::mat4& projMat, glm::mat4& viewMat, glm::mat4& modelMat, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& sunVAO, const std::unique_ptr<VAO>& towerVAO, const std::unique_ptr<VAO>& tower2VAO, const std::unique_ptr<VAO>& tower3VAO, std::vector<unsigned int>& towerIndices, std::vector<unsigned int>& tower2Indices, std::vector<unsigned int>& tower3Indices, const std::unique_ptr<VAO>& obeliskVAO, std::vector<unsigned int>& obeliskIndices, const std::unique_ptr<VAO>& terrainVAO, std::vector<unsigned int>& terrainIndices, glm::vec3& godRaysColor, const std::unique_ptr<FBO>& occlusionFBO)
+void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& currentWidth, int& currentHeight, glm::mat4& projMat, glm::mat4& viewMat, glm::mat4& modelMat, glm::vec3& depthMapLightPos, const std::unique_ptr<VAO>& sunVAO, const MeshHandle& sunHandle, const std::unique_ptr<VAO>& towerVAO, const std::unique_ptr<VAO>& tower2VAO, const std::unique_ptr<VAO>& tower3VAO, const MeshLODSet& towerLODs, const MeshLODSet& tower2LODs, const MeshLODSet& tower3LODs, const MeshHandle& towerHandle, const MeshHandle& tower2Handle, const MeshHandle& tower3Handle, const std::unique_ptr<VAO>& obeliskVAO, const MeshLODSet& obeliskLODs, const MeshHandle& obeliskHandle, const std::unique_ptr<VAO>& terrainVAO, const MeshHandle& terrainHandle, const TerrainChunkManager& terrainChunks, const TerrainHeightfieldMesh& terrainHeightfield, glm::vec3& godRaysColor, const std::unique_ptr<FBO>& occlusionFBO)
 {
     occlusionFBO->bind();
     glViewport(0, 0, currentWidth, currentHeight);
@@ -1638,6 +2057,7 @@ void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& curr
 
     godRaysOcclusionShader.setMat4("projMat", projMat);
     godRaysOcclusionShader.setMat4("viewMat", viewMat);
+    MeshLODView lodView = makeMeshLODView(viewMat, projMat, currentHeight);
 
     /*Render sun billboard*/
     modelMat = glm::mat4(1.f);
@@ -1662,13 +2082,15 @@ void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& curr
     godRaysOcclusionShader.setBool("isSun", true);
     godRaysOcclusionShader.setVec3("godRaysColor", godRaysColor);
     sunVAO->bind();
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    setVertexDecodeUniforms(godRaysOcclusionShader, sunHandle.decode);
+    drawMeshElements(sunHandle);
     glEnable(GL_BLEND);
 
     /*Render Tower Buildings*/
     /*Tower 1*/
     godRaysOcclusionShader.setBool("isSun", false);
     towerVAO->bind();
+    setVertexDecodeUniforms(godRaysOcclusionShader, towerHandle.decode);
     for (int i = 0; i < 3; i++)
     {
         modelMat = glm::mat4(1.f);
@@ -1684,12 +2106,13 @@ void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& curr
         }
         modelMat = glm::scale(modelMat, glm::vec3(0.5f));
         godRaysOcclusionShader.setMat4("modelMat", modelMat);
-        glDrawElements(GL_TRIANGLES, GLsizei(towerIndices.size()), GL_UNSIGNED_INT, nullptr);
+        drawMeshLOD(towerHandle, towerLODs, modelMat, lodView);
     }
 
     /*Tower 2*/
     godRaysOcclusionShader.setBool("isSun", false);
     tower2VAO->bind();
+    setVertexDecodeUniforms(godRaysOcclusionShader, tower2Handle.decode);
     for (glm::vec3 location : tower2Locations)
     {
         modelMat = glm::mat4(1.f);
@@ -1698,12 +2121,13 @@ void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& curr
         glm::mat4 rotationY = glm::rotate(glm::mat4(1.0f), float(-1.59999883), glm::vec3(0.0f, 1.0f, 0.0f));
         modelMat = rotationY * modelMat;
         godRaysOcclusionShader.setMat4("modelMat", modelMat);
-        glDrawElements(GL_TRIANGLES, GLsizei(tower2Indices.size()), GL_UNSIGNED_INT, nullptr);
+        drawMeshLOD(tower2Handle, tower2LODs, modelMat, lodView);
     }
 
     /*Tower 3*/
     godRaysOcclusionShader.setBool("isSun", false);
     tower3VAO->bind();
+    setVertexDecodeUniforms(godRaysOcclusionShader, tower3Handle.decode);
     modelMat = glm::mat4(1.f);
     // [3] = {x=0.619141638 y=2.00000000 z=-21.7912159 }
     modelMat = glm::translate(modelMat, glm::vec3(0.619141638, 2.00000000 - 1.5f, 21.7912159));
@@ -1712,11 +2136,12 @@ void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& curr
     glm::mat4 rotationY = glm::rotate(glm::mat4(1.0f), float(-3.16999745), glm::vec3(0.0f, 1.0f, 0.0f));
     modelMat = rotationY * modelMat;
     godRaysOcclusionShader.setMat4("modelMat", modelMat);
-    glDrawElements(GL_TRIANGLES, GLsizei(tower3Indices.size()), GL_UNSIGNED_INT, nullptr);
+    drawMeshLOD(tower3Handle, tower3LODs, modelMat, lodView);
 
     /*Render obelisk*/
     godRaysOcclusionShader.setBool("isSun", false);
     obeliskVAO->bind();
+    setVertexDecodeUniforms(godRaysOcclusionShader, obeliskHandle.decode);
     modelMat = glm::mat4(1.f);
     float yOffset = obeliskAmplitude * sin(obeliskFrequency * obeliskTime);
     //[3] = {x=0.199999854 y=10.9999943 z=0.00000000 }
@@ -1724,19 +2149,18 @@ void renderSceneForGodRaysOcclusionMap(Shader& godRaysOcclusionShader, int& curr
     obeliskTime += deltaTime;
     modelMat = glm::scale(modelMat, glm::vec3(2.f));
     godRaysOcclusionShader.setMat4("modelMat", modelMat);
-    glDrawElements(GL_TRIANGLES, GLsizei(obeliskIndices.size()), GL_UNSIGNED_INT, nullptr);
+    drawMeshLOD(obeliskHandle, obeliskLODs, modelMat, lodView);
 
     /*Render terrain*/
     godRaysOcclusionShader.setBool("isSun", false);
-    terrainVAO->bind();
     modelMat = glm::mat4(1.f);
     godRaysOcclusionShader.setMat4("modelMat", modelMat);
 
-    glDrawElements(GL_TRIANGLES, GLsizei(terrainIndices.size()), GL_UNSIGNED_INT, nullptr);
+    drawTerrain(godRaysOcclusionShader, projMat * viewMat, terrainOcclusionStats, terrainVAO, terrainHandle, terrainChunks, terrainHeightfield);
 
     occlusionFBO->unbind();
 }
-std::vector<unsigned int> genPointLightOctahedronBuffers(const std::unique_ptr<VAO>& octaVAO, const std::unique_ptr<VBO>& octaVBO, const std::unique_ptr<EBO>& octaEBO)
+MeshHandle genPointLightOctahedronBuffers(const std::unique_ptr<VAO>& octaVAO, const std::unique_ptr<VBO>& octaVBO, const std::unique_ptr<EBO>& octaEBO)
 {
     std::vector<unsigned int> octahedronIndices =
     {
@@ -1774,7 +2198,7 @@ std::vector<unsigned int> genPointLightOctahedronBuffers(const std::unique_ptr<V
     glBufferData(GL_ARRAY_BUFFER, sizeof(octahedronVertices), octahedronVertices, GL_STATIC_DRAW);
 
     octaEBO->bind();
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, octahedronIndices.size() * sizeof(unsigned int), octahedronIndices.data(), GL_STATIC_DRAW);
+    MeshHandle mesh = uploadIndexBuffer(octahedronIndices.data(), octahedronIndices.size(), 10);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -1786,7 +2210,7 @@ std::vector<unsigned int> genPointLightOctahedronBuffers(const std::unique_ptr<V
     glEnableVertexAttribArray(2);
 
     octaVAO->unbind();
-    return octahedronIndices;
+    return mesh;
 }
 
 unsigned int loadTextureFromBMP(const char* path)
@@ -2035,3 +2459,304 @@ unsigned int loadCubemap(std::vector<std::string>& cubemapFaces)
     return textureID;
 }
 
+/*Usage: FinalProjectCW3 --bench [name|all] [args...]*/
+int runBenchmarks(int argc, char** argv)
+{
+    std::string benchmarkName = argc > 2 ? argv[2] : "all";
+    bool runAll = benchmarkName == "all";
+
+    if (runAll || benchmarkName == "obj")
+    {
+        /*Optional OBJ path, otherwise a 64 MB synthetic mesh.*/
+        std::string objPath = (!runAll && argc > 3) ? argv[3] : "bench_synthetic.obj";
+        if (runAll || argc <= 3)
+        {
+            writeSyntheticOBJ(objPath, size_t(64) << 20);
+        }
+        runOBJParserBenchmark(objPath, 3);
+    }
+
+    if (runAll || benchmarkName == "objmt")
+    {
+        /*Optional OBJ path, otherwise a 500 MB synthetic mesh.*/
+        std::string objPath = (!runAll && argc > 3) ? argv[3] : "bench_synthetic_large.obj";
+        if (runAll || argc <= 3)
+        {
+            writeSyntheticOBJ(objPath, size_t(500) << 20);
+        }
+        runOBJParallelBenchmark(objPath, sharedThreadPool().size() + 1, 1);
+    }
+
+    if (runAll || benchmarkName == "mesh")
+    {
+        /*Optional OBJ path, otherwise the 64 MB synthetic mesh. Writes <path>.mesh next to it.*/
+        std::string objPath = (!runAll && argc > 3) ? argv[3] : "bench_synthetic.obj";
+        if (!runAll && argc <= 3)
+        {
+            writeSyntheticOBJ(objPath, size_t(64) << 20);
+        }
+        runMeshCacheBenchmark(objPath, 3);
+    }
+
+    if (runAll || benchmarkName == "meshopt")
+    {
+        /*Optional OBJ path, otherwise a 16 MB synthetic mesh; then a 512x512 terrain grid.*/
+        std::string objPath = (!runAll && argc > 3) ? argv[3] : "bench_synthetic_small.obj";
+        if (runAll || argc <= 3)
+        {
+            writeSyntheticOBJ(objPath, size_t(16) << 20);
+        }
+        std::vector<Vertex> objVertices;
+        std::vector<unsigned int> objIndices;
+        if (parseOBJFile(objPath, objVertices, objIndices))
+        {
+            runMeshOptimizerBenchmark(objPath, objVertices, objIndices, MESH_OPTIMIZE_ALL, 3);
+        }
+
+        std::vector<Vertex> gridVertices;
+        std::vector<unsigned int> gridIndices;
+        int gridSize = 512;
+        int seed = 0;
+        float gridMinHeight = 0.f;
+        float gridMaxHeight = 0.f;
+        perlinNoiseInit(perlinG, seed);
+        generateTerrainVerticesIndices(gridSize, gridSize, hScale, gridVertices, gridIndices, perlinG, gridMinHeight, gridMaxHeight);
+        runMeshOptimizerBenchmark("terrain 512x512", gridVertices, gridIndices, MESH_OPTIMIZE_VERTEX_CACHE, 3);
+    }
+
+    if (runAll || benchmarkName == "lod")
+    {
+        /*Optional OBJ path, otherwise the 16 MB synthetic mesh.*/
+        std::string objPath = (!runAll && argc > 3) ? argv[3] : "bench_synthetic_small.obj";
+        if (!runAll && argc <= 3)
+        {
+            writeSyntheticOBJ(objPath, size_t(16) << 20);
+        }
+        std::vector<Vertex> objVertices;
+        std::vector<unsigned int> objIndices;
+        if (parseOBJFile(objPath, objVertices, objIndices))
+        {
+            optimizeMesh(objVertices, objIndices, MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_VERTEX_FETCH);
+            runMeshLODBenchmark(objPath, objVertices, objIndices);
+        }
+    }
+
+    if (runAll || benchmarkName == "packed")
+    {
+        /*Optional OBJ path, otherwise the 16 MB synthetic mesh; then a 512x512 terrain grid.
+          Exits with 1 if a decode error is out of bounds.*/
+        std::string objPath = (!runAll && argc > 3) ? argv[3] : "bench_synthetic_small.obj";
+        if (!runAll && argc <= 3)
+        {
+            writeSyntheticOBJ(objPath, size_t(16) << 20);
+        }
+        bool passed = true;
+        std::vector<Vertex> objVertices;
+        std::vector<unsigned int> objIndices;
+        if (parseOBJFile(objPath, objVertices, objIndices))
+        {
+            passed &= runPackedVertexBenchmark(objPath, objVertices, 3);
+        }
+
+        std::vector<Vertex> gridVertices;
+        std::vector<unsigned int> gridIndices;
+        int gridSize = 512;
+        int seed = 0;
+        float gridMinHeight = 0.f;
+        float gridMaxHeight = 0.f;
+        perlinNoiseInit(perlinG, seed);
+        generateTerrainVerticesIndices(gridSize, gridSize, hScale, gridVertices, gridIndices, perlinG, gridMinHeight, gridMaxHeight);
+        passed &= runPackedVertexBenchmark("terrain 512x512", gridVertices, 3);
+
+        if (!passed)
+            return 1;
+    }
+
+    if (runAll || benchmarkName == "tangent")
+    {
+        /*Optional OBJ path, otherwise the 64 MB synthetic mesh; then a 1024x1024 terrain grid.
+          Exits with 1 if a SIMD level or thread count disagrees with the scalar single-threaded run.*/
+        std::string objPath = (!runAll && argc > 3) ? argv[3] : "bench_synthetic.obj";
+        if (!runAll && argc <= 3)
+        {
+            writeSyntheticOBJ(objPath, size_t(64) << 20);
+        }
+        bool passed = true;
+        std::vector<Vertex> objVertices;
+        std::vector<unsigned int> objIndices;
+        if (parseOBJFile(objPath, objVertices, objIndices))
+        {
+            passed &= runTangentFrameBenchmark(objPath, objVertices, objIndices, 3);
+        }
+
+        std::vector<Vertex> gridVertices;
+        std::vector<unsigned int> gridIndices;
+        int gridSize = 1024;
+        int seed = 0;
+        float gridMinHeight = 0.f;
+        float gridMaxHeight = 0.f;
+        perlinNoiseInit(perlinG, seed);
+        generateTerrainVerticesIndices(gridSize, gridSize, hScale, gridVertices, gridIndices, perlinG, gridMinHeight, gridMaxHeight);
+        passed &= runTangentFrameBenchmark("terrain 1024x1024", gridVertices, gridIndices, 3);
+
+        if (!passed)
+            return 1;
+    }
+
+    if (runAll || benchmarkName == "noise")
+    {
+        /*Optional sample count, otherwise 4M. Exits with 1 if a SIMD level disagrees with scalar
+          or leaves the float tolerance, for values or gradients.*/
+        size_t sampleCount = (!runAll && argc > 3) ? size_t(std::stoull(argv[3])) : (size_t(1) << 22);
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runNoiseBenchmark(perlinG, sampleCount, 5, 3))
+            return 1;
+    }
+
+    if (runAll || benchmarkName == "noisematrix")
+    {
+        /*Optional sample count, otherwise 256K. Exits with 1 if float or fixed point leaves its tolerance
+          against double.*/
+        size_t sampleCount = (!runAll && argc > 3) ? size_t(std::stoull(argv[3])) : (size_t(1) << 18);
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runNoiseBackendBenchmark(perlinG, sampleCount))
+            return 1;
+    }
+
+    if (runAll || benchmarkName == "terrain")
+    {
+        /*Optional largest grid side, otherwise 8193 (~4 GB of vertices). Exits with 1 if a threaded
+          run differs from the serial one.*/
+        int maxGridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 8193;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainGenerationBenchmark(perlinG, maxGridSize))
+            return 1;
+    }
+
+    if (runAll || benchmarkName == "stream")
+    {
+        /*Optional flight distance and speed in world units, otherwise 16384 at 1000 units/s. Exits
+          with 1 if chunk borders do not match or memory grows during the flight.*/
+        float distance = (!runAll && argc > 3) ? std::stof(argv[3]) : 16384.0f;
+        float speed = (!runAll && argc > 4) ? std::stof(argv[4]) : 1000.0f;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainStreamingBenchmark(perlinG, distance, speed))
+            return 1;
+    }
+    if (runAll || benchmarkName == "cdlod")
+    {
+        /*Optional largest grid side, otherwise 4097. Exits with 1 if the selection of the whole grid
+          leaves a hole or an overlap.*/
+        int maxGridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 4097;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainLODBenchmark(perlinG, maxGridSize))
+            return 1;
+    }
+    if (runAll || benchmarkName == "heightfield")
+    {
+        /*Optional largest grid side, otherwise 4097. Exits with 1 if a quantized height is more than
+          half a step from the generated one.*/
+        int maxGridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 4097;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainHeightfieldBenchmark(perlinG, maxGridSize))
+            return 1;
+    }
+    if (runAll || benchmarkName == "normals")
+    {
+        /*Optional largest grid side, otherwise 4097. Exits with 1 if an analytic frame is not unit
+          length or faces down.*/
+        int maxGridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 4097;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainNormalBenchmark(perlinG, maxGridSize))
+            return 1;
+    }
+    if (runAll || benchmarkName == "edit")
+    {
+        /*Optional largest grid side, otherwise 4097. Exits with 1 if the dirty rectangles miss a
+          change or regenerating does not restore the generated heights.*/
+        int maxGridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 4097;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainEditBenchmark(perlinG, maxGridSize))
+            return 1;
+    }
+    if (runAll || benchmarkName == "query")
+    {
+        /*Optional query count, otherwise 4M, on a 4097x4097 grid. Exits with 1 if a SIMD level differs
+          from the scalar query.*/
+        size_t queryCount = (!runAll && argc > 3) ? size_t(std::stoull(argv[3])) : (size_t(1) << 22);
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainQueryBenchmark(perlinG, 4097, queryCount))
+            return 1;
+    }
+    if (runAll || benchmarkName == "raycast")
+    {
+        /*Optional ray count, otherwise 30000, on a 4097x4097 grid. Exits with 1 if the pyramid's hits
+          differ from the brute-force march.*/
+        size_t rayCount = (!runAll && argc > 3) ? size_t(std::stoull(argv[3])) : size_t(30000);
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainRaycastBenchmark(perlinG, 4097, rayCount))
+            return 1;
+    }
+    if (runAll || benchmarkName == "cache")
+    {
+        /*Optional grid size, otherwise 2049. Exits with 1 if a mapped load differs from generation or a
+          stale cache is used.*/
+        int gridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 2049;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainCacheBenchmark(perlinG, gridSize))
+            return 1;
+    }
+    if (runAll || benchmarkName == "erosion")
+    {
+        /*Optional grid size, otherwise 2049. Exits with 1 if the eroded heights depend on the thread
+          count or a SIMD level's thermal pass differs from the scalar one.*/
+        int gridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 2049;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainErosionBenchmark(perlinG, gridSize))
+            return 1;
+    }
+    if (runAll || benchmarkName == "tiled")
+    {
+        /*Optional query count, otherwise 4M, on a 4097x4097 grid. Exits with 1 if the tiled layout
+          does not round-trip or a tiled kernel differs from the row-major one.*/
+        size_t queryCount = (!runAll && argc > 3) ? size_t(std::stoull(argv[3])) : (size_t(1) << 22);
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTiledHeightfieldBenchmark(perlinG, 4097, queryCount))
+            return 1;
+    }
+    if (runAll || benchmarkName == "heightmap")
+    {
+        /*Optional grid size, otherwise 4097. Exits with 1 if a file does not read back as the quantized
+          heights or the banded rebuild differs from the full-grid one.*/
+        int gridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 4097;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runHeightmapBenchmark(perlinG, gridSize))
+            return 1;
+    }
+    if (runAll || benchmarkName == "splat")
+    {
+        /*Optional grid size, otherwise 4097. Exits with 1 if a SIMD level or thread count changes the
+          splat map or its height layers stray from the float blend factor.*/
+        int gridSize = (!runAll && argc > 3) ? std::stoi(argv[3]) : 4097;
+        int seed = 0;
+        perlinNoiseInit(perlinG, seed);
+        if (!runTerrainSplatBenchmark(perlinG, gridSize))
+            return 1;
+    }
+
+    return 0;
+}
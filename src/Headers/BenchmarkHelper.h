@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+/*Wall-clock timer for the headless benchmarks*/
+class BenchmarkTimer
+{
+public:
+    BenchmarkTimer() : startTime(std::chrono::steady_clock::now()) {}
+
+    void restart()
+    {
+        startTime = std::chrono::steady_clock::now();
+    }
+
+    double elapsedSeconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point startTime;
+};
+
+/*Run fn repeats times and return the fastest run in seconds*/
+template <typename Fn>
+inline double benchmarkBestOf(int repeats, Fn&& fn)
+{
+    double best = 0.0;
+    for (int i = 0; i < repeats; ++i) {
+        BenchmarkTimer timer;
+        fn();
+        double elapsed = timer.elapsedSeconds();
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+inline void printBenchmarkResult(const std::string& label, double seconds, double work, const std::string& unit)
+{
+    std::cout << std::left << std::setw(40) << label << std::right
+        << std::setw(10) << std::fixed << std::setprecision(2) << seconds * 1000.0 << " ms  "
+        << std::setw(12) << std::setprecision(2) << (seconds > 0.0 ? work / seconds : 0.0) << " " << unit << "\n";
+}
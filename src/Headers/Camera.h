@@ -3,8 +3,10 @@
 #include "../includes/GLAD/glad.h"
 #include "../includes/glm/glm.hpp"
 #include "../includes/glm/gtc/matrix_transform.hpp"
+#include "TerrainQuery.h"
 
 #include <vector>
+#include <functional>
 
 enum cameraMovement
 {
@@ -77,8 +79,8 @@ public:
 		if (direction == RIGHT)
 			newPos += Right * velocity;
 
-		// Check terrain collision
-		float terrainHeight = getHeightAtPosition(blendMap, 50, 50, newPos);
+		// Check terrain collision: the grid where it covers, the height source everywhere else
+		float terrainHeight = terrainQuery.covers(newPos) ? terrainQuery.heightAt(newPos) : (terrainHeightSource ? terrainHeightSource(newPos) : 0.0f);
 		if (newPos.y < terrainHeight)
 			newPos.y = terrainHeight + 1; // add some offset to avoid sinking into the terrain
 
@@ -107,50 +109,21 @@ public:
 
 	}
 
-	float getHeightAtPosition(const std::vector<float>& blendMap, int width, int height, glm::vec3 position)
+	/*Terrain the camera collides with; a view, so edits are seen without copying the heights*/
+	void setTerrainQuery(const TerrainHeightQuery& query)
 	{
-		/*Normalize the position to the range[0, width] and [0, height] for x and z respectively*/
-		float normalizedX = position.x / width;
-		float normalizedZ = position.z / height;
-
-		// Find the four corners of the grid cell the position is in
-		int x1 = std::floor(normalizedX);
-		int x2 = x1 + 1;
-		int z1 = std::floor(normalizedZ);
-		int z2 = z1 + 1;
-
-		/*Ensure the position is within the grid*/
-		if (x1 < 0 || x2 >= width || z1 < 0 || z2 >= height)
-		{
-			return 0.0f;
-		}
-
-		/*Find the height at each corner of the grid cell*/
-		float h1 = blendMap[x1 + z1 * width];
-		float h2 = blendMap[x2 + z1 * width];
-		float h3 = blendMap[x1 + z2 * width];
-		float h4 = blendMap[x2 + z2 * width];
-
-		// Calculate the x and z fractions from the position within the grid cell
-		float fracX = normalizedX - x1;
-		float fracZ = normalizedZ - z1;
-
-		/*Perform bilinear interpolation to find the height at the exact position.*/
-		float fheight = h1 * (1 - fracX) * (1 - fracZ) +
-			h2 * fracX * (1 - fracZ) +
-			h3 * (1 - fracX) * fracZ +
-			h4 * fracX * fracZ;
-
-		return fheight;
+		terrainQuery = query;
 	}
 
-	void setBlendMap(std::vector<float> inBlendMap)
+	/*Height under a position the query's grid does not cover, e.g. the streamed terrain's field*/
+	void setTerrainHeightSource(std::function<float(const glm::vec3&)> source)
 	{
-		blendMap = inBlendMap;
+		terrainHeightSource = std::move(source);
 	}
 
 private:
-	std::vector<float> blendMap;
+	TerrainHeightQuery terrainQuery;
+	std::function<float(const glm::vec3&)> terrainHeightSource;
 	void updateCameraVectors()
 	{
 		glm::vec3 front;
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+/*Signed 16.16 fixed point, the integer-only scalar the noise templates can run on: adds are integer
+  adds, products and quotients go through 64 bits. Range about +-32768 with steps of 1/65536, enough
+  for fBm lattice coordinates and the fade and falloff polynomials.*/
+struct Fixed16
+{
+    int32_t raw{ 0 };
+
+    Fixed16() = default;
+    explicit Fixed16(double value) : raw(int32_t(std::lround(value * 65536.0))) {}
+
+    static Fixed16 fromRaw(int32_t value)
+    {
+        Fixed16 result;
+        result.raw = value;
+        return result;
+    }
+
+    double toDouble() const { return raw * (1.0 / 65536.0); }
+
+    Fixed16 operator-() const { return fromRaw(-raw); }
+    Fixed16 operator+(Fixed16 other) const { return fromRaw(raw + other.raw); }
+    Fixed16 operator-(Fixed16 other) const { return fromRaw(raw - other.raw); }
+    /*Rounded to nearest: truncating every product biases the long fade and falloff polynomials down*/
+    Fixed16 operator*(Fixed16 other) const { return fromRaw(int32_t((int64_t(raw) * other.raw + 0x8000) >> 16)); }
+    Fixed16 operator/(Fixed16 other) const { return fromRaw(int32_t((int64_t(raw) * 65536) / other.raw)); }
+    Fixed16& operator+=(Fixed16 other) { raw += other.raw; return *this; }
+    Fixed16& operator-=(Fixed16 other) { raw -= other.raw; return *this; }
+    Fixed16& operator*=(Fixed16 other) { return *this = *this * other; }
+
+    bool operator<(Fixed16 other) const { return raw < other.raw; }
+    bool operator>(Fixed16 other) const { return raw > other.raw; }
+    bool operator<=(Fixed16 other) const { return raw <= other.raw; }
+    bool operator>=(Fixed16 other) const { return raw >= other.raw; }
+};
+
+/*-----------NOISE SCALARS----------*/
+/*What the noise templates need of their scalar beyond arithmetic, for float, double and Fixed16*/
+inline float noiseFloor(float value) { return std::floor(value); }
+inline double noiseFloor(double value) { return std::floor(value); }
+/*Clearing the fraction bits of a two's complement value rounds it down*/
+inline Fixed16 noiseFloor(Fixed16 value) { return Fixed16::fromRaw(int32_t(uint32_t(value.raw) & 0xFFFF0000u)); }
+
+inline int noiseFloorToInt(float value) { return static_cast<int>(std::floor(value)); }
+inline int noiseFloorToInt(double value) { return static_cast<int>(std::floor(value)); }
+inline int noiseFloorToInt(Fixed16 value) { return value.raw >> 16; }
+
+inline float noiseToFloat(float value) { return value; }
+inline float noiseToFloat(double value) { return static_cast<float>(value); }
+inline float noiseToFloat(Fixed16 value) { return static_cast<float>(value.toDouble()); }
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "PerlinHelper.h"
+#include "TerrainHeightfield.h"
+#include "TerrainSplatMap.h"
+
+/*-----------HEIGHTMAP FILES----------*/
+/*16-bit heightmaps in and out, e.g. DEM tiles or hand-authored maps: headerless RAW in either byte
+  order and binary PGM (P5, 8 or 16 bits, big-endian as the format specifies). Reading maps the file and
+  converts it a band of rows at a time, and writing streams rows to disk, so a map larger than memory
+  only ever costs one band. Samples are normalized to 0..65535 and decode over a height range exactly
+  like the heightfield terrain's samples, which can take them as they are.*/
+
+enum HeightmapFormat
+{
+    HEIGHTMAP_RAW16_LITTLE_ENDIAN,
+    HEIGHTMAP_RAW16_BIG_ENDIAN,
+    HEIGHTMAP_PGM
+};
+
+/*Rows converted per band when streaming; 4096 columns of 16 bits make a 4 MB band*/
+const int HEIGHTMAP_BAND_ROWS = 512;
+
+/*PGM by extension, anything else RAW in the little-endian order most tools write*/
+inline HeightmapFormat heightmapFormatFromPath(const std::string& path)
+{
+    std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : std::string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return extension == ".pgm" ? HEIGHTMAP_PGM : HEIGHTMAP_RAW16_LITTLE_ENDIAN;
+}
+
+/*A normalized sample at its height over [minHeight, maxHeight], as decodeTerrainHeight decodes it*/
+inline float decodeHeightmapSample(uint16_t sample, float minHeight, float maxHeight)
+{
+    return minHeight + sample / 65535.0f * (maxHeight - minHeight);
+}
+
+class HeightmapReader
+{
+public:
+    /*RAW has no header: its size is rawWidth x rawHeight when the file has exactly that many samples,
+      otherwise the square the file holds. Fails on a RAW file of an odd byte count or, without a size
+      that fits it, of a sample count that is not a square, and on a PGM that is not binary or whose
+      samples do not fit the file.*/
+    bool open(const std::string& path, int rawWidth = 0, int rawHeight = 0)
+    {
+        return open(path, heightmapFormatFromPath(path), rawWidth, rawHeight);
+    }
+
+    bool open(const std::string& path, HeightmapFormat inFormat, int rawWidth = 0, int rawHeight = 0)
+    {
+        close();
+        if (!file.open(path) || !file.data())
+            return false;
+        format = inFormat;
+        if (format == HEIGHTMAP_PGM) {
+            if (!parsePGMHeader()) {
+                close();
+                return false;
+            }
+        }
+        else {
+            size_t sampleCount = file.size() / 2;
+            size_t side = size_t(std::sqrt(double(sampleCount)) + 0.5);
+            if (rawWidth > 0 && rawHeight > 0 && (size_t)rawWidth * rawHeight == sampleCount) {
+                width = rawWidth;
+                height = rawHeight;
+            }
+            else if (side * side == sampleCount) {
+                width = height = int(side);
+            }
+            if (file.size() % 2 != 0 || width == 0) {
+                close();
+                return false;
+            }
+            maxValue = 65535;
+            bytesPerSample = 2;
+            dataOffset = 0;
+        }
+        if (width < 2 || height < 2 || dataOffset + (size_t)width * height * bytesPerSample > file.size()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        width = 0;
+        height = 0;
+    }
+
+    bool isOpen() const { return width > 0; }
+    int gridWidth() const { return width; }
+    int gridHeight() const { return height; }
+    HeightmapFormat fileFormat() const { return format; }
+
+    /*Rows [firstRow, firstRow + rowCount) normalized to 0..65535, row-major into outSamples*/
+    void readRows(int firstRow, int rowCount, uint16_t* outSamples) const
+    {
+        size_t first = (size_t)firstRow * width, count = (size_t)rowCount * width;
+        for (size_t i = 0; i < count; ++i)
+            outSamples[i] = normalizedSample(first + i);
+    }
+
+    /*Height of the bilinear surface at grid position (gridX, gridZ) over [minHeight, maxHeight],
+      clamped to the map, with the same operations TerrainHeightQuery runs on the decoded heights. Reads
+      four samples of the mapped file, e.g. to collide with a map too large to keep as floats.*/
+    float heightAt(float gridX, float gridZ, float minHeight, float maxHeight) const
+    {
+        if (!isOpen())
+            return 0.0f;
+        gridX = std::min(std::max(gridX, 0.0f), float(width - 1));
+        gridZ = std::min(std::max(gridZ, 0.0f), float(height - 1));
+        int cellX = std::min(int(gridX), width - 2), cellZ = std::min(int(gridZ), height - 2);
+        float fracX = gridX - float(cellX), fracZ = gridZ - float(cellZ);
+
+        size_t corner = (size_t)cellZ * width + cellX;
+        float h00 = decodeHeightmapSample(normalizedSample(corner), minHeight, maxHeight);
+        float h10 = decodeHeightmapSample(normalizedSample(corner + 1), minHeight, maxHeight);
+        float h01 = decodeHeightmapSample(normalizedSample(corner + width), minHeight, maxHeight);
+        float h11 = decodeHeightmapSample(normalizedSample(corner + width + 1), minHeight, maxHeight);
+        float rowX = h10 - h00, nextRowX = h11 - h01;
+        float top = h00 + rowX * fracX, bottom = h01 + nextRowX * fracX;
+        return top + (bottom - top) * fracZ;
+    }
+
+    /*The same rows as heights over [minHeight, maxHeight]*/
+    void readHeights(int firstRow, int rowCount, float minHeight, float maxHeight, float* outHeights, std::vector<uint16_t>& scratch) const
+    {
+        scratch.resize((size_t)rowCount * width);
+        readRows(firstRow, rowCount, scratch.data());
+        for (size_t i = 0; i < scratch.size(); ++i)
+            outHeights[i] = decodeHeightmapSample(scratch[i], minHeight, maxHeight);
+    }
+
+    /*fn(firstRow, rowCount, samples) over the whole map, bandRows rows at a time. samples[-width] is the
+      row above the band and samples[rowCount * width] the row below, clamped at the map's edges, for
+      stencils reading one row either side.*/
+    template <typename Fn>
+    void forEachBand(int bandRows, Fn&& fn) const
+    {
+        bandRows = std::max(1, std::min(bandRows, height));
+        std::vector<uint16_t> band((size_t)(bandRows + 2) * width);
+        for (int firstRow = 0; firstRow < height; firstRow += bandRows) {
+            int rowCount = std::min(bandRows, height - firstRow);
+            readRows(std::max(firstRow - 1, 0), 1, band.data());
+            readRows(firstRow, rowCount, band.data() + width);
+            readRows(std::min(firstRow + rowCount, height - 1), 1, band.data() + (size_t)(rowCount + 1) * width);
+            fn(firstRow, rowCount, static_cast<const uint16_t*>(band.data() + width));
+        }
+    }
+
+private:
+    MappedFile file;
+    HeightmapFormat format{ HEIGHTMAP_RAW16_LITTLE_ENDIAN };
+    int width{ 0 };
+    int height{ 0 };
+    uint32_t maxValue{ 65535 };
+    size_t bytesPerSample{ 2 };
+    size_t dataOffset{ 0 };
+
+    /*Sample i of the row-major map normalized to 0..65535*/
+    uint16_t normalizedSample(size_t i) const
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.data()) + dataOffset + i * bytesPerSample;
+        uint32_t value = bytesPerSample == 1 ? bytes[0]
+            : format != HEIGHTMAP_RAW16_LITTLE_ENDIAN ? (uint32_t(bytes[0]) << 8) | bytes[1] : uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8);
+        return maxValue == 65535 ? uint16_t(value) : uint16_t((std::min(value, maxValue) * 65535u + maxValue / 2) / maxValue);
+    }
+
+    /*"P5", width, height and maxval separated by whitespace and # comments, then one whitespace byte*/
+    bool parsePGMHeader()
+    {
+        const char* text = file.data();
+        size_t size = file.size(), position = 2;
+        if (size < 2 || text[0] != 'P' || text[1] != '5')
+            return false;
+        unsigned long fields[3];
+        for (unsigned long& field : fields) {
+            for (;;) {
+                while (position < size && std::isspace((unsigned char)text[position]))
+                    ++position;
+                if (position >= size || text[position] != '#')
+                    break;
+                while (position < size && text[position] != '\n')
+                    ++position;
+            }
+            if (position >= size || !std::isdigit((unsigned char)text[position]))
+                return false;
+            field = 0;
+            while (position < size && std::isdigit((unsigned char)text[position]) && field <= 0xFFFFFFul)
+                field = field * 10 + (text[position++] - '0');
+        }
+        if (position >= size || !std::isspace((unsigned char)text[position]) || fields[2] == 0 || fields[2] > 65535
+            || fields[0] > 0x7FFFFFFFul || fields[1] > 0x7FFFFFFFul)
+            return false;
+        width = int(fields[0]);
+        height = int(fields[1]);
+        maxValue = uint32_t(fields[2]);
+        bytesPerSample = maxValue < 256 ? 1 : 2;
+        dataOffset = position + 1;
+        return true;
+    }
+};
+
+/*Streams rows out in order through a temporary file like writeTerrainCache; the map only appears at
+  path once every row is written and close succeeds*/
+class HeightmapWriter
+{
+public:
+    HeightmapWriter() = default;
+
+    /*Delete copy constructor and copy assignment operators*/
+    HeightmapWriter(const HeightmapWriter&) = delete;
+    HeightmapWriter& operator=(const HeightmapWriter&) = delete;
+
+    /*Destructor, drops an unfinished map*/
+    ~HeightmapWriter()
+    {
+        if (file) {
+            std::fclose(file);
+            std::remove(tempPath.c_str());
+        }
+    }
+
+    bool open(const std::string& inPath, HeightmapFormat inFormat, int inWidth, int inHeight)
+    {
+        if (file || inWidth < 1 || inHeight < 1)
+            return false;
+        path = inPath;
+        tempPath = path + ".tmp";
+        format = inFormat;
+        width = inWidth;
+        height = inHeight;
+        rowsWritten = 0;
+        file = std::fopen(tempPath.c_str(), "wb");
+        if (!file)
+            return false;
+        if (format == HEIGHTMAP_PGM && std::fprintf(file, "P5\n%d %d\n65535\n", width, height) < 0) {
+            std::fclose(file);
+            file = nullptr;
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /*The next rowCount rows of 0..65535 samples, row-major*/
+    bool writeRows(const uint16_t* samples, int rowCount)
+    {
+        if (!file || rowCount < 0 || rowsWritten + rowCount > height)
+            return false;
+        size_t count = (size_t)rowCount * width;
+        bytes.resize(count * 2);
+        bool bigEndian = format != HEIGHTMAP_RAW16_LITTLE_ENDIAN;
+        for (size_t i = 0; i < count; ++i) {
+            bytes[i * 2] = (unsigned char)(bigEndian ? samples[i] >> 8 : samples[i] & 0xFF);
+            bytes[i * 2 + 1] = (unsigned char)(bigEndian ? samples[i] & 0xFF : samples[i] >> 8);
+        }
+        if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size())
+            return false;
+        rowsWritten += rowCount;
+        return true;
+    }
+
+    /*True when every row was written and the map is in place*/
+    bool close()
+    {
+        if (!file)
+            return false;
+        bool written = std::fclose(file) == 0 && rowsWritten == height;
+        file = nullptr;
+        std::remove(path.c_str());
+        if (!written || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    FILE* file{ nullptr };
+    std::string path;
+    std::string tempPath;
+    HeightmapFormat format{ HEIGHTMAP_RAW16_LITTLE_ENDIAN };
+    int width{ 0 };
+    int height{ 0 };
+    int rowsWritten{ 0 };
+    std::vector<unsigned char> bytes;
+};
+
+/*Row-major heights quantized over [minHeight, maxHeight] and written a band at a time*/
+inline bool writeTerrainHeightmap(const std::string& path, HeightmapFormat format, const float* heights, int width, int height, float minHeight, float maxHeight,
+    int bandRows = HEIGHTMAP_BAND_ROWS)
+{
+    HeightmapWriter writer;
+    if (!writer.open(path, format, width, height))
+        return false;
+    bandRows = std::max(1, bandRows);
+    std::vector<uint16_t> band;
+    for (int firstRow = 0; firstRow < height; firstRow += bandRows) {
+        int rowCount = std::min(bandRows, height - firstRow);
+        band.resize((size_t)rowCount * width);
+        const float* rows = heights + (size_t)firstRow * width;
+        for (size_t i = 0; i < band.size(); ++i)
+            band[i] = quantizeTerrainHeight(rows[i], minHeight, maxHeight);
+        if (!writer.writeRows(band.data(), rowCount))
+            return false;
+    }
+    return writer.close();
+}
+
+/*-----------TERRAIN FROM A HEIGHTMAP----------*/
+/*fn(firstRow, rowCount, samples, rows) over the whole map, bandRows rows at a time: the band's samples
+  as forEachBand gives them and its heights over [minHeight, maxHeight], decoded with the apron rows so
+  rows[-width] and rows[rowCount * width] are in reach*/
+template <typename Fn>
+inline void forEachHeightmapHeightBand(const HeightmapReader& reader, float minHeight, float maxHeight, int bandRows, Fn&& fn)
+{
+    int width = reader.gridWidth();
+    std::vector<float> bandHeights;
+    reader.forEachBand(bandRows, [&](int firstRow, int rowCount, const uint16_t* samples) {
+        bandHeights.resize((size_t)(rowCount + 2) * width);
+        for (size_t i = 0; i < bandHeights.size(); ++i)
+            bandHeights[i] = decodeHeightmapSample(samples[(ptrdiff_t)i - width], minHeight, maxHeight);
+        fn(firstRow, rowCount, samples, static_cast<const float*>(bandHeights.data() + width));
+    });
+}
+
+/*Splat texels of the band's rows from its decoded rows and apron, as generateTerrainSplatMap builds
+  them; rows past the map's edges are the edge rows, so the span drops to 1 there*/
+inline void buildHeightmapSplatBand(const float* rows, int firstRow, int rowCount, int width, int height, const TerrainSplatRamps& ramps, SIMDLevel level,
+    uint32_t* outTexels)
+{
+    for (int bandZ = 0; bandZ < rowCount; ++bandZ) {
+        int z = firstRow + bandZ;
+        const float* row = rows + (size_t)bandZ * width;
+        const float* up = z < height - 1 ? row + width : row;
+        const float* down = z > 0 ? row - width : row;
+        float spanZ = float((z < height - 1) + (z > 0));
+        terrainSplatRow(up, row, down, width, spanZ == 2.0f ? 0.5f : 1.0f, 0, width, ramps, outTexels + (size_t)bandZ * width, level);
+    }
+}
+
+/*Vertices and splat texels of the map's terrain over [minHeight, maxHeight], a band at a time, laid
+  out as TerrainEditor::buildVertices and buildSplatTexels lay them out for the same heights imported
+  (TERRAIN_HEIGHTS_IMPORTED).
+  fn(firstRow, rowCount, vertices, splatTexels) gets each band's rows, e.g. for a glBufferSubData of
+  the band; nothing the size of the whole map is kept.*/
+template <typename Fn>
+inline void buildHeightmapTerrainBands(const HeightmapReader& reader, float minHeight, float maxHeight, const TerrainSplatSettings& splat, int bandRows, Fn&& fn)
+{
+    int width = reader.gridWidth(), height = reader.gridHeight();
+    TerrainSplatRamps ramps = makeTerrainSplatRamps(splat, minHeight, maxHeight);
+    SIMDLevel level = activeSIMDLevel();
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> splatTexels;
+    forEachHeightmapHeightBand(reader, minHeight, maxHeight, bandRows, [&](int firstRow, int rowCount, const uint16_t*, const float* rows) {
+        vertices.resize((size_t)rowCount * width);
+        splatTexels.resize(vertices.size());
+        for (int bandZ = 0; bandZ < rowCount; ++bandZ) {
+            int z = firstRow + bandZ;
+            const float* row = rows + (size_t)bandZ * width;
+            const float* up = z < height - 1 ? row + width : row;
+            const float* down = z > 0 ? row - width : row;
+            float spanZ = float((z < height - 1) + (z > 0));
+            for (int x = 0; x < width; ++x) {
+                int left = std::max(x - 1, 0), right = std::min(x + 1, width - 1);
+                Vertex& vertex = vertices[(size_t)bandZ * width + x];
+                vertex.vPos = glm::vec3(x - width / 2, row[x], z - height / 2);
+                vertex.vTexCoords = glm::vec2(x / (float)width, z / (float)height) * TERRAIN_HEIGHTFIELD_TEX_REPEAT;
+                setTerrainFrameFromSlope((row[right] - row[left]) / float(right - left), (up[x] - down[x]) / spanZ, vertex);
+            }
+        }
+        buildHeightmapSplatBand(rows, firstRow, rowCount, width, height, ramps, level, splatTexels.data());
+        fn(firstRow, rowCount, static_cast<const Vertex*>(vertices.data()), static_cast<const uint32_t*>(splatTexels.data()));
+    });
+}
+
+/*Whether the map fits the heightfield and splat textures, which are as large as the map*/
+inline bool heightmapFitsTexture(const HeightmapReader& reader)
+{
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    return reader.gridWidth() <= maxTextureSize && reader.gridHeight() <= maxTextureSize;
+}
+
+/*The map straight into the heightfield terrain's texture over [minHeight, maxHeight], a band per
+  upload; its samples are already what the texture holds. outHeights, unless null, gets the map as
+  row-major heights, e.g. for the editor. splatTexture, unless null, gets the splat map built a band
+  at a time with splat, for maps too large to build it from outHeights. Uploads nothing and returns
+  false when the map does not fit a texture.*/
+inline bool uploadHeightmapToHeightfield(const HeightmapReader& reader, float minHeight, float maxHeight, TerrainHeightfieldMesh& mesh,
+    float* outHeights = nullptr, TerrainSplatTexture* splatTexture = nullptr, const TerrainSplatSettings& splat = TerrainSplatSettings(),
+    int bandRows = HEIGHTMAP_BAND_ROWS)
+{
+    if (!heightmapFitsTexture(reader))
+        return false;
+    int width = reader.gridWidth(), height = reader.gridHeight();
+    mesh.allocate(width, height, minHeight, maxHeight);
+    TerrainSplatRamps ramps = makeTerrainSplatRamps(splat, minHeight, maxHeight);
+    SIMDLevel level = activeSIMDLevel();
+    std::vector<uint32_t> splatTexels;
+    if (splatTexture)
+        splatTexture->allocate(width, height);
+    forEachHeightmapHeightBand(reader, minHeight, maxHeight, bandRows, [&](int firstRow, int rowCount, const uint16_t* samples, const float* rows) {
+        mesh.uploadRegion(0, firstRow, width, rowCount, samples);
+        if (outHeights)
+            std::copy(rows, rows + (size_t)rowCount * width, outHeights + (size_t)firstRow * width);
+        if (splatTexture) {
+            splatTexels.resize((size_t)rowCount * width);
+            buildHeightmapSplatBand(rows, firstRow, rowCount, width, height, ramps, level, splatTexels.data());
+            splatTexture->uploadRegion(0, firstRow, width, rowCount, splatTexels.data());
+        }
+    });
+    return true;
+}
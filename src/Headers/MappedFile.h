@@ -0,0 +1,164 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*Read-only memory mapping of a whole file. Move-only, unmapped on destruction.*/
+class MappedFile
+{
+public:
+    MappedFile() {}
+
+    explicit MappedFile(const std::string& filePath)
+    {
+        open(filePath);
+    }
+
+    /*Delete copy constructor and copy assignment operators*/
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /*Move constructor*/
+    MappedFile(MappedFile&& other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    /*Move assignment operator*/
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    /*Destructor*/
+    ~MappedFile()
+    {
+        close();
+    }
+
+    /*Map the file. An empty file opens successfully with a null data pointer.*/
+    bool open(const std::string& filePath)
+    {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) {
+            close();
+            return false;
+        }
+        mappedSize = static_cast<size_t>(fileSize.QuadPart);
+        opened = true;
+        if (mappedSize == 0)
+            return true;
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL) {
+            close();
+            return false;
+        }
+        mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+        fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+        if (fileDescriptor < 0)
+            return false;
+
+        struct stat fileStat;
+        if (fstat(fileDescriptor, &fileStat) != 0) {
+            close();
+            return false;
+        }
+        mappedSize = static_cast<size_t>(fileStat.st_size);
+        opened = true;
+        if (mappedSize == 0)
+            return true;
+
+        void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        mappedData = mapping == MAP_FAILED ? nullptr : static_cast<const char*>(mapping);
+        if (mappedData)
+            madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+#endif
+        if (!mappedData) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    /*Unmap and release the file*/
+    void close()
+    {
+#ifdef _WIN32
+        if (mappedData)
+            UnmapViewOfFile(mappedData);
+        if (mappingHandle != NULL)
+            CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(fileHandle);
+        mappingHandle = NULL;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (mappedData)
+            munmap(const_cast<char*>(mappedData), mappedSize);
+        if (fileDescriptor >= 0)
+            ::close(fileDescriptor);
+        fileDescriptor = -1;
+#endif
+        mappedData = nullptr;
+        mappedSize = 0;
+        opened = false;
+    }
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+
+private:
+    const char* mappedData = nullptr;
+    size_t mappedSize = 0;
+    bool opened = false;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#else
+    int fileDescriptor = -1;
+#endif
+
+    void moveFrom(MappedFile& other)
+    {
+        mappedData = other.mappedData;
+        mappedSize = other.mappedSize;
+        opened = other.opened;
+#ifdef _WIN32
+        fileHandle = other.fileHandle;
+        mappingHandle = other.mappingHandle;
+        other.fileHandle = INVALID_HANDLE_VALUE;
+        other.mappingHandle = NULL;
+#else
+        fileDescriptor = other.fileDescriptor;
+        other.fileDescriptor = -1;
+#endif
+        other.mappedData = nullptr;
+        other.mappedSize = 0;
+        other.opened = false;
+    }
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include "Vertex.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "PackedVertex.h"
+#include "TangentFrame.h"
+#include <cstring>
+#include "BenchmarkHelper.h"
+
+inline void printVertexCacheStats(const std::string& label, const VertexCacheStats& stats)
+{
+    std::cout << "    " << std::left << std::setw(36) << label << std::right
+        << "ACMR " << std::setw(6) << std::setprecision(3) << stats.acmr
+        << "  ATVR " << std::setw(6) << std::setprecision(3) << stats.atvr << "\n";
+}
+
+/*Vertex-cache quality of a mesh as given, with its triangles shuffled, and after optimizeMesh,
+  plus the optimizer's own throughput in triangles per second*/
+inline void runMeshOptimizerBenchmark(const std::string& label, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int flags, int repeats)
+{
+    size_t triangleCount = indices.size() / 3;
+    std::cout << "MESH OPTIMIZER BENCHMARK: " << label << " (" << vertices.size() << " vertices, " << triangleCount << " triangles, best of " << repeats << ")\n";
+
+    /*Shuffled triangle order is the worst case an exporter can hand us*/
+    std::vector<unsigned int> shuffledIndices(indices.size());
+    std::vector<size_t> order(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        order[t] = t;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+    for (size_t t = 0; t < triangleCount; ++t)
+        std::copy(indices.begin() + order[t] * 3, indices.begin() + order[t] * 3 + 3, shuffledIndices.begin() + t * 3);
+
+    std::vector<Vertex> optimizedVertices;
+    std::vector<unsigned int> optimizedIndices;
+    double seconds = benchmarkBestOf(repeats, [&]() {
+        optimizedVertices = vertices;
+        optimizedIndices = shuffledIndices;
+        optimizeMesh(optimizedVertices, optimizedIndices, flags);
+    });
+    printBenchmarkResult("optimizeMesh (from shuffled)", seconds, double(triangleCount), "tris/s");
+
+    std::vector<Vertex> inputVertices = vertices;
+    std::vector<unsigned int> inputIndices = indices;
+    optimizeMesh(inputVertices, inputIndices, flags);
+
+    printVertexCacheStats("input order", analyzeVertexCache(indices, vertices.size()));
+    printVertexCacheStats("input order, optimized", analyzeVertexCache(inputIndices, inputVertices.size()));
+    printVertexCacheStats("shuffled", analyzeVertexCache(shuffledIndices, vertices.size()));
+    printVertexCacheStats("shuffled, optimized", analyzeVertexCache(optimizedIndices, optimizedVertices.size()));
+}
+
+/*LOD chain generation time, and triangle count / relative error / ACMR of every level*/
+inline void runMeshLODBenchmark(const std::string& label, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+    std::cout << "MESH LOD BENCHMARK: " << label << " (" << vertices.size() << " vertices, " << indices.size() / 3 << " triangles)\n";
+
+    std::vector<unsigned int> chainIndices = indices;
+    BenchmarkTimer timer;
+    MeshLODSet lodSet = generateMeshLODs(vertices, chainIndices, true);
+    printBenchmarkResult("generateMeshLODs", timer.elapsedSeconds(), double(indices.size() / 3), "tris/s");
+
+    for (size_t i = 0; i < lodSet.lods.size(); ++i) {
+        const MeshLOD& lod = lodSet.lods[i];
+        VertexCacheStats stats = analyzeVertexCache(chainIndices.data() + lod.indexOffset, lod.indexCount, vertices.size());
+        std::cout << "    LOD" << i << std::setw(12) << lod.indexCount / 3 << " tris  error " << std::setprecision(5) << lod.error
+            << " x radius  ACMR " << std::setprecision(3) << stats.acmr << "\n";
+    }
+}
+
+/*PackedVertex encode/decode throughput, memory saved, and the largest decode error of every
+  attribute against the bounds the format guarantees. Returns false if any bound is exceeded.*/
+inline bool runPackedVertexBenchmark(const std::string& label, const std::vector<Vertex>& vertices, int repeats)
+{
+    std::cout << "PACKED VERTEX BENCHMARK: " << label << " (" << vertices.size() << " vertices, best of " << repeats << ")\n";
+
+    VertexDecodeParams params = computePackedVertexParams(vertices);
+    std::vector<PackedVertex> packed;
+    double packSeconds = benchmarkBestOf(repeats, [&]() {
+        packed = packVertices(vertices.data(), vertices.size(), params);
+    });
+    printBenchmarkResult("packVertices", packSeconds, double(vertices.size()), "verts/s");
+
+    std::vector<Vertex> unpacked(packed.size());
+    double unpackSeconds = benchmarkBestOf(repeats, [&]() {
+        for (size_t i = 0; i < packed.size(); ++i)
+            unpacked[i] = unpackVertex(packed[i], params);
+    });
+    printBenchmarkResult("unpackVertex", unpackSeconds, double(vertices.size()), "verts/s");
+
+    std::cout << "    " << vertices.size() * sizeof(Vertex) / 1024 << " KB -> " << packed.size() * sizeof(PackedVertex) / 1024 << " KB ("
+        << sizeof(Vertex) << " -> " << sizeof(PackedVertex) << " bytes per vertex)\n";
+
+    PackedVertexError error = measurePackedVertexError(vertices, packed, params);
+    PackedVertexError bounds = packedVertexErrorBounds(params);
+    std::cout << std::scientific << std::setprecision(3)
+        << "    position  " << error.position << " (bound " << bounds.position << ")\n"
+        << "    texCoord  " << error.texCoord << " (bound " << bounds.texCoord << ")\n"
+        << "    normal    " << error.normalDegrees << " deg (bound " << bounds.normalDegrees << ")\n"
+        << "    tangent   " << error.tangentDegrees << " deg (bound " << bounds.tangentDegrees << ")\n"
+        << std::fixed << "    handedness flips " << error.handednessFlips << "\n";
+
+    bool passed = withinPackedVertexBounds(error, bounds);
+    std::cout << "    " << (passed ? "PASS" : "FAIL: decode error exceeds the format bounds") << "\n";
+    return passed;
+}
+
+/*The scalar AoS loop the OBJ parser and terrain used before TangentFrame.h, kept as the baseline*/
+inline void computeTangentBasisReference(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        Vertex& v0 = vertices[indices[i]];
+        Vertex& v1 = vertices[indices[i + 1]];
+        Vertex& v2 = vertices[indices[i + 2]];
+
+        /*Calculate the tangent and bitangent as before*/
+        glm::vec3 edge1 = v1.vPos - v0.vPos;
+        glm::vec3 edge2 = v2.vPos - v0.vPos;
+        glm::vec2 deltaUV1 = v1.vTexCoords - v0.vTexCoords;
+        glm::vec2 deltaUV2 = v2.vTexCoords - v0.vTexCoords;
+
+        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+        glm::vec3 tangent;
+        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+
+        glm::vec3 bitangent;
+        bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+        bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+        bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+
+        /*Accumulate the tangent and bitangent for each vertex of the triangle*/
+        tangents[indices[i]] += tangent;
+        tangents[indices[i + 1]] += tangent;
+        tangents[indices[i + 2]] += tangent;
+
+        bitangents[indices[i]] += bitangent;
+        bitangents[indices[i + 1]] += bitangent;
+        bitangents[indices[i + 2]] += bitangent;
+    }
+
+    /*Normalize and orthogonalize tangent and bitangent*/
+    for (unsigned int i = 0; i < vertices.size(); ++i) {
+        Vertex& vertex = vertices[i];
+
+        if (glm::length(tangents[i]) > 0.0f)
+            vertex.vTangent = glm::normalize(tangents[i]);
+        else
+            vertex.vTangent = glm::vec3(0.0f);
+
+        if (glm::length(bitangents[i]) > 0.0f)
+            vertex.vBiTangent = glm::normalize(bitangents[i]);
+        else
+            vertex.vBiTangent = glm::vec3(0.0f);
+
+        /*Orthogonalize*/
+        vertex.vTangent = glm::normalize(vertex.vTangent - vertex.vNormals * glm::dot(vertex.vNormals, vertex.vTangent));
+        vertex.vBiTangent = glm::cross(vertex.vNormals, vertex.vTangent);
+    }
+}
+
+/*Reference loop against single-threaded computeTangentFrames at every SIMD level this CPU has, both
+  through the AoS wrapper and on SoA streams already in place, then the threaded path at several
+  thread counts. Checks that levels and thread counts agree bit for bit and how far the kernel's
+  tangents are from the reference where the reference is finite. Returns false on any mismatch.*/
+inline bool runTangentFrameBenchmark(const std::string& label, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, int repeats)
+{
+    std::cout << "TANGENT FRAME BENCHMARK: " << label << " (" << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, best of " << repeats
+        << ", detected " << simdLevelName(activeSIMDLevel()) << ")\n";
+
+    std::vector<unsigned int> referenceIndices = indices;
+    std::vector<Vertex> referenceVertices;
+    double referenceSeconds = benchmarkBestOf(repeats, [&]() {
+        referenceVertices = vertices;
+        computeTangentBasisReference(referenceVertices, referenceIndices);
+    });
+    printBenchmarkResult("reference AoS loop", referenceSeconds, double(vertices.size()), "verts/s");
+
+    bool passed = true;
+    std::vector<Vertex> scalarVertices;
+    for (int level = SIMD_SCALAR; level <= int(activeSIMDLevel()); ++level) {
+        SIMDLevel simdLevel = SIMDLevel(level);
+        std::vector<Vertex> frameVertices;
+        double seconds = benchmarkBestOf(repeats, [&]() {
+            frameVertices = vertices;
+            computeTangentFrames(frameVertices, indices, TANGENT_FRAME_DEFAULT, simdLevel, 1);
+        });
+        printBenchmarkResult(std::string("computeTangentFrames ") + simdLevelName(simdLevel), seconds, double(vertices.size()), "verts/s");
+
+        TangentFrameStreams streams;
+        loadTangentFrameStreams(vertices, streams, true);
+        double kernelSeconds = benchmarkBestOf(repeats, [&]() {
+            computeTangentFrames(streams, indices.data(), indices.size(), TANGENT_FRAME_DEFAULT, simdLevel, 1);
+        });
+        printBenchmarkResult(std::string("  SoA kernel only ") + simdLevelName(simdLevel), kernelSeconds, double(vertices.size()), "verts/s");
+
+        if (simdLevel == SIMD_SCALAR) {
+            scalarVertices = frameVertices;
+        }
+        else {
+            bool identical = std::memcmp(frameVertices.data(), scalarVertices.data(), frameVertices.size() * sizeof(Vertex)) == 0;
+            std::cout << "    identical to scalar: " << (identical ? "yes" : "NO") << "\n";
+            passed &= identical;
+        }
+    }
+
+    TangentFrameStreams normalStreams;
+    loadTangentFrameStreams(vertices, normalStreams, false);
+    double normalSeconds = benchmarkBestOf(repeats, [&]() {
+        computeTangentFrames(normalStreams, indices.data(), indices.size(), TANGENT_FRAME_ACCUMULATE_NORMALS, activeSIMDLevel(), 1);
+    });
+    printBenchmarkResult("  SoA kernel, accumulating normals", normalSeconds, double(vertices.size()), "verts/s");
+
+    /*Threaded path, with and without normal accumulation, against the single-threaded result*/
+    unsigned int allThreads = sharedThreadPool().size() + 1;
+    for (unsigned int flags : { unsigned(TANGENT_FRAME_DEFAULT), unsigned(TANGENT_FRAME_ACCUMULATE_NORMALS) }) {
+        std::vector<Vertex> serialVertices;
+        for (unsigned int threadCount : { 1u, 2u, 4u, allThreads }) {
+            std::vector<Vertex> threadedVertices;
+            double seconds = benchmarkBestOf(repeats, [&]() {
+                threadedVertices = vertices;
+                computeTangentFrames(threadedVertices, indices, flags, activeSIMDLevel(), threadCount);
+            });
+            printBenchmarkResult(std::string(flags ? "accumulating normals, " : "computeTangentFrames, ") + std::to_string(threadCount) + " threads", seconds,
+                double(vertices.size()), "verts/s");
+            if (threadCount == 1) {
+                serialVertices = threadedVertices;
+            }
+            else {
+                bool identical = std::memcmp(threadedVertices.data(), serialVertices.data(), threadedVertices.size() * sizeof(Vertex)) == 0;
+                std::cout << "    identical to 1 thread: " << (identical ? "yes" : "NO") << "\n";
+                passed &= identical;
+            }
+        }
+    }
+
+    float maxDegrees = 0.0f;
+    size_t comparedCount = 0;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const glm::vec3& reference = referenceVertices[i].vTangent;
+        if (!std::isfinite(reference.x) || !std::isfinite(reference.y) || !std::isfinite(reference.z))
+            continue;
+        maxDegrees = std::max(maxDegrees, angleDegrees(scalarVertices[i].vTangent, reference));
+        ++comparedCount;
+    }
+    std::cout << "    max tangent deviation from reference " << std::setprecision(4) << maxDegrees << " deg over " << comparedCount << " vertices\n";
+    std::cout << "    " << (passed ? "PASS" : "FAIL: SIMD levels or thread counts disagree") << "\n";
+    return passed;
+}
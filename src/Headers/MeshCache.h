@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "OBJParser.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshLOD.h"
+
+/*-----------COOKED MESH FILE----------*/
+/*Layout: MeshCacheHeader, lodCount MeshLOD ranges, vertexCount Vertex records, indexCount 32-bit indices.
+  The records are stored exactly as uploaded so a mapped file goes straight to glBufferData.*/
+const uint32_t MESH_CACHE_MAGIC = 0x4853454Du; /*"MESH"*/
+const uint32_t MESH_CACHE_VERSION = 3;
+
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t indexStride;
+    uint32_t optimizeFlags; /*MeshOptimizeFlags applied before cooking*/
+    uint32_t lodCount;      /*at least 1; level 0 is the full mesh*/
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+static_assert(sizeof(MeshCacheHeader) == 80, "MeshCacheHeader must stay tightly packed");
+
+/*64-bit content hash of the source file, eight bytes per step*/
+inline uint64_t hashMeshSource(const char* data, size_t size)
+{
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t h = 0xCBF29CE484222325ull ^ (size * multiplier);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * multiplier;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    if (i < size)
+        std::memcpy(&tail, data + i, size - i);
+    h = (h ^ tail) * multiplier;
+    h ^= h >> 32;
+    return h;
+}
+
+/*Every level a whole number of triangles inside the index buffer, with level 0 starting it and
+  ending where the simplified levels begin (or at the end of the buffer when there are none)*/
+inline bool meshLODTableValid(const MeshLOD* lods, uint32_t lodCount, uint64_t indexCount)
+{
+    if (lodCount == 0 || lods[0].indexOffset != 0)
+        return false;
+    uint64_t fullIndexCount = lodCount > 1 ? lods[1].indexOffset : indexCount;
+    if (lods[0].indexCount != fullIndexCount)
+        return false;
+    for (uint32_t i = 0; i < lodCount; ++i)
+        if (lods[i].indexCount % 3 != 0 || uint64_t(lods[i].indexOffset) + lods[i].indexCount > indexCount)
+            return false;
+    return true;
+}
+
+/*Write a cooked mesh through a temporary file so a failed write never leaves a half file behind*/
+inline bool writeMeshCache(const std::string& cachePath, const MeshCacheHeader& header, const MeshLOD* lods, const Vertex* vertices, const unsigned int* indices)
+{
+    std::string tempPath = cachePath + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (written)
+        written = std::fwrite(lods, sizeof(MeshLOD), header.lodCount, file) == header.lodCount;
+    if (written && header.vertexCount)
+        written = std::fwrite(vertices, sizeof(Vertex), size_t(header.vertexCount), file) == header.vertexCount;
+    if (written && header.indexCount)
+        written = std::fwrite(indices, sizeof(unsigned int), size_t(header.indexCount), file) == header.indexCount;
+    written = std::fclose(file) == 0 && written;
+
+    std::remove(cachePath.c_str());
+    if (!written || std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*Final vertex/index arrays of a mesh, either mapped from its cooked file or parsed from
+  the OBJ (and cooked for next time) when the cache is missing or stale.*/
+class CookedMesh
+{
+public:
+    /*Load objPath through cachePath. The cache is used when its source hash and optimizeFlags
+      match, or as is when the OBJ itself is missing. Parsed meshes are optimized before cooking.*/
+    bool load(const std::string& objPath, const std::string& cachePath, unsigned int optimizeFlags = MESH_OPTIMIZE_NONE)
+    {
+        release();
+
+        MappedFile source(objPath);
+        bool haveSource = source.isOpen();
+        uint64_t sourceSize = haveSource ? source.size() : 0;
+        uint64_t sourceHash = haveSource ? hashMeshSource(source.data(), source.size()) : 0;
+        source.close();
+
+        if (openCache(cachePath, haveSource, sourceSize, sourceHash, optimizeFlags))
+            return true;
+
+        if (!haveSource) {
+            std::cout << "MESH CACHE: no source or valid cache for " << objPath << std::endl;
+            return false;
+        }
+
+        if (!parseOBJFileParallel(objPath, parsedVertices, parsedIndices))
+            return false;
+        optimizeMesh(parsedVertices, parsedIndices, optimizeFlags, objPath.c_str());
+        if (optimizeFlags & MESH_OPTIMIZE_LOD_CHAIN) {
+            lods = generateMeshLODs(parsedVertices, parsedIndices, (optimizeFlags & MESH_OPTIMIZE_VERTEX_CACHE) != 0).lods;
+            std::cout << "MESH CACHE: " << objPath << " LOD triangles";
+            for (const MeshLOD& lod : lods)
+                std::cout << " " << lod.indexCount / 3;
+            std::cout << std::endl;
+        }
+        else {
+            lods.assign(1, MeshLOD{ 0, static_cast<uint32_t>(parsedIndices.size()), 0.0f, 0 });
+        }
+
+        vertices = parsedVertices.data();
+        indices = parsedIndices.data();
+        numVertices = parsedVertices.size();
+        numIndices = parsedIndices.size();
+        computeBounds();
+
+        MeshCacheHeader header = makeHeader(sourceSize, sourceHash, optimizeFlags);
+        if (!writeMeshCache(cachePath, header, lods.data(), vertices, indices))
+            std::cout << "MESH CACHE: unable to write " << cachePath << std::endl;
+
+        return true;
+    }
+
+    /*Drop the mapping or parsed arrays, e.g. once they are uploaded*/
+    void release()
+    {
+        cacheFile.close();
+        parsedVertices = std::vector<Vertex>();
+        parsedIndices = std::vector<unsigned int>();
+        lods.clear();
+        vertices = nullptr;
+        indices = nullptr;
+        numVertices = 0;
+        numIndices = 0;
+        cached = false;
+    }
+
+    const Vertex* vertexData() const { return vertices; }
+    size_t vertexCount() const { return numVertices; }
+    const unsigned int* indexData() const { return indices; }
+    size_t indexCount() const { return numIndices; }
+    const glm::vec3& getBoundsMin() const { return boundsMin; }
+    const glm::vec3& getBoundsMax() const { return boundsMax; }
+
+    /*Index ranges of the levels of detail inside indexData(), with the bounding sphere to size them*/
+    MeshLODSet getLODSet() const
+    {
+        MeshLODSet lodSet;
+        lodSet.lods = lods;
+        lodSet.boundsCenter = 0.5f * (boundsMin + boundsMax);
+        lodSet.boundsRadius = meshBoundsRadius(boundsMin, boundsMax);
+        return lodSet;
+    }
+
+    /*True when the data came from the cooked file rather than a parse*/
+    bool fromCache() const { return cached; }
+
+private:
+    MappedFile cacheFile;
+    std::vector<Vertex> parsedVertices;
+    std::vector<unsigned int> parsedIndices;
+    std::vector<MeshLOD> lods;
+    const Vertex* vertices = nullptr;
+    const unsigned int* indices = nullptr;
+    size_t numVertices = 0;
+    size_t numIndices = 0;
+    glm::vec3 boundsMin{ 0.0f };
+    glm::vec3 boundsMax{ 0.0f };
+    bool cached = false;
+
+    bool openCache(const std::string& cachePath, bool checkSource, uint64_t sourceSize, uint64_t sourceHash, unsigned int optimizeFlags)
+    {
+        if (!cacheFile.open(cachePath))
+            return false;
+
+        MeshCacheHeader header;
+        if (cacheFile.size() < sizeof(header)) {
+            cacheFile.close();
+            return false;
+        }
+        std::memcpy(&header, cacheFile.data(), sizeof(header));
+
+        bool valid = header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION &&
+            header.vertexStride == sizeof(Vertex) && header.indexStride == sizeof(unsigned int) &&
+            header.lodCount >= 1 &&
+            cacheFile.size() == sizeof(header) + header.lodCount * sizeof(MeshLOD) + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(unsigned int);
+        if (valid && checkSource)
+            valid = header.sourceSize == sourceSize && header.sourceHash == sourceHash && header.optimizeFlags == optimizeFlags;
+        const MeshLOD* lodTable = reinterpret_cast<const MeshLOD*>(cacheFile.data() + sizeof(header));
+        /*A damaged level table would draw past the index buffer; re-cook instead*/
+        if (valid)
+            valid = meshLODTableValid(lodTable, header.lodCount, header.indexCount);
+        if (!valid) {
+            cacheFile.close();
+            return false;
+        }
+
+        lods.assign(lodTable, lodTable + header.lodCount);
+        const char* payload = cacheFile.data() + sizeof(header) + header.lodCount * sizeof(MeshLOD);
+        numVertices = size_t(header.vertexCount);
+        numIndices = size_t(header.indexCount);
+        vertices = reinterpret_cast<const Vertex*>(payload);
+        indices = reinterpret_cast<const unsigned int*>(payload + numVertices * sizeof(Vertex));
+        boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+        cached = true;
+        return true;
+    }
+
+    void computeBounds()
+    {
+        boundsMin = boundsMax = numVertices ? vertices[0].vPos : glm::vec3(0.0f);
+        for (size_t i = 1; i < numVertices; ++i) {
+            boundsMin = glm::min(boundsMin, vertices[i].vPos);
+            boundsMax = glm::max(boundsMax, vertices[i].vPos);
+        }
+    }
+
+    MeshCacheHeader makeHeader(uint64_t sourceSize, uint64_t sourceHash, unsigned int optimizeFlags) const
+    {
+        MeshCacheHeader header;
+        header.magic = MESH_CACHE_MAGIC;
+        header.version = MESH_CACHE_VERSION;
+        header.vertexStride = sizeof(Vertex);
+        header.indexStride = sizeof(unsigned int);
+        header.optimizeFlags = optimizeFlags;
+        header.lodCount = static_cast<uint32_t>(lods.size());
+        header.vertexCount = numVertices;
+        header.indexCount = numIndices;
+        header.sourceSize = sourceSize;
+        header.sourceHash = sourceHash;
+        for (int i = 0; i < 3; ++i) {
+            header.boundsMin[i] = boundsMin[i];
+            header.boundsMax[i] = boundsMax[i];
+        }
+        return header;
+    }
+};
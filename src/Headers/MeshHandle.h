@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "../includes/GLAD/glad.h"
+#include "Vertex.h"
+#include "PackedVertex.h"
+
+/*What a draw needs to know about an uploaded mesh: the layout of its index buffer and how the
+  vertex shaders decode its vertices*/
+struct MeshHandle
+{
+    GLenum indexType{ GL_UNSIGNED_INT };
+    GLsizei indexCount{ 0 };
+    VertexDecodeParams decode;
+};
+
+/*Vertex count 16-bit indices can address (no primitive restart, so 0xFFFF is a valid index)*/
+const size_t MESH_SHORT_INDEX_VERTEX_LIMIT = size_t(1) << 16;
+
+inline GLenum selectIndexType(size_t vertexCount)
+{
+    return vertexCount <= MESH_SHORT_INDEX_VERTEX_LIMIT ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t indexTypeSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+/*Fill the bound GL_ELEMENT_ARRAY_BUFFER with the narrowest index type vertexCount allows.
+  Indices stay 32-bit on the CPU side; only the uploaded copy is narrowed.*/
+inline MeshHandle uploadIndexBuffer(const unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+    MeshHandle mesh;
+    mesh.indexType = selectIndexType(vertexCount);
+    mesh.indexCount = GLsizei(indexCount);
+
+    if (mesh.indexType == GL_UNSIGNED_SHORT) {
+        std::vector<uint16_t> shortIndices(indices, indices + indexCount);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    }
+    return mesh;
+}
+
+/*Attribute layout of the float Vertex on the bound VAO/VBO: position, UV, normal, tangent, bitangent*/
+inline void setVertexAttributePointers()
+{
+    // Position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, vPos));
+    glEnableVertexAttribArray(0);
+
+    // Texture coordinate attribute
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, vTexCoords));
+    glEnableVertexAttribArray(1);
+
+    // Normal attribute
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vNormals)));
+    glEnableVertexAttribArray(2);
+
+    // Tangent attribute
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vTangent)));
+    glEnableVertexAttribArray(3);
+
+    // Bitangent attribute
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, vBiTangent)));
+    glEnableVertexAttribArray(4);
+}
+
+/*Packed layout: attribute 0 is unorm16 relative to the mesh AABB, attribute 1 half floats, and the
+  tangent frame is one quaternion at PACKED_QTANGENT_LOCATION in place of attributes 2-4*/
+inline void setPackedVertexAttributePointers()
+{
+    // Position attribute
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+
+    // Texture coordinate attribute
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+    glEnableVertexAttribArray(1);
+
+    // Tangent frame attribute, not normalized: the shader scales it so the snorm rule of the driver does not matter
+    glVertexAttribPointer(PACKED_QTANGENT_LOCATION, 4, GL_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, qTangent));
+    glEnableVertexAttribArray(PACKED_QTANGENT_LOCATION);
+}
+
+/*Draw indexCount indices starting at firstIndex from the bound VAO*/
+inline void drawMeshElements(const MeshHandle& mesh, GLsizei indexCount, size_t firstIndex)
+{
+    glDrawElements(GL_TRIANGLES, indexCount, mesh.indexType, (void*)(firstIndex * indexTypeSize(mesh.indexType)));
+}
+
+/*Same with baseVertex added to every index, for index lists shared between parts of one vertex buffer*/
+inline void drawMeshElements(const MeshHandle& mesh, GLsizei indexCount, size_t firstIndex, GLint baseVertex)
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, (void*)(firstIndex * indexTypeSize(mesh.indexType)), baseVertex);
+}
+
+inline void drawMeshElements(const MeshHandle& mesh)
+{
+    drawMeshElements(mesh, mesh.indexCount, 0);
+}
+
+/*Whole index buffer instanceCount times, the shader tells instances apart by gl_InstanceID*/
+inline void drawMeshElementsInstanced(const MeshHandle& mesh, GLsizei instanceCount)
+{
+    glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, mesh.indexType, (void*)0, instanceCount);
+}
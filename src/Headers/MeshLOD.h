@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "MeshHandle.h"
+
+/*One level of detail: a range of the mesh's shared index buffer. error is the simplification
+  error relative to the bounding-sphere radius (0 for the full-resolution level).*/
+struct MeshLOD
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;
+    uint32_t reserved;
+};
+static_assert(sizeof(MeshLOD) == 16, "MeshLOD is stored as is in cooked meshes");
+
+/*Largest on-screen simplification error, in pixels, before a finer level is drawn*/
+const float MESH_LOD_PIXEL_ERROR = 1.0f;
+
+/*LOD levels of a mesh, finest first, with the object-space bounding sphere used to size them on screen*/
+struct MeshLODSet
+{
+    std::vector<MeshLOD> lods;
+    glm::vec3 boundsCenter{ 0.0f };
+    float boundsRadius{ 0.0f };
+};
+
+/*Bounding sphere radius of an AABB; shared by the simplifier and the selection*/
+inline float meshBoundsRadius(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    return 0.5f * glm::length(boundsMax - boundsMin);
+}
+
+/*What a pass needs to size objects on screen*/
+struct MeshLODView
+{
+    glm::vec3 eye{ 0.0f };
+    float pixelScale{ 0.0f }; /*pixels per world unit at distance 1 (perspective) or anywhere (orthographic)*/
+    bool orthographic{ false };
+};
+
+/*Works for both glm::perspective and glm::ortho projections*/
+inline MeshLODView makeMeshLODView(const glm::mat4& viewMat, const glm::mat4& projMat, int viewportHeight)
+{
+    MeshLODView view;
+    view.eye = glm::vec3(glm::inverse(viewMat)[3]);
+    view.orthographic = projMat[2][3] == 0.0f;
+    view.pixelScale = projMat[1][1] * 0.5f * float(viewportHeight);
+    return view;
+}
+
+/*Projected bounding-sphere radius in pixels of the mesh drawn with modelMat*/
+inline float projectedRadiusPixels(const MeshLODSet& lodSet, const glm::mat4& modelMat, const MeshLODView& view)
+{
+    float scale = std::max(glm::length(glm::vec3(modelMat[0])), std::max(glm::length(glm::vec3(modelMat[1])), glm::length(glm::vec3(modelMat[2]))));
+    float radius = lodSet.boundsRadius * scale;
+    if (view.orthographic)
+        return radius * view.pixelScale;
+
+    glm::vec3 center = glm::vec3(modelMat * glm::vec4(lodSet.boundsCenter, 1.0f));
+    float distance = glm::length(center - view.eye);
+    if (distance <= radius)
+        return FLT_MAX;
+    return radius / distance * view.pixelScale;
+}
+
+/*Coarsest level whose error stays under maxPixelError at this size*/
+inline const MeshLOD& selectMeshLOD(const MeshLODSet& lodSet, float radiusPixels, float maxPixelError = MESH_LOD_PIXEL_ERROR)
+{
+    size_t chosen = 0;
+    for (size_t i = 1; i < lodSet.lods.size(); ++i) {
+        if (lodSet.lods[i].error * radiusPixels > maxPixelError)
+            break;
+        chosen = i;
+    }
+    return lodSet.lods[chosen];
+}
+
+/*Draw the level selected for modelMat from the bound VAO, whose index buffer is mesh's*/
+inline void drawMeshLOD(const MeshHandle& mesh, const MeshLODSet& lodSet, const glm::mat4& modelMat, const MeshLODView& view)
+{
+    if (lodSet.lods.empty())
+        return;
+    const MeshLOD& lod = selectMeshLOD(lodSet, projectedRadiusPixels(lodSet, modelMat, view));
+    drawMeshElements(mesh, GLsizei(lod.indexCount), lod.indexOffset);
+}
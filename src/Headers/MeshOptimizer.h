@@ -0,0 +1,248 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include "Vertex.h"
+
+/*Which post-import passes optimizeMesh runs*/
+enum MeshOptimizeFlags : unsigned int
+{
+    MESH_OPTIMIZE_NONE = 0,
+    MESH_OPTIMIZE_VERTEX_CACHE = 1, /*reorder triangles for the post-transform cache*/
+    MESH_OPTIMIZE_VERTEX_FETCH = 2, /*reorder vertices to first use, drop unreferenced ones*/
+    MESH_OPTIMIZE_LOD_CHAIN = 4,    /*append simplified levels (CookedMesh only, see MeshSimplifier.h)*/
+    MESH_OPTIMIZE_ALL = 7
+};
+
+/*Cache size used for reporting; matches a typical FIFO post-transform cache*/
+const unsigned int VERTEX_CACHE_REPORT_SIZE = 16;
+
+/*Cache size the optimizer scores against (Forsyth's LRU model)*/
+const unsigned int VERTEX_CACHE_OPTIMIZE_SIZE = 32;
+
+/*ACMR: transformed vertices per triangle. ATVR: transformed vertices per referenced vertex (1.0 is ideal).*/
+struct VertexCacheStats
+{
+    float acmr{ 0.0f };
+    float atvr{ 0.0f };
+};
+
+/*-----------VERTEX CACHE ANALYSIS----------*/
+/*Simulate a FIFO cache of cacheSize entries over the index stream*/
+inline VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_REPORT_SIZE)
+{
+    VertexCacheStats stats;
+    if (indexCount < 3 || vertexCount == 0)
+        return stats;
+
+    /*A vertex is cached while fewer than cacheSize misses happened since it was loaded*/
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t misses = 0;
+    size_t referencedCount = 0;
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        unsigned int v = indices[i];
+        if (!referenced[v]) {
+            referenced[v] = true;
+            ++referencedCount;
+        }
+        if (loadedAt[v] == 0 || misses + 1 - loadedAt[v] > cacheSize) {
+            ++misses;
+            loadedAt[v] = misses;
+        }
+    }
+
+    stats.acmr = float(misses) / float(indexCount / 3);
+    stats.atvr = float(misses) / float(referencedCount);
+    return stats;
+}
+
+inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_REPORT_SIZE)
+{
+    return analyzeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize);
+}
+
+/*-----------VERTEX CACHE OPTIMIZATION----------*/
+/*Forsyth's score for a vertex at cachePosition (-1 if not cached) with liveTriangles unemitted triangles left*/
+inline float forsythVertexScore(int cachePosition, unsigned int liveTriangles)
+{
+    if (liveTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            /*The last triangle's vertices get a fixed score so it is not simply repeated*/
+            score = 0.75f;
+        }
+        else {
+            float scaler = 1.0f / float(VERTEX_CACHE_OPTIMIZE_SIZE - 3);
+            score = std::pow(1.0f - float(cachePosition - 3) * scaler, 1.5f);
+        }
+    }
+
+    /*Favour vertices with few triangles left so they are finished and leave the working set*/
+    score += 2.0f / std::sqrt(float(liveTriangles));
+    return score;
+}
+
+/*Reorder triangles (in place) for the post-transform vertex cache. Linear-speed greedy
+  algorithm after Tom Forsyth; the vertex array itself is unchanged.*/
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2 || vertexCount == 0)
+        return;
+
+    /*Vertex -> triangle adjacency; each list keeps its live triangles at the front*/
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        liveTriangles[indices[i]]++;
+
+    std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+    std::vector<unsigned int> adjacency(adjacencyOffsets[vertexCount]);
+    {
+        std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = forsythVertexScore(-1, liveTriangles[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+    size_t bestTriangle = 0;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        if (score > bestScore) {
+            bestScore = score;
+            bestTriangle = t;
+        }
+    }
+
+    const size_t NO_TRIANGLE = size_t(-1);
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(VERTEX_CACHE_OPTIMIZE_SIZE + 3);
+    nextCache.reserve(VERTEX_CACHE_OPTIMIZE_SIZE + 3);
+
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    size_t scanCursor = 0;
+
+    while (result.size() < triangleCount * 3) {
+        /*Nothing useful in the cache: continue with the next unemitted triangle in input order*/
+        if (bestTriangle == NO_TRIANGLE) {
+            while (emitted[scanCursor])
+                ++scanCursor;
+            bestTriangle = scanCursor;
+        }
+
+        const unsigned int* triangle = &indices[bestTriangle * 3];
+        emitted[bestTriangle] = true;
+
+        /*Emit and remove the triangle from its vertices' live lists*/
+        nextCache.clear();
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = triangle[k];
+            result.push_back(v);
+
+            unsigned int* list = &adjacency[adjacencyOffsets[v]];
+            unsigned int live = liveTriangles[v];
+            for (unsigned int j = 0; j < live; ++j) {
+                if (list[j] == bestTriangle) {
+                    std::swap(list[j], list[live - 1]);
+                    break;
+                }
+            }
+            liveTriangles[v]--;
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+                nextCache.push_back(v);
+        }
+
+        /*LRU update: emitted vertices move to the front*/
+        for (unsigned int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        cache.swap(nextCache);
+
+        /*Rescore cached vertices; anything past the cache size falls out*/
+        for (size_t i = 0; i < cache.size(); ++i) {
+            unsigned int v = cache[i];
+            cachePosition[v] = i < VERTEX_CACHE_OPTIMIZE_SIZE ? int(i) : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], liveTriangles[v]);
+        }
+
+        /*Best live triangle touching the cache*/
+        bestTriangle = NO_TRIANGLE;
+        bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            const unsigned int* list = &adjacency[adjacencyOffsets[v]];
+            for (unsigned int j = 0; j < liveTriangles[v]; ++j) {
+                size_t t = list[j];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (cache.size() > VERTEX_CACHE_OPTIMIZE_SIZE)
+            cache.resize(VERTEX_CACHE_OPTIMIZE_SIZE);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+/*-----------VERTEX FETCH OPTIMIZATION----------*/
+/*Reorder vertices to the order the index buffer first uses them and drop unreferenced ones.
+  Returns the new vertex count.*/
+inline size_t optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int UNASSIGNED = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(vertices.size(), UNASSIGNED);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (unsigned int& index : indices) {
+        if (remap[index] == UNASSIGNED) {
+            remap[index] = static_cast<unsigned int>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered);
+    return vertices.size();
+}
+
+/*-----------POST-IMPORT OPTIMIZATION----------*/
+/*Run the passes selected by flags. With a label, ACMR/ATVR before and after are printed.*/
+inline void optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, unsigned int flags, const char* label = nullptr)
+{
+    if (flags == MESH_OPTIMIZE_NONE)
+        return;
+
+    VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+
+    if (flags & MESH_OPTIMIZE_VERTEX_CACHE)
+        optimizeVertexCache(indices, vertices.size());
+    if (flags & MESH_OPTIMIZE_VERTEX_FETCH)
+        optimizeVertexFetch(vertices, indices);
+
+    if (label) {
+        VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+        std::cout << "MESH OPTIMIZER: " << label << " ACMR " << before.acmr << " -> " << after.acmr
+            << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    }
+}
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "../includes/glm/glm.hpp"
+#include "Vertex.h"
+#include "MeshLOD.h"
+#include "MeshOptimizer.h"
+
+/*Triangle ratios of the generated LOD chain, after the full-resolution level*/
+const float MESH_LOD_RATIOS[] = { 0.5f, 0.25f, 0.1f };
+
+/*Symmetric 4x4 error quadric (Garland-Heckbert), stored as its upper triangle, plus the total
+  plane weight so evaluate() returns a weighted mean squared distance rather than area * distance^2*/
+struct MeshQuadric
+{
+    double a00{ 0 }, a01{ 0 }, a02{ 0 }, a03{ 0 };
+    double a11{ 0 }, a12{ 0 }, a13{ 0 };
+    double a22{ 0 }, a23{ 0 };
+    double a33{ 0 };
+    double weight{ 0 };
+
+    /*Squared distance to the plane n.p + d = 0, scaled by weight*/
+    static MeshQuadric fromPlane(const glm::dvec3& n, double d, double weight)
+    {
+        MeshQuadric q;
+        q.a00 = weight * n.x * n.x; q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z; q.a03 = weight * n.x * d;
+        q.a11 = weight * n.y * n.y; q.a12 = weight * n.y * n.z; q.a13 = weight * n.y * d;
+        q.a22 = weight * n.z * n.z; q.a23 = weight * n.z * d;
+        q.a33 = weight * d * d;
+        q.weight = weight;
+        return q;
+    }
+
+    MeshQuadric& operator+=(const MeshQuadric& other)
+    {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+        a11 += other.a11; a12 += other.a12; a13 += other.a13;
+        a22 += other.a22; a23 += other.a23;
+        a33 += other.a33;
+        weight += other.weight;
+        return *this;
+    }
+
+    double evaluate(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double result = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+            + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+            + a22 * z * z + 2.0 * a23 * z
+            + a33;
+        return weight > 0.0 ? std::max(result, 0.0) / weight : 0.0;
+    }
+};
+
+/*-----------MESH SIMPLIFICATION----------*/
+/*Same normal and texture coordinates: at one position, either vertex can stand in for the other*/
+inline bool meshVertexAttributesMatch(const Vertex& a, const Vertex& b)
+{
+    return a.vNormals == b.vNormals && a.vTexCoords == b.vTexCoords;
+}
+
+/*Half-edge collapse simplification towards targetIndexCount indices. Vertices only ever collapse onto
+  an existing neighbour, so the result indexes the same vertex array and can share its VBO.
+  Vertices sharing a position (UV/normal seams, hard edges) form one position class, and a collapse
+  moves a whole class onto the neighbouring one: each of its vertices becomes the vertex of the target
+  class it shares a triangle with, or follows an identical vertex of its own class that does. A collapse
+  where some vertex has no such counterpart would tear a seam or smear a hard edge and is skipped, so
+  seams and creases only ever shorten along themselves. Open borders are locked. outError receives
+  the largest collapse error as an object-space distance.*/
+inline std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float* outError = nullptr)
+{
+    size_t vertexCount = vertices.size();
+    std::vector<unsigned int> result(indices);
+    if (outError)
+        *outError = 0.0f;
+    if (result.size() <= targetIndexCount || vertexCount == 0)
+        return result;
+
+    /*Weld vertices sharing a position into one position class, named after its first vertex*/
+    std::vector<unsigned int> positionClass(vertexCount);
+    {
+        struct PositionKey
+        {
+            uint32_t bits[3];
+            bool operator==(const PositionKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+        };
+        struct PositionHash
+        {
+            size_t operator()(const PositionKey& key) const
+            {
+                uint64_t h = (uint64_t(key.bits[0]) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(key.bits[1]) * 0xC2B2AE3D27D4EB4Full) ^ (uint64_t(key.bits[2]) * 0x165667B19E3779F9ull);
+                return static_cast<size_t>(h ^ (h >> 32));
+            }
+        };
+        std::unordered_map<PositionKey, unsigned int, PositionHash> firstVertex;
+        firstVertex.reserve(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            PositionKey key;
+            std::memcpy(key.bits, &vertices[v].vPos, sizeof(key.bits));
+            auto inserted = firstVertex.emplace(key, static_cast<unsigned int>(v));
+            positionClass[v] = inserted.first->second;
+        }
+    }
+
+    /*Members of each class, contiguous per class*/
+    std::vector<size_t> classOffsets(vertexCount + 1, 0);
+    std::vector<unsigned int> classMembers(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        classOffsets[positionClass[v] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        classOffsets[v + 1] += classOffsets[v];
+    {
+        std::vector<size_t> fill(classOffsets.begin(), classOffsets.end() - 1);
+        for (size_t v = 0; v < vertexCount; ++v)
+            classMembers[fill[positionClass[v]]++] = static_cast<unsigned int>(v);
+    }
+
+    /*Open borders: directed class edges with no opposite edge. Seams are not borders, the classes
+      on either side of them are welded.*/
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::unordered_map<uint64_t, unsigned int> directedEdges;
+        directedEdges.reserve(result.size());
+        auto edgeKey = [](unsigned int a, unsigned int b) { return (uint64_t(a) << 32) | b; };
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; ++k)
+                directedEdges[edgeKey(positionClass[result[i + k]], positionClass[result[i + (k + 1) % 3]])]++;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int a = positionClass[result[i + k]];
+                unsigned int b = positionClass[result[i + (k + 1) % 3]];
+                if (directedEdges.find(edgeKey(b, a)) == directedEdges.end()) {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+    }
+
+    /*Area-weighted plane quadrics per position class*/
+    std::vector<MeshQuadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        glm::dvec3 p0(vertices[result[i]].vPos), p1(vertices[result[i + 1]].vPos), p2(vertices[result[i + 2]].vPos);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double doubleArea = glm::length(normal);
+        if (doubleArea <= 0.0)
+            continue;
+        normal /= doubleArea;
+        MeshQuadric q = MeshQuadric::fromPlane(normal, -glm::dot(normal, p0), 0.5 * doubleArea);
+        for (int k = 0; k < 3; ++k)
+            quadrics[positionClass[result[i + k]]] += q;
+    }
+
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<size_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<Collapse> collapses;
+    /*Per class: frozen for the rest of the pass*/
+    std::vector<bool> touched(vertexCount);
+    std::vector<std::pair<unsigned int, unsigned int>> counterparts;
+    double maxError = 0.0;
+
+    auto triangleNormal = [](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+        return glm::cross(b - a, c - a);
+    };
+
+    while (result.size() > targetIndexCount) {
+        size_t triangleCount = result.size() / 3;
+
+        /*Vertex -> triangle adjacency of the current mesh*/
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (unsigned int v : result)
+            adjacencyOffsets[v + 1]++;
+        for (size_t v = 0; v < vertexCount; ++v)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        {
+            std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t t = 0; t < triangleCount; ++t)
+                for (int k = 0; k < 3; ++k)
+                    adjacency[fill[result[t * 3 + k]]++] = static_cast<unsigned int>(t);
+        }
+
+        /*Candidate collapses: every edge, in both directions, away from an unlocked class*/
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int a = result[i + k];
+                unsigned int b = result[i + (k + 1) % 3];
+                for (int direction = 0; direction < 2; ++direction) {
+                    unsigned int from = direction ? b : a;
+                    unsigned int to = direction ? a : b;
+                    if (locked[positionClass[from]])
+                        continue;
+                    MeshQuadric q = quadrics[positionClass[from]];
+                    q += quadrics[positionClass[to]];
+                    double cost = q.evaluate(vertices[to].vPos);
+                    /*Small penalty for bending the shading normal on smooth surfaces*/
+                    glm::vec3 edge = vertices[to].vPos - vertices[from].vPos;
+                    cost += (1.0 - glm::dot(vertices[from].vNormals, vertices[to].vNormals)) * 0.01 * glm::dot(edge, edge);
+                    collapses.push_back({ from, to, cost });
+                }
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+            return x.cost < y.cost || (x.cost == y.cost && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+        });
+
+        for (size_t v = 0; v < vertexCount; ++v)
+            remap[v] = static_cast<unsigned int>(v);
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t removedTriangles = 0;
+        size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+        size_t collapsesApplied = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (removedTriangles >= trianglesToRemove)
+                break;
+            unsigned int fromClass = positionClass[collapse.from];
+            unsigned int toClass = positionClass[collapse.to];
+            if (fromClass == toClass || touched[fromClass] || touched[toClass])
+                continue;
+            const glm::vec3& target = vertices[collapse.to].vPos;
+
+            /*Pair every used vertex of the class with its counterpart in the target class, and reject
+              collapses that flip or squash a remaining triangle*/
+            bool valid = true;
+            size_t sharedTriangles = 0;
+            counterparts.clear();
+            for (size_t m = classOffsets[fromClass]; m < classOffsets[fromClass + 1] && valid; ++m) {
+                unsigned int from = classMembers[m];
+                if (adjacencyOffsets[from] == adjacencyOffsets[from + 1])
+                    continue;
+                unsigned int counterpart = ~0u;
+                for (size_t j = adjacencyOffsets[from]; j < adjacencyOffsets[from + 1] && valid; ++j) {
+                    const unsigned int* triangle = &result[size_t(adjacency[j]) * 3];
+                    bool shared = false;
+                    for (int k = 0; k < 3; ++k) {
+                        if (positionClass[triangle[k]] != toClass)
+                            continue;
+                        shared = true;
+                        /*Triangles of one vertex must agree on the vertex they collapse onto*/
+                        if (counterpart != ~0u && counterpart != triangle[k])
+                            valid = false;
+                        counterpart = triangle[k];
+                    }
+                    if (shared) {
+                        ++sharedTriangles;
+                        continue;
+                    }
+                    glm::vec3 p[3], q[3];
+                    for (int k = 0; k < 3; ++k) {
+                        p[k] = vertices[triangle[k]].vPos;
+                        q[k] = triangle[k] == from ? target : p[k];
+                    }
+                    glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+                    glm::vec3 after = triangleNormal(q[0], q[1], q[2]);
+                    float beforeLength = glm::length(before), afterLength = glm::length(after);
+                    if (afterLength <= 1e-3f * beforeLength || glm::dot(before, after) < 0.25f * beforeLength * afterLength)
+                        valid = false;
+                }
+                counterparts.push_back({ from, counterpart });
+            }
+            /*Away from the collapsing edge a vertex follows an identical vertex of its class that
+              touches the edge; one with no such twin sits across a seam or crease and pins the class*/
+            for (size_t m = 0; m < counterparts.size() && valid; ++m) {
+                if (counterparts[m].second != ~0u)
+                    continue;
+                for (size_t n = 0; n < counterparts.size() && counterparts[m].second == ~0u; ++n)
+                    if (counterparts[n].second != ~0u && meshVertexAttributesMatch(vertices[counterparts[m].first], vertices[counterparts[n].first]))
+                        counterparts[m].second = counterparts[n].second;
+                valid = counterparts[m].second != ~0u;
+            }
+            if (!valid || sharedTriangles == 0)
+                continue;
+
+            /*Apply, and freeze the neighbourhood for the rest of this pass so the checks above stay exact*/
+            for (const auto& pair : counterparts)
+                remap[pair.first] = pair.second;
+            quadrics[toClass] += quadrics[fromClass];
+            maxError = std::max(maxError, collapse.cost);
+            removedTriangles += sharedTriangles;
+            ++collapsesApplied;
+            for (const auto& pair : counterparts) {
+                for (size_t j = adjacencyOffsets[pair.first]; j < adjacencyOffsets[pair.first + 1]; ++j) {
+                    const unsigned int* triangle = &result[size_t(adjacency[j]) * 3];
+                    for (int k = 0; k < 3; ++k)
+                        touched[positionClass[triangle[k]]] = true;
+                }
+            }
+        }
+
+        if (collapsesApplied == 0)
+            break;
+
+        /*Rewrite the index buffer and drop the triangles that collapsed*/
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (outError)
+        *outError = static_cast<float>(std::sqrt(maxError));
+    return result;
+}
+
+/*-----------LOD CHAIN----------*/
+/*Append simplified levels (MESH_LOD_RATIOS of the full triangle count) to indices and return the
+  level table; level 0 is the original index range. Each level is simplified from the previous one
+  and, with optimizeLevels, reordered for the vertex cache. Stops early when the simplifier can
+  no longer make meaningful progress (everything left is locked).*/
+inline MeshLODSet generateMeshLODs(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, bool optimizeLevels)
+{
+    MeshLODSet lodSet;
+    glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+    if (!vertices.empty()) {
+        boundsMin = boundsMax = vertices[0].vPos;
+        for (const Vertex& vertex : vertices) {
+            boundsMin = glm::min(boundsMin, vertex.vPos);
+            boundsMax = glm::max(boundsMax, vertex.vPos);
+        }
+    }
+    lodSet.boundsCenter = 0.5f * (boundsMin + boundsMax);
+    lodSet.boundsRadius = meshBoundsRadius(boundsMin, boundsMax);
+
+    size_t fullIndexCount = indices.size();
+    lodSet.lods.push_back({ 0, static_cast<uint32_t>(fullIndexCount), 0.0f, 0 });
+
+    std::vector<unsigned int> previous(indices);
+    float previousError = 0.0f;
+    for (float ratio : MESH_LOD_RATIOS) {
+        size_t targetIndexCount = size_t(double(fullIndexCount / 3) * ratio) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> level = simplifyMesh(vertices, previous, targetIndexCount, &error);
+        if (level.empty() || level.size() > previous.size() * 9 / 10)
+            break;
+        if (optimizeLevels)
+            optimizeVertexCache(level, vertices.size());
+
+        /*Each level is simplified from the previous one, so the errors add up*/
+        previousError += error;
+        float relativeError = lodSet.boundsRadius > 0.0f ? previousError / lodSet.boundsRadius : 0.0f;
+        lodSet.lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), relativeError, 0 });
+        indices.insert(indices.end(), level.begin(), level.end());
+        previous.swap(level);
+    }
+    return lodSet;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include "OBJParser.h"
+#include "BenchmarkHelper.h"
+#include "MeshCache.h"
+
+/*Write a synthetic OBJ made of a jittered triangulated grid until roughly targetBytes have been written.*/
+inline bool writeSyntheticOBJ(const std::string& filePath, size_t targetBytes)
+{
+    FILE* file = std::fopen(filePath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    /*Each grid cell costs ~2 faces plus one v/vt/vn triple, about 160 bytes*/
+    size_t gridSize = std::max<size_t>(2, static_cast<size_t>(std::sqrt(targetBytes / 160.0)));
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> jitter(-0.25f, 0.25f);
+    std::vector<char> buffer(1 << 20);
+    size_t used = 0;
+    auto flush = [&]() { std::fwrite(buffer.data(), 1, used, file); used = 0; };
+
+    for (size_t z = 0; z <= gridSize; ++z) {
+        for (size_t x = 0; x <= gridSize; ++x) {
+            if (used + 256 > buffer.size())
+                flush();
+            used += std::snprintf(buffer.data() + used, 256, "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                x + jitter(rng), jitter(rng), z + jitter(rng),
+                x / float(gridSize), z / float(gridSize),
+                jitter(rng), 1.f, jitter(rng));
+        }
+    }
+    for (size_t z = 0; z < gridSize; ++z) {
+        for (size_t x = 0; x < gridSize; ++x) {
+            size_t topLeft = z * (gridSize + 1) + x + 1;
+            size_t topRight = topLeft + 1;
+            size_t bottomLeft = topLeft + gridSize + 1;
+            size_t bottomRight = bottomLeft + 1;
+            if (used + 256 > buffer.size())
+                flush();
+            used += std::snprintf(buffer.data() + used, 256, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\nf %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+                topLeft, topLeft, topLeft, bottomRight, bottomRight, bottomRight, bottomLeft, bottomLeft, bottomLeft,
+                topLeft, topLeft, topLeft, topRight, topRight, topRight, bottomRight, bottomRight, bottomRight);
+        }
+    }
+    flush();
+    std::fclose(file);
+    return true;
+}
+
+inline bool sameOBJOutput(const std::vector<Vertex>& verticesA, const std::vector<unsigned int>& indicesA,
+    const std::vector<Vertex>& verticesB, const std::vector<unsigned int>& indicesB)
+{
+    return verticesA.size() == verticesB.size() && indicesA == indicesB &&
+        (verticesA.empty() || std::memcmp(verticesA.data(), verticesB.data(), verticesA.size() * sizeof(Vertex)) == 0);
+}
+
+/*Parse throughput of the stream parser against the mapped tokenizer, in MB/s*/
+inline void runOBJParserBenchmark(const std::string& filePath, int repeats)
+{
+    std::ifstream sizeProbe(filePath, std::ios::binary | std::ios::ate);
+    if (!sizeProbe.is_open()) {
+        std::cout << "OBJ BENCHMARK: unable to open " << filePath << "\n";
+        return;
+    }
+    double megabytes = static_cast<double>(sizeProbe.tellg()) / (1024.0 * 1024.0);
+    sizeProbe.close();
+
+    std::cout << "OBJ BENCHMARK: " << filePath << " (" << megabytes << " MB, best of " << repeats << ")\n";
+
+    std::vector<Vertex> streamVertices, mappedVertices;
+    std::vector<unsigned int> streamIndices, mappedIndices;
+
+    double streamSeconds = benchmarkBestOf(repeats, [&]() {
+        std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint> uniqueVertices;
+        streamVertices.clear();
+        streamIndices.clear();
+        parseOBJFileStream(filePath, streamVertices, streamIndices, uniqueVertices);
+    });
+    printBenchmarkResult("parseOBJFileStream (getline/istringstream)", streamSeconds, megabytes, "MB/s");
+
+    double mappedSeconds = benchmarkBestOf(repeats, [&]() {
+        mappedVertices.clear();
+        mappedIndices.clear();
+        parseOBJFile(filePath, mappedVertices, mappedIndices);
+    });
+    printBenchmarkResult("parseOBJFile (mmap/from_chars)", mappedSeconds, megabytes, "MB/s");
+
+    std::cout << "Outputs identical: " << (sameOBJOutput(streamVertices, streamIndices, mappedVertices, mappedIndices) ? "yes" : "NO") << "\n";
+
+    /*Dedup alone, on pre-tokenized records, in face corners per second*/
+    OBJRawData rawData;
+    if (!readOBJFile(filePath, rawData))
+        return;
+    double corners = static_cast<double>(rawData.faceCorners.size());
+
+    std::vector<Vertex> mapVertices, flatVertices;
+    std::vector<unsigned int> mapIndices, flatIndices;
+    double mapSeconds = benchmarkBestOf(repeats, [&]() {
+        std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint> uniqueVertices;
+        mapIndices.clear();
+        buildOBJVertices(rawData, mapVertices, mapIndices, uniqueVertices);
+    });
+    printBenchmarkResult("buildOBJVertices (std::map)", mapSeconds, corners, "corners/s");
+
+    double flatSeconds = benchmarkBestOf(repeats, [&]() {
+        flatIndices.clear();
+        buildOBJVertices(rawData, flatVertices, flatIndices);
+    });
+    printBenchmarkResult("buildOBJVertices (flat hash)", flatSeconds, corners, "corners/s");
+
+    std::cout << "Dedup identical: " << (sameOBJOutput(mapVertices, mapIndices, flatVertices, flatIndices) ? "yes" : "NO") << "\n";
+}
+
+/*Scaling of parseOBJFileParallel from 1 to maxThreads threads (doubling, plus maxThreads itself)*/
+inline void runOBJParallelBenchmark(const std::string& filePath, unsigned int maxThreads, int repeats)
+{
+    std::ifstream sizeProbe(filePath, std::ios::binary | std::ios::ate);
+    if (!sizeProbe.is_open()) {
+        std::cout << "OBJ PARALLEL BENCHMARK: unable to open " << filePath << "\n";
+        return;
+    }
+    double megabytes = static_cast<double>(sizeProbe.tellg()) / (1024.0 * 1024.0);
+    sizeProbe.close();
+
+    std::cout << "OBJ PARALLEL BENCHMARK: " << filePath << " (" << megabytes << " MB, best of " << repeats << ")\n";
+
+    std::vector<Vertex> serialVertices;
+    std::vector<unsigned int> serialIndices;
+    double serialSeconds = benchmarkBestOf(repeats, [&]() {
+        serialVertices.clear();
+        serialIndices.clear();
+        parseOBJFile(filePath, serialVertices, serialIndices);
+    });
+    printBenchmarkResult("parseOBJFile (serial)", serialSeconds, megabytes, "MB/s");
+
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(std::max(1u, maxThreads));
+
+    for (unsigned int threads : threadCounts) {
+        std::vector<Vertex> parallelVertices;
+        std::vector<unsigned int> parallelIndices;
+        double seconds = benchmarkBestOf(repeats, [&]() {
+            parallelVertices.clear();
+            parallelIndices.clear();
+            parseOBJFileParallel(filePath, parallelVertices, parallelIndices, threads);
+        });
+        bool identical = sameOBJOutput(serialVertices, serialIndices, parallelVertices, parallelIndices);
+        printBenchmarkResult("parseOBJFileParallel x" + std::to_string(threads), seconds, megabytes, "MB/s");
+        std::cout << "    speedup " << std::setprecision(2) << serialSeconds / seconds << "x, identical to serial: " << (identical ? "yes" : "NO") << "\n";
+    }
+}
+
+/*Startup cost of a cooked mesh against parsing the OBJ, and re-cook detection when the OBJ changes*/
+inline void runMeshCacheBenchmark(const std::string& filePath, int repeats)
+{
+    std::string cachePath = filePath + ".mesh";
+    std::remove(cachePath.c_str());
+
+    std::cout << "MESH CACHE BENCHMARK: " << filePath << " (best of " << repeats << ")\n";
+
+    std::vector<Vertex> parsedVertices;
+    std::vector<unsigned int> parsedIndices;
+    double parseSeconds = benchmarkBestOf(repeats, [&]() {
+        parsedVertices.clear();
+        parsedIndices.clear();
+        parseOBJFileParallel(filePath, parsedVertices, parsedIndices);
+    });
+    double megabytes = static_cast<double>(parsedVertices.size() * sizeof(Vertex) + parsedIndices.size() * sizeof(unsigned int)) / (1024.0 * 1024.0);
+    printBenchmarkResult("parseOBJFileParallel", parseSeconds, megabytes, "MB/s out");
+
+    CookedMesh mesh;
+    BenchmarkTimer cookTimer;
+    bool cooked = mesh.load(filePath, cachePath) && !mesh.fromCache();
+    printBenchmarkResult("CookedMesh::load (parse + cook)", cookTimer.elapsedSeconds(), megabytes, "MB/s out");
+
+    bool fromCache = true;
+    double cachedSeconds = benchmarkBestOf(repeats, [&]() {
+        mesh.load(filePath, cachePath);
+        fromCache = fromCache && mesh.fromCache();
+    });
+    printBenchmarkResult("CookedMesh::load (mapped cache)", cachedSeconds, megabytes, "MB/s out");
+
+    bool identical = mesh.vertexCount() == parsedVertices.size() && mesh.indexCount() == parsedIndices.size() &&
+        std::memcmp(mesh.vertexData(), parsedVertices.data(), parsedVertices.size() * sizeof(Vertex)) == 0 &&
+        std::memcmp(mesh.indexData(), parsedIndices.data(), parsedIndices.size() * sizeof(unsigned int)) == 0;
+    mesh.release();
+
+    std::cout << "Cooked on first load: " << (cooked ? "yes" : "NO") << ", later loads mapped: " << (fromCache ? "yes" : "NO")
+        << ", identical to parse: " << (identical ? "yes" : "NO") << "\n";
+    std::cout << "    speedup " << std::setprecision(2) << parseSeconds / cachedSeconds << "x\n";
+}
@@ -5,20 +5,450 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <charconv>
+#include <cstring>
+#include "../includes/GLAD/glad.h"
 #include "../includes/glm/glm.hpp"
 #include <map>
 #include "Vertex.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "TangentFrame.h"
+#include <algorithm>
+#include <cstdint>
 
 
+/*Zero-based index triple of one face corner*/
+struct OBJFaceCorner
+{
+    GLuint positionIndex{ 0 };
+    GLuint texcoordIndex{ 0 };
+    GLuint normalIndex{ 0 };
+};
+
+/*Raw records of an OBJ file, before vertex deduplication*/
+struct OBJRawData
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<OBJFaceCorner> faceCorners;
+
+    /*Corners using negative (relative) indices: corner index and a pos/uv/normal bit mask.
+      Those components hold an offset from the start of the tokenized range until rebased.*/
+    std::vector<std::pair<size_t, unsigned int>> relativeCorners;
+};
+
+/*-----------OBJ TOKENIZER----------*/
+inline bool objIsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline const char* objSkipBlanks(const char* p, const char* end)
+{
+    while (p < end && objIsBlank(*p))
+        ++p;
+    return p;
+}
+
+inline const char* objNextLine(const char* p, const char* end)
+{
+    const char* newLine = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    return newLine ? newLine + 1 : end;
+}
+
+/*Parse one float, leaving out untouched when the token is not a number*/
+inline const char* objParseFloat(const char* p, const char* end, float& out)
+{
+    p = objSkipBlanks(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    std::from_chars_result result = std::from_chars(p, end, out);
+    return result.ec == std::errc() ? result.ptr : p;
+}
+
+/*Parse one 1-based index and return it zero-based. Negative indices count back from the
+  last record seen in this range and are returned as a range-relative offset.*/
+inline const char* objParseIndex(const char* p, const char* end, size_t rangeCount, GLuint& out, bool& isRelative)
+{
+    p = objSkipBlanks(p, end);
+    long long value = 0;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    isRelative = value < 0;
+    out = isRelative ? static_cast<GLuint>(static_cast<long long>(rangeCount) + value) : static_cast<GLuint>(value - 1);
+    return result.ptr;
+}
+
+/*Tokenize the v/vt/vn/f records in [begin, end). Other records are skipped.
+  Faces are read as three pos/uv/normal corners, like the stream parser.*/
+inline void tokenizeOBJRange(const char* begin, const char* end, OBJRawData& rawData)
+{
+    const char* p = begin;
+    while (p < end) {
+        p = objSkipBlanks(p, end);
+        const char* tokenEnd = p;
+        while (tokenEnd < end && !objIsBlank(*tokenEnd) && *tokenEnd != '\n')
+            ++tokenEnd;
+        size_t tokenLength = static_cast<size_t>(tokenEnd - p);
+
+        if (tokenLength == 1 && p[0] == 'v') {
+            glm::vec3 pos{ 0.f };
+            const char* q = objParseFloat(tokenEnd, end, pos.x);
+            q = objParseFloat(q, end, pos.y);
+            objParseFloat(q, end, pos.z);
+            rawData.positions.push_back(pos);
+        }
+        else if (tokenLength == 2 && p[0] == 'v' && p[1] == 't') {
+            glm::vec2 tc{ 0.f };
+            const char* q = objParseFloat(tokenEnd, end, tc.x);
+            objParseFloat(q, end, tc.y);
+            tc.y = 1.f - tc.y;
+            rawData.texCoords.push_back(tc);
+        }
+        else if (tokenLength == 2 && p[0] == 'v' && p[1] == 'n') {
+            glm::vec3 normals{ 0.f };
+            const char* q = objParseFloat(tokenEnd, end, normals.x);
+            q = objParseFloat(q, end, normals.y);
+            objParseFloat(q, end, normals.z);
+            rawData.normals.push_back(normals);
+        }
+        else if (tokenLength == 1 && p[0] == 'f') {
+            const char* q = tokenEnd;
+            for (int i = 0; i < 3; ++i) {
+                OBJFaceCorner corner;
+                bool isRelative[3];
+                q = objParseIndex(q, end, rawData.positions.size(), corner.positionIndex, isRelative[0]);
+                if (q < end && *q == '/')
+                    ++q;
+                q = objParseIndex(q, end, rawData.texCoords.size(), corner.texcoordIndex, isRelative[1]);
+                if (q < end && *q == '/')
+                    ++q;
+                q = objParseIndex(q, end, rawData.normals.size(), corner.normalIndex, isRelative[2]);
+
+                unsigned int relativeMask = (isRelative[0] ? 1u : 0u) | (isRelative[1] ? 2u : 0u) | (isRelative[2] ? 4u : 0u);
+                if (relativeMask)
+                    rawData.relativeCorners.emplace_back(rawData.faceCorners.size(), relativeMask);
+                rawData.faceCorners.push_back(corner);
+            }
+        }
+        p = objNextLine(tokenEnd, end);
+    }
+}
+
+/*Turn range-relative corner components into absolute indices, given how many records of
+  each kind precede the range in the file.*/
+inline void rebaseOBJRelativeIndices(OBJRawData& rawData, size_t positionBase, size_t texcoordBase, size_t normalBase)
+{
+    for (const std::pair<size_t, unsigned int>& relative : rawData.relativeCorners) {
+        OBJFaceCorner& corner = rawData.faceCorners[relative.first];
+        if (relative.second & 1u)
+            corner.positionIndex = static_cast<GLuint>(positionBase + static_cast<int>(corner.positionIndex));
+        if (relative.second & 2u)
+            corner.texcoordIndex = static_cast<GLuint>(texcoordBase + static_cast<int>(corner.texcoordIndex));
+        if (relative.second & 4u)
+            corner.normalIndex = static_cast<GLuint>(normalBase + static_cast<int>(corner.normalIndex));
+    }
+    rawData.relativeCorners.clear();
+}
+
+/*Vertex for one face corner. Missing attributes (e.g. "f 1//1") fall back to zero.*/
+inline Vertex makeOBJVertex(const OBJRawData& rawData, const OBJFaceCorner& corner)
+{
+    Vertex vertex;
+    if (corner.positionIndex < rawData.positions.size())
+        vertex.vPos = rawData.positions[corner.positionIndex];
+    if (corner.texcoordIndex < rawData.texCoords.size())
+        vertex.vTexCoords = rawData.texCoords[corner.texcoordIndex];
+    if (corner.normalIndex < rawData.normals.size())
+        vertex.vNormals = rawData.normals[corner.normalIndex];
+    return vertex;
+}
+
+/*Open-addressing (linear probing) table from a pos/uv/normal index triple to its
+  deduplicated vertex index. One flat slot array, no per-entry allocation.*/
+class OBJVertexDedupTable
+{
+public:
+    /*Pre-sized so that a mesh with up to one unique vertex per face stays under half load*/
+    explicit OBJVertexDedupTable(size_t faceCount)
+    {
+        size_t capacity = 16;
+        while (capacity < faceCount * 2)
+            capacity *= 2;
+        slots.assign(capacity, Slot());
+        mask = capacity - 1;
+    }
+
+    /*Return the vertex index stored for corner, or store newIndex and return it*/
+    GLuint findOrInsert(const OBJFaceCorner& corner, GLuint newIndex, bool& inserted)
+    {
+        size_t slotIndex = hashCorner(corner) & mask;
+        for (;;) {
+            Slot& slot = slots[slotIndex];
+            if (slot.vertexIndex == EMPTY_SLOT) {
+                slot.key = corner;
+                slot.vertexIndex = newIndex;
+                inserted = true;
+                if (++count * 2 > slots.size())
+                    grow();
+                return newIndex;
+            }
+            if (slot.key.positionIndex == corner.positionIndex && slot.key.texcoordIndex == corner.texcoordIndex && slot.key.normalIndex == corner.normalIndex) {
+                inserted = false;
+                return slot.vertexIndex;
+            }
+            slotIndex = (slotIndex + 1) & mask;
+        }
+    }
+
+private:
+    static const GLuint EMPTY_SLOT = 0xFFFFFFFFu;
+
+    struct Slot
+    {
+        OBJFaceCorner key;
+        GLuint vertexIndex{ EMPTY_SLOT };
+    };
+
+    std::vector<Slot> slots;
+    size_t mask{ 0 };
+    size_t count{ 0 };
+
+    static size_t hashCorner(const OBJFaceCorner& corner)
+    {
+        uint64_t packed = (uint64_t(corner.positionIndex) << 32) | corner.texcoordIndex;
+        uint64_t h = packed * 0x9E3779B97F4A7C15ull ^ (uint64_t(corner.normalIndex) * 0xC2B2AE3D27D4EB4Full);
+        h ^= h >> 32;
+        return static_cast<size_t>(h);
+    }
+
+    void grow()
+    {
+        std::vector<Slot> oldSlots(slots.size() * 2);
+        oldSlots.swap(slots);
+        mask = slots.size() - 1;
+        for (const Slot& slot : oldSlots) {
+            if (slot.vertexIndex == EMPTY_SLOT)
+                continue;
+            size_t slotIndex = hashCorner(slot.key) & mask;
+            while (slots[slotIndex].vertexIndex != EMPTY_SLOT)
+                slotIndex = (slotIndex + 1) & mask;
+            slots[slotIndex] = slot;
+        }
+    }
+};
+
+/*Deduplicate face corners into the final vertex and index arrays*/
+inline void buildOBJVertices(const OBJRawData& rawData,
+    std::vector<Vertex>& outVertices,
+    std::vector<unsigned int>& orderedIndices
+)
+{
+    std::vector<Vertex> vertices;
+    orderedIndices.reserve(orderedIndices.size() + rawData.faceCorners.size());
+
+    OBJVertexDedupTable uniqueVertices(rawData.faceCorners.size() / 3);
+    for (const OBJFaceCorner& corner : rawData.faceCorners) {
+        bool inserted = false;
+        unsigned int index = uniqueVertices.findOrInsert(corner, static_cast<GLuint>(vertices.size()), inserted);
+        if (inserted)
+            vertices.push_back(makeOBJVertex(rawData, corner));
+        orderedIndices.push_back(index);
+    }
+
+    outVertices = std::move(vertices);
+}
+
+/*Same, with a caller-owned map that keeps the unique corners after parsing*/
+inline void buildOBJVertices(const OBJRawData& rawData,
+    std::vector<Vertex>& outVertices,
+    std::vector<unsigned int>& orderedIndices,
+    std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint>& uniqueVertices
+)
+{
+    std::vector<Vertex> vertices;
+    orderedIndices.reserve(orderedIndices.size() + rawData.faceCorners.size());
+
+    for (const OBJFaceCorner& corner : rawData.faceCorners) {
+        std::tuple<GLuint, GLuint, GLuint> uniqueKey = { corner.positionIndex, corner.texcoordIndex, corner.normalIndex };
+        auto it = uniqueVertices.lower_bound(uniqueKey);
+        unsigned int index;
+        if (it != uniqueVertices.end() && it->first == uniqueKey) {
+            index = it->second;
+        }
+        else {
+            vertices.push_back(makeOBJVertex(rawData, corner));
+            index = static_cast<unsigned int>(vertices.size() - 1);
+            uniqueVertices.emplace_hint(it, uniqueKey, index);
+        }
+        orderedIndices.push_back(index);
+    }
+
+    outVertices = std::move(vertices);
+}
+
+/*-----------READ OBJ----------*/
+/*Memory-maps the file and tokenizes it in place; no per-line allocations.*/
+inline bool readOBJFile(const std::string& filePath, OBJRawData& rawData)
+{
+    MappedFile OBJfile(filePath);
+    if (!OBJfile.isOpen()) {
+        std::cout << "Unable to open file: " << filePath << std::endl;
+        return false;
+    }
+
+    tokenizeOBJRange(OBJfile.data(), OBJfile.data() + OBJfile.size(), rawData);
+    rebaseOBJRelativeIndices(rawData, 0, 0, 0);
+    return true;
+}
+
+/*Minimum bytes per chunk so small files are not split across threads*/
+const size_t OBJ_MIN_CHUNK_BYTES = size_t(1) << 20;
+
+/*Split the file at line boundaries, tokenize the chunks on the shared thread pool into
+  per-chunk arrays, then merge them in file order. The merged records are identical to
+  readOBJFile's. threadCount 0 uses every pool thread plus the caller.*/
+inline bool readOBJFileParallel(const std::string& filePath, OBJRawData& rawData, unsigned int threadCount = 0)
+{
+    MappedFile OBJfile(filePath);
+    if (!OBJfile.isOpen()) {
+        std::cout << "Unable to open file: " << filePath << std::endl;
+        return false;
+    }
 
-void computeTangentBasis(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    ThreadPool& pool = sharedThreadPool();
+    const char* fileBegin = OBJfile.data();
+    const char* fileEnd = fileBegin + OBJfile.size();
+
+    size_t chunkCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    chunkCount = std::max<size_t>(1, std::min(chunkCount, OBJfile.size() / OBJ_MIN_CHUNK_BYTES));
+
+    /*Chunk boundaries, each moved forward to the start of the next line*/
+    std::vector<const char*> chunkStarts(chunkCount + 1, fileEnd);
+    chunkStarts[0] = fileBegin;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        const char* split = fileBegin + OBJfile.size() * i / chunkCount;
+        split = std::max(split, chunkStarts[i - 1]);
+        chunkStarts[i] = split > fileBegin && split[-1] == '\n' ? split : objNextLine(split, fileEnd);
+    }
+
+    std::vector<OBJRawData> chunks(chunkCount);
+    pool.parallelFor(chunkCount, chunkCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            tokenizeOBJRange(chunkStarts[i], chunkStarts[i + 1], chunks[i]);
+    });
+
+    /*Prefix offsets of every record kind*/
+    std::vector<size_t> positionBase(chunkCount + 1, 0), texcoordBase(chunkCount + 1, 0), normalBase(chunkCount + 1, 0), cornerBase(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+        texcoordBase[i + 1] = texcoordBase[i] + chunks[i].texCoords.size();
+        normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+        cornerBase[i + 1] = cornerBase[i] + chunks[i].faceCorners.size();
+    }
+
+    /*Deterministic merge: every chunk rebases its relative indices and copies into its own slice*/
+    rawData = OBJRawData();
+    rawData.positions.resize(positionBase[chunkCount]);
+    rawData.texCoords.resize(texcoordBase[chunkCount]);
+    rawData.normals.resize(normalBase[chunkCount]);
+    rawData.faceCorners.resize(cornerBase[chunkCount]);
+    pool.parallelFor(chunkCount, chunkCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            OBJRawData& chunk = chunks[i];
+            rebaseOBJRelativeIndices(chunk, positionBase[i], texcoordBase[i], normalBase[i]);
+            std::copy(chunk.positions.begin(), chunk.positions.end(), rawData.positions.begin() + positionBase[i]);
+            std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), rawData.texCoords.begin() + texcoordBase[i]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), rawData.normals.begin() + normalBase[i]);
+            std::copy(chunk.faceCorners.begin(), chunk.faceCorners.end(), rawData.faceCorners.begin() + cornerBase[i]);
+            chunk = OBJRawData();
+        }
+    });
+    return true;
+}
 
 /*-----------PARSE OBJ----------*/
+/*Vertex dedup goes through a flat hash table that is released once parsing finishes.*/
+inline bool parseOBJFile(const std::string& filePath,
+    std::vector<Vertex>& outVertices,
+    std::vector<unsigned int>& orderedIndices
+)
+{
+    OBJRawData rawData;
+    if (!readOBJFile(filePath, rawData))
+        return false;
+
+    buildOBJVertices(rawData, outVertices, orderedIndices);
+
+    computeTangentFrames(outVertices, orderedIndices);
+
+    return true;
+}
+
+/*Overload that also fills a caller-owned map of unique corners*/
 inline bool parseOBJFile(const std::string& filePath,
     std::vector<Vertex>& outVertices,
     std::vector<unsigned int>& orderedIndices,
     std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint>& uniqueVertices
 )
+{
+    OBJRawData rawData;
+    if (!readOBJFile(filePath, rawData))
+        return false;
+
+    buildOBJVertices(rawData, outVertices, orderedIndices, uniqueVertices);
+
+    computeTangentFrames(outVertices, orderedIndices);
+
+    return true;
+}
+
+/*-----------PARSE OBJ (PARALLEL)----------*/
+/*Dedup and tangents run on the merged records exactly as in parseOBJFile,
+  so the output is bit-identical to the serial path.*/
+inline bool parseOBJFileParallel(const std::string& filePath,
+    std::vector<Vertex>& outVertices,
+    std::vector<unsigned int>& orderedIndices,
+    unsigned int threadCount = 0
+)
+{
+    OBJRawData rawData;
+    if (!readOBJFileParallel(filePath, rawData, threadCount))
+        return false;
+
+    buildOBJVertices(rawData, outVertices, orderedIndices);
+
+    computeTangentFrames(outVertices, orderedIndices);
+
+    return true;
+}
+
+inline bool parseOBJFileParallel(const std::string& filePath,
+    std::vector<Vertex>& outVertices,
+    std::vector<unsigned int>& orderedIndices,
+    std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint>& uniqueVertices,
+    unsigned int threadCount = 0
+)
+{
+    OBJRawData rawData;
+    if (!readOBJFileParallel(filePath, rawData, threadCount))
+        return false;
+
+    buildOBJVertices(rawData, outVertices, orderedIndices, uniqueVertices);
+
+    computeTangentFrames(outVertices, orderedIndices);
+
+    return true;
+}
+
+/*-----------PARSE OBJ (STREAM)----------*/
+/*Original getline/istringstream parser, kept as the reference for benchmarks.*/
+inline bool parseOBJFileStream(const std::string& filePath,
+    std::vector<Vertex>& outVertices,
+    std::vector<unsigned int>& orderedIndices,
+    std::map<std::tuple<GLuint, GLuint, GLuint>, GLuint>& uniqueVertices
+)
 {
     std::ifstream OBJfile(filePath);
     if (!OBJfile.is_open()) {
@@ -90,66 +520,7 @@ inline bool parseOBJFile(const std::string& filePath,
 
     outVertices = vertices;
 
-    computeTangentBasis(outVertices, orderedIndices);
+    computeTangentFrames(outVertices, orderedIndices);
 
     return true;
 }
-
-
-inline void computeTangentBasis(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
-{
-    std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
-    std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
-
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        Vertex& v0 = vertices[indices[i]];
-        Vertex& v1 = vertices[indices[i + 1]];
-        Vertex& v2 = vertices[indices[i + 2]];
-
-        /*Calculate the tangent and bitangent as before*/
-        glm::vec3 edge1 = v1.vPos - v0.vPos;
-        glm::vec3 edge2 = v2.vPos - v0.vPos;
-        glm::vec2 deltaUV1 = v1.vTexCoords - v0.vTexCoords;
-        glm::vec2 deltaUV2 = v2.vTexCoords - v0.vTexCoords;
-
-        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        glm::vec3 tangent;
-        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-        glm::vec3 bitangent;
-        bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-        bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-        bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-        /*Accumulate the tangent and bitangent for each vertex of the triangle*/
-        tangents[indices[i]] += tangent;
-        tangents[indices[i + 1]] += tangent;
-        tangents[indices[i + 2]] += tangent;
-
-        bitangents[indices[i]] += bitangent;
-        bitangents[indices[i + 1]] += bitangent;
-        bitangents[indices[i + 2]] += bitangent;
-    }
-
-    /*Normalize and orthogonalize tangent and bitangent*/
-    for (unsigned int i = 0; i < vertices.size(); ++i) {
-        Vertex& vertex = vertices[i];
-
-        if (glm::length(tangents[i]) > 0.0f)
-            vertex.vTangent = glm::normalize(tangents[i]);
-        else
-            vertex.vTangent = glm::vec3(0.0f);
-
-        if (glm::length(bitangents[i]) > 0.0f)
-            vertex.vBiTangent = glm::normalize(bitangents[i]);
-        else
-            vertex.vBiTangent = glm::vec3(0.0f);
-
-        /*Orthogonalize*/
-        vertex.vTangent = glm::normalize(vertex.vTangent - vertex.vNormals * glm::dot(vertex.vNormals, vertex.vTangent));
-        vertex.vBiTangent = glm::cross(vertex.vNormals, vertex.vTangent);
-    }
-}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "../includes/glm/gtc/packing.hpp"
+#include "../includes/glm/gtc/quaternion.hpp"
+#include "Vertex.h"
+
+/*20-byte GPU vertex:
+  position  3 x unorm16 relative to the mesh AABB (+1 pad)  attribute 0
+  texCoords 2 x half float                                   attribute 1
+  qTangent  4 x int16, a unit quaternion holding the normal/tangent frame,
+            the sign of w holding the bitangent handedness    attribute 9*/
+struct PackedVertex
+{
+    uint16_t position[4];
+    uint16_t texCoords[2];
+    int16_t qTangent[4];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay 20 bytes");
+
+/*Attribute location of the quaternion tangent frame (0-4 are the float Vertex, 5-8 the instance matrix)*/
+const GLuint PACKED_QTANGENT_LOCATION = 9;
+
+/*How the vertex shaders decode attribute 0 and the tangent frame of the mesh being drawn*/
+struct VertexDecodeParams
+{
+    bool packed{ false };
+    glm::vec3 positionMin{ 0.0f };
+    glm::vec3 positionExtent{ 1.0f };
+};
+
+/*Quantization range of a mesh: its AABB, with empty axes widened so they still decode exactly*/
+inline VertexDecodeParams computePackedVertexParams(const Vertex* vertices, size_t vertexCount)
+{
+    VertexDecodeParams params;
+    params.packed = true;
+    if (vertexCount == 0)
+        return params;
+
+    glm::vec3 boundsMin = vertices[0].vPos, boundsMax = vertices[0].vPos;
+    for (size_t i = 1; i < vertexCount; ++i) {
+        boundsMin = glm::min(boundsMin, vertices[i].vPos);
+        boundsMax = glm::max(boundsMax, vertices[i].vPos);
+    }
+    params.positionMin = boundsMin;
+    params.positionExtent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    return params;
+}
+
+inline VertexDecodeParams computePackedVertexParams(const std::vector<Vertex>& vertices)
+{
+    return computePackedVertexParams(vertices.data(), vertices.size());
+}
+
+/*-----------TANGENT FRAME----------*/
+/*Orthonormal frame from a vertex: T is made perpendicular to N, and handedness is +1 when
+  cross(N, T) points along the stored bitangent. Degenerate (or NaN, from degenerate UVs)
+  tangents get any perpendicular.*/
+inline void orthonormalTangentFrame(const Vertex& vertex, glm::vec3& normal, glm::vec3& tangent, float& handedness)
+{
+    normal = glm::length(vertex.vNormals) > 0.0f ? glm::normalize(vertex.vNormals) : glm::vec3(0.0f, 1.0f, 0.0f);
+    tangent = vertex.vTangent - glm::dot(vertex.vTangent, normal) * normal;
+    if (!(glm::length(tangent) >= 1e-6f)) {
+        glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        tangent = axis - glm::dot(axis, normal) * normal;
+    }
+    tangent = glm::normalize(tangent);
+    handedness = glm::dot(glm::cross(normal, tangent), vertex.vBiTangent) < 0.0f ? -1.0f : 1.0f;
+}
+
+/*Frame as a unit quaternion with w kept away from zero so its sign survives quantization*/
+inline glm::quat encodeQTangent(const glm::vec3& normal, const glm::vec3& tangent, float handedness)
+{
+    glm::mat3 frame(tangent, glm::cross(normal, tangent), normal);
+    glm::quat q = glm::normalize(glm::quat_cast(frame));
+    if (q.w < 0.0f)
+        q = -q;
+
+    const float bias = 1.0f / 32767.0f;
+    if (q.w < bias) {
+        float scale = std::sqrt(1.0f - bias * bias);
+        q.x *= scale;
+        q.y *= scale;
+        q.z *= scale;
+        q.w = bias;
+    }
+    if (handedness < 0.0f)
+        q = -q;
+    return q;
+}
+
+/*Same decode as the vertex shaders*/
+inline void decodeQTangent(const glm::quat& q, glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+{
+    tangent = glm::vec3(1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y));
+    normal = glm::vec3(2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+    bitangent = glm::cross(normal, tangent) * (q.w < 0.0f ? -1.0f : 1.0f);
+}
+
+/*-----------ENCODE / DECODE----------*/
+inline PackedVertex packVertex(const Vertex& vertex, const VertexDecodeParams& params)
+{
+    PackedVertex packed;
+    glm::vec3 unitPosition = (vertex.vPos - params.positionMin) / params.positionExtent;
+    for (int i = 0; i < 3; ++i)
+        packed.position[i] = glm::packUnorm1x16(unitPosition[i]);
+    packed.position[3] = 0;
+
+    packed.texCoords[0] = glm::packHalf1x16(vertex.vTexCoords.x);
+    packed.texCoords[1] = glm::packHalf1x16(vertex.vTexCoords.y);
+
+    glm::vec3 normal, tangent;
+    float handedness;
+    orthonormalTangentFrame(vertex, normal, tangent, handedness);
+    glm::quat q = encodeQTangent(normal, tangent, handedness);
+    float components[4] = { q.x, q.y, q.z, q.w };
+    for (int i = 0; i < 4; ++i)
+        packed.qTangent[i] = static_cast<int16_t>(glm::packSnorm1x16(components[i]));
+    return packed;
+}
+
+inline Vertex unpackVertex(const PackedVertex& packed, const VertexDecodeParams& params)
+{
+    Vertex vertex;
+    glm::vec3 unitPosition(glm::unpackUnorm1x16(packed.position[0]), glm::unpackUnorm1x16(packed.position[1]), glm::unpackUnorm1x16(packed.position[2]));
+    vertex.vPos = params.positionMin + unitPosition * params.positionExtent;
+    vertex.vTexCoords = glm::vec2(glm::unpackHalf1x16(packed.texCoords[0]), glm::unpackHalf1x16(packed.texCoords[1]));
+
+    /*Integer attribute read as float and scaled in the shader, so the GL normalization rule never matters*/
+    glm::quat q(packed.qTangent[3] / 32767.0f, packed.qTangent[0] / 32767.0f, packed.qTangent[1] / 32767.0f, packed.qTangent[2] / 32767.0f);
+    decodeQTangent(glm::normalize(q), vertex.vNormals, vertex.vTangent, vertex.vBiTangent);
+    return vertex;
+}
+
+inline std::vector<PackedVertex> packVertices(const Vertex* vertices, size_t vertexCount, const VertexDecodeParams& params)
+{
+    std::vector<PackedVertex> packed(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+        packed[i] = packVertex(vertices[i], params);
+    return packed;
+}
+
+/*-----------ERROR BOUNDS----------*/
+/*Largest decode error over a mesh, and the bounds the format guarantees*/
+struct PackedVertexError
+{
+    float position{ 0.0f };      /*world units*/
+    float texCoord{ 0.0f };      /*relative to max(|uv|, 1)*/
+    float normalDegrees{ 0.0f };
+    float tangentDegrees{ 0.0f };
+    size_t handednessFlips{ 0 };
+};
+
+/*Half a quantization step per axis for positions, half an ulp of a half float for UVs, and the
+  angle a 1/32767 step in each quaternion component can rotate the frame by (with margin)*/
+inline PackedVertexError packedVertexErrorBounds(const VertexDecodeParams& params)
+{
+    PackedVertexError bounds;
+    bounds.position = glm::length(params.positionExtent) * (0.5f / 65535.0f) * 1.01f + 1e-6f * glm::length(params.positionMin + params.positionExtent);
+    bounds.texCoord = 1.0f / 2048.0f;
+    bounds.normalDegrees = 0.01f;
+    bounds.tangentDegrees = 0.01f;
+    bounds.handednessFlips = 0;
+    return bounds;
+}
+
+/*atan2 form: acos loses all precision for the tiny angles measured here*/
+inline float angleDegrees(const glm::vec3& a, const glm::vec3& b)
+{
+    return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+}
+
+inline PackedVertexError measurePackedVertexError(const std::vector<Vertex>& vertices, const std::vector<PackedVertex>& packed, const VertexDecodeParams& params)
+{
+    PackedVertexError error;
+    for (size_t i = 0; i < vertices.size() && i < packed.size(); ++i) {
+        const Vertex& original = vertices[i];
+        Vertex decoded = unpackVertex(packed[i], params);
+
+        error.position = std::max(error.position, glm::length(decoded.vPos - original.vPos));
+        glm::vec2 uvScale = glm::max(glm::abs(original.vTexCoords), glm::vec2(1.0f));
+        glm::vec2 uvError = glm::abs(decoded.vTexCoords - original.vTexCoords) / uvScale;
+        error.texCoord = std::max(error.texCoord, std::max(uvError.x, uvError.y));
+
+        glm::vec3 normal, tangent;
+        float handedness;
+        orthonormalTangentFrame(original, normal, tangent, handedness);
+        error.normalDegrees = std::max(error.normalDegrees, angleDegrees(decoded.vNormals, normal));
+        error.tangentDegrees = std::max(error.tangentDegrees, angleDegrees(decoded.vTangent, tangent));
+        if (glm::dot(decoded.vBiTangent, glm::cross(normal, tangent)) * handedness < 0.0f)
+            error.handednessFlips++;
+    }
+    return error;
+}
+
+inline bool withinPackedVertexBounds(const PackedVertexError& error, const PackedVertexError& bounds)
+{
+    return error.position <= bounds.position && error.texCoord <= bounds.texCoord &&
+        error.normalDegrees <= bounds.normalDegrees && error.tangentDegrees <= bounds.tangentDegrees &&
+        error.handednessFlips <= bounds.handednessFlips;
+}
@@ -5,9 +5,16 @@
 #include <numeric>
 #include <cmath>
 #include "Vertex.h"
+#include "TangentFrame.h"
+#include "PerlinSIMD.h"
+#include "ThreadPool.h"
+#include "FixedPoint.h"
+#include "SimplexNoise.h"
+#include "TerrainErosion.h"
 #include <iostream>
 #include <list>
 #include <limits>
+#include <algorithm>
 
 
 /*PERLIN*/
@@ -15,7 +22,9 @@ extern const unsigned int PERLIN_SIZE;
 extern float hScale;
 extern float noiseScale;
 
-void computeTerrainTangentBasis(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+/*fBm of the single terrain, its editor and its cache key*/
+const int TERRAIN_FBM_OCTAVES = 5;
+const float TERRAIN_FBM_PERSISTENCE = 0.5f;
 
 
 inline void perlinNoiseInit(std::vector<int>& perlinG, int& seed) {
@@ -26,208 +35,302 @@ inline void perlinNoiseInit(std::vector<int>& perlinG, int& seed) {
     std::copy_n(perlinG.begin(), PERLIN_SIZE, perlinG.begin() + PERLIN_SIZE);
 }
 
-inline double perlinNoiseFade(double t) {
-    return t * t * t * (t * (t * 6 - 15) + 10);
+/*The scalar noise is templated on its number type: double is the reference, float and Fixed16 trade
+  precision for cheaper arithmetic. In double every expression is the one the double-only code
+  evaluated, so its results are unchanged.*/
+template <typename Real>
+inline Real perlinNoiseFade(Real t) {
+    return t * t * t * (t * (t * Real(6) - Real(15)) + Real(10));
 }
 
-inline double perlinNoiseGradient(int hash, double x, double y) {
+template <typename Real>
+inline Real perlinNoiseGradient(int hash, Real x, Real y) {
     hash &= 7;
-    double u = hash < 4 ? x : y;
-    double v = hash < 4 ? y : x;
-    return ((hash & 1) ? -u : u) + ((hash & 2) ? -2.0 * v : 2.0 * v);
+    Real u = hash < 4 ? x : y;
+    Real v = hash < 4 ? y : x;
+    return ((hash & 1) ? -u : u) + ((hash & 2) ? -Real(2) * v : Real(2) * v);
 }
 
-inline double perlinNoiseLerp(double t, double a, double b) {
+template <typename Real>
+inline Real perlinNoiseLerp(Real t, Real a, Real b) {
     return a + t * (b - a);
 }
 
 
-inline double perlinNoise2D(double x, double y, std::vector<int>& perlinG) {
+template <typename Real>
+inline Real perlinNoise2D(Real x, Real y, const std::vector<int>& perlinG) {
     
-    int X = static_cast<int>(std::floor(x)) & (PERLIN_SIZE - 1);
-    int Y = static_cast<int>(std::floor(y)) & (PERLIN_SIZE - 1);
-    x -= std::floor(x);
-    y -= std::floor(y);
-    double u = perlinNoiseFade(x);
-    double v = perlinNoiseFade(y);
+    int X = noiseFloorToInt(x) & (PERLIN_SIZE - 1);
+    int Y = noiseFloorToInt(y) & (PERLIN_SIZE - 1);
+    x -= noiseFloor(x);
+    y -= noiseFloor(y);
+    Real u = perlinNoiseFade(x);
+    Real v = perlinNoiseFade(y);
     int A = perlinG[X] + Y, AA = perlinG[A], AB = perlinG[(size_t)A + 1],
         B = perlinG[(size_t)X + 1] + Y, BA = perlinG[B], BB = perlinG[(size_t)B + 1];
 
-    return perlinNoiseLerp(v, perlinNoiseLerp(u, perlinNoiseGradient(perlinG[AA], x, y), perlinNoiseGradient(perlinG[BA], x - 1, y)),
-        perlinNoiseLerp(u, perlinNoiseGradient(perlinG[AB], x, y - 1), perlinNoiseGradient(perlinG[BB], x - 1, y - 1)));
+    return perlinNoiseLerp(v, perlinNoiseLerp(u, perlinNoiseGradient(perlinG[AA], x, y), perlinNoiseGradient(perlinG[BA], x - Real(1), y)),
+        perlinNoiseLerp(u, perlinNoiseGradient(perlinG[AB], x, y - Real(1)), perlinNoiseGradient(perlinG[BB], x - Real(1), y - Real(1))));
 }
 
-inline float fractalBrownianMotion(double x, double y, int octaves, float persistence, std::vector<int>& perlinG) {
+template <typename Real = double>
+inline float fractalBrownianMotion(double x, double y, int octaves, float persistence, const std::vector<int>& perlinG) {
 
-    double total = 0;
-    double frequency = 1;
-    double amplitude = 1;
-    double maxValue = 0;  // Used for normalizing result to 0.0 - 1.0
+    Real total(0);
+    Real frequency(1);
+    Real amplitude(1);
+    Real maxValue(0);  // Used for normalizing result to 0.0 - 1.0
     for (int i = 0; i < octaves; i++) {
-        total += perlinNoise2D(x * frequency, y * frequency, perlinG) * amplitude;
+        total += perlinNoise2D(Real(x) * frequency, Real(y) * frequency, perlinG) * amplitude;
 
         maxValue += amplitude;
 
-        amplitude *= persistence;
-        frequency *= 2;
+        amplitude *= Real(persistence);
+        frequency *= Real(2);
     }
 
-    return static_cast<float>(total / maxValue);
+    return noiseToFloat(total / maxValue);
 }
 
 
-inline void generateTerrainVerticesIndices(int& width, int& height, float& heightScale, std::vector<Vertex>& terrainVertices, std::vector<unsigned int>& terrainIndices, std::vector<int>& perlinG, float& outMinHeight, float& outMaxHeight) {
+/*Largest |Fixed16 - double| difference of fBm over coordinates in [0, 1), for any backend and up
+  to 8 octaves; the worst measured is ~1.5e-3, simplex 2D, where the corner falloff's fourth power
+  keeps few fraction bits before the final scale of 70.*/
+const float NOISE_FIXED_TOLERANCE = 4e-3f;
 
-    std::vector<glm::vec3> faceNormals;
-    float texRepeat = 4;
-    // Generate vertices
-    for (int z = 0; z < height; ++z) {
-        for (int x = 0; x < width; ++x) {
-
-            float localHeight = fractalBrownianMotion(x / (float)width, z / (float)height, 5, 0.5f, perlinG) * heightScale;
-            Vertex vertex;
-            vertex.vPos = glm::vec3(x - width/2, localHeight, z - height/2);
-            vertex.vTexCoords = glm::vec2(x / (float)width, z / (float)height);
-            vertex.vTexCoords.x = vertex.vTexCoords.x * texRepeat;
-            vertex.vTexCoords.y = vertex.vTexCoords.y * texRepeat;
-            vertex.vNormals = glm::vec3(0, 0, 0);
-            vertex.vTangent = glm::vec3(0, 0, 0);
-            vertex.vBiTangent = glm::vec3(0, 0, 0);
-
-            terrainVertices.push_back(vertex);
-        }
-    }
-
-    // Generate indices
-    for (int z = 0; z < height - 1; ++z) {
-        for (int x = 0; x < width - 1; ++x) {
-            int topLeft = (z * width) + x;
-            int topRight = topLeft + 1;
-            int bottomLeft = ((z + 1) * width) + x;
-            int bottomRight = bottomLeft + 1;
+/*The same for float simplex, looser than PERLIN_FLOAT_TOLERANCE: float skewing puts a sample near a
+  simplex edge on the neighbouring tetrahedron now and then, worst ~1.1e-5 in 3D at 8 octaves*/
+const float SIMPLEX_FLOAT_TOLERANCE = 3e-5f;
 
-            terrainIndices.push_back(topLeft);
-            terrainIndices.push_back(bottomRight);
-            terrainIndices.push_back(bottomLeft);
 
-            terrainIndices.push_back(topLeft);
-            terrainIndices.push_back(topRight);
-            terrainIndices.push_back(bottomRight);
-
-            glm::vec3 edge1 = terrainVertices[topRight].vPos - terrainVertices[topLeft].vPos;
-            glm::vec3 edge2 = terrainVertices[bottomRight].vPos - terrainVertices[topLeft].vPos;
-            faceNormals.push_back(glm::normalize(glm::cross(edge2, edge1)));
+/*-----------TERRAIN NOISE----------*/
+enum NoiseBasis
+{
+    NOISE_BASIS_PERLIN,
+    NOISE_BASIS_SIMPLEX
+};
 
-            edge1 = terrainVertices[bottomRight].vPos - terrainVertices[topLeft].vPos;
-            edge2 = terrainVertices[bottomLeft].vPos - terrainVertices[topLeft].vPos;
-            faceNormals.push_back(glm::normalize(glm::cross(edge2, edge1)));
+enum NoisePrecision
+{
+    NOISE_PRECISION_FLOAT,
+    NOISE_PRECISION_DOUBLE,
+    NOISE_PRECISION_FIXED
+};
+
+/*The fBm the single terrain is generated from. Perlin in float is the batched SIMD evaluator, the
+  only one with analytic gradients; it needs PERLIN_SIZE 256 and otherwise falls back to double as
+  before. Every other combination runs the scalar templates, and the terrain's normals are
+  accumulated over its triangles.*/
+struct TerrainNoiseSettings
+{
+    NoiseBasis basis{ NOISE_BASIS_PERLIN };
+    NoisePrecision precision{ NOISE_PRECISION_FLOAT };
+};
 
-        }
+/*Samples the terrain fBm for one TerrainNoiseSettings. Holds its own copy of the permutation, so it
+  can be kept and shared across threads; sampling is const.*/
+class TerrainNoiseSampler
+{
+public:
+    TerrainNoiseSampler() = default;
+
+    TerrainNoiseSampler(const std::vector<int>& perlinG, TerrainNoiseSettings settings)
+        : perlinG(perlinG), noiseSettings(settings),
+        batch(settings.basis == NOISE_BASIS_PERLIN && settings.precision == NOISE_PRECISION_FLOAT && PERLIN_SIZE == 256)
+    {
+        if (batch)
+            table = makePerlinNoiseTable(perlinG);
     }
 
-    // Compute vertex normals by averaging face normals
-    for (unsigned int i = 0; i < terrainIndices.size(); i += 3) {
-        for (unsigned int j = 0; j < 3; ++j) {
-            terrainVertices[terrainIndices[i + j]].vNormals += faceNormals[i / 3];
+    /*True when sampleRow can also return slopes*/
+    bool hasGradient() const { return batch; }
+    TerrainNoiseSettings settings() const { return noiseSettings; }
+    const std::vector<int>& permutation() const { return perlinG; }
+
+    /*outNoise[i] = fBm at (sampleX[i], sampleY) for count samples; sampleYScratch holds count floats.
+      With hasGradient() and outDx/outDy, also d/dx and d/dy of each sample.*/
+    void sampleRow(const float* sampleX, float sampleY, float* sampleYScratch, float* outNoise, int count, float* outDx = nullptr, float* outDy = nullptr) const
+    {
+        if (batch) {
+            std::fill(sampleYScratch, sampleYScratch + count, sampleY);
+            if (outDx && outDy)
+                fractalBrownianMotionGradientBatch(sampleX, sampleYScratch, outNoise, outDx, outDy, count, TERRAIN_FBM_OCTAVES, TERRAIN_FBM_PERSISTENCE, table);
+            else
+                fractalBrownianMotionBatch(sampleX, sampleYScratch, outNoise, count, TERRAIN_FBM_OCTAVES, TERRAIN_FBM_PERSISTENCE, table);
+            return;
         }
-    }
-    for (auto& vertex : terrainVertices) {
-        vertex.vNormals = glm::normalize(vertex.vNormals);
-        vertex.vNormals.y = abs(vertex.vNormals.y);
+        if (noiseSettings.precision == NOISE_PRECISION_FIXED)
+            sampleScalarRow<Fixed16>(sampleX, sampleY, outNoise, count);
+        else if (noiseSettings.precision == NOISE_PRECISION_FLOAT && noiseSettings.basis == NOISE_BASIS_SIMPLEX)
+            sampleScalarRow<float>(sampleX, sampleY, outNoise, count);
+        else
+            sampleScalarRow<double>(sampleX, sampleY, outNoise, count);
     }
 
-    outMinHeight = 0;
-    outMaxHeight = 0;
-
-    for (auto& vertex : terrainVertices) {
-        if (vertex.vPos.y < outMinHeight) {
-            outMinHeight = vertex.vPos.y;
-        }
-        if (vertex.vPos.y > outMaxHeight) {
-            outMaxHeight = vertex.vPos.y;
+private:
+    template <typename Real>
+    void sampleScalarRow(const float* sampleX, float sampleY, float* outNoise, int count) const
+    {
+        for (int i = 0; i < count; ++i) {
+            outNoise[i] = noiseSettings.basis == NOISE_BASIS_SIMPLEX
+                ? simplexFractalBrownianMotion<Real>(sampleX[i], sampleY, TERRAIN_FBM_OCTAVES, TERRAIN_FBM_PERSISTENCE, perlinG)
+                : fractalBrownianMotion<Real>(sampleX[i], sampleY, TERRAIN_FBM_OCTAVES, TERRAIN_FBM_PERSISTENCE, perlinG);
         }
     }
 
-
-    computeTerrainTangentBasis(terrainVertices, terrainIndices);
-}
-
-inline void computeTerrainTangentBasis(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
-{
-    std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
-    std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
-
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        Vertex& v0 = vertices[indices[i]];
-        Vertex& v1 = vertices[indices[i + 1]];
-        Vertex& v2 = vertices[indices[i + 2]];
-
-        /*Calculate the tangent and bitangent as before*/
-        glm::vec3 edge1 = v1.vPos - v0.vPos;
-        glm::vec3 edge2 = v2.vPos - v0.vPos;
-        glm::vec2 deltaUV1 = v1.vTexCoords - v0.vTexCoords;
-        glm::vec2 deltaUV2 = v2.vTexCoords - v0.vTexCoords;
-
-        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        glm::vec3 tangent;
-        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-        glm::vec3 bitangent;
-        bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-        bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-        bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-        /*Accumulate the tangent and bitangent for each vertex of the triangle*/
-        tangents[indices[i]] += tangent;
-        tangents[indices[i + 1]] += tangent;
-        tangents[indices[i + 2]] += tangent;
-
-        bitangents[indices[i]] += bitangent;
-        bitangents[indices[i + 1]] += bitangent;
-        bitangents[indices[i + 2]] += bitangent;
+    std::vector<int> perlinG;
+    TerrainNoiseSettings noiseSettings;
+    bool batch{ false };
+    PerlinNoiseTable table;
+};
+
+
+/*Two triangles per quad between rows z and z + 1 of a width-wide grid, wound clockwise seen from
+  above; (width - 1) * 6 indices*/
+inline void writeTerrainQuadRowIndices(int z, int width, unsigned int* quadIndices) {
+    for (int x = 0; x < width - 1; ++x) {
+        unsigned int topLeft = (z * width) + x;
+        unsigned int topRight = topLeft + 1;
+        unsigned int bottomLeft = ((z + 1) * width) + x;
+        unsigned int bottomRight = bottomLeft + 1;
+
+        *quadIndices++ = topLeft;
+        *quadIndices++ = bottomRight;
+        *quadIndices++ = bottomLeft;
+
+        *quadIndices++ = topLeft;
+        *quadIndices++ = topRight;
+        *quadIndices++ = bottomRight;
     }
+}
 
-    /*Normalize and orthogonalize tangent and bitangent*/
-    for (unsigned int i = 0; i < vertices.size(); ++i) {
-        Vertex& vertex = vertices[i];
-
-        if (glm::length(tangents[i]) > 0.0f)
-            vertex.vTangent = glm::normalize(tangents[i]);
-        else
-            vertex.vTangent = glm::vec3(0.0f);
-
-        if (glm::length(bitangents[i]) > 0.0f)
-            vertex.vBiTangent = glm::normalize(bitangents[i]);
-        else
-            vertex.vBiTangent = glm::vec3(0.0f);
+inline void generateTerrainGridIndices(int width, int height, std::vector<unsigned int>& indices) {
+    indices.resize((width > 1 && height > 1) ? (size_t)(width - 1) * (height - 1) * 6 : 0);
+    for (int z = 0; z < height - 1; ++z)
+        writeTerrainQuadRowIndices(z, width, indices.data() + (size_t)z * (width - 1) * 6);
+}
 
-        /*Orthogonalize*/
-        vertex.vTangent = glm::normalize(vertex.vTangent - vertex.vNormals * glm::dot(vertex.vNormals, vertex.vTangent));
-        vertex.vBiTangent = glm::cross(vertex.vNormals, vertex.vTangent);
+/*Heights of row z of a width x height terrain grid: fBm at (x / width, z / height) times heightScale.
+  sampleX holds x / width per column and sampleY is scratch of the same length. When the sampler has
+  gradients and rowSlopeX/rowSlopeZ are given, also the analytic height change per grid step in x
+  and z.*/
+inline void sampleTerrainHeightRow(int z, int width, int height, float heightScale, const TerrainNoiseSampler& noise,
+    const float* sampleX, float* sampleY, float* rowHeights, float* rowSlopeX = nullptr, float* rowSlopeZ = nullptr) {
+    const bool slopes = noise.hasGradient() && rowSlopeX && rowSlopeZ;
+    noise.sampleRow(sampleX, z / (float)height, sampleY, rowHeights, width, slopes ? rowSlopeX : nullptr, slopes ? rowSlopeZ : nullptr);
+    for (int x = 0; x < width; ++x) {
+        rowHeights[x] = rowHeights[x] * heightScale;
+        if (slopes) {
+            rowSlopeX[x] = rowSlopeX[x] * heightScale / (float)width;
+            rowSlopeZ[x] = rowSlopeZ[x] * heightScale / (float)height;
+        }
     }
 }
 
-inline std::vector<float> generateBlendMap(const std::vector<Vertex>& terrainVertices, int width, int height, float minHeight, float maxHeight) {
-    std::vector<float> blendMap(width * height);
-
-    for (int z = 0; z < height; ++z) {
-        for (int x = 0; x < width; ++x) {
-            /*Get the vertex for this point on the terrain*/
-            const Vertex& vertex = terrainVertices[(size_t)z * width + x];
+/*Frame of a height field vertex from its slopes dh/dx and dh/dz: the up-facing normal
+  (-dh/dx, 1, -dh/dz), the tangent along +x (1, dh/dx, 0), already orthogonal to it, and
+  B = cross(N, T) as computeTangentFrames writes it*/
+inline void setTerrainFrameFromSlope(float slopeX, float slopeZ, Vertex& vertex) {
+    vertex.vNormals = glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+    vertex.vTangent = glm::normalize(glm::vec3(1.0f, slopeX, 0.0f));
+    vertex.vBiTangent = glm::cross(vertex.vNormals, vertex.vTangent);
+}
 
-            /*Normalize the height to a value between 0 and 1. 0 represents grass, 1 represents rock */
-            float normalizedHeight = (vertex.vPos.y - minHeight) / (maxHeight - minHeight);
+/*Rows are independent, so heights, vertices and indices are filled in contiguous row ranges on the
+  shared pool, each row writing its own slice of the pre-sized outputs; the result does not depend
+  on threadCount. threadCount 0 uses every pool thread plus the caller, 1 runs serially. noise picks
+  the fBm; with the default batched float Perlin, normals and tangents come from its analytic
+  gradient in the same pass. The scalar backends have no gradient and accumulate them over the
+  triangles afterwards with the same threadCount. erosion, when enabled, reshapes the finished
+  heights before any frame is built; the noise's gradient no longer describes them, so the frames
+  are accumulated over the triangles then too.*/
+inline void generateTerrainVerticesIndices(int& width, int& height, float& heightScale, std::vector<Vertex>& terrainVertices, std::vector<unsigned int>& terrainIndices, std::vector<int>& perlinG, float& outMinHeight, float& outMaxHeight,
+    unsigned int threadCount = 0, TerrainNoiseSettings noise = TerrainNoiseSettings(), TerrainErosionSettings erosion = TerrainErosionSettings()) {
 
-            /*Clamp the value between 0 and 1*/
-            normalizedHeight = std::max(0.f, std::min(1.f, normalizedHeight));
+    float texRepeat = 4;
 
-            /*Store the normalized height in the blendmap*/
-            blendMap[(size_t)z * width + x] = normalizedHeight;
+    /*Heights come from the sampler one row at a time*/
+    TerrainNoiseSampler noiseSampler(perlinG, noise);
+    const bool batchNoise = noiseSampler.hasGradient() && !erosion.enabled();
+
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    size_t quadCount = (width > 1 && height > 1) ? (size_t)(width - 1) * (height - 1) : 0;
+    terrainVertices.resize((size_t)width * height);
+    terrainIndices.resize(quadCount * 6);
+
+    /*Min/max start at 0 like the serial loop did and are reduced per task*/
+    std::vector<float> taskMinHeight(taskCount, 0.f), taskMaxHeight(taskCount, 0.f);
+
+    pool.parallelFor((size_t)height, taskCount, [&](size_t task, size_t firstRow, size_t lastRow) {
+        std::vector<float> sampleX(width), sampleY(width), rowHeights(width), rowSlopeX(width), rowSlopeZ(width);
+        for (int x = 0; x < width; ++x)
+            sampleX[x] = x / (float)width;
+        float minHeight = 0.f, maxHeight = 0.f;
+
+        for (int z = int(firstRow); z < int(lastRow); ++z) {
+            // Generate vertices
+            sampleTerrainHeightRow(z, width, height, heightScale, noiseSampler, sampleX.data(), sampleY.data(), rowHeights.data(),
+                batchNoise ? rowSlopeX.data() : nullptr, batchNoise ? rowSlopeZ.data() : nullptr);
+            for (int x = 0; x < width; ++x) {
+
+                float localHeight = rowHeights[x];
+                Vertex& vertex = terrainVertices[(size_t)z * width + x];
+                vertex.vPos = glm::vec3(x - width/2, localHeight, z - height/2);
+                vertex.vTexCoords = glm::vec2(x / (float)width, z / (float)height);
+                vertex.vTexCoords.x = vertex.vTexCoords.x * texRepeat;
+                vertex.vTexCoords.y = vertex.vTexCoords.y * texRepeat;
+                if (batchNoise) {
+                    setTerrainFrameFromSlope(rowSlopeX[x], rowSlopeZ[x], vertex);
+                }
+                else {
+                    vertex.vNormals = glm::vec3(0, 0, 0);
+                    vertex.vTangent = glm::vec3(0, 0, 0);
+                    vertex.vBiTangent = glm::vec3(0, 0, 0);
+                }
+
+                if (localHeight < minHeight) {
+                    minHeight = localHeight;
+                }
+                if (localHeight > maxHeight) {
+                    maxHeight = localHeight;
+                }
+            }
+
+            // Generate indices, two triangles per quad between this row and the next
+            if (z >= height - 1)
+                continue;
+            writeTerrainQuadRowIndices(z, width, terrainIndices.data() + (size_t)z * (width - 1) * 6);
         }
+
+        taskMinHeight[task] = minHeight;
+        taskMaxHeight[task] = maxHeight;
+    });
+
+    outMinHeight = *std::min_element(taskMinHeight.begin(), taskMinHeight.end());
+    outMaxHeight = *std::max_element(taskMaxHeight.begin(), taskMaxHeight.end());
+
+    if (erosion.enabled()) {
+        std::vector<float> heights(terrainVertices.size());
+        for (size_t i = 0; i < heights.size(); ++i)
+            heights[i] = terrainVertices[i].vPos.y;
+        erodeTerrainHeights(heights, width, height, erosion, threadCount);
+        pool.parallelFor((size_t)height, taskCount, [&](size_t task, size_t firstRow, size_t lastRow) {
+            float minHeight = 0.f, maxHeight = 0.f;
+            for (size_t i = firstRow * width; i < lastRow * width; ++i) {
+                terrainVertices[i].vPos.y = heights[i];
+                minHeight = std::min(minHeight, heights[i]);
+                maxHeight = std::max(maxHeight, heights[i]);
+            }
+            taskMinHeight[task] = minHeight;
+            taskMaxHeight[task] = maxHeight;
+        });
+        outMinHeight = *std::min_element(taskMinHeight.begin(), taskMinHeight.end());
+        outMaxHeight = *std::max_element(taskMaxHeight.begin(), taskMaxHeight.end());
     }
 
-    return blendMap;
+    /*Scalar and eroded paths: normals and tangent frames in one pass over the triangles. The grid is wound
+      clockwise seen from above, so the accumulated (area-weighted) face normals are flipped to point up.*/
+    if (!batchNoise)
+        computeTangentFrames(terrainVertices, terrainIndices, TANGENT_FRAME_ACCUMULATE_NORMALS | TANGENT_FRAME_FLIP_NORMALS, activeSIMDLevel(), threadCount);
 }
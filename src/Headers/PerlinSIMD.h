@@ -0,0 +1,555 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "SIMDHelper.h"
+
+/*Batched float Perlin noise and fBm, 8 samples per step with AVX2 and 4 with SSE2.
+
+  Same lattice, hash and gradients as perlinNoise2D/fractalBrownianMotion in PerlinHelper.h, in
+  float instead of double. The doubled int table is folded into one 256-byte permutation: every
+  index the scalar code forms is below 512, and perlinG[i + 256] == perlinG[i].
+  AVX2 hashes without gathers: each sample's four lattice corners are four bytes of one 32-bit
+  lane, and the permutation is looked up 32 bytes at a time with 16 pshufb over its 16-byte rows.
+  The gradient hash p[p[A + Y]] reads a precomputed permutation-of-the-permutation, so each octave
+  costs two such lookups instead of three.
+
+  The Gradient variants also return d/dx and d/dy, analytically: the bilinear blend of the corner
+  gradient vectors plus the fade derivative times the corner value differences. Their values are the
+  same expressions as the value-only functions, so the heights do not change.
+
+  Every backend evaluates the same float expressions in the same order, so they agree bit for bit.
+  Against the double reference the difference stays within PERLIN_FLOAT_TOLERANCE, and the
+  derivatives within PERLIN_FLOAT_GRADIENT_TOLERANCE of its central differences.*/
+
+/*Largest |float - double| difference of noise or fBm over coordinates in [-256, 256]. Terrain-style
+  coordinates in [0, 1) stay under 3e-7; the worst measured case is ~1.8e-6 at |x| near 256, where
+  the float lattice fraction only keeps ~15 bits.*/
+const float PERLIN_FLOAT_TOLERANCE = 4e-6f;
+
+/*Same for d/dx and d/dy of fBm, divided by the largest octave frequency since every octave's
+  derivative is scaled by it. The worst measured case is ~4.3e-7 in both coordinate ranges.*/
+const float PERLIN_FLOAT_GRADIENT_TOLERANCE = 2e-6f;
+
+/*The 256-entry permutation shared by every backend, and the permutation applied twice: a corner's
+  gradient hash is p[p[A + Y]], so one lookup in twice saves the last dependent lookup*/
+struct PerlinNoiseTable
+{
+    alignas(32) uint8_t permutation[256];
+    alignas(32) uint8_t permutationTwice[256];
+};
+
+/*perlinG must come from perlinNoiseInit with PERLIN_SIZE 256*/
+inline PerlinNoiseTable makePerlinNoiseTable(const std::vector<int>& perlinG)
+{
+    PerlinNoiseTable table;
+    for (int i = 0; i < 256; ++i)
+        table.permutation[i] = static_cast<uint8_t>(perlinG[i]);
+    for (int i = 0; i < 256; ++i)
+        table.permutationTwice[i] = table.permutation[table.permutation[i]];
+    return table;
+}
+
+/*-----------SCALAR----------*/
+inline float perlinNoiseFadeFloat(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+/*d/dt of perlinNoiseFadeFloat, 30 t^2 (t - 1)^2*/
+inline float perlinNoiseFadeDerivativeFloat(float t)
+{
+    return t * t * (t * (t * 30.0f - 60.0f) + 30.0f);
+}
+
+inline float perlinNoiseGradientFloat(int hash, float x, float y)
+{
+    hash &= 7;
+    float u = hash < 4 ? x : y;
+    float v = hash < 4 ? y : x;
+    return ((hash & 1) ? -u : u) + ((hash & 2) ? -2.0f * v : 2.0f * v);
+}
+
+/*The gradient vector perlinNoiseGradientFloat dots with (x, y)*/
+inline void perlinNoiseGradientVectorFloat(int hash, float& gx, float& gy)
+{
+    hash &= 7;
+    float signU = (hash & 1) ? -1.0f : 1.0f;
+    float signV = (hash & 2) ? -2.0f : 2.0f;
+    gx = hash < 4 ? signU : signV;
+    gy = hash < 4 ? signV : signU;
+}
+
+inline float perlinNoiseLerpFloat(float t, float a, float b)
+{
+    return a + t * (b - a);
+}
+
+inline float perlinNoise2DFloat(float x, float y, const PerlinNoiseTable& table)
+{
+    const uint8_t* p = table.permutation;
+    const uint8_t* pp = table.permutationTwice;
+    float floorX = std::floor(x), floorY = std::floor(y);
+    int X = static_cast<int>(floorX) & 255;
+    int Y = static_cast<int>(floorY) & 255;
+    x -= floorX;
+    y -= floorY;
+    float u = perlinNoiseFadeFloat(x);
+    float v = perlinNoiseFadeFloat(y);
+
+    int A = p[X], B = p[(X + 1) & 255];
+    int hashAA = pp[(A + Y) & 255], hashAB = pp[(A + Y + 1) & 255];
+    int hashBA = pp[(B + Y) & 255], hashBB = pp[(B + Y + 1) & 255];
+
+    return perlinNoiseLerpFloat(v, perlinNoiseLerpFloat(u, perlinNoiseGradientFloat(hashAA, x, y), perlinNoiseGradientFloat(hashBA, x - 1.0f, y)),
+        perlinNoiseLerpFloat(u, perlinNoiseGradientFloat(hashAB, x, y - 1.0f), perlinNoiseGradientFloat(hashBB, x - 1.0f, y - 1.0f)));
+}
+
+/*perlinNoise2DFloat and its d/dx, d/dy*/
+inline float perlinNoise2DGradientFloat(float x, float y, const PerlinNoiseTable& table, float& outDx, float& outDy)
+{
+    const uint8_t* p = table.permutation;
+    const uint8_t* pp = table.permutationTwice;
+    float floorX = std::floor(x), floorY = std::floor(y);
+    int X = static_cast<int>(floorX) & 255;
+    int Y = static_cast<int>(floorY) & 255;
+    x -= floorX;
+    y -= floorY;
+    float u = perlinNoiseFadeFloat(x);
+    float v = perlinNoiseFadeFloat(y);
+
+    int A = p[X], B = p[(X + 1) & 255];
+    int hashAA = pp[(A + Y) & 255], hashAB = pp[(A + Y + 1) & 255];
+    int hashBA = pp[(B + Y) & 255], hashBB = pp[(B + Y + 1) & 255];
+
+    float gAA = perlinNoiseGradientFloat(hashAA, x, y), gBA = perlinNoiseGradientFloat(hashBA, x - 1.0f, y);
+    float gAB = perlinNoiseGradientFloat(hashAB, x, y - 1.0f), gBB = perlinNoiseGradientFloat(hashBB, x - 1.0f, y - 1.0f);
+    float bottom = perlinNoiseLerpFloat(u, gAA, gBA), top = perlinNoiseLerpFloat(u, gAB, gBB);
+
+    float xAA, yAA, xBA, yBA, xAB, yAB, xBB, yBB;
+    perlinNoiseGradientVectorFloat(hashAA, xAA, yAA);
+    perlinNoiseGradientVectorFloat(hashBA, xBA, yBA);
+    perlinNoiseGradientVectorFloat(hashAB, xAB, yAB);
+    perlinNoiseGradientVectorFloat(hashBB, xBB, yBB);
+    outDx = perlinNoiseLerpFloat(v, perlinNoiseLerpFloat(u, xAA, xBA), perlinNoiseLerpFloat(u, xAB, xBB))
+        + perlinNoiseFadeDerivativeFloat(x) * perlinNoiseLerpFloat(v, gBA - gAA, gBB - gAB);
+    outDy = perlinNoiseLerpFloat(v, perlinNoiseLerpFloat(u, yAA, yBA), perlinNoiseLerpFloat(u, yAB, yBB))
+        + perlinNoiseFadeDerivativeFloat(y) * (top - bottom);
+    return perlinNoiseLerpFloat(v, bottom, top);
+}
+
+inline float fractalBrownianMotionFloat(float x, float y, int octaves, float persistence, const PerlinNoiseTable& table)
+{
+    float total = 0.0f;
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+    for (int i = 0; i < octaves; i++) {
+        total += perlinNoise2DFloat(x * frequency, y * frequency, table) * amplitude;
+        maxValue += amplitude;
+        amplitude *= persistence;
+        frequency *= 2.0f;
+    }
+    return total / maxValue;
+}
+
+/*fractalBrownianMotionFloat and its d/dx, d/dy: each octave's derivative is scaled by its frequency*/
+inline float fractalBrownianMotionGradientFloat(float x, float y, int octaves, float persistence, const PerlinNoiseTable& table, float& outDx, float& outDy)
+{
+    float total = 0.0f, totalDx = 0.0f, totalDy = 0.0f;
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+    for (int i = 0; i < octaves; i++) {
+        float dx, dy;
+        total += perlinNoise2DGradientFloat(x * frequency, y * frequency, table, dx, dy) * amplitude;
+        totalDx += dx * (amplitude * frequency);
+        totalDy += dy * (amplitude * frequency);
+        maxValue += amplitude;
+        amplitude *= persistence;
+        frequency *= 2.0f;
+    }
+    outDx = totalDx / maxValue;
+    outDy = totalDy / maxValue;
+    return total / maxValue;
+}
+
+#if defined(SIMD_HAS_X86)
+/*-----------SSE2----------*/
+/*floor for |x| < 2^31, without SSE4.1*/
+inline __m128 perlinFloorSSE2(__m128 x)
+{
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+inline __m128 perlinFadeSSE2(__m128 t)
+{
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+inline __m128 perlinGradientSSE2(__m128i hash, __m128 x, __m128 y)
+{
+    hash = _mm_and_si128(hash, _mm_set1_epi32(7));
+    __m128 useX = _mm_castsi128_ps(_mm_cmplt_epi32(hash, _mm_set1_epi32(4)));
+    __m128 u = _mm_or_ps(_mm_and_ps(useX, x), _mm_andnot_ps(useX, y));
+    __m128 v = _mm_or_ps(_mm_and_ps(useX, y), _mm_andnot_ps(useX, x));
+    __m128 signU = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(hash, _mm_set1_epi32(1)), 31));
+    __m128 signV = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(hash, _mm_set1_epi32(2)), 30));
+    return _mm_add_ps(_mm_xor_ps(u, signU), _mm_xor_ps(_mm_mul_ps(_mm_set1_ps(2.0f), v), signV));
+}
+
+inline __m128 perlinFadeDerivativeSSE2(__m128 t)
+{
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(30.0f)), _mm_set1_ps(60.0f))), _mm_set1_ps(30.0f));
+    return _mm_mul_ps(_mm_mul_ps(t, t), inner);
+}
+
+inline void perlinGradientVectorSSE2(__m128i hash, __m128& gx, __m128& gy)
+{
+    hash = _mm_and_si128(hash, _mm_set1_epi32(7));
+    __m128 useX = _mm_castsi128_ps(_mm_cmplt_epi32(hash, _mm_set1_epi32(4)));
+    __m128 signU = _mm_xor_ps(_mm_set1_ps(1.0f), _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(hash, _mm_set1_epi32(1)), 31)));
+    __m128 signV = _mm_xor_ps(_mm_set1_ps(2.0f), _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(hash, _mm_set1_epi32(2)), 30)));
+    gx = _mm_or_ps(_mm_and_ps(useX, signU), _mm_andnot_ps(useX, signV));
+    gy = _mm_or_ps(_mm_and_ps(useX, signV), _mm_andnot_ps(useX, signU));
+}
+
+inline __m128 perlinLerpSSE2(__m128 t, __m128 a, __m128 b)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+/*SSE2 has no byte shuffle, so the 24 hash bytes of 4 samples are read from the tables one by one.
+  x and y become the fractions in the cell; hashes are AA, BA, AB, BB.*/
+inline void perlinHashesSSE2(__m128& x, __m128& y, const PerlinNoiseTable& table, __m128i hashVectors[4])
+{
+    const uint8_t* p = table.permutation;
+    const uint8_t* pp = table.permutationTwice;
+    __m128 floorX = perlinFloorSSE2(x), floorY = perlinFloorSSE2(y);
+    alignas(16) int32_t lattice[2][4];
+    _mm_store_si128((__m128i*)lattice[0], _mm_cvttps_epi32(floorX));
+    _mm_store_si128((__m128i*)lattice[1], _mm_cvttps_epi32(floorY));
+    x = _mm_sub_ps(x, floorX);
+    y = _mm_sub_ps(y, floorY);
+
+    alignas(16) int32_t hashes[4][4];
+    for (int lane = 0; lane < 4; ++lane) {
+        int X = lattice[0][lane] & 255, Y = lattice[1][lane] & 255;
+        int A = p[X], B = p[(X + 1) & 255];
+        hashes[0][lane] = pp[(A + Y) & 255];
+        hashes[1][lane] = pp[(B + Y) & 255];
+        hashes[2][lane] = pp[(A + Y + 1) & 255];
+        hashes[3][lane] = pp[(B + Y + 1) & 255];
+    }
+    for (int corner = 0; corner < 4; ++corner)
+        hashVectors[corner] = _mm_load_si128((const __m128i*)hashes[corner]);
+}
+
+inline __m128 perlinNoise2DSSE2(__m128 x, __m128 y, const PerlinNoiseTable& table)
+{
+    __m128i hashes[4];
+    perlinHashesSSE2(x, y, table, hashes);
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 u = perlinFadeSSE2(x), v = perlinFadeSSE2(y);
+    __m128 x1 = _mm_sub_ps(x, one), y1 = _mm_sub_ps(y, one);
+    __m128 gAA = perlinGradientSSE2(hashes[0], x, y);
+    __m128 gBA = perlinGradientSSE2(hashes[1], x1, y);
+    __m128 gAB = perlinGradientSSE2(hashes[2], x, y1);
+    __m128 gBB = perlinGradientSSE2(hashes[3], x1, y1);
+    return perlinLerpSSE2(v, perlinLerpSSE2(u, gAA, gBA), perlinLerpSSE2(u, gAB, gBB));
+}
+
+inline __m128 perlinNoise2DGradientSSE2(__m128 x, __m128 y, const PerlinNoiseTable& table, __m128& outDx, __m128& outDy)
+{
+    __m128i hashes[4];
+    perlinHashesSSE2(x, y, table, hashes);
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 u = perlinFadeSSE2(x), v = perlinFadeSSE2(y);
+    __m128 x1 = _mm_sub_ps(x, one), y1 = _mm_sub_ps(y, one);
+    __m128 gAA = perlinGradientSSE2(hashes[0], x, y);
+    __m128 gBA = perlinGradientSSE2(hashes[1], x1, y);
+    __m128 gAB = perlinGradientSSE2(hashes[2], x, y1);
+    __m128 gBB = perlinGradientSSE2(hashes[3], x1, y1);
+    __m128 bottom = perlinLerpSSE2(u, gAA, gBA), top = perlinLerpSSE2(u, gAB, gBB);
+
+    __m128 xAA, yAA, xBA, yBA, xAB, yAB, xBB, yBB;
+    perlinGradientVectorSSE2(hashes[0], xAA, yAA);
+    perlinGradientVectorSSE2(hashes[1], xBA, yBA);
+    perlinGradientVectorSSE2(hashes[2], xAB, yAB);
+    perlinGradientVectorSSE2(hashes[3], xBB, yBB);
+    outDx = _mm_add_ps(perlinLerpSSE2(v, perlinLerpSSE2(u, xAA, xBA), perlinLerpSSE2(u, xAB, xBB)),
+        _mm_mul_ps(perlinFadeDerivativeSSE2(x), perlinLerpSSE2(v, _mm_sub_ps(gBA, gAA), _mm_sub_ps(gBB, gAB))));
+    outDy = _mm_add_ps(perlinLerpSSE2(v, perlinLerpSSE2(u, yAA, yBA), perlinLerpSSE2(u, yAB, yBB)),
+        _mm_mul_ps(perlinFadeDerivativeSSE2(y), _mm_sub_ps(top, bottom)));
+    return perlinLerpSSE2(v, bottom, top);
+}
+
+/*-----------AVX2----------*/
+/*32 byte lookups in the 256-byte permutation: row r answers the bytes whose high nibble is r*/
+SIMD_TARGET_AVX2 inline __m256i perlinPermuteAVX2(const __m256i* rows, __m256i index)
+{
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_and_si256(index, lowNibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(index, 4), lowNibble);
+    __m256i result = _mm256_setzero_si256();
+    for (int row = 0; row < 16; ++row) {
+        __m256i match = _mm256_cmpeq_epi8(high, _mm256_set1_epi8(char(row)));
+        result = _mm256_or_si256(result, _mm256_and_si256(match, _mm256_shuffle_epi8(rows[row], low)));
+    }
+    return result;
+}
+
+SIMD_TARGET_AVX2 inline __m256 perlinFadeAVX2(__m256 t)
+{
+    __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+SIMD_TARGET_AVX2 inline __m256 perlinGradientAVX2(__m256i hash, __m256 x, __m256 y)
+{
+    hash = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+    __m256 useX = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), hash));
+    __m256 u = _mm256_blendv_ps(y, x, useX);
+    __m256 v = _mm256_blendv_ps(x, y, useX);
+    __m256 signU = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(hash, _mm256_set1_epi32(1)), 31));
+    __m256 signV = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(hash, _mm256_set1_epi32(2)), 30));
+    return _mm256_add_ps(_mm256_xor_ps(u, signU), _mm256_xor_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), v), signV));
+}
+
+SIMD_TARGET_AVX2 inline __m256 perlinFadeDerivativeAVX2(__m256 t)
+{
+    __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(30.0f)), _mm256_set1_ps(60.0f))), _mm256_set1_ps(30.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(t, t), inner);
+}
+
+SIMD_TARGET_AVX2 inline void perlinGradientVectorAVX2(__m256i hash, __m256& gx, __m256& gy)
+{
+    hash = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+    __m256 useX = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), hash));
+    __m256 signU = _mm256_xor_ps(_mm256_set1_ps(1.0f), _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(hash, _mm256_set1_epi32(1)), 31)));
+    __m256 signV = _mm256_xor_ps(_mm256_set1_ps(2.0f), _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(hash, _mm256_set1_epi32(2)), 30)));
+    gx = _mm256_blendv_ps(signV, signU, useX);
+    gy = _mm256_blendv_ps(signU, signV, useX);
+}
+
+SIMD_TARGET_AVX2 inline __m256 perlinLerpAVX2(__m256 t, __m256 a, __m256 b)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+/*Corner bytes per lane, low to high: AA, AB, BA, BB. rows/rowsTwice are the 16-byte rows of the
+  two tables broadcast to both 128-bit halves. x and y become the fractions in the cell.*/
+SIMD_TARGET_AVX2 inline __m256i perlinHashesAVX2(__m256& x, __m256& y, const __m256i* rows, const __m256i* rowsTwice)
+{
+    __m256 floorX = _mm256_floor_ps(x), floorY = _mm256_floor_ps(y);
+    const __m256i byteMask = _mm256_set1_epi32(255);
+    __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(floorX), byteMask);
+    __m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(floorY), byteMask);
+    x = _mm256_sub_ps(x, floorX);
+    y = _mm256_sub_ps(y, floorY);
+
+    /*(X, X, X+1, X+1) -> (A, A, B, B); + (Y, Y+1, Y, Y+1) with byte wrap-around -> gradient hashes*/
+    __m256i X1 = _mm256_and_si256(_mm256_add_epi32(X, _mm256_set1_epi32(1)), byteMask);
+    __m256i xBytes = _mm256_or_si256(_mm256_or_si256(X, _mm256_slli_epi32(X, 8)), _mm256_or_si256(_mm256_slli_epi32(X1, 16), _mm256_slli_epi32(X1, 24)));
+    __m256i yBytes = _mm256_add_epi8(_mm256_mullo_epi32(Y, _mm256_set1_epi32(0x01010101)), _mm256_set1_epi32(0x01000100));
+    return perlinPermuteAVX2(rowsTwice, _mm256_add_epi8(perlinPermuteAVX2(rows, xBytes), yBytes));
+}
+
+SIMD_TARGET_AVX2 inline __m256 perlinNoise2DAVX2(__m256 x, __m256 y, const __m256i* rows, const __m256i* rowsTwice)
+{
+    __m256i hashes = perlinHashesAVX2(x, y, rows, rowsTwice);
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 u = perlinFadeAVX2(x), v = perlinFadeAVX2(y);
+    __m256 x1 = _mm256_sub_ps(x, one), y1 = _mm256_sub_ps(y, one);
+    __m256 gAA = perlinGradientAVX2(hashes, x, y);
+    __m256 gAB = perlinGradientAVX2(_mm256_srli_epi32(hashes, 8), x, y1);
+    __m256 gBA = perlinGradientAVX2(_mm256_srli_epi32(hashes, 16), x1, y);
+    __m256 gBB = perlinGradientAVX2(_mm256_srli_epi32(hashes, 24), x1, y1);
+    return perlinLerpAVX2(v, perlinLerpAVX2(u, gAA, gBA), perlinLerpAVX2(u, gAB, gBB));
+}
+
+SIMD_TARGET_AVX2 inline __m256 perlinNoise2DGradientAVX2(__m256 x, __m256 y, const __m256i* rows, const __m256i* rowsTwice, __m256& outDx, __m256& outDy)
+{
+    __m256i hashes = perlinHashesAVX2(x, y, rows, rowsTwice);
+    __m256i hashAB = _mm256_srli_epi32(hashes, 8), hashBA = _mm256_srli_epi32(hashes, 16), hashBB = _mm256_srli_epi32(hashes, 24);
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 u = perlinFadeAVX2(x), v = perlinFadeAVX2(y);
+    __m256 x1 = _mm256_sub_ps(x, one), y1 = _mm256_sub_ps(y, one);
+    __m256 gAA = perlinGradientAVX2(hashes, x, y);
+    __m256 gAB = perlinGradientAVX2(hashAB, x, y1);
+    __m256 gBA = perlinGradientAVX2(hashBA, x1, y);
+    __m256 gBB = perlinGradientAVX2(hashBB, x1, y1);
+    __m256 bottom = perlinLerpAVX2(u, gAA, gBA), top = perlinLerpAVX2(u, gAB, gBB);
+
+    __m256 xAA, yAA, xBA, yBA, xAB, yAB, xBB, yBB;
+    perlinGradientVectorAVX2(hashes, xAA, yAA);
+    perlinGradientVectorAVX2(hashBA, xBA, yBA);
+    perlinGradientVectorAVX2(hashAB, xAB, yAB);
+    perlinGradientVectorAVX2(hashBB, xBB, yBB);
+    outDx = _mm256_add_ps(perlinLerpAVX2(v, perlinLerpAVX2(u, xAA, xBA), perlinLerpAVX2(u, xAB, xBB)),
+        _mm256_mul_ps(perlinFadeDerivativeAVX2(x), perlinLerpAVX2(v, _mm256_sub_ps(gBA, gAA), _mm256_sub_ps(gBB, gAB))));
+    outDy = _mm256_add_ps(perlinLerpAVX2(v, perlinLerpAVX2(u, yAA, yBA), perlinLerpAVX2(u, yAB, yBB)),
+        _mm256_mul_ps(perlinFadeDerivativeAVX2(y), _mm256_sub_ps(top, bottom)));
+    return perlinLerpAVX2(v, bottom, top);
+}
+#endif
+
+/*-----------BATCH----------*/
+#if defined(SIMD_HAS_X86)
+SIMD_TARGET_AVX2 inline void fractalBrownianMotionAVX2(const float* x, const float* y, float* out, size_t count, int octaves, float persistence, const PerlinNoiseTable& table)
+{
+    __m256i rows[16], rowsTwice[16];
+    for (int row = 0; row < 16; ++row) {
+        rows[row] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)(table.permutation + row * 16)));
+        rowsTwice[row] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)(table.permutationTwice + row * 16)));
+    }
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 sampleX = _mm256_loadu_ps(x + i), sampleY = _mm256_loadu_ps(y + i);
+        __m256 total = _mm256_setzero_ps();
+        float frequency = 1.0f, amplitude = 1.0f, maxValue = 0.0f;
+        for (int octave = 0; octave < octaves; ++octave) {
+            __m256 f = _mm256_set1_ps(frequency);
+            __m256 noise = perlinNoise2DAVX2(_mm256_mul_ps(sampleX, f), _mm256_mul_ps(sampleY, f), rows, rowsTwice);
+            total = _mm256_add_ps(total, _mm256_mul_ps(noise, _mm256_set1_ps(amplitude)));
+            maxValue += amplitude;
+            amplitude *= persistence;
+            frequency *= 2.0f;
+        }
+        _mm256_storeu_ps(out + i, _mm256_div_ps(total, _mm256_set1_ps(maxValue)));
+    }
+    for (; i < count; ++i)
+        out[i] = fractalBrownianMotionFloat(x[i], y[i], octaves, persistence, table);
+}
+
+SIMD_TARGET_AVX2 inline void fractalBrownianMotionGradientAVX2(const float* x, const float* y, float* out, float* outDx, float* outDy, size_t count, int octaves,
+    float persistence, const PerlinNoiseTable& table)
+{
+    __m256i rows[16], rowsTwice[16];
+    for (int row = 0; row < 16; ++row) {
+        rows[row] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)(table.permutation + row * 16)));
+        rowsTwice[row] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)(table.permutationTwice + row * 16)));
+    }
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 sampleX = _mm256_loadu_ps(x + i), sampleY = _mm256_loadu_ps(y + i);
+        __m256 total = _mm256_setzero_ps(), totalDx = _mm256_setzero_ps(), totalDy = _mm256_setzero_ps();
+        float frequency = 1.0f, amplitude = 1.0f, maxValue = 0.0f;
+        for (int octave = 0; octave < octaves; ++octave) {
+            __m256 f = _mm256_set1_ps(frequency), slopeScale = _mm256_set1_ps(amplitude * frequency);
+            __m256 dx, dy;
+            __m256 noise = perlinNoise2DGradientAVX2(_mm256_mul_ps(sampleX, f), _mm256_mul_ps(sampleY, f), rows, rowsTwice, dx, dy);
+            total = _mm256_add_ps(total, _mm256_mul_ps(noise, _mm256_set1_ps(amplitude)));
+            totalDx = _mm256_add_ps(totalDx, _mm256_mul_ps(dx, slopeScale));
+            totalDy = _mm256_add_ps(totalDy, _mm256_mul_ps(dy, slopeScale));
+            maxValue += amplitude;
+            amplitude *= persistence;
+            frequency *= 2.0f;
+        }
+        __m256 m = _mm256_set1_ps(maxValue);
+        _mm256_storeu_ps(out + i, _mm256_div_ps(total, m));
+        _mm256_storeu_ps(outDx + i, _mm256_div_ps(totalDx, m));
+        _mm256_storeu_ps(outDy + i, _mm256_div_ps(totalDy, m));
+    }
+    for (; i < count; ++i)
+        out[i] = fractalBrownianMotionGradientFloat(x[i], y[i], octaves, persistence, table, outDx[i], outDy[i]);
+}
+
+inline void fractalBrownianMotionSSE2(const float* x, const float* y, float* out, size_t count, int octaves, float persistence, const PerlinNoiseTable& table)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sampleX = _mm_loadu_ps(x + i), sampleY = _mm_loadu_ps(y + i);
+        __m128 total = _mm_setzero_ps();
+        float frequency = 1.0f, amplitude = 1.0f, maxValue = 0.0f;
+        for (int octave = 0; octave < octaves; ++octave) {
+            __m128 f = _mm_set1_ps(frequency);
+            __m128 noise = perlinNoise2DSSE2(_mm_mul_ps(sampleX, f), _mm_mul_ps(sampleY, f), table);
+            total = _mm_add_ps(total, _mm_mul_ps(noise, _mm_set1_ps(amplitude)));
+            maxValue += amplitude;
+            amplitude *= persistence;
+            frequency *= 2.0f;
+        }
+        _mm_storeu_ps(out + i, _mm_div_ps(total, _mm_set1_ps(maxValue)));
+    }
+    for (; i < count; ++i)
+        out[i] = fractalBrownianMotionFloat(x[i], y[i], octaves, persistence, table);
+}
+
+inline void fractalBrownianMotionGradientSSE2(const float* x, const float* y, float* out, float* outDx, float* outDy, size_t count, int octaves, float persistence,
+    const PerlinNoiseTable& table)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sampleX = _mm_loadu_ps(x + i), sampleY = _mm_loadu_ps(y + i);
+        __m128 total = _mm_setzero_ps(), totalDx = _mm_setzero_ps(), totalDy = _mm_setzero_ps();
+        float frequency = 1.0f, amplitude = 1.0f, maxValue = 0.0f;
+        for (int octave = 0; octave < octaves; ++octave) {
+            __m128 f = _mm_set1_ps(frequency), slopeScale = _mm_set1_ps(amplitude * frequency);
+            __m128 dx, dy;
+            __m128 noise = perlinNoise2DGradientSSE2(_mm_mul_ps(sampleX, f), _mm_mul_ps(sampleY, f), table, dx, dy);
+            total = _mm_add_ps(total, _mm_mul_ps(noise, _mm_set1_ps(amplitude)));
+            totalDx = _mm_add_ps(totalDx, _mm_mul_ps(dx, slopeScale));
+            totalDy = _mm_add_ps(totalDy, _mm_mul_ps(dy, slopeScale));
+            maxValue += amplitude;
+            amplitude *= persistence;
+            frequency *= 2.0f;
+        }
+        __m128 m = _mm_set1_ps(maxValue);
+        _mm_storeu_ps(out + i, _mm_div_ps(total, m));
+        _mm_storeu_ps(outDx + i, _mm_div_ps(totalDx, m));
+        _mm_storeu_ps(outDy + i, _mm_div_ps(totalDy, m));
+    }
+    for (; i < count; ++i)
+        out[i] = fractalBrownianMotionGradientFloat(x[i], y[i], octaves, persistence, table, outDx[i], outDy[i]);
+}
+#endif
+
+/*out[i] = fBm(x[i], y[i]) for count samples; octaves 1 with any persistence is plain noise.
+  level is clamped to what the CPU supports.*/
+inline void fractalBrownianMotionBatch(const float* x, const float* y, float* out, size_t count, int octaves, float persistence, const PerlinNoiseTable& table,
+    SIMDLevel level = activeSIMDLevel())
+{
+    level = std::min(level, activeSIMDLevel());
+#if defined(SIMD_HAS_X86)
+    if (level == SIMD_AVX2) {
+        fractalBrownianMotionAVX2(x, y, out, count, octaves, persistence, table);
+        return;
+    }
+    if (level == SIMD_SSE2) {
+        fractalBrownianMotionSSE2(x, y, out, count, octaves, persistence, table);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i)
+        out[i] = fractalBrownianMotionFloat(x[i], y[i], octaves, persistence, table);
+}
+
+/*fractalBrownianMotionBatch that also writes d/dx and d/dy of every sample; out matches it bit for bit*/
+inline void fractalBrownianMotionGradientBatch(const float* x, const float* y, float* out, float* outDx, float* outDy, size_t count, int octaves, float persistence,
+    const PerlinNoiseTable& table, SIMDLevel level = activeSIMDLevel())
+{
+    level = std::min(level, activeSIMDLevel());
+#if defined(SIMD_HAS_X86)
+    if (level == SIMD_AVX2) {
+        fractalBrownianMotionGradientAVX2(x, y, out, outDx, outDy, count, octaves, persistence, table);
+        return;
+    }
+    if (level == SIMD_SSE2) {
+        fractalBrownianMotionGradientSSE2(x, y, out, outDx, outDy, count, octaves, persistence, table);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i)
+        out[i] = fractalBrownianMotionGradientFloat(x[i], y[i], octaves, persistence, table, outDx[i], outDy[i]);
+}
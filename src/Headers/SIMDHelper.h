@@ -0,0 +1,65 @@
+#pragma once
+
+/*x86 SIMD support: SSE2 is assumed wherever the compiler targets it (every x64 build), AVX2 is
+  detected at runtime so one binary runs everywhere. Other targets use the scalar paths.*/
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_HAS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/*MSVC accepts AVX2 intrinsics in any function; GCC/Clang need the target per function*/
+#if defined(SIMD_HAS_X86) && !defined(_MSC_VER)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+enum SIMDLevel : int
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE2 = 1,
+    SIMD_AVX2 = 2
+};
+
+inline const char* simdLevelName(SIMDLevel level)
+{
+    switch (level) {
+    case SIMD_AVX2: return "AVX2";
+    case SIMD_SSE2: return "SSE2";
+    default: return "scalar";
+    }
+}
+
+/*Best level this CPU and OS support*/
+inline SIMDLevel detectSIMDLevel()
+{
+#if defined(SIMD_HAS_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        if (osSavesYmm && (info[1] & (1 << 5)))
+            return SIMD_AVX2;
+    }
+#else
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+#endif
+    return SIMD_SSE2;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+/*Detected once; kernels take a level parameter defaulting to this so benchmarks can force one*/
+inline SIMDLevel activeSIMDLevel()
+{
+    static const SIMDLevel level = detectSIMDLevel();
+    return level;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include "FixedPoint.h"
+
+/*Simplex noise in 2D and 3D over the same perlinG permutation as perlinNoise2D, templated on the
+  scalar like it (float, double or Fixed16). A simplex has 3 corners in 2D and 4 in 3D against the
+  lattice square's 4 and cube's 8, and each corner adds a radial falloff instead of a fade-weighted
+  blend, so a sample costs fewer hashes and no lerps; 3D gives animated fields with time as z.
+  Results land in about [-1, 1].*/
+
+extern const unsigned int PERLIN_SIZE;
+
+/*Diagonal directions for hashes 0-3, axes for 4-7; selects rather than branches, since the hash is
+  random*/
+template <typename Real>
+inline Real simplexNoiseGradient2D(int hash, Real x, Real y)
+{
+    hash &= 7;
+    Real u = hash < 6 ? x : y;
+    Real v = hash < 4 ? y : Real(0);
+    return ((hash & 1) ? -u : u) + ((hash & 2) ? -v : v);
+}
+
+/*The 12 cube edge directions, 4 of them twice, as in improved Perlin noise*/
+template <typename Real>
+inline Real simplexNoiseGradient3D(int hash, Real x, Real y, Real z)
+{
+    hash &= 15;
+    Real u = hash < 8 ? x : y;
+    Real v = hash < 4 ? y : (hash == 12 || hash == 14 ? x : z);
+    return ((hash & 1) ? -u : u) + ((hash & 2) ? -v : v);
+}
+
+/*Corner at (x, y) from it: (r^2 - |d|^2)^4 times its gradient's dot product, nothing past r*/
+template <typename Real>
+inline Real simplexNoiseCorner2D(int hash, Real x, Real y)
+{
+    Real falloff = Real(0.5) - x * x - y * y;
+    /*Clamped rather than branched on: whether a corner reaches the sample is a coin flip*/
+    falloff = falloff > Real(0) ? falloff : Real(0);
+    falloff *= falloff;
+    return falloff * falloff * simplexNoiseGradient2D(hash, x, y);
+}
+
+template <typename Real>
+inline Real simplexNoiseCorner3D(int hash, Real x, Real y, Real z)
+{
+    Real falloff = Real(0.6) - x * x - y * y - z * z;
+    /*Clamped rather than branched on: whether a corner reaches the sample is a coin flip*/
+    falloff = falloff > Real(0) ? falloff : Real(0);
+    falloff *= falloff;
+    return falloff * falloff * simplexNoiseGradient3D(hash, x, y, z);
+}
+
+template <typename Real>
+inline Real simplexNoise2D(Real x, Real y, const std::vector<int>& perlinG)
+{
+    /*(sqrt(3) - 1) / 2 skews the plane onto the square lattice, (3 - sqrt(3)) / 6 back*/
+    const Real skew(0.36602540378443865), unskew(0.21132486540518713);
+    Real offset = (x + y) * skew;
+    Real cellX = noiseFloor(x + offset), cellY = noiseFloor(y + offset);
+    Real origin = (cellX + cellY) * unskew;
+    Real x0 = x - (cellX - origin), y0 = y - (cellY - origin);
+
+    /*Lower or upper triangle of the skewed cell*/
+    int stepX = x0 > y0 ? 1 : 0, stepY = 1 - stepX;
+    Real x1 = x0 - Real(stepX) + unskew, y1 = y0 - Real(stepY) + unskew;
+    Real x2 = x0 - Real(1) + Real(2) * unskew, y2 = y0 - Real(1) + Real(2) * unskew;
+
+    int X = noiseFloorToInt(cellX) & (PERLIN_SIZE - 1);
+    int Y = noiseFloorToInt(cellY) & (PERLIN_SIZE - 1);
+    Real total = simplexNoiseCorner2D(perlinG[(size_t)X + perlinG[Y]], x0, y0);
+    total += simplexNoiseCorner2D(perlinG[(size_t)X + stepX + perlinG[(size_t)Y + stepY]], x1, y1);
+    total += simplexNoiseCorner2D(perlinG[(size_t)X + 1 + perlinG[(size_t)Y + 1]], x2, y2);
+    return Real(70) * total;
+}
+
+template <typename Real>
+inline Real simplexNoise3D(Real x, Real y, Real z, const std::vector<int>& perlinG)
+{
+    const Real skew(1.0 / 3.0), unskew(1.0 / 6.0);
+    Real offset = (x + y + z) * skew;
+    Real cellX = noiseFloor(x + offset), cellY = noiseFloor(y + offset), cellZ = noiseFloor(z + offset);
+    Real origin = (cellX + cellY + cellZ) * unskew;
+    Real x0 = x - (cellX - origin), y0 = y - (cellY - origin), z0 = z - (cellZ - origin);
+
+    /*The tetrahedron of the skewed cube is set by the order of the offsets: the second corner
+      steps along the largest axis, the third along the two largest. Ranked with comparisons
+      instead of the usual branch tree, whose branches are unpredictable; ties go x, then y, then z.*/
+    bool xOverY = x0 >= y0, xOverZ = x0 >= z0, yOverZ = y0 >= z0;
+    int i1 = xOverY && xOverZ, j1 = !xOverY && yOverZ, k1 = !xOverZ && !yOverZ;
+    int i2 = xOverY || xOverZ, j2 = !xOverY || yOverZ, k2 = !xOverZ || !yOverZ;
+    Real x1 = x0 - Real(i1) + unskew, y1 = y0 - Real(j1) + unskew, z1 = z0 - Real(k1) + unskew;
+    Real x2 = x0 - Real(i2) + Real(2) * unskew, y2 = y0 - Real(j2) + Real(2) * unskew, z2 = z0 - Real(k2) + Real(2) * unskew;
+    Real x3 = x0 - Real(1) + Real(3) * unskew, y3 = y0 - Real(1) + Real(3) * unskew, z3 = z0 - Real(1) + Real(3) * unskew;
+
+    size_t X = noiseFloorToInt(cellX) & (PERLIN_SIZE - 1);
+    size_t Y = noiseFloorToInt(cellY) & (PERLIN_SIZE - 1);
+    size_t Z = noiseFloorToInt(cellZ) & (PERLIN_SIZE - 1);
+    Real total = simplexNoiseCorner3D(perlinG[X + perlinG[Y + perlinG[Z]]], x0, y0, z0);
+    total += simplexNoiseCorner3D(perlinG[X + i1 + perlinG[Y + j1 + perlinG[Z + k1]]], x1, y1, z1);
+    total += simplexNoiseCorner3D(perlinG[X + i2 + perlinG[Y + j2 + perlinG[Z + k2]]], x2, y2, z2);
+    total += simplexNoiseCorner3D(perlinG[X + 1 + perlinG[Y + 1 + perlinG[Z + 1]]], x3, y3, z3);
+    return Real(32) * total;
+}
+
+/*fBm like fractalBrownianMotion, in Real, normalized by the summed amplitudes*/
+template <typename Real = double>
+inline float simplexFractalBrownianMotion(double x, double y, int octaves, float persistence, const std::vector<int>& perlinG)
+{
+    Real total(0), frequency(1), amplitude(1), maxValue(0);
+    for (int i = 0; i < octaves; i++) {
+        total += simplexNoise2D(Real(x) * frequency, Real(y) * frequency, perlinG) * amplitude;
+        maxValue += amplitude;
+        amplitude *= Real(persistence);
+        frequency *= Real(2);
+    }
+    return noiseToFloat(total / maxValue);
+}
+
+template <typename Real = double>
+inline float simplexFractalBrownianMotion3D(double x, double y, double z, int octaves, float persistence, const std::vector<int>& perlinG)
+{
+    Real total(0), frequency(1), amplitude(1), maxValue(0);
+    for (int i = 0; i < octaves; i++) {
+        total += simplexNoise3D(Real(x) * frequency, Real(y) * frequency, Real(z) * frequency, perlinG) * amplitude;
+        maxValue += amplitude;
+        amplitude *= Real(persistence);
+        frequency *= Real(2);
+    }
+    return noiseToFloat(total / maxValue);
+}
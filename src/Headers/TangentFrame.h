@@ -0,0 +1,684 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "Vertex.h"
+#include "SIMDHelper.h"
+#include "ThreadPool.h"
+
+/*What computeTangentFrames does with normals*/
+enum TangentFrameFlags : unsigned int
+{
+    TANGENT_FRAME_DEFAULT = 0,            /*normals are inputs (OBJ files)*/
+    TANGENT_FRAME_ACCUMULATE_NORMALS = 1, /*area-weighted face normals are accumulated and normalized*/
+    TANGENT_FRAME_FLIP_NORMALS = 2        /*accumulated normals are negated (clockwise winding)*/
+};
+
+/*Structure-of-arrays view of a mesh for the tangent-frame kernel.
+  px..v are read; nx..nz are read, or written with TANGENT_FRAME_ACCUMULATE_NORMALS.
+  tx..bz receive the orthonormalized tangent and B = cross(N, T).
+  tangentSums/normalSums are the scatter targets, 4 floats per vertex so one triangle corner is a
+  single vector add; split x/y/z sums would cost three cache misses per corner.*/
+struct TangentFrameStreams
+{
+    std::vector<float> px, py, pz;
+    std::vector<float> u, v;
+    std::vector<float> nx, ny, nz;
+    std::vector<float> tx, ty, tz;
+    std::vector<float> bx, by, bz;
+    std::vector<float> tangentSums, normalSums;
+
+    size_t size() const
+    {
+        return px.size();
+    }
+
+    void resize(size_t vertexCount)
+    {
+        for (std::vector<float>* stream : { &px, &py, &pz, &u, &v, &nx, &ny, &nz, &tx, &ty, &tz, &bx, &by, &bz })
+            stream->resize(vertexCount);
+    }
+};
+
+/*Inputs only: the AoS path of computeTangentFrames writes results straight back into the vertices*/
+inline void loadTangentFrameStreams(const std::vector<Vertex>& vertices, TangentFrameStreams& streams, bool withNormals)
+{
+    size_t vertexCount = vertices.size();
+    for (std::vector<float>* stream : { &streams.px, &streams.py, &streams.pz, &streams.u, &streams.v })
+        stream->resize(vertexCount);
+    if (withNormals) {
+        streams.nx.resize(vertexCount);
+        streams.ny.resize(vertexCount);
+        streams.nz.resize(vertexCount);
+    }
+
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const Vertex& vertex = vertices[i];
+        streams.px[i] = vertex.vPos.x;
+        streams.py[i] = vertex.vPos.y;
+        streams.pz[i] = vertex.vPos.z;
+        streams.u[i] = vertex.vTexCoords.x;
+        streams.v[i] = vertex.vTexCoords.y;
+        if (withNormals) {
+            streams.nx[i] = vertex.vNormals.x;
+            streams.ny[i] = vertex.vNormals.y;
+            streams.nz[i] = vertex.vNormals.z;
+        }
+    }
+}
+
+/*-----------SCALAR----------*/
+/*Every path evaluates the same expressions in the same order and adds triangles to a vertex in
+  index order, so scalar, SSE2, AVX2 and threaded results are bit-identical.
+  The accumulate functions scatter triangle t into tangentSums/normalSums, or with triangleTangents
+  set store its (x, y, z, 0) terms at triangleTangents/triangleNormals + t * 4 for the binned pass.*/
+inline void accumulateTriangleFrameScalar(TangentFrameStreams& s, const unsigned int* indices, size_t t, bool accumulateNormals, float* triangleTangents, float* triangleNormals)
+{
+    const unsigned int* tri = indices + t * 3;
+    unsigned int a = tri[0], b = tri[1], c = tri[2];
+    float e1x = s.px[b] - s.px[a], e1y = s.py[b] - s.py[a], e1z = s.pz[b] - s.pz[a];
+    float e2x = s.px[c] - s.px[a], e2y = s.py[c] - s.py[a], e2z = s.pz[c] - s.pz[a];
+    float du1 = s.u[b] - s.u[a], dv1 = s.v[b] - s.v[a];
+    float du2 = s.u[c] - s.u[a], dv2 = s.v[c] - s.v[a];
+
+    /*Triangles without a UV parametrization add nothing instead of infinities*/
+    float det = du1 * dv2 - du2 * dv1;
+    float f = det != 0.0f ? 1.0f / det : 0.0f;
+
+    float tx = f * (dv2 * e1x - dv1 * e2x);
+    float ty = f * (dv2 * e1y - dv1 * e2y);
+    float tz = f * (dv2 * e1z - dv1 * e2z);
+    float nx = e1y * e2z - e1z * e2y;
+    float ny = e1z * e2x - e1x * e2z;
+    float nz = e1x * e2y - e1y * e2x;
+
+    if (triangleTangents) {
+        float* tangent = triangleTangents + t * 4;
+        tangent[0] = tx;
+        tangent[1] = ty;
+        tangent[2] = tz;
+        tangent[3] = 0.0f;
+        if (accumulateNormals) {
+            float* normal = triangleNormals + t * 4;
+            normal[0] = nx;
+            normal[1] = ny;
+            normal[2] = nz;
+            normal[3] = 0.0f;
+        }
+        return;
+    }
+
+    for (int k = 0; k < 3; ++k) {
+        float* sum = &s.tangentSums[size_t(tri[k]) * 4];
+        sum[0] += tx;
+        sum[1] += ty;
+        sum[2] += tz;
+    }
+    if (accumulateNormals) {
+        for (int k = 0; k < 3; ++k) {
+            float* sum = &s.normalSums[size_t(tri[k]) * 4];
+            sum[0] += nx;
+            sum[1] += ny;
+            sum[2] += nz;
+        }
+    }
+}
+
+/*Finished frame of vertex i, written to the SoA outputs or, with out, to out[i]*/
+inline void finalizeVertexFrameScalar(TangentFrameStreams& s, size_t i, unsigned int flags, Vertex* out)
+{
+    float nx, ny, nz;
+    if (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) {
+        const float* sum = &s.normalSums[i * 4];
+        nx = sum[0];
+        ny = sum[1];
+        nz = sum[2];
+        if (flags & TANGENT_FRAME_FLIP_NORMALS) {
+            nx = -nx;
+            ny = -ny;
+            nz = -nz;
+        }
+        float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+        if (length > 0.0f) {
+            nx = nx / length;
+            ny = ny / length;
+            nz = nz / length;
+        }
+    }
+    else {
+        nx = s.nx[i];
+        ny = s.ny[i];
+        nz = s.nz[i];
+    }
+
+    /*Gram-Schmidt against the normal; degenerate tangents become zero*/
+    const float* sum = &s.tangentSums[i * 4];
+    float d = nx * sum[0] + ny * sum[1] + nz * sum[2];
+    float tx = sum[0] - nx * d, ty = sum[1] - ny * d, tz = sum[2] - nz * d;
+    float length = std::sqrt(tx * tx + ty * ty + tz * tz);
+    if (length > 0.0f) {
+        tx = tx / length;
+        ty = ty / length;
+        tz = tz / length;
+    }
+    else {
+        tx = ty = tz = 0.0f;
+    }
+    float bx = ny * tz - nz * ty;
+    float by = nz * tx - nx * tz;
+    float bz = nx * ty - ny * tx;
+
+    if (out) {
+        if (flags & TANGENT_FRAME_ACCUMULATE_NORMALS)
+            out[i].vNormals = glm::vec3(nx, ny, nz);
+        out[i].vTangent = glm::vec3(tx, ty, tz);
+        out[i].vBiTangent = glm::vec3(bx, by, bz);
+        return;
+    }
+    if (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) {
+        s.nx[i] = nx;
+        s.ny[i] = ny;
+        s.nz[i] = nz;
+    }
+    s.tx[i] = tx;
+    s.ty[i] = ty;
+    s.tz[i] = tz;
+    s.bx[i] = bx;
+    s.by[i] = by;
+    s.bz[i] = bz;
+}
+
+/*Write a block of finished lanes (rows nx ny nz tx ty tz bx by bz) to the SoA outputs or to out*/
+inline void storeVertexFrameLanes(TangentFrameStreams& s, size_t first, int laneCount, const float (*lanes)[8], unsigned int flags, Vertex* out)
+{
+    bool withNormals = (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) != 0;
+    if (out) {
+        for (int lane = 0; lane < laneCount; ++lane) {
+            Vertex& vertex = out[first + lane];
+            if (withNormals)
+                vertex.vNormals = glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+            vertex.vTangent = glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+            vertex.vBiTangent = glm::vec3(lanes[6][lane], lanes[7][lane], lanes[8][lane]);
+        }
+        return;
+    }
+    std::vector<float>* streams[9] = { &s.nx, &s.ny, &s.nz, &s.tx, &s.ty, &s.tz, &s.bx, &s.by, &s.bz };
+    for (int row = withNormals ? 0 : 3; row < 9; ++row)
+        std::copy(lanes[row], lanes[row] + laneCount, streams[row]->begin() + first);
+}
+
+#if defined(SIMD_HAS_X86)
+/*-----------SSE2----------*/
+inline void accumulateTriangleFramesSSE2(TangentFrameStreams& s, const unsigned int* indices, size_t firstTriangle, size_t lastTriangle, bool accumulateNormals,
+    float* triangleTangents, float* triangleNormals)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    float* tangentSums = s.tangentSums.data();
+    float* normalSums = s.normalSums.data();
+
+    size_t t = firstTriangle;
+    for (; t + 4 <= lastTriangle; t += 4) {
+        const unsigned int* tri = indices + t * 3;
+        auto gather = [tri](const std::vector<float>& stream, int corner) {
+            return _mm_setr_ps(stream[tri[corner]], stream[tri[3 + corner]], stream[tri[6 + corner]], stream[tri[9 + corner]]);
+        };
+
+        __m128 ax = gather(s.px, 0), ay = gather(s.py, 0), az = gather(s.pz, 0);
+        __m128 e1x = _mm_sub_ps(gather(s.px, 1), ax), e1y = _mm_sub_ps(gather(s.py, 1), ay), e1z = _mm_sub_ps(gather(s.pz, 1), az);
+        __m128 e2x = _mm_sub_ps(gather(s.px, 2), ax), e2y = _mm_sub_ps(gather(s.py, 2), ay), e2z = _mm_sub_ps(gather(s.pz, 2), az);
+        __m128 au = gather(s.u, 0), av = gather(s.v, 0);
+        __m128 du1 = _mm_sub_ps(gather(s.u, 1), au), dv1 = _mm_sub_ps(gather(s.v, 1), av);
+        __m128 du2 = _mm_sub_ps(gather(s.u, 2), au), dv2 = _mm_sub_ps(gather(s.v, 2), av);
+
+        __m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+        __m128 f = _mm_and_ps(_mm_div_ps(one, det), _mm_cmpneq_ps(det, zero));
+
+        /*Transpose to one (x, y, z, 0) vector per triangle for the scatter*/
+        __m128 tangent[4] = {
+            _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1x), _mm_mul_ps(dv1, e2x))),
+            _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1y), _mm_mul_ps(dv1, e2y))),
+            _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1z), _mm_mul_ps(dv1, e2z))),
+            zero
+        };
+        _MM_TRANSPOSE4_PS(tangent[0], tangent[1], tangent[2], tangent[3]);
+
+        __m128 normal[4];
+        if (accumulateNormals) {
+            normal[0] = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+            normal[1] = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+            normal[2] = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+            normal[3] = zero;
+            _MM_TRANSPOSE4_PS(normal[0], normal[1], normal[2], normal[3]);
+        }
+
+        if (triangleTangents) {
+            for (int lane = 0; lane < 4; ++lane) {
+                _mm_storeu_ps(triangleTangents + (t + lane) * 4, tangent[lane]);
+                if (accumulateNormals)
+                    _mm_storeu_ps(triangleNormals + (t + lane) * 4, normal[lane]);
+            }
+            continue;
+        }
+
+        /*Scatter stays serial: neighbouring triangles share vertices*/
+        for (int lane = 0; lane < 4; ++lane) {
+            for (int k = 0; k < 3; ++k) {
+                float* sum = tangentSums + size_t(tri[lane * 3 + k]) * 4;
+                _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), tangent[lane]));
+            }
+            if (accumulateNormals) {
+                for (int k = 0; k < 3; ++k) {
+                    float* sum = normalSums + size_t(tri[lane * 3 + k]) * 4;
+                    _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), normal[lane]));
+                }
+            }
+        }
+    }
+    for (; t < lastTriangle; ++t)
+        accumulateTriangleFrameScalar(s, indices, t, accumulateNormals, triangleTangents, triangleNormals);
+}
+
+inline void finalizeVertexFramesSSE2(TangentFrameStreams& s, size_t firstVertex, size_t lastVertex, unsigned int flags, Vertex* out)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const float* tangentSums = s.tangentSums.data();
+    const float* normalSums = s.normalSums.data();
+    alignas(16) float lanes[9][8];
+
+    size_t i = firstVertex;
+    for (; i + 4 <= lastVertex; i += 4) {
+        __m128 nx, ny, nz;
+        if (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) {
+            __m128 nw;
+            nx = _mm_loadu_ps(normalSums + i * 4);
+            ny = _mm_loadu_ps(normalSums + i * 4 + 4);
+            nz = _mm_loadu_ps(normalSums + i * 4 + 8);
+            nw = _mm_loadu_ps(normalSums + i * 4 + 12);
+            _MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+            if (flags & TANGENT_FRAME_FLIP_NORMALS) {
+                nx = _mm_xor_ps(nx, signBit);
+                ny = _mm_xor_ps(ny, signBit);
+                nz = _mm_xor_ps(nz, signBit);
+            }
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+            __m128 valid = _mm_cmpgt_ps(length, zero);
+            nx = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(nx, length)), _mm_andnot_ps(valid, nx));
+            ny = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(ny, length)), _mm_andnot_ps(valid, ny));
+            nz = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(nz, length)), _mm_andnot_ps(valid, nz));
+        }
+        else {
+            nx = _mm_loadu_ps(&s.nx[i]);
+            ny = _mm_loadu_ps(&s.ny[i]);
+            nz = _mm_loadu_ps(&s.nz[i]);
+        }
+
+        __m128 tx = _mm_loadu_ps(tangentSums + i * 4);
+        __m128 ty = _mm_loadu_ps(tangentSums + i * 4 + 4);
+        __m128 tz = _mm_loadu_ps(tangentSums + i * 4 + 8);
+        __m128 tw = _mm_loadu_ps(tangentSums + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+        tx = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+        ty = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+        tz = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz)));
+        __m128 valid = _mm_cmpgt_ps(length, zero);
+        tx = _mm_and_ps(valid, _mm_div_ps(tx, length));
+        ty = _mm_and_ps(valid, _mm_div_ps(ty, length));
+        tz = _mm_and_ps(valid, _mm_div_ps(tz, length));
+
+        _mm_store_ps(lanes[0], nx);
+        _mm_store_ps(lanes[1], ny);
+        _mm_store_ps(lanes[2], nz);
+        _mm_store_ps(lanes[3], tx);
+        _mm_store_ps(lanes[4], ty);
+        _mm_store_ps(lanes[5], tz);
+        _mm_store_ps(lanes[6], _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty)));
+        _mm_store_ps(lanes[7], _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz)));
+        _mm_store_ps(lanes[8], _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx)));
+        storeVertexFrameLanes(s, i, 4, lanes, flags, out);
+    }
+    for (; i < lastVertex; ++i)
+        finalizeVertexFrameScalar(s, i, flags, out);
+}
+
+/*-----------AVX2----------*/
+/*No lambdas in here: they would not inherit the AVX2 target on GCC/Clang*/
+SIMD_TARGET_AVX2 inline void accumulateTriangleFramesAVX2(TangentFrameStreams& s, const unsigned int* indices, size_t firstTriangle, size_t lastTriangle, bool accumulateNormals,
+    float* triangleTangents, float* triangleNormals)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const float* px = s.px.data();
+    const float* py = s.py.data();
+    const float* pz = s.pz.data();
+    const float* pu = s.u.data();
+    const float* pv = s.v.data();
+    float* tangentSums = s.tangentSums.data();
+    float* normalSums = s.normalSums.data();
+
+    size_t t = firstTriangle;
+    for (; t + 8 <= lastTriangle; t += 8) {
+        const unsigned int* tri = indices + t * 3;
+        __m256i ia = _mm256_setr_epi32(int(tri[0]), int(tri[3]), int(tri[6]), int(tri[9]), int(tri[12]), int(tri[15]), int(tri[18]), int(tri[21]));
+        __m256i ib = _mm256_setr_epi32(int(tri[1]), int(tri[4]), int(tri[7]), int(tri[10]), int(tri[13]), int(tri[16]), int(tri[19]), int(tri[22]));
+        __m256i ic = _mm256_setr_epi32(int(tri[2]), int(tri[5]), int(tri[8]), int(tri[11]), int(tri[14]), int(tri[17]), int(tri[20]), int(tri[23]));
+
+        __m256 ax = _mm256_i32gather_ps(px, ia, 4), ay = _mm256_i32gather_ps(py, ia, 4), az = _mm256_i32gather_ps(pz, ia, 4);
+        __m256 e1x = _mm256_sub_ps(_mm256_i32gather_ps(px, ib, 4), ax);
+        __m256 e1y = _mm256_sub_ps(_mm256_i32gather_ps(py, ib, 4), ay);
+        __m256 e1z = _mm256_sub_ps(_mm256_i32gather_ps(pz, ib, 4), az);
+        __m256 e2x = _mm256_sub_ps(_mm256_i32gather_ps(px, ic, 4), ax);
+        __m256 e2y = _mm256_sub_ps(_mm256_i32gather_ps(py, ic, 4), ay);
+        __m256 e2z = _mm256_sub_ps(_mm256_i32gather_ps(pz, ic, 4), az);
+        __m256 au = _mm256_i32gather_ps(pu, ia, 4), av = _mm256_i32gather_ps(pv, ia, 4);
+        __m256 du1 = _mm256_sub_ps(_mm256_i32gather_ps(pu, ib, 4), au), dv1 = _mm256_sub_ps(_mm256_i32gather_ps(pv, ib, 4), av);
+        __m256 du2 = _mm256_sub_ps(_mm256_i32gather_ps(pu, ic, 4), au), dv2 = _mm256_sub_ps(_mm256_i32gather_ps(pv, ic, 4), av);
+
+        __m256 det = _mm256_sub_ps(_mm256_mul_ps(du1, dv2), _mm256_mul_ps(du2, dv1));
+        __m256 f = _mm256_and_ps(_mm256_div_ps(one, det), _mm256_cmp_ps(det, zero, _CMP_NEQ_UQ));
+        __m256 tx = _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(dv2, e1x), _mm256_mul_ps(dv1, e2x)));
+        __m256 ty = _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(dv2, e1y), _mm256_mul_ps(dv1, e2y)));
+        __m256 tz = _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(dv2, e1z), _mm256_mul_ps(dv1, e2z)));
+
+        /*Two 4x4 transposes give one (x, y, z, 0) vector per triangle*/
+        __m128 tangent[8];
+        for (int half = 0; half < 2; ++half) {
+            __m128 x = half ? _mm256_extractf128_ps(tx, 1) : _mm256_castps256_ps128(tx);
+            __m128 y = half ? _mm256_extractf128_ps(ty, 1) : _mm256_castps256_ps128(ty);
+            __m128 z = half ? _mm256_extractf128_ps(tz, 1) : _mm256_castps256_ps128(tz);
+            __m128 w = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            tangent[half * 4] = x;
+            tangent[half * 4 + 1] = y;
+            tangent[half * 4 + 2] = z;
+            tangent[half * 4 + 3] = w;
+        }
+
+        __m128 normal[8];
+        if (accumulateNormals) {
+            __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e1z, e2y));
+            __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e1x, e2z));
+            __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e1y, e2x));
+            for (int half = 0; half < 2; ++half) {
+                __m128 x = half ? _mm256_extractf128_ps(nx, 1) : _mm256_castps256_ps128(nx);
+                __m128 y = half ? _mm256_extractf128_ps(ny, 1) : _mm256_castps256_ps128(ny);
+                __m128 z = half ? _mm256_extractf128_ps(nz, 1) : _mm256_castps256_ps128(nz);
+                __m128 w = _mm_setzero_ps();
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+                normal[half * 4] = x;
+                normal[half * 4 + 1] = y;
+                normal[half * 4 + 2] = z;
+                normal[half * 4 + 3] = w;
+            }
+        }
+
+        if (triangleTangents) {
+            for (int lane = 0; lane < 8; ++lane) {
+                _mm_storeu_ps(triangleTangents + (t + lane) * 4, tangent[lane]);
+                if (accumulateNormals)
+                    _mm_storeu_ps(triangleNormals + (t + lane) * 4, normal[lane]);
+            }
+            continue;
+        }
+
+        for (int lane = 0; lane < 8; ++lane) {
+            for (int k = 0; k < 3; ++k) {
+                float* sum = tangentSums + size_t(tri[lane * 3 + k]) * 4;
+                _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), tangent[lane]));
+            }
+            if (accumulateNormals) {
+                for (int k = 0; k < 3; ++k) {
+                    float* sum = normalSums + size_t(tri[lane * 3 + k]) * 4;
+                    _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), normal[lane]));
+                }
+            }
+        }
+    }
+    for (; t < lastTriangle; ++t)
+        accumulateTriangleFrameScalar(s, indices, t, accumulateNormals, triangleTangents, triangleNormals);
+}
+
+/*8 interleaved (x, y, z, w) sums -> x, y, z rows*/
+SIMD_TARGET_AVX2 inline void transposeFrameSumsAVX2(const float* sums, __m256& x, __m256& y, __m256& z)
+{
+    __m128 lx = _mm_loadu_ps(sums), ly = _mm_loadu_ps(sums + 4), lz = _mm_loadu_ps(sums + 8), lw = _mm_loadu_ps(sums + 12);
+    __m128 hx = _mm_loadu_ps(sums + 16), hy = _mm_loadu_ps(sums + 20), hz = _mm_loadu_ps(sums + 24), hw = _mm_loadu_ps(sums + 28);
+    _MM_TRANSPOSE4_PS(lx, ly, lz, lw);
+    _MM_TRANSPOSE4_PS(hx, hy, hz, hw);
+    x = _mm256_insertf128_ps(_mm256_castps128_ps256(lx), hx, 1);
+    y = _mm256_insertf128_ps(_mm256_castps128_ps256(ly), hy, 1);
+    z = _mm256_insertf128_ps(_mm256_castps128_ps256(lz), hz, 1);
+}
+
+SIMD_TARGET_AVX2 inline void finalizeVertexFramesAVX2(TangentFrameStreams& s, size_t firstVertex, size_t lastVertex, unsigned int flags, Vertex* out)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    alignas(32) float lanes[9][8];
+
+    size_t i = firstVertex;
+    for (; i + 8 <= lastVertex; i += 8) {
+        __m256 nx, ny, nz;
+        if (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) {
+            transposeFrameSumsAVX2(s.normalSums.data() + i * 4, nx, ny, nz);
+            if (flags & TANGENT_FRAME_FLIP_NORMALS) {
+                nx = _mm256_xor_ps(nx, signBit);
+                ny = _mm256_xor_ps(ny, signBit);
+                nz = _mm256_xor_ps(nz, signBit);
+            }
+            __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+            __m256 valid = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);
+            nx = _mm256_blendv_ps(nx, _mm256_div_ps(nx, length), valid);
+            ny = _mm256_blendv_ps(ny, _mm256_div_ps(ny, length), valid);
+            nz = _mm256_blendv_ps(nz, _mm256_div_ps(nz, length), valid);
+        }
+        else {
+            nx = _mm256_loadu_ps(&s.nx[i]);
+            ny = _mm256_loadu_ps(&s.ny[i]);
+            nz = _mm256_loadu_ps(&s.nz[i]);
+        }
+
+        __m256 tx, ty, tz;
+        transposeFrameSumsAVX2(s.tangentSums.data() + i * 4, tx, ty, tz);
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, tx), _mm256_mul_ps(ny, ty)), _mm256_mul_ps(nz, tz));
+        tx = _mm256_sub_ps(tx, _mm256_mul_ps(nx, d));
+        ty = _mm256_sub_ps(ty, _mm256_mul_ps(ny, d));
+        tz = _mm256_sub_ps(tz, _mm256_mul_ps(nz, d));
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, tx), _mm256_mul_ps(ty, ty)), _mm256_mul_ps(tz, tz)));
+        __m256 valid = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);
+        tx = _mm256_and_ps(valid, _mm256_div_ps(tx, length));
+        ty = _mm256_and_ps(valid, _mm256_div_ps(ty, length));
+        tz = _mm256_and_ps(valid, _mm256_div_ps(tz, length));
+
+        _mm256_store_ps(lanes[0], nx);
+        _mm256_store_ps(lanes[1], ny);
+        _mm256_store_ps(lanes[2], nz);
+        _mm256_store_ps(lanes[3], tx);
+        _mm256_store_ps(lanes[4], ty);
+        _mm256_store_ps(lanes[5], tz);
+        _mm256_store_ps(lanes[6], _mm256_sub_ps(_mm256_mul_ps(ny, tz), _mm256_mul_ps(nz, ty)));
+        _mm256_store_ps(lanes[7], _mm256_sub_ps(_mm256_mul_ps(nz, tx), _mm256_mul_ps(nx, tz)));
+        _mm256_store_ps(lanes[8], _mm256_sub_ps(_mm256_mul_ps(nx, ty), _mm256_mul_ps(ny, tx)));
+        storeVertexFrameLanes(s, i, 8, lanes, flags, out);
+    }
+    for (; i < lastVertex; ++i)
+        finalizeVertexFrameScalar(s, i, flags, out);
+}
+#endif
+
+/*-----------KERNEL----------*/
+/*Triangles [first, last) at the given level, scattered into the sums or stored per triangle*/
+inline void accumulateTriangleFrames(TangentFrameStreams& s, const unsigned int* indices, size_t firstTriangle, size_t lastTriangle, bool accumulateNormals, SIMDLevel level,
+    float* triangleTangents = nullptr, float* triangleNormals = nullptr)
+{
+#if defined(SIMD_HAS_X86)
+    if (level == SIMD_AVX2) {
+        accumulateTriangleFramesAVX2(s, indices, firstTriangle, lastTriangle, accumulateNormals, triangleTangents, triangleNormals);
+        return;
+    }
+    if (level == SIMD_SSE2) {
+        accumulateTriangleFramesSSE2(s, indices, firstTriangle, lastTriangle, accumulateNormals, triangleTangents, triangleNormals);
+        return;
+    }
+#endif
+    for (size_t t = firstTriangle; t < lastTriangle; ++t)
+        accumulateTriangleFrameScalar(s, indices, t, accumulateNormals, triangleTangents, triangleNormals);
+}
+
+inline void finalizeVertexFrames(TangentFrameStreams& s, size_t firstVertex, size_t lastVertex, unsigned int flags, SIMDLevel level, Vertex* out)
+{
+#if defined(SIMD_HAS_X86)
+    if (level == SIMD_AVX2) {
+        finalizeVertexFramesAVX2(s, firstVertex, lastVertex, flags, out);
+        return;
+    }
+    if (level == SIMD_SSE2) {
+        finalizeVertexFramesSSE2(s, firstVertex, lastVertex, flags, out);
+        return;
+    }
+#endif
+    for (size_t i = firstVertex; i < lastVertex; ++i)
+        finalizeVertexFrameScalar(s, i, flags, out);
+}
+
+/*Work split of the threaded path. Fixed sizes, so the split never depends on the thread count;
+  bins are a multiple of 8 vertices so each one finalizes in whole AVX2 blocks.*/
+const size_t TANGENT_FRAME_CHUNK_TRIANGLES = size_t(1) << 15;
+const size_t TANGENT_FRAME_BIN_VERTICES = size_t(1) << 13;
+
+/*The binned path does about 2.5x the memory traffic of the serial scatter, so it is only picked
+  automatically when this many hardware threads can share it*/
+const unsigned int TANGENT_FRAME_MIN_AUTO_THREADS = 4;
+
+/*Threaded accumulation without atomics:
+  1. triangle chunks store their tangent/normal terms per triangle and count their corners per
+     vertex bin;
+  2. a bin-major prefix sum over the counts gives every chunk its own slice of every bin;
+  3. chunks write their corner ids into those slices, so each bin lists its corners in index order;
+  4. each bin adds its corners into the sums of the vertex range it owns, then finalizes that range.
+  Every vertex still receives its triangles in index order, exactly like the serial scatter, so the
+  result is bit-identical to it for any thread count.*/
+inline void runTangentFrameKernelThreaded(TangentFrameStreams& s, const unsigned int* indices, size_t triangleCount, unsigned int flags, SIMDLevel level, Vertex* out,
+    ThreadPool& pool, size_t taskCount)
+{
+    bool accumulateNormals = (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) != 0;
+    size_t vertexCount = s.size();
+    size_t chunkCount = (triangleCount + TANGENT_FRAME_CHUNK_TRIANGLES - 1) / TANGENT_FRAME_CHUNK_TRIANGLES;
+    size_t binCount = (vertexCount + TANGENT_FRAME_BIN_VERTICES - 1) / TANGENT_FRAME_BIN_VERTICES;
+
+    std::vector<float> triangleTangents(triangleCount * 4);
+    std::vector<float> triangleNormals(accumulateNormals ? triangleCount * 4 : 0);
+    std::vector<size_t> binCursors(chunkCount * binCount, 0); /*chunk-major: counts, then write cursors*/
+    pool.parallelFor(chunkCount, taskCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            size_t firstTriangle = chunk * TANGENT_FRAME_CHUNK_TRIANGLES;
+            size_t lastTriangle = std::min(firstTriangle + TANGENT_FRAME_CHUNK_TRIANGLES, triangleCount);
+            accumulateTriangleFrames(s, indices, firstTriangle, lastTriangle, accumulateNormals, level,
+                triangleTangents.data(), accumulateNormals ? triangleNormals.data() : nullptr);
+
+            size_t* counts = &binCursors[chunk * binCount];
+            for (size_t corner = firstTriangle * 3; corner < lastTriangle * 3; ++corner)
+                counts[indices[corner] / TANGENT_FRAME_BIN_VERTICES]++;
+        }
+    });
+
+    std::vector<size_t> binStarts(binCount + 1, 0);
+    size_t offset = 0;
+    for (size_t bin = 0; bin < binCount; ++bin) {
+        binStarts[bin] = offset;
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            size_t count = binCursors[chunk * binCount + bin];
+            binCursors[chunk * binCount + bin] = offset;
+            offset += count;
+        }
+    }
+    binStarts[binCount] = offset;
+
+    std::vector<unsigned int> binCorners(offset);
+    pool.parallelFor(chunkCount, taskCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            size_t firstTriangle = chunk * TANGENT_FRAME_CHUNK_TRIANGLES;
+            size_t lastTriangle = std::min(firstTriangle + TANGENT_FRAME_CHUNK_TRIANGLES, triangleCount);
+            size_t* cursors = &binCursors[chunk * binCount];
+            for (size_t corner = firstTriangle * 3; corner < lastTriangle * 3; ++corner)
+                binCorners[cursors[indices[corner] / TANGENT_FRAME_BIN_VERTICES]++] = static_cast<unsigned int>(corner);
+        }
+    });
+
+    pool.parallelFor(binCount, taskCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t bin = begin; bin < end; ++bin) {
+            for (size_t j = binStarts[bin]; j < binStarts[bin + 1]; ++j) {
+                size_t corner = binCorners[j];
+                size_t vertex = indices[corner];
+                const float* tangent = &triangleTangents[corner / 3 * 4];
+                float* tangentSum = &s.tangentSums[vertex * 4];
+                tangentSum[0] += tangent[0];
+                tangentSum[1] += tangent[1];
+                tangentSum[2] += tangent[2];
+                if (accumulateNormals) {
+                    const float* normal = &triangleNormals[corner / 3 * 4];
+                    float* normalSum = &s.normalSums[vertex * 4];
+                    normalSum[0] += normal[0];
+                    normalSum[1] += normal[1];
+                    normalSum[2] += normal[2];
+                }
+            }
+            size_t firstVertex = bin * TANGENT_FRAME_BIN_VERTICES;
+            finalizeVertexFrames(s, firstVertex, std::min(firstVertex + TANGENT_FRAME_BIN_VERTICES, vertexCount), flags, level, out);
+        }
+    });
+}
+
+/*threadCount 1 runs the serial scatter and larger counts the binned path on the shared pool. 0 picks
+  the binned path with one task per hardware thread when there are at least
+  TANGENT_FRAME_MIN_AUTO_THREADS of them. Meshes of a single chunk always run serially.*/
+inline void runTangentFrameKernel(TangentFrameStreams& streams, const unsigned int* indices, size_t indexCount, unsigned int flags, SIMDLevel level, Vertex* out,
+    unsigned int threadCount)
+{
+    bool accumulateNormals = (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) != 0;
+    size_t triangleCount = indexCount / 3;
+    level = std::min(level, activeSIMDLevel());
+
+    if (!out) {
+        for (std::vector<float>* stream : { &streams.nx, &streams.ny, &streams.nz, &streams.tx, &streams.ty, &streams.tz, &streams.bx, &streams.by, &streams.bz })
+            stream->resize(streams.size());
+    }
+    streams.tangentSums.assign(streams.size() * 4, 0.0f);
+    if (accumulateNormals)
+        streams.normalSums.assign(streams.size() * 4, 0.0f);
+
+    if (threadCount == 0) {
+        threadCount = ThreadPool::defaultThreadCount();
+        if (threadCount < TANGENT_FRAME_MIN_AUTO_THREADS)
+            threadCount = 1;
+    }
+    if (threadCount > 1 && triangleCount > TANGENT_FRAME_CHUNK_TRIANGLES) {
+        runTangentFrameKernelThreaded(streams, indices, triangleCount, flags, level, out, sharedThreadPool(), threadCount);
+        return;
+    }
+    accumulateTriangleFrames(streams, indices, 0, triangleCount, accumulateNormals, level);
+    finalizeVertexFrames(streams, 0, streams.size(), flags, level, out);
+}
+
+/*Per-vertex tangent (and optionally normal) accumulation over the triangles, then normalization,
+  Gram-Schmidt and B = cross(N, T) per vertex into the SoA outputs. level is clamped to what the
+  CPU supports; the result is the same for every level and thread count.*/
+inline void computeTangentFrames(TangentFrameStreams& streams, const unsigned int* indices, size_t indexCount, unsigned int flags, SIMDLevel level = activeSIMDLevel(),
+    unsigned int threadCount = 0)
+{
+    runTangentFrameKernel(streams, indices, indexCount, flags, level, nullptr, threadCount);
+}
+
+/*AoS entry point used by the OBJ parser and the terrain: inputs are transposed into SoA streams and
+  the finished frames are written straight back into the vertices*/
+inline void computeTangentFrames(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int flags = TANGENT_FRAME_DEFAULT, SIMDLevel level = activeSIMDLevel(),
+    unsigned int threadCount = 0)
+{
+    TangentFrameStreams streams;
+    loadTangentFrameStreams(vertices, streams, (flags & TANGENT_FRAME_ACCUMULATE_NORMALS) == 0);
+    runTangentFrameKernel(streams, indices.data(), indices.size(), flags, level, vertices.data(), threadCount);
+}
@@ -0,0 +1,1430 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <iomanip>
+#include <cstdint>
+#include <thread>
+#include <chrono>
+#include "PerlinHelper.h"
+#include "PerlinSIMD.h"
+#include "BenchmarkHelper.h"
+#include "ThreadPool.h"
+#include "TerrainChunks.h"
+#include "TerrainHeightfield.h"
+#include "TerrainEditor.h"
+#include "TerrainQuery.h"
+#include "TerrainRaycast.h"
+#include "TerrainCache.h"
+#include "TerrainErosion.h"
+#include "TiledHeightfield.h"
+#include "HeightmapIO.h"
+#include "TerrainSplatMap.h"
+#include "../includes/glm/gtc/matrix_transform.hpp"
+
+/*fBm samples/sec of the double reference and of the batch engine at every SIMD level this CPU has,
+  on terrain-style coordinates (a grid over [0, 1)) and on random ones over [-256, 256]. Checks the
+  levels agree bit for bit and stay within PERLIN_FLOAT_TOLERANCE of the reference.*/
+inline bool runNoiseBenchmark(std::vector<int>& perlinG, size_t sampleCount, int octaves, int repeats)
+{
+    std::cout << "NOISE BENCHMARK: " << sampleCount << " samples, " << octaves << " octaves, best of " << repeats
+        << ", detected " << simdLevelName(activeSIMDLevel()) << "\n";
+
+    PerlinNoiseTable table = makePerlinNoiseTable(perlinG);
+    bool passed = true;
+    for (int pattern = 0; pattern < 2; ++pattern) {
+        std::vector<float> sampleX(sampleCount), sampleY(sampleCount);
+        if (pattern == 0) {
+            size_t side = std::max<size_t>(1, size_t(std::sqrt(double(sampleCount))));
+            for (size_t i = 0; i < sampleCount; ++i) {
+                sampleX[i] = float(i % side) / float(side);
+                sampleY[i] = float(i / side) / float(side);
+            }
+        }
+        else {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> coordinate(-256.0f, 256.0f);
+            for (size_t i = 0; i < sampleCount; ++i) {
+                sampleX[i] = coordinate(rng);
+                sampleY[i] = coordinate(rng);
+            }
+        }
+        std::cout << "  " << (pattern == 0 ? "grid over [0, 1)" : "random over [-256, 256]") << "\n";
+
+        std::vector<float> reference(sampleCount);
+        double referenceSeconds = benchmarkBestOf(repeats, [&]() {
+            for (size_t i = 0; i < sampleCount; ++i)
+                reference[i] = fractalBrownianMotion(sampleX[i], sampleY[i], octaves, 0.5f, perlinG);
+        });
+        printBenchmarkResult("reference double fBm", referenceSeconds, double(sampleCount), "samples/s");
+
+        /*The reference rounds to float only at the end, so compare against it in double*/
+        std::vector<double> referenceDouble(sampleCount);
+        for (size_t i = 0; i < sampleCount; ++i) {
+            double total = 0.0, frequency = 1.0, amplitude = 1.0, maxValue = 0.0;
+            for (int octave = 0; octave < octaves; ++octave) {
+                total += perlinNoise2D(sampleX[i] * frequency, sampleY[i] * frequency, perlinG) * amplitude;
+                maxValue += amplitude;
+                amplitude *= 0.5;
+                frequency *= 2.0;
+            }
+            referenceDouble[i] = total / maxValue;
+        }
+
+        std::vector<float> scalarResult;
+        for (int level = SIMD_SCALAR; level <= int(activeSIMDLevel()); ++level) {
+            SIMDLevel simdLevel = SIMDLevel(level);
+            std::vector<float> result(sampleCount);
+            double seconds = benchmarkBestOf(repeats, [&]() {
+                fractalBrownianMotionBatch(sampleX.data(), sampleY.data(), result.data(), sampleCount, octaves, 0.5f, table, simdLevel);
+            });
+            printBenchmarkResult(std::string("fractalBrownianMotionBatch ") + simdLevelName(simdLevel), seconds, double(sampleCount), "samples/s");
+
+            double maxError = 0.0;
+            for (size_t i = 0; i < sampleCount; ++i)
+                maxError = std::max(maxError, std::abs(double(result[i]) - referenceDouble[i]));
+            bool withinTolerance = maxError <= PERLIN_FLOAT_TOLERANCE;
+            passed &= withinTolerance;
+            std::cout << "    max |error| vs double " << std::scientific << std::setprecision(2) << maxError << std::fixed
+                << " (tolerance " << std::scientific << PERLIN_FLOAT_TOLERANCE << std::fixed << ") " << (withinTolerance ? "PASS" : "FAIL") << "\n";
+
+            if (simdLevel == SIMD_SCALAR) {
+                scalarResult = result;
+            }
+            else {
+                bool identical = std::memcmp(result.data(), scalarResult.data(), sampleCount * sizeof(float)) == 0;
+                passed &= identical;
+                std::cout << "    identical to scalar: " << (identical ? "yes" : "NO") << "\n";
+            }
+        }
+
+        /*Gradients against central differences of the double fBm on every 16th sample*/
+        const size_t gradientStride = 16;
+        const double step = 1e-5;
+        auto referenceFBm = [&](double x, double y) {
+            double total = 0.0, frequency = 1.0, amplitude = 1.0, maxValue = 0.0;
+            for (int octave = 0; octave < octaves; ++octave) {
+                total += perlinNoise2D(x * frequency, y * frequency, perlinG) * amplitude;
+                maxValue += amplitude;
+                amplitude *= 0.5;
+                frequency *= 2.0;
+            }
+            return total / maxValue;
+        };
+        std::vector<double> referenceDx(sampleCount / gradientStride), referenceDy(sampleCount / gradientStride);
+        for (size_t i = 0; i < referenceDx.size(); ++i) {
+            double x = sampleX[i * gradientStride], y = sampleY[i * gradientStride];
+            referenceDx[i] = (referenceFBm(x + step, y) - referenceFBm(x - step, y)) / (2.0 * step);
+            referenceDy[i] = (referenceFBm(x, y + step) - referenceFBm(x, y - step)) / (2.0 * step);
+        }
+        double topFrequency = std::ldexp(1.0, std::max(0, octaves - 1));
+
+        std::vector<float> scalarDx, scalarDy;
+        for (int level = SIMD_SCALAR; level <= int(activeSIMDLevel()); ++level) {
+            SIMDLevel simdLevel = SIMDLevel(level);
+            std::vector<float> result(sampleCount), dx(sampleCount), dy(sampleCount);
+            double seconds = benchmarkBestOf(repeats, [&]() {
+                fractalBrownianMotionGradientBatch(sampleX.data(), sampleY.data(), result.data(), dx.data(), dy.data(), sampleCount, octaves, 0.5f, table, simdLevel);
+            });
+            printBenchmarkResult(std::string("fractalBrownianMotionGradientBatch ") + simdLevelName(simdLevel), seconds, double(sampleCount), "samples/s");
+
+            double maxError = 0.0;
+            for (size_t i = 0; i < referenceDx.size(); ++i) {
+                maxError = std::max(maxError, std::abs(double(dx[i * gradientStride]) - referenceDx[i]));
+                maxError = std::max(maxError, std::abs(double(dy[i * gradientStride]) - referenceDy[i]));
+            }
+            maxError /= topFrequency;
+            bool withinTolerance = maxError <= PERLIN_FLOAT_GRADIENT_TOLERANCE;
+            bool sameValues = std::memcmp(result.data(), scalarResult.data(), sampleCount * sizeof(float)) == 0;
+            passed &= withinTolerance && sameValues;
+            std::cout << "    values identical to fractalBrownianMotionBatch: " << (sameValues ? "yes" : "NO") << "\n"
+                << "    max |gradient error| / " << topFrequency << " vs double central differences " << std::scientific << std::setprecision(2) << maxError << std::fixed
+                << " (tolerance " << std::scientific << PERLIN_FLOAT_GRADIENT_TOLERANCE << std::fixed << ") " << (withinTolerance ? "PASS" : "FAIL") << "\n";
+
+            if (simdLevel == SIMD_SCALAR) {
+                scalarDx = dx;
+                scalarDy = dy;
+            }
+            else {
+                bool identical = std::memcmp(dx.data(), scalarDx.data(), sampleCount * sizeof(float)) == 0
+                    && std::memcmp(dy.data(), scalarDy.data(), sampleCount * sizeof(float)) == 0;
+                passed &= identical;
+                std::cout << "    gradients identical to scalar: " << (identical ? "yes" : "NO") << "\n";
+            }
+        }
+    }
+    return passed;
+}
+
+/*FNV-1a over raw bytes, to compare outputs too large to keep two copies of*/
+inline uint64_t hashTerrainBytes(const void* data, size_t size, uint64_t hash = 1469598103934665603ull)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+/*generateTerrainVerticesIndices and generateTerrainSplatMap on (2^n + 1)^2 grids from 257^2 up to
+  maxGridSize^2, serially and at 2, 4 and pool.size() + 1 threads. Every threaded run must hash to
+  the same vertices, indices, height range and splat map as the serial one.*/
+inline bool runTerrainGenerationBenchmark(std::vector<int>& perlinG, int maxGridSize)
+{
+    ThreadPool& pool = sharedThreadPool();
+    std::vector<unsigned int> threadCounts = { 1, 2, 4, pool.size() + 1 };
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    std::cout << "TERRAIN BENCHMARK: up to " << maxGridSize << "x" << maxGridSize << ", " << pool.size() << " pool threads + caller\n";
+
+    bool passed = true;
+    for (int gridSize = 257; gridSize <= maxGridSize; gridSize = gridSize * 2 - 1) {
+        int repeats = gridSize <= 1025 ? 3 : 1;
+        size_t vertexCount = (size_t)gridSize * gridSize;
+        std::cout << "  " << gridSize << "x" << gridSize << " (" << vertexCount << " vertices, best of " << repeats << ")\n";
+
+        uint64_t serialHash = 0;
+        double serialSeconds = 0.0;
+        for (unsigned int threadCount : threadCounts) {
+            std::vector<Vertex> vertices;
+            std::vector<unsigned int> indices;
+            std::vector<uint32_t> splatMap;
+            float minHeight = 0.f, maxHeight = 0.f;
+            int width = gridSize, height = gridSize;
+
+            double generateSeconds = benchmarkBestOf(repeats, [&]() {
+                generateTerrainVerticesIndices(width, height, hScale, vertices, indices, perlinG, minHeight, maxHeight, threadCount);
+            });
+            std::vector<float> heights = terrainHeightsFromVertices(vertices);
+            double splatSeconds = benchmarkBestOf(repeats, [&]() {
+                generateTerrainSplatMap(heights.data(), width, height, minHeight, maxHeight, TerrainSplatSettings(), splatMap, threadCount);
+            });
+
+            uint64_t hash = hashTerrainBytes(vertices.data(), vertices.size() * sizeof(Vertex));
+            hash = hashTerrainBytes(indices.data(), indices.size() * sizeof(unsigned int), hash);
+            hash = hashTerrainBytes(splatMap.data(), splatMap.size() * sizeof(uint32_t), hash);
+            hash = hashTerrainBytes(&minHeight, sizeof(float), hash);
+            hash = hashTerrainBytes(&maxHeight, sizeof(float), hash);
+
+            double seconds = generateSeconds + splatSeconds;
+            std::string label = std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads");
+            printBenchmarkResult("    generate, " + label, generateSeconds, double(vertexCount), "vertices/s");
+            printBenchmarkResult("    splat map, " + label, splatSeconds, double(vertexCount), "vertices/s");
+            if (threadCount == 1) {
+                serialHash = hash;
+                serialSeconds = seconds;
+            }
+            else {
+                bool identical = hash == serialHash;
+                passed &= identical;
+                std::cout << "    speedup " << std::setprecision(2) << serialSeconds / seconds << "x, identical to serial: " << (identical ? "yes" : "NO") << "\n";
+            }
+        }
+    }
+    return passed;
+}
+
+/*Streaming terrain without a GL context: per-chunk generation cost, a check that neighbouring chunks
+  agree bit for bit on their shared border, then a flight of distance world units at speed units/s
+  with 60 Hz frames. CPU memory must not grow after the first chunks are streamed in.*/
+inline bool runTerrainStreamingBenchmark(std::vector<int>& perlinG, float distance, float speed)
+{
+    TerrainChunkSettings settings;
+    settings.heightScale = hScale;
+    settings.createGPUBuffers = false;
+    const int side = settings.chunkQuads + 1;
+
+    std::cout << "TERRAIN STREAMING BENCHMARK: " << side << "x" << side << " vertex chunks of " << settings.chunkSize << " units, view radius "
+        << settings.viewRadius << ", flight of " << distance << " units at " << speed << " units/s\n";
+
+    PerlinNoiseTable table = makePerlinNoiseTable(perlinG);
+
+    std::vector<Vertex> chunk, neighbourX, neighbourZ;
+    const int chunkRepeats = 64;
+    double chunkSeconds = benchmarkBestOf(3, [&]() {
+        for (int i = 0; i < chunkRepeats; ++i)
+            generateTerrainChunkVertices(settings, table, 1000 + i, -3, chunk);
+    });
+    printBenchmarkResult("generateTerrainChunkVertices", chunkSeconds, double(chunkRepeats), "chunks/s");
+
+    /*Far from the origin on purpose: the wrapped noise samples must still line up*/
+    const int farX = 40000, farZ = -25000;
+    generateTerrainChunkVertices(settings, table, farX, farZ, chunk);
+    generateTerrainChunkVertices(settings, table, farX + 1, farZ, neighbourX);
+    generateTerrainChunkVertices(settings, table, farX, farZ + 1, neighbourZ);
+    /*Packed, the border must decode to the same position and to UVs a whole number apart*/
+    VertexDecodeParams chunkDecode = computeTerrainChunkDecodeParams(settings, farX, farZ);
+    VertexDecodeParams neighbourXDecode = computeTerrainChunkDecodeParams(settings, farX + 1, farZ);
+    VertexDecodeParams neighbourZDecode = computeTerrainChunkDecodeParams(settings, farX, farZ + 1);
+    auto packedMatch = [](const Vertex& a, const VertexDecodeParams& aDecode, const Vertex& b, const VertexDecodeParams& bDecode) {
+        Vertex decodedA = unpackVertex(packVertex(a, aDecode), aDecode);
+        Vertex decodedB = unpackVertex(packVertex(b, bDecode), bDecode);
+        glm::vec2 shift = decodedA.vTexCoords - decodedB.vTexCoords;
+        return decodedA.vPos == decodedB.vPos && shift == glm::floor(shift) && decodedA.vNormals == decodedB.vNormals;
+    };
+    bool seamless = true, packedSeamless = true;
+    for (int i = 0; i < side; ++i) {
+        const Vertex& right = chunk[(size_t)i * side + side - 1];
+        const Vertex& left = neighbourX[(size_t)i * side];
+        const Vertex& bottom = chunk[(size_t)(side - 1) * side + i];
+        const Vertex& top = neighbourZ[i];
+        seamless &= right.vPos == left.vPos && right.vNormals == left.vNormals && right.vTangent == left.vTangent;
+        seamless &= bottom.vPos == top.vPos && bottom.vNormals == top.vNormals && bottom.vTangent == top.vTangent;
+        packedSeamless &= packedMatch(right, chunkDecode, left, neighbourXDecode) && packedMatch(bottom, chunkDecode, top, neighbourZDecode);
+    }
+    std::cout << "  shared borders bit-identical: " << (seamless ? "yes" : "NO") << ", packed: " << (packedSeamless ? "yes" : "NO") << "\n";
+    seamless &= packedSeamless;
+
+    /*The collision height at each vertex of a chunk that was never made resident must be its height*/
+    float worstHeight = 0.0f;
+    for (const Vertex& vertex : chunk)
+        worstHeight = std::max(worstHeight, std::abs(terrainChunkHeightAt(settings, table, vertex.vPos.x, vertex.vPos.z) - vertex.vPos.y));
+    bool heightsMatch = worstHeight <= 1e-4f * settings.heightScale;
+    std::cout << "  terrainChunkHeightAt against the chunk's vertices: worst difference " << std::scientific << std::setprecision(2) << worstHeight
+        << std::fixed << (heightsMatch ? "" : " TOO LARGE") << "\n";
+    seamless &= heightsMatch;
+
+    TerrainChunkManager manager(settings, perlinG);
+    const double frameSeconds = 1.0 / 60.0;
+    glm::vec3 camera(0.0f, 20.0f, 0.0f);
+    glm::vec3 direction = glm::normalize(glm::vec3(1.0f, 0.0f, 0.3f));
+    size_t frames = size_t(distance / (speed * frameSeconds));
+    size_t settledBytes = 0, maxBytes = 0;
+    double totalUpdateSeconds = 0.0, maxUpdateSeconds = 0.0, residentInView = 0.0;
+
+    BenchmarkTimer flightTimer;
+    for (size_t frame = 0; frame < frames; ++frame) {
+        BenchmarkTimer frameTimer;
+        camera += direction * float(speed * frameSeconds);
+        manager.update(camera);
+        double updateSeconds = frameTimer.elapsedSeconds();
+        totalUpdateSeconds += updateSeconds;
+        maxUpdateSeconds = std::max(maxUpdateSeconds, updateSeconds);
+        residentInView += double(manager.residentChunksInView()) / double(manager.chunksInView());
+
+        /*Every slot has held a finished chunk once as many chunks as slots have been generated; from
+          then on nothing may grow*/
+        if (settledBytes == 0 && manager.generatedChunkCount() >= manager.slotCount())
+            settledBytes = manager.cpuBytes();
+        maxBytes = std::max(maxBytes, manager.cpuBytes());
+
+        double remaining = frameSeconds - frameTimer.elapsedSeconds();
+        if (remaining > 0.0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+    }
+    double flightSeconds = flightTimer.elapsedSeconds();
+
+    bool flat = settledBytes > 0 && maxBytes == settledBytes;
+    std::cout << std::fixed << std::setprecision(2)
+        << "  " << frames << " frames in " << flightSeconds << " s, " << manager.generatedChunkCount() << " chunks generated, "
+        << manager.evictedChunkCount() << " evicted, " << manager.slotCount() << " slots\n"
+        << "  update() " << totalUpdateSeconds * 1000.0 / std::max<size_t>(1, frames) << " ms average, " << maxUpdateSeconds * 1000.0 << " ms worst\n"
+        << "  chunks in view resident: " << 100.0 * residentInView / std::max<size_t>(1, frames) << "% on average\n"
+        << "  CPU bytes once the cache is full " << settledBytes << ", largest " << maxBytes << ": " << (flat ? "flat" : "GREW") << "\n";
+    return seamless && flat;
+}
+
+/*CDLOD on single (2^n + 1)^2 terrain grids from 1025^2 up to maxGridSize^2: cost of the morph deltas
+  and node bounds, then node selection from a camera at the grid centre, for a perspective view and
+  for an orthographic view of the whole grid like the shadow pass. The whole-grid selection must
+  cover every quad of the grid exactly once.*/
+inline bool runTerrainLODBenchmark(std::vector<int>& perlinG, int maxGridSize)
+{
+    TerrainLODSettings settings;
+    std::cout << "TERRAIN LOD BENCHMARK: up to " << maxGridSize << "x" << maxGridSize << ", " << settings.leafQuads << " quad leaves, LOD distance ratio "
+        << settings.lodDistanceRatio << "\n";
+
+    bool passed = true;
+    for (int gridSize = 1025; gridSize <= maxGridSize; gridSize = gridSize * 2 - 1) {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        float minHeight = 0.f, maxHeight = 0.f;
+        int width = gridSize, height = gridSize;
+        generateTerrainVerticesIndices(width, height, hScale, vertices, indices, perlinG, minHeight, maxHeight);
+        indices = std::vector<unsigned int>();
+        std::cout << "  " << gridSize << "x" << gridSize << "\n";
+
+        TerrainLODLayout layout(gridSize - 1, 1.0f, settings);
+        std::vector<float> deltas;
+        std::vector<glm::vec2> bounds;
+        double deltaSeconds = benchmarkBestOf(3, [&]() { layout.computeMorphDeltas(vertices.data(), deltas); });
+        double boundsSeconds = benchmarkBestOf(3, [&]() { layout.computeNodeBounds(vertices.data(), bounds); });
+        printBenchmarkResult("    computeMorphDeltas", deltaSeconds, double(vertices.size()), "vertices/s");
+        printBenchmarkResult("    computeNodeBounds", boundsSeconds, double(vertices.size()), "vertices/s");
+
+        /*Vertex (0, 0) sits at -gridSize / 2 in x and z*/
+        glm::vec2 gridOrigin(float(-(gridSize / 2)));
+        float extent = float(gridSize);
+        glm::vec3 camera(0.0f, maxHeight + 2.0f, 0.0f);
+        glm::mat4 perspective = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, extent)
+            * glm::lookAt(camera, camera + glm::vec3(1.0f, -0.2f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 wholeGrid = glm::ortho(-extent, extent, -extent, extent, -extent, extent)
+            * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        for (int view = 0; view < 2; ++view) {
+            TerrainFrustum frustum = makeTerrainFrustum(view == 0 ? perspective : wholeGrid);
+            std::vector<TerrainLODNodeDraw> draws;
+            TerrainLODStats stats;
+            const int selectRepeats = 100;
+            double selectSeconds = benchmarkBestOf(3, [&]() {
+                for (int i = 0; i < selectRepeats; ++i) {
+                    draws.clear();
+                    stats = TerrainLODStats();
+                    layout.selectNodes(gridOrigin, bounds, camera, frustum, 0, draws, stats);
+                }
+            });
+            printBenchmarkResult(view == 0 ? "    selectNodes, perspective" : "    selectNodes, whole grid", selectSeconds, double(selectRepeats), "selections/s");
+            std::cout << "      " << stats.nodes << " nodes, " << stats.culledNodes << " culled, " << stats.triangles << " of " << stats.fullTriangles
+                << " triangles (" << std::setprecision(2) << 100.0 * double(stats.triangles) / double(stats.fullTriangles) << "%)\n";
+
+            if (view == 1) {
+                /*A level l patch quad covers 4^l grid quads*/
+                size_t coveredQuads = 0;
+                for (const TerrainLODNodeDraw& draw : draws)
+                    coveredQuads += (size_t(draw.indexCount) / 6) << (2 * draw.level);
+                bool covered = coveredQuads == (size_t)(gridSize - 1) * (gridSize - 1);
+                passed &= covered;
+                std::cout << "      every quad covered once: " << (covered ? "yes" : "NO") << "\n";
+            }
+        }
+    }
+    return passed;
+}
+
+/*Single terrain grids from 257^2 up to maxGridSize^2 as Vertex buffers against a 16-bit heightfield,
+  each with its splat map: generation time, GPU bytes of each, and how far the heights and the frames the
+  vertex shaders rebuild are from the generated vertices. Heights must stay within half a
+  quantization step.*/
+inline bool runTerrainHeightfieldBenchmark(std::vector<int>& perlinG, int maxGridSize)
+{
+    const int patchQuads = 32;
+    std::cout << "TERRAIN HEIGHTFIELD BENCHMARK: up to " << maxGridSize << "x" << maxGridSize << ", " << patchQuads << "x" << patchQuads << " quad patch\n";
+
+    bool passed = true;
+    for (int gridSize = 257; gridSize <= maxGridSize; gridSize = gridSize * 2 - 1) {
+        int repeats = gridSize <= 1025 ? 3 : 1;
+        size_t vertexCount = (size_t)gridSize * gridSize;
+        std::cout << "  " << gridSize << "x" << gridSize << " (best of " << repeats << ")\n";
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        float minHeight = 0.f, maxHeight = 0.f;
+        int width = gridSize, height = gridSize;
+        double vertexSeconds = benchmarkBestOf(repeats, [&]() {
+            generateTerrainVerticesIndices(width, height, hScale, vertices, indices, perlinG, minHeight, maxHeight);
+        });
+        TerrainHeightfield field;
+        double heightfieldSeconds = benchmarkBestOf(repeats, [&]() { generateTerrainHeightfield(gridSize, gridSize, hScale, perlinG, field); });
+        printBenchmarkResult("    vertices", vertexSeconds, double(vertexCount), "vertices/s");
+        printBenchmarkResult("    heightfield", heightfieldSeconds, double(vertexCount), "vertices/s");
+
+        size_t indexBytes = indices.size() * indexTypeSize(selectIndexType(vertexCount));
+        size_t splatBytes = vertexCount * sizeof(uint32_t);
+        size_t vertexBytes = vertexCount * sizeof(Vertex) + indexBytes + splatBytes;
+        size_t packedBytes = vertexCount * sizeof(PackedVertex) + indexBytes + splatBytes;
+        size_t heightfieldBytes = terrainHeightfieldGPUBytes(gridSize, gridSize, patchQuads) + splatBytes;
+        std::cout << std::setprecision(1)
+            << "    GPU bytes: Vertex " << vertexBytes << ", PackedVertex " << packedBytes << ", heightfield " << heightfieldBytes
+            << " (" << double(vertexBytes) / double(heightfieldBytes) << "x and " << double(packedBytes) / double(heightfieldBytes) << "x smaller)\n";
+
+        /*The vertex path's range is the heightfield's, both start min/max at 0*/
+        bool sameRange = field.minHeight == minHeight && field.maxHeight == maxHeight;
+        float halfStep = 0.5f * (maxHeight - minHeight) / 65535.0f;
+        float maxHeightError = 0.f, minNormalDot = 1.f, minTangentDot = 1.f;
+        for (int z = 0; z < gridSize; ++z) {
+            for (int x = 0; x < gridSize; ++x) {
+                const Vertex& vertex = vertices[(size_t)z * gridSize + x];
+                Vertex rebuilt = reconstructTerrainHeightfieldVertex(field, x, z);
+                maxHeightError = std::max(maxHeightError, std::fabs(rebuilt.vPos.y - vertex.vPos.y));
+                minNormalDot = std::min(minNormalDot, glm::dot(rebuilt.vNormals, vertex.vNormals));
+                minTangentDot = std::min(minTangentDot, glm::dot(rebuilt.vTangent, vertex.vTangent));
+            }
+        }
+        /*Plus a few ulps for the float decode*/
+        float tolerance = halfStep + 4.0f * std::numeric_limits<float>::epsilon() * std::max(std::fabs(minHeight), std::fabs(maxHeight));
+        bool heightsClose = sameRange && maxHeightError <= tolerance;
+        passed &= heightsClose;
+        std::cout << std::setprecision(6) << "    height error " << maxHeightError << " (half step " << halfStep << ", allowed " << tolerance << ")" << (sameRange ? "" : ", RANGE DIFFERS")
+            << ": " << (heightsClose ? "ok" : "TOO LARGE") << "\n"
+            << "    rebuilt frame vs generated, worst cosine: normal " << minNormalDot << ", tangent " << minTangentDot << "\n";
+    }
+    return passed;
+}
+
+/*Terrain frames from the analytic fBm gradient, which generateTerrainVerticesIndices now writes in its
+  height pass, against the area-weighted face normals computeTangentFrames accumulated over the
+  triangles in a second pass before. The two differ by the discretization of the face normals, which
+  shrinks as the grid gets denser. Fails on a frame that is not unit length or points down.*/
+inline bool runTerrainNormalBenchmark(std::vector<int>& perlinG, int maxGridSize)
+{
+    std::cout << "TERRAIN NORMAL BENCHMARK: analytic gradient against accumulated face normals, up to " << maxGridSize << "x" << maxGridSize << "\n";
+
+    bool passed = true;
+    for (int gridSize = 257; gridSize <= maxGridSize; gridSize = gridSize * 2 - 1) {
+        int repeats = gridSize <= 1025 ? 3 : 1;
+        size_t vertexCount = (size_t)gridSize * gridSize;
+        std::cout << "  " << gridSize << "x" << gridSize << " (best of " << repeats << ")\n";
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        float minHeight = 0.f, maxHeight = 0.f;
+        int width = gridSize, height = gridSize;
+        double generateSeconds = benchmarkBestOf(repeats, [&]() {
+            generateTerrainVerticesIndices(width, height, hScale, vertices, indices, perlinG, minHeight, maxHeight);
+        });
+        std::vector<Vertex> accumulated = vertices;
+        double accumulateSeconds = benchmarkBestOf(repeats, [&]() {
+            computeTangentFrames(accumulated, indices, TANGENT_FRAME_ACCUMULATE_NORMALS | TANGENT_FRAME_FLIP_NORMALS);
+        });
+        printBenchmarkResult("    generate with analytic frames", generateSeconds, double(vertexCount), "vertices/s");
+        printBenchmarkResult("    face-normal pass it replaces", accumulateSeconds, double(vertexCount), "vertices/s");
+
+        double normalSum = 0.0, tangentSum = 0.0, normalWorst = 0.0, tangentWorst = 0.0;
+        bool valid = true;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const Vertex& analytic = vertices[i];
+            valid &= std::abs(glm::length(analytic.vNormals) - 1.0f) < 1e-4f && std::abs(glm::length(analytic.vTangent) - 1.0f) < 1e-4f && analytic.vNormals.y > 0.0f;
+            double normalAngle = std::acos(std::min(1.0, double(glm::dot(analytic.vNormals, accumulated[i].vNormals)))) * 180.0 / 3.14159265358979;
+            double tangentAngle = std::acos(std::min(1.0, double(glm::dot(analytic.vTangent, accumulated[i].vTangent)))) * 180.0 / 3.14159265358979;
+            normalSum += normalAngle;
+            tangentSum += tangentAngle;
+            normalWorst = std::max(normalWorst, normalAngle);
+            tangentWorst = std::max(tangentWorst, tangentAngle);
+        }
+        passed &= valid;
+        std::cout << std::setprecision(4)
+            << "    normal angle to the face-normal result: mean " << normalSum / vertexCount << " deg, worst " << normalWorst << " deg\n"
+            << "    tangent angle: mean " << tangentSum / vertexCount << " deg, worst " << tangentWorst << " deg\n"
+            << "    unit length and facing up: " << (valid ? "yes" : "NO") << "\n";
+    }
+    return passed;
+}
+
+/*Copies a rect-sized block into the rows of a width-wide grid, as uploadTerrainRectRows does into the
+  vertex buffer*/
+template <typename T>
+inline void copyTerrainRectRows(const TerrainRect& rect, int width, const T* block, std::vector<T>& grid)
+{
+    for (int z = rect.z0; z < rect.z1; ++z)
+        std::copy(block + (size_t)(z - rect.z0) * rect.columns(), block + (size_t)(z - rect.z0 + 1) * rect.columns(), grid.begin() + (size_t)z * width + rect.x0);
+}
+
+/*Terrain editing on single grids from 1025^2 up to maxGridSize^2 without a GL context: brush strokes
+  and patch regenerations ahead of a moving camera, each rebuilding only its dirty rectangles into CPU mirrors of the vertex
+  buffer and splat map, against regenerating and re-uploading the whole grid. Fails if the mirrors
+  differ from a full rebuild after the strokes (a change the rectangles missed) or if regenerating
+  the whole grid does not restore the generated heights.*/
+inline bool runTerrainEditBenchmark(std::vector<int>& perlinG, int maxGridSize)
+{
+    const int strokeCount = 256;
+    const float brushRadius = 32.0f;
+    std::cout << "TERRAIN EDIT BENCHMARK: up to " << maxGridSize << "x" << maxGridSize << ", " << strokeCount << " strokes of radius " << brushRadius << "\n";
+
+    bool passed = true;
+    for (int gridSize = 1025; gridSize <= maxGridSize; gridSize = gridSize * 2 - 1) {
+        size_t vertexCount = (size_t)gridSize * gridSize;
+        std::cout << "  " << gridSize << "x" << gridSize << "\n";
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<uint32_t> splatMap;
+        std::vector<float> generatedHeights;
+        float minHeight = 0.f, maxHeight = 0.f;
+        int width = gridSize, height = gridSize;
+        double regenerateSeconds = benchmarkBestOf(1, [&]() {
+            generateTerrainVerticesIndices(width, height, hScale, vertices, indices, perlinG, minHeight, maxHeight);
+            generatedHeights = terrainHeightsFromVertices(vertices);
+            generateTerrainSplatMap(generatedHeights.data(), width, height, minHeight, maxHeight, TerrainSplatSettings(), splatMap);
+        });
+        std::vector<unsigned int>().swap(indices);
+
+        /*The mirror starts as the generated vertex buffer, which the editor must rebuild frames and all*/
+        TerrainEditor editor(gridSize, gridSize, hScale, perlinG, generatedHeights, minHeight, maxHeight);
+        std::vector<Vertex> vertexMirror(vertexCount);
+        editor.buildVertices(editor.bounds(), vertexMirror.data());
+        bool framesMatch = std::memcmp(vertexMirror.data(), vertices.data(), vertexCount * sizeof(Vertex)) == 0;
+        passed &= framesMatch;
+        std::vector<Vertex>().swap(vertices);
+        std::vector<uint32_t> splatMirror = splatMap;
+
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> step(-4.0f, 4.0f);
+        glm::vec3 center(0.0f);
+        std::vector<Vertex> rectVertices;
+        std::vector<uint32_t> rectSplat;
+        size_t uploadBytes = 0;
+        BenchmarkTimer timer;
+        for (int stroke = 0; stroke < strokeCount; ++stroke) {
+            /*A held brush drifting with the camera, switching mode every 32 strokes*/
+            center += glm::vec3(step(random), 0.0f, step(random));
+            TerrainBrushMode mode = TerrainBrushMode((stroke / 32) % 3);
+            editor.applyBrush(mode, center, brushRadius, mode == TERRAIN_BRUSH_FLATTEN ? 0.05f : 0.1f);
+            /*Every 16th stroke also restores a patch off to the side. Unlike the brush it changes heights
+              right up to its border, so only the one-vertex ring keeps the frames outside it current.*/
+            if (stroke % 16 == 15) {
+                int patchX = int(center.x) + gridSize / 2 + 96, patchZ = int(center.z) + gridSize / 2;
+                editor.regenerateRect(TerrainRect{ patchX - 24, patchZ - 24, patchX + 24, patchZ + 24 });
+            }
+
+            TerrainEditBatch edits = editor.takeEdits();
+            for (const TerrainRect& rect : edits.rects) {
+                rectVertices.resize(rect.area());
+                rectSplat.resize(rect.area());
+                editor.buildVertices(rect, rectVertices.data());
+                editor.buildSplatTexels(rect, rectSplat.data());
+                copyTerrainRectRows(rect, gridSize, rectVertices.data(), vertexMirror);
+                copyTerrainRectRows(rect, gridSize, rectSplat.data(), splatMirror);
+                uploadBytes += rect.area() * (sizeof(Vertex) + sizeof(uint32_t));
+            }
+        }
+        double strokeSeconds = timer.elapsedSeconds() / strokeCount;
+        size_t fullBytes = vertexCount * (sizeof(Vertex) + sizeof(uint32_t));
+        printBenchmarkResult("    regenerate whole grid", regenerateSeconds, double(vertexCount), "vertices/s");
+        printBenchmarkResult("    brush stroke + dirty rebuild", strokeSeconds, 1.0, "strokes/s");
+        std::cout << std::setprecision(1) << "    bytes per stroke " << uploadBytes / strokeCount << " against " << fullBytes
+            << " (" << double(fullBytes) * strokeCount / double(uploadBytes) << "x fewer)\n";
+
+        /*The mirrors only saw the rectangles; a full rebuild from the edited heights must match them*/
+        std::vector<Vertex> rebuilt(vertexCount);
+        std::vector<uint32_t> rebuiltSplat(vertexCount);
+        editor.buildVertices(editor.bounds(), rebuilt.data());
+        editor.buildSplatTexels(editor.bounds(), rebuiltSplat.data());
+        bool mirrorsMatch = std::memcmp(rebuilt.data(), vertexMirror.data(), vertexCount * sizeof(Vertex)) == 0
+            && rebuiltSplat == splatMirror;
+        passed &= mirrorsMatch;
+        std::vector<Vertex>().swap(rebuilt);
+        std::vector<Vertex>().swap(vertexMirror);
+
+        double rescaleSeconds = benchmarkBestOf(1, [&]() {
+            editor.setHeightScale(hScale * 1.5f);
+            editor.setHeightScale(hScale);
+        });
+        double restoreSeconds = benchmarkBestOf(1, [&]() { editor.regenerateRect(editor.bounds()); });
+        bool restored = editor.gridHeights() == generatedHeights;
+        passed &= restored;
+        printBenchmarkResult("    height scale there and back", rescaleSeconds, double(vertexCount) * 2.0, "vertices/s");
+        printBenchmarkResult("    regenerate heights from noise", restoreSeconds, double(vertexCount), "vertices/s");
+        std::cout << "    rebuilt vertices match the generated ones: " << (framesMatch ? "yes" : "NO")
+            << ", dirty rectangles match a full rebuild: " << (mirrorsMatch ? "yes" : "NO")
+            << ", regeneration restores the generated heights: " << (restored ? "yes" : "NO") << "\n";
+    }
+
+    /*Eroded, the generator accumulates triangle frames; the editor's rectangles must too*/
+    {
+        const int gridSize = 257;
+        TerrainErosionSettings erosion;
+        erosion.droplets = 20000;
+        erosion.thermalPasses = 4;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        float minHeight = 0.f, maxHeight = 0.f;
+        int width = gridSize, height = gridSize;
+        generateTerrainVerticesIndices(width, height, hScale, vertices, indices, perlinG, minHeight, maxHeight, 0, TerrainNoiseSettings(), erosion);
+        TerrainEditor editor(gridSize, gridSize, hScale, perlinG, terrainHeightsFromVertices(vertices), minHeight, maxHeight, 0, TerrainNoiseSettings(), erosion);
+        TerrainRect rect{ 40, 70, 200, 130 };
+        std::vector<Vertex> rectVertices(rect.area());
+        editor.buildVertices(rect, rectVertices.data());
+        float worstNormal = 0.f;
+        for (int z = rect.z0; z < rect.z1; ++z)
+            for (int x = rect.x0; x < rect.x1; ++x)
+                worstNormal = std::max(worstNormal, glm::length(rectVertices[(size_t)(z - rect.z0) * rect.columns() + (x - rect.x0)].vNormals
+                    - vertices[(size_t)z * gridSize + x].vNormals));
+        bool erodedMatch = worstNormal <= 1e-5f;
+        passed &= erodedMatch;
+        std::cout << "  eroded " << gridSize << "x" << gridSize << ": rectangle frames against the generated ones, worst normal difference "
+            << std::scientific << std::setprecision(2) << worstNormal << std::fixed << (erodedMatch ? "" : " TOO LARGE") << "\n";
+    }
+    return passed;
+}
+
+/*Height and normal queries on a gridSize^2 terrain: queryCount positions scattered over it (every
+  16th past an edge) answered one by one with heightAt, then in batches of batchSize at every SIMD
+  level this CPU has. Fails if a level differs from the scalar query in any bit or a query on a grid
+  vertex does not return that vertex's height.*/
+inline bool runTerrainQueryBenchmark(std::vector<int>& perlinG, int gridSize, size_t queryCount)
+{
+    const size_t batchSize = 4096;
+    const int repeats = 3;
+    std::cout << "TERRAIN QUERY BENCHMARK: " << queryCount << " queries on " << gridSize << "x" << gridSize << ", batches of " << batchSize << "\n";
+
+    std::vector<float> heights;
+    float minHeight = 0.f, maxHeight = 0.f;
+    generateTerrainHeights(gridSize, gridSize, hScale, perlinG, heights, minHeight, maxHeight);
+    TerrainHeightQuery query(heights.data(), gridSize, gridSize);
+
+    std::mt19937 random(11);
+    float half = float(gridSize / 2);
+    std::uniform_real_distribution<float> inside(-half, half), outside(-half - 64.0f, half + 64.0f);
+    std::vector<float> x(queryCount), z(queryCount);
+    for (size_t i = 0; i < queryCount; ++i) {
+        x[i] = i % 16 == 15 ? outside(random) : inside(random);
+        z[i] = i % 16 == 15 ? outside(random) : inside(random);
+    }
+
+    std::vector<float> scalarHeights(queryCount);
+    std::vector<glm::vec3> scalarNormals(queryCount);
+    double scalarSeconds = benchmarkBestOf(repeats, [&]() {
+        for (size_t i = 0; i < queryCount; ++i)
+            scalarHeights[i] = query.heightAt(glm::vec3(x[i], 0.0f, z[i]));
+    });
+    double scalarNormalSeconds = benchmarkBestOf(repeats, [&]() {
+        for (size_t i = 0; i < queryCount; ++i)
+            scalarNormals[i] = query.normalAt(glm::vec3(x[i], 0.0f, z[i]));
+    });
+    printBenchmarkResult("  heightAt, one by one", scalarSeconds, double(queryCount), "queries/s");
+    printBenchmarkResult("  normalAt, one by one", scalarNormalSeconds, double(queryCount), "queries/s");
+
+    bool passed = true;
+    std::vector<float> batchHeights(queryCount);
+    std::vector<glm::vec3> batchNormals(queryCount);
+    for (int levelIndex = SIMD_SCALAR; levelIndex <= int(activeSIMDLevel()); ++levelIndex) {
+        SIMDLevel level = SIMDLevel(levelIndex);
+        auto runBatches = [&](glm::vec3* normals) {
+            for (size_t first = 0; first < queryCount; first += batchSize) {
+                size_t count = std::min(batchSize, queryCount - first);
+                query.sample(x.data() + first, z.data() + first, batchHeights.data() + first, normals ? normals + first : nullptr, count, level);
+            }
+        };
+        double heightSeconds = benchmarkBestOf(repeats, [&]() { runBatches(nullptr); });
+        bool heightsIdentical = std::memcmp(batchHeights.data(), scalarHeights.data(), queryCount * sizeof(float)) == 0;
+        double normalSeconds = benchmarkBestOf(repeats, [&]() { runBatches(batchNormals.data()); });
+        bool normalsIdentical = std::memcmp(batchNormals.data(), scalarNormals.data(), queryCount * sizeof(glm::vec3)) == 0
+            && std::memcmp(batchHeights.data(), scalarHeights.data(), queryCount * sizeof(float)) == 0;
+        passed &= heightsIdentical && normalsIdentical;
+
+        std::string name = simdLevelName(level);
+        printBenchmarkResult("  batch heights, " + name, heightSeconds, double(queryCount), "queries/s");
+        printBenchmarkResult("  batch heights + normals, " + name, normalSeconds, double(queryCount), "queries/s");
+        std::cout << "    identical to one by one: heights " << (heightsIdentical ? "yes" : "NO") << ", normals " << (normalsIdentical ? "yes" : "NO") << "\n";
+    }
+
+    /*The bilinear surface passes through the grid vertices*/
+    bool onVertices = true;
+    for (int z0 = 0; z0 < gridSize; z0 += 97)
+        for (int x0 = 0; x0 < gridSize; x0 += 89)
+            onVertices &= query.heightAt(glm::vec3(float(x0) - half, 0.0f, float(z0) - half)) == heights[(size_t)z0 * gridSize + x0];
+    passed &= onVertices;
+    std::cout << "  grid vertices returned exactly: " << (onVertices ? "yes" : "NO") << "\n";
+    return passed;
+}
+
+/*Brute-force reference for the raycaster: every cell the ray crosses, in order, through the same
+  cell test, with no pyramid to skip any*/
+inline TerrainRayHit marchTerrainRayCells(const std::vector<float>& heights, int width, int height, const TerrainRay& ray)
+{
+    TerrainRayHit hit;
+    TerrainGridRay gridRay;
+    float enter, exit;
+    if (!makeTerrainGridRay(ray, width, height, gridRay)
+        || !terrainRaySpan(gridRay, 0.0f, 0.0f, float(width - 1), float(height - 1), enter, exit))
+        return hit;
+
+    const glm::vec3& origin = gridRay.origin;
+    const glm::vec3& direction = gridRay.direction;
+    int cellX = std::min(std::max(int(std::floor(origin.x + direction.x * enter)), 0), width - 2);
+    int cellZ = std::min(std::max(int(std::floor(origin.z + direction.z * enter)), 0), height - 2);
+    int stepX = direction.x > 0.0f ? 1 : -1, stepZ = direction.z > 0.0f ? 1 : -1;
+    const float never = std::numeric_limits<float>::infinity();
+    while (cellX >= 0 && cellZ >= 0 && cellX < width - 1 && cellZ < height - 1) {
+        float distance;
+        if (intersectTerrainCell(heights.data(), width, gridRay, cellX, cellZ, distance)) {
+            hit.hit = true;
+            hit.distance = distance;
+            hit.position = ray.origin + direction * distance;
+            return hit;
+        }
+        /*Distances to the next column and row edges, from the cell each time so they never drift*/
+        float nextX = direction.x != 0.0f ? (float(cellX + (stepX > 0)) - origin.x) / direction.x : never;
+        float nextZ = direction.z != 0.0f ? (float(cellZ + (stepZ > 0)) - origin.z) / direction.z : never;
+        if (std::min(nextX, nextZ) > exit)
+            break;
+        if (nextX < nextZ)
+            cellX += stepX;
+        else
+            cellZ += stepZ;
+    }
+    return hit;
+}
+
+/*Rays against a gridSize^2 terrain, a third of each kind: picking rays cast down from above the
+  terrain at every angle up to grazing, line-of-sight segments between points just above the ground,
+  and unbounded rays toward a low sun. The pyramid traversal, serial and batched over the pool, is
+  timed against marchTerrainRayCells; fails if any hit or distance differs from the march's. Then
+  lineOfSight between points on the ground itself: a point must see straight up and along a flat
+  grid, and between ground points agree with the march of the segment it tests.*/
+inline bool runTerrainRaycastBenchmark(std::vector<int>& perlinG, int gridSize, size_t rayCount)
+{
+    const int repeats = 3;
+    std::cout << "TERRAIN RAYCAST BENCHMARK: " << rayCount << " rays on " << gridSize << "x" << gridSize << "\n";
+
+    std::vector<float> heights;
+    float minHeight = 0.f, maxHeight = 0.f;
+    generateTerrainHeights(gridSize, gridSize, hScale, perlinG, heights, minHeight, maxHeight);
+    TerrainHeightQuery query(heights.data(), gridSize, gridSize);
+    TerrainHeightPyramid pyramid;
+    double buildSeconds = benchmarkBestOf(repeats, [&]() { pyramid.build(heights.data(), gridSize, gridSize); });
+    printBenchmarkResult("  pyramid build", buildSeconds, double(gridSize) * gridSize, "heights/s");
+    TerrainRaycaster raycaster(heights.data(), gridSize, gridSize, pyramid);
+
+    std::mt19937 random(19);
+    float half = float(gridSize / 2) - 1.0f;
+    std::uniform_real_distribution<float> position(-half, half), unit(0.0f, 1.0f);
+    const glm::vec3 sunDirection = glm::normalize(glm::vec3(0.6f, 0.15f, 0.3f));
+    auto groundPoint = [&](float lift) {
+        glm::vec3 point(position(random), 0.0f, position(random));
+        point.y = query.heightAt(point) + lift;
+        return point;
+    };
+    std::vector<TerrainRay> rays(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        TerrainRay& ray = rays[i];
+        if (i % 3 == 0) {
+            float angle = unit(random) * 6.2831853f, drop = 0.02f + unit(random);
+            ray.origin = glm::vec3(position(random), maxHeight + 1.0f + 10.0f * unit(random), position(random));
+            ray.direction = glm::vec3(std::cos(angle), -drop, std::sin(angle));
+        }
+        else if (i % 3 == 1) {
+            glm::vec3 from = groundPoint(0.5f + 2.0f * unit(random)), to = groundPoint(0.5f + 2.0f * unit(random));
+            ray.origin = from;
+            ray.direction = to - from;
+            ray.maxDistance = glm::length(to - from);
+        }
+        else {
+            ray.origin = groundPoint(0.05f);
+            ray.direction = sunDirection;
+        }
+    }
+
+    std::vector<TerrainRayHit> marchHits(rayCount), serialHits(rayCount), batchHits(rayCount);
+    double marchSeconds = benchmarkBestOf(repeats, [&]() {
+        for (size_t i = 0; i < rayCount; ++i)
+            marchHits[i] = marchTerrainRayCells(heights, gridSize, gridSize, rays[i]);
+    });
+    double serialSeconds = benchmarkBestOf(repeats, [&]() {
+        for (size_t i = 0; i < rayCount; ++i)
+            serialHits[i] = raycaster.raycast(rays[i]);
+    });
+    double batchSeconds = benchmarkBestOf(repeats, [&]() { raycaster.raycast(rays.data(), batchHits.data(), rayCount); });
+    printBenchmarkResult("  cell march", marchSeconds, double(rayCount), "rays/s");
+    printBenchmarkResult("  pyramid", serialSeconds, double(rayCount), "rays/s");
+    printBenchmarkResult("  pyramid, batched on the pool", batchSeconds, double(rayCount), "rays/s");
+
+    size_t hits = 0, differences = 0, visibilityDifferences = 0;
+    for (size_t i = 0; i < rayCount; ++i) {
+        hits += marchHits[i].hit;
+        for (const TerrainRayHit* other : { &serialHits[i], &batchHits[i] })
+            if (other->hit != marchHits[i].hit || (other->hit && other->distance != marchHits[i].distance))
+                ++differences;
+        if (i % 3 == 1) {
+            TerrainRay lifted = rays[i];
+            lifted.origin.y += TERRAIN_SIGHT_TOLERANCE;
+            if (raycaster.lineOfSight(rays[i].origin, rays[i].origin + rays[i].direction) == marchTerrainRayCells(heights, gridSize, gridSize, lifted).hit)
+                ++visibilityDifferences;
+        }
+    }
+    std::cout << "  " << hits << " of " << rayCount << " rays hit; differences from the march: " << differences
+        << " hits, " << visibilityDifferences << " line-of-sight results\n";
+
+    const size_t groundCount = 1000;
+    size_t upBlocked = 0, groundVisible = 0, groundDifferences = 0;
+    for (size_t i = 0; i < groundCount; ++i) {
+        glm::vec3 from = groundPoint(0.0f), to = groundPoint(0.0f);
+        upBlocked += !raycaster.lineOfSight(from, from + glm::vec3(0.0f, 10.0f, 0.0f));
+        bool visible = raycaster.lineOfSight(from, to);
+        groundVisible += visible;
+        TerrainRay lifted;
+        lifted.origin = from + glm::vec3(0.0f, TERRAIN_SIGHT_TOLERANCE, 0.0f);
+        lifted.direction = to - from;
+        lifted.maxDistance = glm::length(to - from);
+        if (visible == marchTerrainRayCells(heights, gridSize, gridSize, lifted).hit)
+            ++groundDifferences;
+    }
+    std::vector<float> flatHeights((size_t)gridSize * gridSize, 0.0f);
+    TerrainHeightPyramid flatPyramid;
+    flatPyramid.build(flatHeights.data(), gridSize, gridSize);
+    TerrainRaycaster flatRaycaster(flatHeights.data(), gridSize, gridSize, flatPyramid);
+    bool flatVisible = flatRaycaster.lineOfSight(glm::vec3(-half, 0.0f, -half * 0.5f), glm::vec3(half, 0.0f, half * 0.3f));
+    std::cout << "  ground to ground: " << upBlocked << " of " << groundCount << " points blocked looking up, " << groundVisible
+        << " pairs visible, " << groundDifferences << " differences from the march; across a flat grid " << (flatVisible ? "visible" : "BLOCKED") << "\n";
+    return differences == 0 && visibilityDifferences == 0 && upBlocked == 0 && groundDifferences == 0 && flatVisible;
+}
+
+/*Startup of a gridSize^2 terrain with and without the cache, for the heights alone and for the mesh:
+  the first load generates and writes the file, later ones map it. Fails if a mapped load is not
+  byte-identical to generation or a changed parameter is still served from the file.*/
+inline bool runTerrainCacheBenchmark(std::vector<int>& perlinG, int gridSize)
+{
+    const int repeats = 3;
+    const std::string cachePath = "terrain_bench.terrain";
+    std::cout << "TERRAIN CACHE BENCHMARK: " << gridSize << "x" << gridSize << "\n";
+
+    bool passed = true;
+    const unsigned int contentsList[2] = { TERRAIN_CACHE_HEIGHTS, TERRAIN_CACHE_MESH };
+    for (unsigned int contents : contentsList) {
+        bool mesh = contents == TERRAIN_CACHE_MESH;
+        std::string label = mesh ? "mesh" : "heights";
+        TerrainCacheKey key = makeTerrainCacheKey(0, gridSize, gridSize, hScale, MESH_OPTIMIZE_VERTEX_CACHE);
+        std::remove(cachePath.c_str());
+
+        CookedTerrain terrain;
+        BenchmarkTimer cookTimer;
+        bool cooked = terrain.load(cachePath, key, perlinG, contents) && !terrain.fromCache();
+        double cookSeconds = cookTimer.elapsedSeconds();
+        size_t gridBytes = (size_t)gridSize * gridSize * sizeof(float);
+        uint64_t generatedHash = hashTerrainBytes(terrain.heightData(), gridBytes);
+        if (mesh) {
+            generatedHash = hashTerrainBytes(terrain.splatMapData(), gridBytes, generatedHash);
+            generatedHash = hashTerrainBytes(terrain.vertexData(), terrain.vertexCount() * sizeof(Vertex), generatedHash);
+            generatedHash = hashTerrainBytes(terrain.indexData(), terrain.indexCount() * sizeof(unsigned int), generatedHash);
+        }
+        double megabytes = double(gridBytes * (mesh ? 2 : 1) + terrain.vertexCount() * sizeof(Vertex) + terrain.indexCount() * sizeof(unsigned int)) / (1024.0 * 1024.0);
+        printBenchmarkResult("  " + label + ": generate + cook", cookSeconds, megabytes, "MB/s out");
+
+        /*A mapped load touches every page it hands out, like the uploads and the editor's copy do*/
+        bool fromCache = true;
+        uint64_t mappedHash = 0;
+        double mappedSeconds = benchmarkBestOf(repeats, [&]() {
+            terrain.load(cachePath, key, perlinG, contents);
+            fromCache = fromCache && terrain.fromCache();
+            mappedHash = hashTerrainBytes(terrain.heightData(), gridBytes);
+            if (mesh) {
+                mappedHash = hashTerrainBytes(terrain.splatMapData(), gridBytes, mappedHash);
+                mappedHash = hashTerrainBytes(terrain.vertexData(), terrain.vertexCount() * sizeof(Vertex), mappedHash);
+                mappedHash = hashTerrainBytes(terrain.indexData(), terrain.indexCount() * sizeof(unsigned int), mappedHash);
+            }
+        });
+        printBenchmarkResult("  " + label + ": mapped cache", mappedSeconds, megabytes, "MB/s out");
+
+        TerrainCacheKey changedKey = key;
+        changedKey.heightScale *= 2.0f;
+        bool invalidated = terrain.load(cachePath, changedKey, perlinG, contents) && !terrain.fromCache();
+        terrain.release();
+
+        bool identical = mappedHash == generatedHash;
+        passed &= cooked && fromCache && identical && invalidated;
+        std::cout << "    cooked on first load: " << (cooked ? "yes" : "NO") << ", later loads mapped: " << (fromCache ? "yes" : "NO")
+            << ", identical to generation: " << (identical ? "yes" : "NO") << ", regenerated for a new height scale: "
+            << (invalidated ? "yes" : "NO") << ", speedup " << std::setprecision(2) << cookSeconds / mappedSeconds << "x\n";
+    }
+    std::remove(cachePath.c_str());
+    return passed;
+}
+
+/*Every noise backend at every precision and a few octave counts, on sampleCount terrain-style
+  coordinates in [0, 1), z included for 3D. Errors are against double of the same
+  backend; fails if float leaves PERLIN_FLOAT_TOLERANCE (SIMPLEX_FLOAT_TOLERANCE for simplex) or
+  Fixed16 NOISE_FIXED_TOLERANCE.*/
+inline bool runNoiseBackendBenchmark(std::vector<int>& perlinG, size_t sampleCount)
+{
+    const int repeats = 3;
+    const int octaveCounts[3] = { 1, 5, 8 };
+    std::cout << "NOISE BACKEND BENCHMARK: " << sampleCount << " samples per backend, precision and octave count\n";
+
+    std::mt19937 random(21);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> sampleX(sampleCount), sampleY(sampleCount), sampleZ(sampleCount);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        sampleX[i] = unit(random);
+        sampleY[i] = unit(random);
+        sampleZ[i] = unit(random);
+    }
+    PerlinNoiseTable table = makePerlinNoiseTable(perlinG);
+    const char* basisNames[3] = { "perlin 2D", "simplex 2D", "simplex 3D" };
+
+    bool passed = true;
+    for (int basis = 0; basis < 3; ++basis) {
+        for (int octaves : octaveCounts) {
+            /*One fBm sample of this backend at this precision*/
+            auto fbm = [&](auto precision, size_t i) {
+                using Real = decltype(precision);
+                if (basis == 0)
+                    return fractalBrownianMotion<Real>(sampleX[i], sampleY[i], octaves, 0.5f, perlinG);
+                if (basis == 1)
+                    return simplexFractalBrownianMotion<Real>(sampleX[i], sampleY[i], octaves, 0.5f, perlinG);
+                return simplexFractalBrownianMotion3D<Real>(sampleX[i], sampleY[i], sampleZ[i], octaves, 0.5f, perlinG);
+            };
+            std::string prefix = std::string("  ") + basisNames[basis] + ", " + std::to_string(octaves) + " octaves, ";
+
+            std::vector<float> reference(sampleCount), result(sampleCount);
+            double seconds = benchmarkBestOf(repeats, [&]() {
+                for (size_t i = 0; i < sampleCount; ++i)
+                    reference[i] = fbm(double(), i);
+            });
+            printBenchmarkResult(prefix + "double", seconds, double(sampleCount), "samples/s");
+
+            auto report = [&](const std::string& name, double runSeconds, float tolerance) {
+                float maxError = 0.0f;
+                for (size_t i = 0; i < sampleCount; ++i)
+                    maxError = std::max(maxError, std::abs(result[i] - reference[i]));
+                bool withinTolerance = maxError <= tolerance;
+                passed &= withinTolerance;
+                printBenchmarkResult(prefix + name, runSeconds, double(sampleCount), "samples/s");
+                std::cout << "    max |error| vs double " << std::scientific << std::setprecision(2) << maxError << std::fixed
+                    << (withinTolerance ? "" : " FAIL") << "\n";
+            };
+            seconds = benchmarkBestOf(repeats, [&]() {
+                for (size_t i = 0; i < sampleCount; ++i)
+                    result[i] = fbm(float(), i);
+            });
+            report("float", seconds, basis == 0 ? PERLIN_FLOAT_TOLERANCE : SIMPLEX_FLOAT_TOLERANCE);
+            seconds = benchmarkBestOf(repeats, [&]() {
+                for (size_t i = 0; i < sampleCount; ++i)
+                    result[i] = fbm(Fixed16(), i);
+            });
+            report("fixed 16.16", seconds, NOISE_FIXED_TOLERANCE);
+            if (basis == 0) {
+                seconds = benchmarkBestOf(repeats, [&]() {
+                    fractalBrownianMotionBatch(sampleX.data(), sampleY.data(), result.data(), sampleCount, octaves, 0.5f, table);
+                });
+                report(std::string("float batch ") + simdLevelName(activeSIMDLevel()), seconds, PERLIN_FLOAT_TOLERANCE);
+            }
+        }
+    }
+    return passed;
+}
+
+/*Erosion of a gridSize^2 terrain with relief in proportion to the grid, as steep per cell as the
+  50x50 scene terrain: hydraulic droplets at 1, 2, 4 and pool.size() + 1 threads, then thermal passes
+  at every SIMD level serially and at the best level threaded. Fails if the heights depend on the
+  thread count or a level differs from the scalar pass in any bit, or if an odd number of thermal
+  passes moves the heights to other storage.*/
+inline bool runTerrainErosionBenchmark(std::vector<int>& perlinG, int gridSize)
+{
+    ThreadPool& pool = sharedThreadPool();
+    std::vector<unsigned int> threadCounts = { 1, 2, 4, pool.size() + 1 };
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    size_t cellCount = (size_t)gridSize * gridSize;
+    TerrainErosionSettings settings;
+    settings.droplets = int32_t(cellCount / 4);
+    settings.thermalPasses = 50;
+    settings.seed = 1;
+    std::cout << "TERRAIN EROSION BENCHMARK: " << gridSize << "x" << gridSize << ", " << settings.droplets << " droplets in "
+        << settings.batches << " batches of " << settings.tileSize << "x" << settings.tileSize << " tiles, " << settings.thermalPasses
+        << " thermal passes, " << pool.size() << " pool threads + caller\n";
+
+    std::vector<float> generated;
+    float minHeight = 0.f, maxHeight = 0.f;
+    generateTerrainHeights(gridSize, gridSize, float(gridSize) * 0.1f, perlinG, generated, minHeight, maxHeight);
+
+    bool passed = true;
+    std::vector<float> hydraulic;
+    uint64_t serialHash = 0;
+    double serialSeconds = 0.0;
+    for (unsigned int threadCount : threadCounts) {
+        std::vector<float> heights = generated;
+        BenchmarkTimer timer;
+        hydraulicErosion(heights.data(), gridSize, gridSize, settings, threadCount);
+        double seconds = timer.elapsedSeconds();
+        uint64_t hash = hashTerrainBytes(heights.data(), cellCount * sizeof(float));
+
+        std::string label = std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads");
+        printBenchmarkResult("  hydraulic, " + label, seconds, double(settings.droplets), "droplets/s");
+        if (threadCount == 1) {
+            serialHash = hash;
+            serialSeconds = seconds;
+            hydraulic.swap(heights);
+        }
+        else {
+            bool identical = hash == serialHash;
+            passed &= identical;
+            std::cout << "    speedup " << std::setprecision(2) << serialSeconds / seconds << "x, identical to serial: " << (identical ? "yes" : "NO") << "\n";
+        }
+    }
+
+    double moved = 0.0;
+    for (size_t i = 0; i < cellCount; ++i)
+        moved += std::abs(hydraulic[i] - generated[i]);
+    std::cout << "    mean height change " << std::scientific << std::setprecision(2) << moved / double(cellCount) << std::fixed
+        << " over a relief of " << std::setprecision(1) << maxHeight - minHeight << "\n";
+
+    std::vector<float> scalarHeights;
+    double scalarSeconds = 0.0;
+    double cellPasses = double(cellCount) * settings.thermalPasses;
+    for (int levelIndex = SIMD_SCALAR; levelIndex <= int(activeSIMDLevel()); ++levelIndex) {
+        SIMDLevel level = SIMDLevel(levelIndex);
+        std::vector<float> heights = hydraulic;
+        BenchmarkTimer timer;
+        thermalErosion(heights, gridSize, gridSize, settings, 1, level);
+        double seconds = timer.elapsedSeconds();
+        printBenchmarkResult(std::string("  thermal, 1 thread, ") + simdLevelName(level), seconds, cellPasses, "cells/s");
+        if (level == SIMD_SCALAR) {
+            scalarHeights.swap(heights);
+            scalarSeconds = seconds;
+        }
+        else {
+            bool identical = std::memcmp(heights.data(), scalarHeights.data(), cellCount * sizeof(float)) == 0;
+            passed &= identical;
+            std::cout << "    speedup " << std::setprecision(2) << scalarSeconds / seconds << "x, identical to scalar: " << (identical ? "yes" : "NO") << "\n";
+        }
+    }
+    for (unsigned int threadCount : threadCounts) {
+        if (threadCount == 1)
+            continue;
+        std::vector<float> heights = hydraulic;
+        BenchmarkTimer timer;
+        thermalErosion(heights, gridSize, gridSize, settings, threadCount);
+        double seconds = timer.elapsedSeconds();
+        bool identical = std::memcmp(heights.data(), scalarHeights.data(), cellCount * sizeof(float)) == 0;
+        passed &= identical;
+        printBenchmarkResult(std::string("  thermal, ") + std::to_string(threadCount) + " threads, " + simdLevelName(activeSIMDLevel()), seconds,
+            cellPasses, "cells/s");
+        std::cout << "    identical to serial scalar: " << (identical ? "yes" : "NO") << "\n";
+    }
+
+    /*Thermal erosion only moves material, so the total holds up to float rounding*/
+    double before = 0.0, after = 0.0;
+    for (size_t i = 0; i < cellCount; ++i) {
+        before += hydraulic[i];
+        after += scalarHeights[i];
+    }
+    std::cout << "    thermal mean height change " << std::scientific << std::setprecision(2) << (after - before) / double(cellCount)
+        << std::fixed << std::setprecision(2) << "\n";
+
+    /*The editor erodes its own heights, which the camera's query points into*/
+    bool storageKept = true;
+    for (int32_t passes : { 1, 2, 3 }) {
+        TerrainErosionSettings oddSettings = settings;
+        oddSettings.thermalPasses = passes;
+        std::vector<float> heights = hydraulic;
+        const float* storage = heights.data();
+        thermalErosion(heights, gridSize, gridSize, oddSettings);
+        storageKept &= heights.data() == storage;
+    }
+    passed &= storageKept;
+    std::cout << "    heights keep their storage over 1, 2 and 3 passes: " << (storageKept ? "yes" : "NO") << "\n";
+    return passed;
+}
+
+/*Row-major against 8x8-tiled heights on a gridSize^2 terrain: the conversions both ways, the
+  central-difference normal stencil over the whole grid, queryCount bilinear queries scattered over
+  it, and as many in short walks of one cell per step from scattered starts, the way droplets and
+  placement read the grid, then an editor's tiled copy kept through edits. Fails if a round trip or a
+  tiled result differs from the row-major one in any bit.*/
+inline bool runTiledHeightfieldBenchmark(std::vector<int>& perlinG, int gridSize, size_t queryCount)
+{
+    const int repeats = 3;
+    const int walkSteps = 32;
+    size_t cellCount = (size_t)gridSize * gridSize;
+    std::cout << "TILED HEIGHTFIELD BENCHMARK: " << gridSize << "x" << gridSize << ", " << TILED_HEIGHTFIELD_TILE << "x"
+        << TILED_HEIGHTFIELD_TILE << " tiles, " << queryCount << " queries\n";
+
+    std::vector<float> heights;
+    float minHeight = 0.f, maxHeight = 0.f;
+    generateTerrainHeights(gridSize, gridSize, hScale, perlinG, heights, minHeight, maxHeight);
+
+    bool passed = true;
+    TiledHeightfield tiled;
+    std::vector<float> roundTrip(cellCount);
+    double toTiledSeconds = benchmarkBestOf(repeats, [&]() { tiled.assign(heights.data(), gridSize, gridSize, 1); });
+    double toRowsSeconds = benchmarkBestOf(repeats, [&]() { tiled.copyTo(roundTrip.data(), 1); });
+    bool roundTripIdentical = roundTrip == heights;
+    passed &= roundTripIdentical;
+    std::vector<float>().swap(roundTrip);
+    printBenchmarkResult("  row-major to tiled", toTiledSeconds, double(cellCount), "heights/s");
+    printBenchmarkResult("  tiled to row-major", toRowsSeconds, double(cellCount), "heights/s");
+    std::cout << "    round trip identical: " << (roundTripIdentical ? "yes" : "NO") << "\n";
+
+    ThreadPool& pool = sharedThreadPool();
+    std::vector<glm::vec3> rowNormals(cellCount), tiledNormals(cellCount);
+    for (unsigned int threadCount : { 1u, pool.size() + 1 }) {
+        std::string label = std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads");
+        double rowSeconds = benchmarkBestOf(repeats, [&]() { computeHeightfieldNormals(heights.data(), gridSize, gridSize, rowNormals.data(), threadCount); });
+        double tiledSeconds = benchmarkBestOf(repeats, [&]() { computeHeightfieldNormals(tiled, tiledNormals.data(), threadCount); });
+        bool identical = std::memcmp(rowNormals.data(), tiledNormals.data(), cellCount * sizeof(glm::vec3)) == 0;
+        passed &= identical;
+        printBenchmarkResult("  normals, row-major, " + label, rowSeconds, double(cellCount), "cells/s");
+        printBenchmarkResult("  normals, tiled, " + label, tiledSeconds, double(cellCount), "cells/s");
+        std::cout << "    tiled " << std::setprecision(2) << rowSeconds / tiledSeconds << "x, identical: " << (identical ? "yes" : "NO") << "\n";
+    }
+    std::vector<glm::vec3>().swap(rowNormals);
+    std::vector<glm::vec3>().swap(tiledNormals);
+
+    /*Scattered queries, then walks of walkSteps from queryCount / walkSteps scattered starts, through
+      TerrainHeightQuery over either storage at every SIMD level*/
+    TerrainHeightQuery rowQuery(heights.data(), gridSize, gridSize), tiledQuery(tiled);
+    float half = float(gridSize / 2);
+    std::mt19937 random(23);
+    std::uniform_real_distribution<float> position(-half, half), angle(0.0f, 6.2831853f);
+    std::vector<float> x(queryCount), z(queryCount), walkX(queryCount), walkZ(queryCount);
+    for (size_t i = 0; i < queryCount; ++i) {
+        x[i] = position(random);
+        z[i] = position(random);
+        if (i % walkSteps == 0) {
+            walkX[i] = position(random);
+            walkZ[i] = position(random);
+        }
+        else {
+            float direction = angle(random);
+            walkX[i] = walkX[i - 1] + std::cos(direction);
+            walkZ[i] = walkZ[i - 1] + std::sin(direction);
+        }
+    }
+    auto compareQueries = [&](const std::string& name, const std::vector<float>& queryX, const std::vector<float>& queryZ) {
+        std::vector<float> rowHeights(queryCount), tiledHeights(queryCount);
+        std::vector<glm::vec3> rowNormals(queryCount), tiledNormals(queryCount);
+        for (int levelIndex = SIMD_SCALAR; levelIndex <= int(activeSIMDLevel()); ++levelIndex) {
+            SIMDLevel level = SIMDLevel(levelIndex);
+            double rowSeconds = benchmarkBestOf(repeats, [&]() { rowQuery.sample(queryX.data(), queryZ.data(), rowHeights.data(), rowNormals.data(), queryCount, level); });
+            double tiledSeconds = benchmarkBestOf(repeats, [&]() { tiledQuery.sample(queryX.data(), queryZ.data(), tiledHeights.data(), tiledNormals.data(), queryCount, level); });
+            bool identical = rowHeights == tiledHeights && std::memcmp(rowNormals.data(), tiledNormals.data(), queryCount * sizeof(glm::vec3)) == 0;
+            passed &= identical;
+            printBenchmarkResult("  " + name + ", row-major, " + simdLevelName(level), rowSeconds, double(queryCount), "queries/s");
+            printBenchmarkResult("  " + name + ", tiled, " + simdLevelName(level), tiledSeconds, double(queryCount), "queries/s");
+            std::cout << "    tiled " << std::setprecision(2) << rowSeconds / tiledSeconds << "x, identical: " << (identical ? "yes" : "NO") << "\n";
+        }
+    };
+    compareQueries("scattered queries", x, z);
+    compareQueries("walks of " + std::to_string(walkSteps), walkX, walkZ);
+
+    /*The editor's tiled copy through edits and a rescale: its queries and the frames of imported
+      heights against an editor reading rows, on a grid small enough for a whole Vertex array*/
+    const int editorSize = 513;
+    std::vector<float> editorHeights;
+    float editorMinHeight = 0.f, editorMaxHeight = 0.f;
+    generateTerrainHeights(editorSize, editorSize, hScale, perlinG, editorHeights, editorMinHeight, editorMaxHeight);
+    TerrainEditor rowEditor(editorSize, editorSize, hScale, perlinG, editorHeights, editorMinHeight, editorMaxHeight, 0, TerrainNoiseSettings(),
+        TerrainErosionSettings(), TerrainSplatSettings(), TERRAIN_HEIGHTS_IMPORTED);
+    TerrainEditor tiledEditor(editorSize, editorSize, hScale, perlinG, editorHeights, editorMinHeight, editorMaxHeight, 0, TerrainNoiseSettings(),
+        TerrainErosionSettings(), TerrainSplatSettings(), TERRAIN_HEIGHTS_IMPORTED);
+    tiledEditor.setTiledHeights(true);
+    for (TerrainEditor* editor : { &rowEditor, &tiledEditor }) {
+        editor->applyBrush(TERRAIN_BRUSH_RAISE, glm::vec3(-37.3f, 0.0f, 12.6f), 21.0f, 3.0f);
+        editor->applyBrush(TERRAIN_BRUSH_FLATTEN, glm::vec3(100.1f, 0.0f, -80.4f), 40.0f, 0.5f);
+        editor->applyBrush(TERRAIN_BRUSH_LOWER, glm::vec3(-float(editorSize / 2), 0.0f, -float(editorSize / 2)), 9.0f, 2.0f);
+        editor->setHeightScale(hScale * 1.5f);
+        editor->applyBrush(TERRAIN_BRUSH_RAISE, glm::vec3(3.5f, 0.0f, 3.5f), 6.0f, 1.0f);
+    }
+    size_t editorCells = (size_t)editorSize * editorSize;
+    std::vector<Vertex> rowVertices(editorCells), tiledVertices(editorCells);
+    double rowFrameSeconds = benchmarkBestOf(repeats, [&]() { rowEditor.buildVertices(rowEditor.bounds(), rowVertices.data()); });
+    double tiledFrameSeconds = benchmarkBestOf(repeats, [&]() { tiledEditor.buildVertices(tiledEditor.bounds(), tiledVertices.data()); });
+    bool framesIdentical = std::memcmp(rowVertices.data(), tiledVertices.data(), editorCells * sizeof(Vertex)) == 0;
+    TerrainRect strokeRect{ 140, 200, 231, 263 };
+    std::vector<Vertex> rowStroke(strokeRect.area()), tiledStroke(strokeRect.area());
+    rowEditor.buildVertices(strokeRect, rowStroke.data());
+    tiledEditor.buildVertices(strokeRect, tiledStroke.data());
+    framesIdentical &= std::memcmp(rowStroke.data(), tiledStroke.data(), strokeRect.area() * sizeof(Vertex)) == 0;
+    size_t editorQueries = std::min(queryCount, editorCells);
+    std::vector<float> rowEditorHeights(editorQueries), tiledEditorHeights(editorQueries);
+    std::vector<glm::vec3> rowEditorNormals(editorQueries), tiledEditorNormals(editorQueries);
+    std::vector<float> editorX(editorQueries), editorZ(editorQueries);
+    std::uniform_real_distribution<float> editorPosition(-float(editorSize / 2) - 2.0f, float(editorSize / 2) + 2.0f);
+    for (size_t i = 0; i < editorQueries; ++i) {
+        editorX[i] = editorPosition(random);
+        editorZ[i] = editorPosition(random);
+    }
+    rowEditor.query().sample(editorX.data(), editorZ.data(), rowEditorHeights.data(), rowEditorNormals.data(), editorQueries);
+    tiledEditor.query().sample(editorX.data(), editorZ.data(), tiledEditorHeights.data(), tiledEditorNormals.data(), editorQueries);
+    bool editorQueriesIdentical = rowEditorHeights == tiledEditorHeights
+        && std::memcmp(rowEditorNormals.data(), tiledEditorNormals.data(), editorQueries * sizeof(glm::vec3)) == 0;
+    passed &= framesIdentical && editorQueriesIdentical;
+    printBenchmarkResult("  editor frames, imported, row-major", rowFrameSeconds, double(editorCells), "vertices/s");
+    printBenchmarkResult("  editor frames, imported, tiled", tiledFrameSeconds, double(editorCells), "vertices/s");
+    std::cout << "    tiled " << std::setprecision(2) << rowFrameSeconds / tiledFrameSeconds << "x, frames identical after edits: "
+        << (framesIdentical ? "yes" : "NO") << ", queries identical: " << (editorQueriesIdentical ? "yes" : "NO") << "\n";
+    return passed;
+}
+
+/*A gridSize^2 terrain written as little- and big-endian RAW and as PGM, then streamed back a band of
+  HEIGHTMAP_BAND_ROWS rows at a time into vertices and splat texels. Fails if a file's samples are not
+  exactly the quantized heights, the banded rebuild or a height read off the mapped file differs in
+  any bit from the editor's over the same heights, or a RAW file of the wrong size is read. Peak memory
+  is the band's against a whole Vertex array and splat map.*/
+inline bool runHeightmapBenchmark(std::vector<int>& perlinG, int gridSize)
+{
+    const int repeats = 3;
+    size_t cellCount = (size_t)gridSize * gridSize;
+    std::cout << "HEIGHTMAP BENCHMARK: " << gridSize << "x" << gridSize << ", " << HEIGHTMAP_BAND_ROWS << "-row bands\n";
+
+    std::vector<float> heights;
+    float minHeight = 0.f, maxHeight = 0.f;
+    generateTerrainHeights(gridSize, gridSize, hScale, perlinG, heights, minHeight, maxHeight);
+    TerrainHeightfield field;
+    quantizeTerrainHeightfield(heights, gridSize, gridSize, minHeight, maxHeight, field);
+
+    /*The editor's rebuild of the heights the files decode to*/
+    std::vector<float> decoded(cellCount);
+    for (size_t i = 0; i < cellCount; ++i)
+        decoded[i] = decodeHeightmapSample(field.samples[i], minHeight, maxHeight);
+    TerrainEditor editor(gridSize, gridSize, hScale, perlinG, std::move(decoded), minHeight, maxHeight, 0, TerrainNoiseSettings(),
+        TerrainErosionSettings(), TerrainSplatSettings(), TERRAIN_HEIGHTS_IMPORTED);
+    std::vector<Vertex> vertices(cellCount);
+    std::vector<uint32_t> splatTexels(cellCount);
+    editor.buildVertices(editor.bounds(), vertices.data());
+    editor.buildSplatTexels(editor.bounds(), splatTexels.data());
+    uint64_t fullVertexHash = hashTerrainBytes(vertices.data(), cellCount * sizeof(Vertex));
+    uint64_t fullSplatHash = hashTerrainBytes(splatTexels.data(), cellCount * sizeof(uint32_t));
+    std::vector<Vertex>().swap(vertices);
+    std::vector<uint32_t>().swap(splatTexels);
+
+    bool passed = true;
+    double megabytes = double(cellCount * sizeof(uint16_t)) / (1024.0 * 1024.0);
+    const HeightmapFormat formats[3] = { HEIGHTMAP_RAW16_LITTLE_ENDIAN, HEIGHTMAP_RAW16_BIG_ENDIAN, HEIGHTMAP_PGM };
+    const char* labels[3] = { "RAW little-endian", "RAW big-endian", "PGM" };
+    for (int f = 0; f < 3; ++f) {
+        const std::string path = formats[f] == HEIGHTMAP_PGM ? "heightmap_bench.pgm" : "heightmap_bench.raw";
+        bool written = true;
+        double writeSeconds = benchmarkBestOf(repeats, [&]() {
+            written = written && writeTerrainHeightmap(path, formats[f], heights.data(), gridSize, gridSize, minHeight, maxHeight);
+        });
+
+        HeightmapReader reader;
+        bool opened = reader.open(path, formats[f]) && reader.gridWidth() == gridSize && reader.gridHeight() == gridSize;
+        bool samplesIdentical = opened;
+        double readSeconds = 0.0;
+        if (opened) {
+            readSeconds = benchmarkBestOf(repeats, [&]() {
+                reader.forEachBand(HEIGHTMAP_BAND_ROWS, [&](int firstRow, int rowCount, const uint16_t* samples) {
+                    samplesIdentical = samplesIdentical && std::memcmp(samples, field.samples.data() + (size_t)firstRow * gridSize,
+                        (size_t)rowCount * gridSize * sizeof(uint16_t)) == 0;
+                });
+            });
+        }
+        printBenchmarkResult("  " + std::string(labels[f]) + ": write", writeSeconds, megabytes, "MB/s");
+        printBenchmarkResult("  " + std::string(labels[f]) + ": banded read", readSeconds, megabytes, "MB/s");
+
+        /*FNV-1a carried across the bands hashes the rows as one block*/
+        uint64_t vertexHash = 0, splatHash = 0;
+        double buildSeconds = 0.0;
+        if (opened) {
+            buildSeconds = benchmarkBestOf(repeats, [&]() {
+                vertexHash = hashTerrainBytes(nullptr, 0);
+                splatHash = hashTerrainBytes(nullptr, 0);
+                buildHeightmapTerrainBands(reader, minHeight, maxHeight, TerrainSplatSettings(), HEIGHTMAP_BAND_ROWS,
+                    [&](int, int rowCount, const Vertex* bandVertices, const uint32_t* bandSplat) {
+                        vertexHash = hashTerrainBytes(bandVertices, (size_t)rowCount * gridSize * sizeof(Vertex), vertexHash);
+                        splatHash = hashTerrainBytes(bandSplat, (size_t)rowCount * gridSize * sizeof(uint32_t), splatHash);
+                    });
+            });
+        }
+        /*Heights straight from the mapped file, as the camera reads a map too large to edit*/
+        bool queriesIdentical = opened;
+        TerrainHeightQuery query = editor.query();
+        std::mt19937 random(29);
+        std::uniform_real_distribution<float> position(-float(gridSize / 2) - 2.0f, float(gridSize / 2) + 2.0f);
+        for (int i = 0; i < 10000 && opened; ++i) {
+            glm::vec3 point(position(random), 0.0f, position(random));
+            queriesIdentical &= reader.heightAt(point.x + float(gridSize / 2), point.z + float(gridSize / 2), minHeight, maxHeight) == query.heightAt(point);
+        }
+        reader.close();
+        std::remove(path.c_str());
+        bool meshIdentical = opened && vertexHash == fullVertexHash && splatHash == fullSplatHash;
+        printBenchmarkResult("  " + std::string(labels[f]) + ": banded mesh", buildSeconds, double(cellCount), "cells/s");
+        passed &= written && opened && samplesIdentical && meshIdentical && queriesIdentical;
+        std::cout << "    written: " << (written ? "yes" : "NO") << ", samples identical: " << (samplesIdentical ? "yes" : "NO")
+            << ", vertices and splat identical to the full rebuild: " << (meshIdentical ? "yes" : "NO")
+            << ", file queries identical: " << (queriesIdentical ? "yes" : "NO") << "\n";
+    }
+
+    /*RAW sizes: an odd byte count and a sample count that is no square are refused unless a size is
+      given that fits them*/
+    auto writeRaw = [](const std::string& path, size_t byteCount) {
+        std::vector<unsigned char> bytes(byteCount, 0x5a);
+        FILE* file = std::fopen(path.c_str(), "wb");
+        bool written = file && std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        if (file)
+            std::fclose(file);
+        return written;
+    };
+    const std::string rawPath = "heightmap_bench_size.raw";
+    HeightmapReader sizeReader;
+    bool oddRefused = writeRaw(rawPath, (size_t)gridSize * gridSize * 2 + 1) && !sizeReader.open(rawPath);
+    bool oddSizedRefused = !sizeReader.open(rawPath, gridSize, gridSize);
+    bool oblongRefused = writeRaw(rawPath, (size_t)gridSize * (gridSize + 1) * 2) && !sizeReader.open(rawPath);
+    bool oblongSized = sizeReader.open(rawPath, gridSize + 1, gridSize) && sizeReader.gridWidth() == gridSize + 1 && sizeReader.gridHeight() == gridSize;
+    sizeReader.close();
+    std::remove(rawPath.c_str());
+    bool sizesChecked = oddRefused && oddSizedRefused && oblongRefused && oblongSized;
+    passed &= sizesChecked;
+    std::cout << "  RAW " << gridSize << "x" << gridSize << " plus a byte refused: " << (oddRefused && oddSizedRefused ? "yes" : "NO") << ", "
+        << gridSize << "x" << gridSize + 1 << " refused as a square and read when sized: " << (oblongRefused && oblongSized ? "yes" : "NO") << "\n";
+
+    /*The band's samples and decoded heights with their apron rows, its vertices and its splat texels*/
+    size_t bandRows = (size_t)std::min(HEIGHTMAP_BAND_ROWS, gridSize);
+    double bandMegabytes = double((bandRows + 2) * gridSize * (sizeof(uint16_t) + sizeof(float)) + bandRows * gridSize * (sizeof(Vertex) + sizeof(uint32_t)))
+        / (1024.0 * 1024.0);
+    double fullMegabytes = double(cellCount * (sizeof(Vertex) + sizeof(uint32_t))) / (1024.0 * 1024.0);
+    std::cout << "  peak memory " << std::setprecision(1) << bandMegabytes << " MB banded against " << fullMegabytes
+        << " MB for the whole Vertex array and splat map\n" << std::setprecision(2);
+    return passed;
+}
+
+/*Splat maps of a gridSize^2 terrain at every SIMD level serially and at the best level threaded,
+  each layer's mean weight, and the second material set's weight with the slope and curvature layers
+  off against the normalized height the float blend map held. Fails if a level or thread count
+  differs from the serial scalar map in any bit, or that weight strays past a quantization step.*/
+inline bool runTerrainSplatBenchmark(std::vector<int>& perlinG, int gridSize)
+{
+    const int repeats = 3;
+    size_t cellCount = (size_t)gridSize * gridSize;
+    std::cout << "TERRAIN SPLAT BENCHMARK: " << gridSize << "x" << gridSize << ", " << TERRAIN_SPLAT_LAYERS << " layers\n";
+
+    std::vector<float> heights;
+    float minHeight = 0.f, maxHeight = 0.f;
+    generateTerrainHeights(gridSize, gridSize, hScale, perlinG, heights, minHeight, maxHeight);
+    TerrainSplatSettings settings;
+
+    bool passed = true;
+    std::vector<uint32_t> scalarTexels, texels;
+    double scalarSeconds = 0.0;
+    for (int levelIndex = SIMD_SCALAR; levelIndex <= int(activeSIMDLevel()); ++levelIndex) {
+        SIMDLevel level = SIMDLevel(levelIndex);
+        double seconds = benchmarkBestOf(repeats, [&]() {
+            generateTerrainSplatMap(heights.data(), gridSize, gridSize, minHeight, maxHeight, settings, texels, 1, level);
+        });
+        printBenchmarkResult(std::string("  1 thread, ") + simdLevelName(level), seconds, double(cellCount), "texels/s");
+        if (level == SIMD_SCALAR) {
+            scalarTexels.swap(texels);
+            scalarSeconds = seconds;
+        }
+        else {
+            bool identical = texels == scalarTexels;
+            passed &= identical;
+            std::cout << "    speedup " << std::setprecision(2) << scalarSeconds / seconds << "x, identical to scalar: " << (identical ? "yes" : "NO") << "\n";
+        }
+    }
+    unsigned int threadCount = sharedThreadPool().size() + 1;
+    double threadedSeconds = benchmarkBestOf(repeats, [&]() {
+        generateTerrainSplatMap(heights.data(), gridSize, gridSize, minHeight, maxHeight, settings, texels, threadCount);
+    });
+    bool threadedIdentical = texels == scalarTexels;
+    passed &= threadedIdentical;
+    printBenchmarkResult("  " + std::to_string(threadCount) + " threads, " + simdLevelName(activeSIMDLevel()), threadedSeconds, double(cellCount), "texels/s");
+    std::cout << "    speedup " << std::setprecision(2) << scalarSeconds / threadedSeconds << "x, identical to serial scalar: "
+        << (threadedIdentical ? "yes" : "NO") << "\n";
+
+    double layerSums[TERRAIN_SPLAT_LAYERS] = {};
+    for (uint32_t texel : scalarTexels)
+        for (int layer = 0; layer < TERRAIN_SPLAT_LAYERS; ++layer)
+            layerSums[layer] += double((texel >> (layer * 8)) & 0xFF) / 255.0;
+    std::cout << "  mean weight: low " << std::setprecision(3) << layerSums[0] / double(cellCount) << ", high " << layerSums[1] / double(cellCount)
+        << ", steep " << layerSums[2] / double(cellCount) << ", hollow " << layerSums[3] / double(cellCount) << "\n";
+
+    /*Height layers alone: the shader's second-set weight is the old blend factor*/
+    TerrainSplatSettings heightOnly;
+    heightOnly.slopeEnd = heightOnly.slopeStart;
+    heightOnly.curvatureEnd = heightOnly.curvatureStart;
+    generateTerrainSplatMap(heights.data(), gridSize, gridSize, minHeight, maxHeight, heightOnly, texels);
+    float maxBlendError = 0.f;
+    for (size_t i = 0; i < cellCount; ++i) {
+        float low = float(texels[i] & 0xFF), high = float((texels[i] >> 8) & 0xFF);
+        float blend = std::max(0.f, std::min(1.f, (heights[i] - minHeight) / (maxHeight - minHeight)));
+        maxBlendError = std::max(maxBlendError, std::fabs(high / std::max(low + high, 1e-4f) - blend));
+    }
+    bool blendClose = maxBlendError <= 1.0f / 255.0f;
+    passed &= blendClose;
+    std::cout << "  height layers against the float blend map: worst difference " << std::setprecision(4) << maxBlendError
+        << (blendClose ? " (within a step)" : " TOO LARGE") << "\n";
+    std::cout << "  texture bytes: " << cellCount * sizeof(uint32_t) << " for " << TERRAIN_SPLAT_LAYERS << " layers, against "
+        << cellCount * sizeof(float) << " for the 1-layer float blend map and " << cellCount * sizeof(float) * TERRAIN_SPLAT_LAYERS
+        << " for " << TERRAIN_SPLAT_LAYERS << " float layers\n";
+    return passed;
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "PerlinHelper.h"
+#include "TerrainHeightfield.h"
+#include "TerrainSplatMap.h"
+
+/*-----------COOKED TERRAIN FILE----------*/
+/*The single terrain's generated arrays, keyed by everything that generates them, so a run with the
+  same parameters maps them instead of running the noise again.
+  Layout: TerrainCacheHeader, width * height float heights, then with TERRAIN_CACHE_MESH the
+  width * height RGBA8 splat map, width * height Vertex records and indexCount 32-bit indices, all
+  stored exactly as uploaded.*/
+const uint32_t TERRAIN_CACHE_MAGIC = 0x52524554u; /*"TERR"*/
+/*Bump whenever the generator's output changes for the same key*/
+const uint32_t TERRAIN_CACHE_VERSION = 4;
+
+enum TerrainCacheContents
+{
+    TERRAIN_CACHE_HEIGHTS = 0,
+    TERRAIN_CACHE_MESH = 1  /*splat map, vertices and indices as well*/
+};
+
+/*Every generation parameter; a cache serves a load only when all of them match*/
+struct TerrainCacheKey
+{
+    int32_t seed;
+    uint32_t perlinSize;
+    int32_t width;
+    int32_t height;
+    float heightScale;
+    int32_t octaves;
+    float persistence;
+    uint32_t meshOptimizeFlags; /*MeshOptimizeFlags run on the mesh before it is stored*/
+    uint32_t noiseBasis;        /*NoiseBasis*/
+    uint32_t noisePrecision;    /*NoisePrecision*/
+    TerrainErosionSettings erosion;
+    TerrainSplatSettings splat;
+};
+static_assert(sizeof(TerrainCacheKey) == 120, "TerrainCacheKey is hashed as bytes and must have no padding");
+
+inline TerrainCacheKey makeTerrainCacheKey(int seed, int width, int height, float heightScale, unsigned int meshOptimizeFlags,
+    TerrainNoiseSettings noise = TerrainNoiseSettings(), TerrainErosionSettings erosion = TerrainErosionSettings(),
+    TerrainSplatSettings splat = TerrainSplatSettings())
+{
+    TerrainCacheKey key;
+    key.seed = seed;
+    key.perlinSize = PERLIN_SIZE;
+    key.width = width;
+    key.height = height;
+    key.heightScale = heightScale;
+    key.octaves = TERRAIN_FBM_OCTAVES;
+    key.persistence = TERRAIN_FBM_PERSISTENCE;
+    key.meshOptimizeFlags = meshOptimizeFlags;
+    key.noiseBasis = noise.basis;
+    key.noisePrecision = noise.precision;
+    key.erosion = erosion;
+    key.splat = splat;
+    return key;
+}
+
+inline uint64_t hashTerrainCacheKey(const TerrainCacheKey& key)
+{
+    return hashMeshSource(reinterpret_cast<const char*>(&key), sizeof(key));
+}
+
+struct TerrainCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t contents;      /*TerrainCacheContents*/
+    uint64_t keyHash;
+    uint64_t indexCount;
+    TerrainCacheKey key;
+    float minHeight;
+    float maxHeight;
+};
+static_assert(sizeof(TerrainCacheHeader) == 160, "TerrainCacheHeader must stay tightly packed");
+
+/*Through a temporary file like writeMeshCache, so a failed write never leaves a half file behind*/
+inline bool writeTerrainCache(const std::string& cachePath, const TerrainCacheHeader& header, const float* heights, const uint32_t* splatMap,
+    const Vertex* vertices, const unsigned int* indices)
+{
+    std::string tempPath = cachePath + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    size_t gridSize = (size_t)header.key.width * header.key.height;
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (written)
+        written = std::fwrite(heights, sizeof(float), gridSize, file) == gridSize;
+    if (written && (header.contents & TERRAIN_CACHE_MESH)) {
+        written = std::fwrite(splatMap, sizeof(uint32_t), gridSize, file) == gridSize &&
+            std::fwrite(vertices, sizeof(Vertex), gridSize, file) == gridSize &&
+            std::fwrite(indices, sizeof(unsigned int), size_t(header.indexCount), file) == header.indexCount;
+    }
+    written = std::fclose(file) == 0 && written;
+
+    std::remove(cachePath.c_str());
+    if (!written || std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*The single terrain's heights, and optionally its mesh and splat map, either mapped from the cache
+  or generated (and cooked for next time) when the cache is missing, from other parameters, or
+  without the mesh this load asks for. A cache with the mesh also serves heights-only loads.*/
+class CookedTerrain
+{
+public:
+    /*perlinG must be the permutation perlinNoiseInit gives key.seed. The mesh has the vertex-cache
+      order from key.meshOptimizeFlags' MESH_OPTIMIZE_VERTEX_CACHE only: the editor and the height
+      queries rely on the row-major vertex layout.*/
+    bool load(const std::string& cachePath, const TerrainCacheKey& key, std::vector<int>& perlinG, unsigned int contents)
+    {
+        release();
+        if (key.width < 2 || key.height < 2)
+            return false;
+        if (openCache(cachePath, key, contents))
+            return true;
+
+        int width = key.width, height = key.height;
+        float heightScale = key.heightScale;
+        TerrainNoiseSettings noise;
+        noise.basis = NoiseBasis(key.noiseBasis);
+        noise.precision = NoisePrecision(key.noisePrecision);
+        if (contents & TERRAIN_CACHE_MESH) {
+            generateTerrainVerticesIndices(width, height, heightScale, generatedVertices, generatedIndices, perlinG, minHeight, maxHeight, 0, noise, key.erosion);
+            optimizeMesh(generatedVertices, generatedIndices, key.meshOptimizeFlags & MESH_OPTIMIZE_VERTEX_CACHE, "terrain");
+            generatedHeights.resize(generatedVertices.size());
+            for (size_t i = 0; i < generatedVertices.size(); ++i)
+                generatedHeights[i] = generatedVertices[i].vPos.y;
+            generateTerrainSplatMap(generatedHeights.data(), width, height, minHeight, maxHeight, key.splat, generatedSplatMap);
+        }
+        else {
+            generateTerrainHeights(width, height, heightScale, perlinG, generatedHeights, minHeight, maxHeight, 0, noise, key.erosion);
+        }
+        heights = generatedHeights.data();
+        splatMap = generatedSplatMap.empty() ? nullptr : generatedSplatMap.data();
+        vertices = generatedVertices.empty() ? nullptr : generatedVertices.data();
+        indices = generatedIndices.empty() ? nullptr : generatedIndices.data();
+        numVertices = generatedVertices.size();
+        numIndices = generatedIndices.size();
+        gridWidth = width;
+        gridHeight = height;
+
+        TerrainCacheHeader header = makeHeader(key, contents);
+        if (!writeTerrainCache(cachePath, header, heights, splatMap, vertices, indices))
+            std::cout << "TERRAIN CACHE: unable to write " << cachePath << std::endl;
+        return true;
+    }
+
+    /*Drop the mapping or generated arrays, e.g. once they are uploaded and copied to the editor*/
+    void release()
+    {
+        cacheFile.close();
+        generatedHeights = std::vector<float>();
+        generatedSplatMap = std::vector<uint32_t>();
+        generatedVertices = std::vector<Vertex>();
+        generatedIndices = std::vector<unsigned int>();
+        heights = nullptr;
+        splatMap = nullptr;
+        vertices = nullptr;
+        indices = nullptr;
+        numVertices = 0;
+        numIndices = 0;
+        gridWidth = 0;
+        gridHeight = 0;
+        minHeight = 0.0f;
+        maxHeight = 0.0f;
+        cached = false;
+    }
+
+    /*Row-major width x height*/
+    const float* heightData() const { return heights; }
+    /*Null unless loaded with TERRAIN_CACHE_MESH; height layers over [getMinHeight(), getMaxHeight()]*/
+    const uint32_t* splatMapData() const { return splatMap; }
+    const Vertex* vertexData() const { return vertices; }
+    size_t vertexCount() const { return numVertices; }
+    const unsigned int* indexData() const { return indices; }
+    size_t indexCount() const { return numIndices; }
+    int width() const { return gridWidth; }
+    int height() const { return gridHeight; }
+    float getMinHeight() const { return minHeight; }
+    float getMaxHeight() const { return maxHeight; }
+
+    /*True when the data came from the cooked file rather than the generator*/
+    bool fromCache() const { return cached; }
+
+private:
+    MappedFile cacheFile;
+    std::vector<float> generatedHeights;
+    std::vector<uint32_t> generatedSplatMap;
+    std::vector<Vertex> generatedVertices;
+    std::vector<unsigned int> generatedIndices;
+    const float* heights = nullptr;
+    const uint32_t* splatMap = nullptr;
+    const Vertex* vertices = nullptr;
+    const unsigned int* indices = nullptr;
+    size_t numVertices = 0;
+    size_t numIndices = 0;
+    int gridWidth = 0;
+    int gridHeight = 0;
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+    bool cached = false;
+
+    bool openCache(const std::string& cachePath, const TerrainCacheKey& key, unsigned int contents)
+    {
+        if (!cacheFile.open(cachePath))
+            return false;
+
+        TerrainCacheHeader header;
+        if (cacheFile.size() < sizeof(header)) {
+            cacheFile.close();
+            return false;
+        }
+        std::memcpy(&header, cacheFile.data(), sizeof(header));
+
+        size_t gridSize = (size_t)key.width * key.height;
+        bool hasMesh = (header.contents & TERRAIN_CACHE_MESH) != 0;
+        bool valid = header.magic == TERRAIN_CACHE_MAGIC && header.version == TERRAIN_CACHE_VERSION &&
+            header.vertexStride == sizeof(Vertex) && header.keyHash == hashTerrainCacheKey(key) &&
+            std::memcmp(&header.key, &key, sizeof(key)) == 0 && (hasMesh || !(contents & TERRAIN_CACHE_MESH)) &&
+            cacheFile.size() == sizeof(header) + gridSize * sizeof(float) +
+            (hasMesh ? gridSize * (sizeof(uint32_t) + sizeof(Vertex)) + header.indexCount * sizeof(unsigned int) : 0);
+        if (!valid) {
+            cacheFile.close();
+            return false;
+        }
+
+        const char* payload = cacheFile.data() + sizeof(header);
+        heights = reinterpret_cast<const float*>(payload);
+        if (contents & TERRAIN_CACHE_MESH) {
+            splatMap = reinterpret_cast<const uint32_t*>(heights + gridSize);
+            vertices = reinterpret_cast<const Vertex*>(splatMap + gridSize);
+            indices = reinterpret_cast<const unsigned int*>(vertices + gridSize);
+            numVertices = gridSize;
+            numIndices = size_t(header.indexCount);
+        }
+        gridWidth = key.width;
+        gridHeight = key.height;
+        minHeight = header.minHeight;
+        maxHeight = header.maxHeight;
+        cached = true;
+        return true;
+    }
+
+    TerrainCacheHeader makeHeader(const TerrainCacheKey& key, unsigned int contents) const
+    {
+        TerrainCacheHeader header;
+        header.magic = TERRAIN_CACHE_MAGIC;
+        header.version = TERRAIN_CACHE_VERSION;
+        header.vertexStride = sizeof(Vertex);
+        header.contents = contents & TERRAIN_CACHE_MESH;
+        header.keyHash = hashTerrainCacheKey(key);
+        header.indexCount = numIndices;
+        header.key = key;
+        header.minHeight = minHeight;
+        header.maxHeight = maxHeight;
+        return header;
+    }
+};
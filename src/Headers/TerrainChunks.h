@@ -0,0 +1,581 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <future>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "Vertex.h"
+#include "PackedVertex.h"
+#include "MeshHandle.h"
+#include "MeshOptimizer.h"
+#include "PerlinHelper.h"
+#include "PerlinSIMD.h"
+#include "TerrainLOD.h"
+#include "ThreadPool.h"
+#include "VAO.h"
+#include "VBO.h"
+#include "EBO.h"
+
+/*Streaming terrain: fixed-size tiles of the fBm height field generated around the camera on the
+  shared pool, kept in a fixed number of slots that are recycled least-recently-used first. Every
+  slot owns its CPU vertex buffers and its VAO/VBO for its whole life, so memory stays flat however
+  far the camera travels; all chunks share one index buffer. Chunks are drawn through a CDLOD
+  quadtree (TerrainLOD.h) when useLOD is set and chunkQuads is a power of two.*/
+
+struct TerrainChunkSettings
+{
+    int chunkQuads{ 64 };                   /*quads per chunk side, (chunkQuads + 1)^2 vertices*/
+    float chunkSize{ 64.0f };               /*world units per chunk side*/
+    int viewRadius{ 4 };                    /*chunks drawn around the camera chunk in x and z*/
+    int cacheSlack{ 24 };                   /*chunks kept cached beyond the (2 * viewRadius + 1)^2 in view*/
+    int maxPendingChunks{ 4 };              /*generation jobs in flight on the pool*/
+    int maxUploadsPerFrame{ 2 };
+    float heightScale{ 5.0f };
+    float noiseFrequency{ 1.0f / 50.0f };   /*fBm sample = (world xz + noiseOffset) * noiseFrequency*/
+    glm::vec2 noiseOffset{ 0.0f };
+    int octaves{ 5 };
+    float persistence{ 0.5f };
+    float texCoordScale{ 4.0f / 50.0f };    /*UVs per world unit*/
+    bool packedVertices{ true };
+    bool useLOD{ true };
+    TerrainLODSettings lod;
+    bool createGPUBuffers{ true };          /*false keeps everything on the CPU, for the headless benchmark*/
+};
+
+struct TerrainChunkKey
+{
+    int x{ 0 };
+    int z{ 0 };
+
+    bool operator==(const TerrainChunkKey& other) const
+    {
+        return x == other.x && z == other.z;
+    }
+};
+
+struct TerrainChunkKeyHash
+{
+    size_t operator()(const TerrainChunkKey& key) const
+    {
+        uint64_t packed = (uint64_t(uint32_t(key.x)) << 32) | uint32_t(key.z);
+        return std::hash<uint64_t>()(packed * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+/*-----------GENERATION----------*/
+/*fBm repeats every 256 lattice cells at every octave, so samples are wrapped into [0, 256) in double
+  before the float evaluation and keep full precision however far from the origin they are*/
+inline float wrapTerrainNoiseSample(double sample)
+{
+    double wrapped = sample - 256.0 * std::floor(sample / 256.0);
+    return float(wrapped < 256.0 ? wrapped : 0.0);
+}
+
+/*Step of the grid the chunk UVs are snapped to: the finest one half floats hold exactly over a
+  chunk's UV range of chunkSize * texCoordScale + 1*/
+inline double terrainChunkTexCoordStep(const TerrainChunkSettings& settings)
+{
+    int exponent = 0;
+    std::frexp(double(settings.chunkSize) * settings.texCoordScale + 1.0, &exponent);
+    return std::ldexp(1.0, exponent - 11);
+}
+
+/*Vertices of chunk (chunkX, chunkZ) in world space. Positions, heights and UVs are derived from the
+  global lattice index, so a vertex on a shared border is bit-identical in both chunks. Normals and
+  tangents come from the analytic fBm gradient at the vertex's own noise sample, so they match across
+  borders too without looking at the neighbours. UVs are shifted by a whole number per chunk, which
+  GL_REPEAT hides, to stay small enough for half floats; they are snapped to terrainChunkTexCoordStep
+  first so the shifted values still pack to the same fraction on both sides of a border.*/
+inline void generateTerrainChunkVertices(const TerrainChunkSettings& settings, const PerlinNoiseTable& table, int chunkX, int chunkZ, std::vector<Vertex>& outVertices)
+{
+    const int side = settings.chunkQuads + 1;
+    const double spacing = double(settings.chunkSize) / settings.chunkQuads;
+
+    /*Scratch per pool thread*/
+    thread_local std::vector<float> sampleX, sampleY, rowHeights, rowSlopeX, rowSlopeZ;
+    sampleX.resize(side);
+    sampleY.resize(side);
+    rowHeights.resize(side);
+    rowSlopeX.resize(side);
+    rowSlopeZ.resize(side);
+
+    const int64_t firstX = int64_t(chunkX) * settings.chunkQuads;
+    const int64_t firstZ = int64_t(chunkZ) * settings.chunkQuads;
+    const double uOrigin = std::floor(double(firstX) * spacing * settings.texCoordScale);
+    const double vOrigin = std::floor(double(firstZ) * spacing * settings.texCoordScale);
+    const double texCoordStep = terrainChunkTexCoordStep(settings);
+
+    /*d(noise sample)/d(world) is noiseFrequency on both axes*/
+    const float slopeScale = settings.heightScale * settings.noiseFrequency;
+
+    for (int x = 0; x < side; ++x)
+        sampleX[x] = wrapTerrainNoiseSample((double(firstX + x) * spacing + settings.noiseOffset.x) * settings.noiseFrequency);
+
+    outVertices.resize((size_t)side * side);
+    for (int z = 0; z < side; ++z) {
+        double worldZ = double(firstZ + z) * spacing;
+        std::fill(sampleY.begin(), sampleY.end(), wrapTerrainNoiseSample((worldZ + settings.noiseOffset.y) * settings.noiseFrequency));
+        fractalBrownianMotionGradientBatch(sampleX.data(), sampleY.data(), rowHeights.data(), rowSlopeX.data(), rowSlopeZ.data(), side,
+            settings.octaves, settings.persistence, table);
+
+        double v = std::round(worldZ * settings.texCoordScale / texCoordStep) * texCoordStep - vOrigin;
+        for (int x = 0; x < side; ++x) {
+            double worldX = double(firstX + x) * spacing;
+            double u = std::round(worldX * settings.texCoordScale / texCoordStep) * texCoordStep - uOrigin;
+            Vertex& vertex = outVertices[(size_t)z * side + x];
+            vertex.vPos = glm::vec3(float(worldX), rowHeights[x] * settings.heightScale, float(worldZ));
+            vertex.vTexCoords = glm::vec2(float(u), float(v));
+            setTerrainFrameFromSlope(rowSlopeX[x] * slopeScale, rowSlopeZ[x] * slopeScale, vertex);
+        }
+    }
+}
+
+/*Height of the streamed surface at world (x, z), resident or not: the four lattice vertices around
+  it as generateTerrainChunkVertices computes them, interpolated like TerrainHeightQuery*/
+inline float terrainChunkHeightAt(const TerrainChunkSettings& settings, const PerlinNoiseTable& table, float worldX, float worldZ)
+{
+    const double spacing = double(settings.chunkSize) / settings.chunkQuads;
+    double gridX = double(worldX) / spacing, gridZ = double(worldZ) / spacing;
+    double cellX = std::floor(gridX), cellZ = std::floor(gridZ);
+    float sampleX[4], sampleY[4], heights[4], slopeX[4], slopeZ[4];
+    for (int corner = 0; corner < 4; ++corner) {
+        sampleX[corner] = wrapTerrainNoiseSample(((cellX + (corner & 1)) * spacing + settings.noiseOffset.x) * settings.noiseFrequency);
+        sampleY[corner] = wrapTerrainNoiseSample(((cellZ + (corner >> 1)) * spacing + settings.noiseOffset.y) * settings.noiseFrequency);
+    }
+    fractalBrownianMotionGradientBatch(sampleX, sampleY, heights, slopeX, slopeZ, 4, settings.octaves, settings.persistence, table);
+
+    float fracX = float(gridX - cellX), fracZ = float(gridZ - cellZ);
+    float top = heights[0] + (heights[1] - heights[0]) * fracX;
+    float bottom = heights[2] + (heights[3] - heights[2]) * fracX;
+    return (top + (bottom - top) * fracZ) * settings.heightScale;
+}
+
+/*Quantization range of a packed chunk. Every chunk spans chunkSize in x and z from its own origin and
+  the fBm's whole [-heightScale, heightScale] in y, so the same height packs to the same code in every
+  chunk and a border vertex decodes to its neighbour's origin plus nothing, or its own origin plus the
+  full extent, which are the same float.*/
+inline VertexDecodeParams computeTerrainChunkDecodeParams(const TerrainChunkSettings& settings, int chunkX, int chunkZ)
+{
+    const double spacing = double(settings.chunkSize) / settings.chunkQuads;
+    const float heightRange = std::max(std::abs(settings.heightScale), 1e-6f);
+    VertexDecodeParams params;
+    params.packed = true;
+    params.positionMin = glm::vec3(float(double(int64_t(chunkX) * settings.chunkQuads) * spacing), -heightRange,
+        float(double(int64_t(chunkZ) * settings.chunkQuads) * spacing));
+    params.positionExtent = glm::vec3(settings.chunkSize, 2.0f * heightRange, settings.chunkSize);
+    return params;
+}
+
+/*-----------CHUNK MANAGER----------*/
+enum TerrainChunkState
+{
+    TERRAIN_CHUNK_FREE,
+    TERRAIN_CHUNK_GENERATING,
+    TERRAIN_CHUNK_READY,
+    TERRAIN_CHUNK_RESIDENT
+};
+
+struct TerrainChunkSlot
+{
+    TerrainChunkKey key;
+    TerrainChunkState state{ TERRAIN_CHUNK_FREE };
+    std::future<void> job;
+    std::list<size_t>::iterator lruPosition;
+
+    /*Written by the job while GENERATING, read by the render thread afterwards*/
+    std::vector<Vertex> vertices;
+    std::vector<PackedVertex> packedVertices;
+    std::vector<float> morphDeltas;
+    std::vector<glm::vec2> nodeBounds;
+    VertexDecodeParams decode;
+
+    /*Created on first upload and reused by every chunk the slot holds afterwards*/
+    std::unique_ptr<VAO> vao;
+    std::unique_ptr<VBO> vbo;
+    std::unique_ptr<VBO> morphVBO;
+    MeshHandle mesh;
+};
+
+class TerrainChunkManager
+{
+public:
+    TerrainChunkManager(const TerrainChunkSettings& inSettings, const std::vector<int>& perlinG)
+        : settings(inSettings), noiseTable(makePerlinNoiseTable(perlinG))
+    {
+        settings.chunkQuads = std::max(1, settings.chunkQuads);
+        settings.viewRadius = std::max(0, settings.viewRadius);
+        settings.maxPendingChunks = std::max(1, settings.maxPendingChunks);
+        settings.maxUploadsPerFrame = std::max(1, settings.maxUploadsPerFrame);
+
+        int side = settings.chunkQuads + 1;
+        generateTerrainGridIndices(side, side, chunkIndices);
+        optimizeVertexCache(chunkIndices, (size_t)side * side);
+
+        /*The LOD patches follow the full-density grid in the shared index buffer*/
+        lodEnabled = settings.useLOD && (settings.chunkQuads & (settings.chunkQuads - 1)) == 0;
+        if (lodEnabled) {
+            lodLayout = TerrainLODLayout(settings.chunkQuads, settings.chunkSize / settings.chunkQuads, settings.lod);
+            lodIndexOffset = chunkIndices.size();
+            chunkIndices.insert(chunkIndices.end(), lodLayout.patchIndices().begin(), lodLayout.patchIndices().end());
+        }
+
+        /*Nearest chunks first, so the ground under the camera streams in before the horizon*/
+        for (int z = -settings.viewRadius; z <= settings.viewRadius; ++z)
+            for (int x = -settings.viewRadius; x <= settings.viewRadius; ++x)
+                viewOffsets.push_back({ x, z });
+        std::stable_sort(viewOffsets.begin(), viewOffsets.end(), [](const TerrainChunkKey& a, const TerrainChunkKey& b) {
+            return a.x * a.x + a.z * a.z < b.x * b.x + b.z * b.z;
+        });
+
+        /*Room for every chunk in view plus the jobs that may still be finishing for chunks left behind*/
+        size_t slotCount = viewOffsets.size() + size_t(std::max(settings.cacheSlack, settings.maxPendingChunks));
+        slots.resize(slotCount);
+        for (size_t slot = slotCount; slot-- > 0;)
+            freeSlots.push_back(slot);
+        chunkSlots.reserve(slotCount * 2);
+    }
+
+    /*Delete copy constructor and copy assignment operators*/
+    TerrainChunkManager(const TerrainChunkManager&) = delete;
+    TerrainChunkManager& operator=(const TerrainChunkManager&) = delete;
+
+    /*Destructor, jobs write into the slots so they have to finish first*/
+    ~TerrainChunkManager()
+    {
+        for (TerrainChunkSlot& slot : slots) {
+            if (slot.job.valid())
+                slot.job.wait();
+        }
+    }
+
+    /*Once per frame: collect finished jobs, upload at most maxUploadsPerFrame of them, and queue the
+      nearest missing chunks around cameraPosition, recycling the least recently used slots*/
+    void update(const glm::vec3& cameraPosition)
+    {
+        center = chunkAt(cameraPosition);
+        lodCenter = cameraPosition;
+
+        for (size_t slot = 0; slot < slots.size(); ++slot) {
+            TerrainChunkSlot& chunk = slots[slot];
+            if (chunk.state == TERRAIN_CHUNK_GENERATING && chunk.job.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                chunk.job.get();
+                chunk.state = TERRAIN_CHUNK_READY;
+                --pendingChunks;
+                ++generatedChunks;
+            }
+        }
+
+        int uploads = 0;
+        for (TerrainChunkSlot& chunk : slots) {
+            if (chunk.state != TERRAIN_CHUNK_READY)
+                continue;
+            if (settings.createGPUBuffers) {
+                if (uploads == settings.maxUploadsPerFrame)
+                    break;
+                uploadChunk(chunk);
+                ++uploads;
+            }
+            chunk.state = TERRAIN_CHUNK_RESIDENT;
+        }
+
+        for (const TerrainChunkKey& offset : viewOffsets) {
+            TerrainChunkKey key{ center.x + offset.x, center.z + offset.z };
+            auto found = chunkSlots.find(key);
+            if (found != chunkSlots.end()) {
+                touch(found->second);
+                continue;
+            }
+            if (pendingChunks >= settings.maxPendingChunks)
+                continue;
+            size_t slot = acquireSlot();
+            if (slot == NO_SLOT)
+                break;
+            startChunk(slot, key);
+        }
+    }
+
+    /*Bind and draw every resident chunk in view that intersects the frustum of viewProj.
+      setupChunk(const MeshHandle&) sets the per-chunk uniforms (vertex decode) on the caller's
+      shader and setupLevel(const TerrainLODMorphParams&) the morph uniforms of the next LOD nodes.
+      LOD distances are measured from the camera position of the last update() in every pass, so
+      the shadow and occlusion passes draw the same surface as the main pass.*/
+    template <typename ChunkFn, typename LevelFn>
+    void draw(const glm::mat4& viewProj, TerrainLODStats& stats, ChunkFn&& setupChunk, LevelFn&& setupLevel) const
+    {
+        TerrainFrustum frustum = makeTerrainFrustum(viewProj);
+        for (const TerrainChunkSlot& chunk : slots) {
+            if (chunk.state != TERRAIN_CHUNK_RESIDENT || !chunk.vao || !inView(chunk.key))
+                continue;
+
+            if (!lodEnabled) {
+                stats.fullTriangles += (size_t)chunk.mesh.indexCount / 3;
+                stats.triangles += (size_t)chunk.mesh.indexCount / 3;
+                ++stats.nodes;
+                chunk.vao->bind();
+                setupChunk(chunk.mesh);
+                drawMeshElements(chunk.mesh);
+                continue;
+            }
+
+            nodeDraws.clear();
+            lodLayout.selectNodes(chunkOrigin(chunk.key), chunk.nodeBounds, lodCenter, frustum, lodIndexOffset, nodeDraws, stats);
+            if (nodeDraws.empty())
+                continue;
+            std::stable_sort(nodeDraws.begin(), nodeDraws.end(), [](const TerrainLODNodeDraw& a, const TerrainLODNodeDraw& b) { return a.level < b.level; });
+
+            chunk.vao->bind();
+            setupChunk(chunk.mesh);
+            int level = -1;
+            for (const TerrainLODNodeDraw& node : nodeDraws) {
+                if (node.level != level) {
+                    level = node.level;
+                    setupLevel(lodLayout.morphParams(level));
+                }
+                drawMeshElements(chunk.mesh, node.indexCount, node.firstIndex, node.baseVertex);
+            }
+        }
+    }
+
+    bool lodActive() const
+    {
+        return lodEnabled;
+    }
+
+    /*Camera position the LOD distances and the vertex shader morph are measured from*/
+    const glm::vec3& lodCenterPosition() const
+    {
+        return lodCenter;
+    }
+
+    /*Height of the streamed surface under position, for collisions anywhere in the endless field*/
+    float heightAt(const glm::vec3& position) const
+    {
+        return terrainChunkHeightAt(settings, noiseTable, position.x, position.z);
+    }
+
+    int chunkGridSide() const
+    {
+        return settings.chunkQuads + 1;
+    }
+
+    TerrainChunkKey chunkAt(const glm::vec3& position) const
+    {
+        return { int(std::floor(position.x / settings.chunkSize)), int(std::floor(position.z / settings.chunkSize)) };
+    }
+
+    bool inView(const TerrainChunkKey& key) const
+    {
+        return std::abs(key.x - center.x) <= settings.viewRadius && std::abs(key.z - center.z) <= settings.viewRadius;
+    }
+
+    size_t slotCount() const
+    {
+        return slots.size();
+    }
+
+    size_t residentChunkCount() const
+    {
+        return size_t(std::count_if(slots.begin(), slots.end(), [](const TerrainChunkSlot& chunk) { return chunk.state == TERRAIN_CHUNK_RESIDENT; }));
+    }
+
+    size_t residentChunksInView() const
+    {
+        return size_t(std::count_if(slots.begin(), slots.end(), [this](const TerrainChunkSlot& chunk) {
+            return chunk.state == TERRAIN_CHUNK_RESIDENT && inView(chunk.key);
+        }));
+    }
+
+    size_t chunksInView() const
+    {
+        return viewOffsets.size();
+    }
+
+    int pendingChunkCount() const
+    {
+        return pendingChunks;
+    }
+
+    size_t generatedChunkCount() const
+    {
+        return generatedChunks;
+    }
+
+    size_t evictedChunkCount() const
+    {
+        return evictedChunks;
+    }
+
+    /*Bytes held by the slot buffers and the index lists; the thread_local row scratch is not counted*/
+    size_t cpuBytes() const
+    {
+        size_t bytes = chunkIndices.capacity() * sizeof(unsigned int);
+        for (const TerrainChunkSlot& chunk : slots) {
+            bytes += chunk.vertices.capacity() * sizeof(Vertex) + chunk.packedVertices.capacity() * sizeof(PackedVertex);
+            bytes += chunk.morphDeltas.capacity() * sizeof(float) + chunk.nodeBounds.capacity() * sizeof(glm::vec2);
+        }
+        return bytes;
+    }
+
+    size_t gpuBytes() const
+    {
+        size_t vertexBytes = chunkVertexCount() * (settings.packedVertices ? sizeof(PackedVertex) : sizeof(Vertex));
+        size_t bytes = indexUploaded ? chunkIndices.size() * indexTypeSize(indexMesh.indexType) : 0;
+        for (const TerrainChunkSlot& chunk : slots)
+            bytes += chunk.vbo ? vertexBytes + (chunk.morphVBO ? chunkVertexCount() * sizeof(float) : 0) : 0;
+        return bytes;
+    }
+
+private:
+    static constexpr size_t NO_SLOT = ~size_t(0);
+
+    TerrainChunkSettings settings;
+    PerlinNoiseTable noiseTable;
+    std::vector<unsigned int> chunkIndices;
+    std::vector<TerrainChunkKey> viewOffsets;
+
+    std::vector<TerrainChunkSlot> slots;
+    std::vector<size_t> freeSlots;
+    std::unordered_map<TerrainChunkKey, size_t, TerrainChunkKeyHash> chunkSlots;
+    std::list<size_t> lru;          /*slots holding a chunk, most recently used first*/
+    TerrainChunkKey center;
+    int pendingChunks{ 0 };
+    size_t generatedChunks{ 0 };
+    size_t evictedChunks{ 0 };
+
+    std::unique_ptr<EBO> indexEBO;
+    MeshHandle indexMesh;
+    bool indexUploaded{ false };
+
+    bool lodEnabled{ false };
+    TerrainLODLayout lodLayout;
+    size_t lodIndexOffset{ 0 };
+    glm::vec3 lodCenter{ 0.0f };
+    mutable std::vector<TerrainLODNodeDraw> nodeDraws;
+
+    glm::vec2 chunkOrigin(const TerrainChunkKey& key) const
+    {
+        double spacing = double(settings.chunkSize) / settings.chunkQuads;
+        return glm::vec2(float(double(int64_t(key.x) * settings.chunkQuads) * spacing), float(double(int64_t(key.z) * settings.chunkQuads) * spacing));
+    }
+
+    size_t chunkVertexCount() const
+    {
+        return size_t(settings.chunkQuads + 1) * size_t(settings.chunkQuads + 1);
+    }
+
+    void touch(size_t slot)
+    {
+        lru.splice(lru.begin(), lru, slots[slot].lruPosition);
+    }
+
+    /*A free slot, otherwise the least recently used chunk that is finished and out of view*/
+    size_t acquireSlot()
+    {
+        if (!freeSlots.empty()) {
+            size_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+            TerrainChunkSlot& chunk = slots[*it];
+            if (chunk.state == TERRAIN_CHUNK_GENERATING || inView(chunk.key))
+                continue;
+            size_t slot = *it;
+            chunkSlots.erase(chunk.key);
+            lru.erase(chunk.lruPosition);
+            chunk.state = TERRAIN_CHUNK_FREE;
+            ++evictedChunks;
+            return slot;
+        }
+        return NO_SLOT;
+    }
+
+    void startChunk(size_t slot, const TerrainChunkKey& key)
+    {
+        TerrainChunkSlot& chunk = slots[slot];
+        chunk.key = key;
+        chunk.state = TERRAIN_CHUNK_GENERATING;
+        chunkSlots[key] = slot;
+        lru.push_front(slot);
+        chunk.lruPosition = lru.begin();
+        ++pendingChunks;
+
+        /*The job only touches its own slot's buffers and state the manager never changes after construction*/
+        chunk.job = sharedThreadPool().submit([this, slot, key]() {
+            TerrainChunkSlot& target = slots[slot];
+            generateTerrainChunkVertices(settings, noiseTable, key.x, key.z, target.vertices);
+            if (settings.packedVertices) {
+                target.decode = computeTerrainChunkDecodeParams(settings, key.x, key.z);
+                target.packedVertices.resize(target.vertices.size());
+                for (size_t i = 0; i < target.vertices.size(); ++i)
+                    target.packedVertices[i] = packVertex(target.vertices[i], target.decode);
+            }
+            else {
+                target.decode = VertexDecodeParams();
+            }
+            if (lodEnabled) {
+                lodLayout.computeMorphDeltas(target.vertices.data(), target.morphDeltas);
+                lodLayout.computeNodeBounds(target.vertices.data(), target.nodeBounds);
+            }
+        });
+    }
+
+    /*The first upload of a slot allocates its VBO at the fixed chunk size and records the attribute
+      layout; later chunks overwrite it with glBufferSubData*/
+    void uploadChunk(TerrainChunkSlot& chunk)
+    {
+        const void* data = settings.packedVertices ? (const void*)chunk.packedVertices.data() : (const void*)chunk.vertices.data();
+        size_t vertexBytes = chunkVertexCount() * (settings.packedVertices ? sizeof(PackedVertex) : sizeof(Vertex));
+
+        if (!chunk.vao) {
+            chunk.vao = std::make_unique<VAO>();
+            chunk.vbo = std::make_unique<VBO>();
+            chunk.vao->bind();
+            chunk.vbo->bind();
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_DYNAMIC_DRAW);
+
+            if (!indexEBO)
+                indexEBO = std::make_unique<EBO>();
+            indexEBO->bind();
+            if (!indexUploaded) {
+                indexMesh = uploadIndexBuffer(chunkIndices.data(), chunkIndices.size(), chunkVertexCount());
+                indexUploaded = true;
+            }
+
+            if (settings.packedVertices)
+                setPackedVertexAttributePointers();
+            else
+                setVertexAttributePointers();
+
+            if (lodEnabled) {
+                chunk.morphVBO = std::make_unique<VBO>();
+                chunk.morphVBO->bind();
+                glBufferData(GL_ARRAY_BUFFER, chunkVertexCount() * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+                glVertexAttribPointer(TERRAIN_MORPH_DELTA_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+                glEnableVertexAttribArray(TERRAIN_MORPH_DELTA_LOCATION);
+            }
+
+            chunk.vao->unbind();
+            chunk.vbo->unbind();
+            indexEBO->unbind();
+        }
+
+        chunk.vbo->bind();
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, data);
+        if (chunk.morphVBO) {
+            chunk.morphVBO->bind();
+            glBufferSubData(GL_ARRAY_BUFFER, 0, chunkVertexCount() * sizeof(float), chunk.morphDeltas.data());
+        }
+        chunk.vbo->unbind();
+
+        chunk.mesh = indexMesh;
+        chunk.mesh.decode = chunk.decode;
+    }
+};
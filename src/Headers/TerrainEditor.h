@@ -0,0 +1,612 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "Vertex.h"
+#include "PackedVertex.h"
+#include "MeshHandle.h"
+#include "PerlinHelper.h"
+#include "PerlinSIMD.h"
+#include "ThreadPool.h"
+#include "VBO.h"
+#include "TerrainHeightfield.h"
+#include "TerrainQuery.h"
+#include "TerrainRaycast.h"
+#include "TerrainSplatMap.h"
+#include "TiledHeightfield.h"
+
+/*Terrain editing: the single terrain's float heights kept on the CPU, brushes and noise regeneration
+  that change them in place, and the grid rectangles they changed. The uploads rebuild only those
+  rectangles and push them with glBufferSubData / glTexSubImage2D, so an edit costs its footprint
+  instead of a regeneration and a re-upload of the whole grid. Rebuilt vertices take the frame the
+  generator gives them, so a stroke leaves no lighting seam around its rectangle; imported heights,
+  which the generator never saw, take central differences, the frame the heightfield shaders rebuild.
+  Optionally the heights are mirrored in 8x8 tiles, and queries and those central differences read the
+  tiles instead of rows.*/
+
+/*Grid cells [x0, x1) x [z0, z1)*/
+struct TerrainRect
+{
+    int x0{ 0 };
+    int z0{ 0 };
+    int x1{ 0 };
+    int z1{ 0 };
+
+    bool empty() const { return x1 <= x0 || z1 <= z0; }
+    int columns() const { return x1 - x0; }
+    int rows() const { return z1 - z0; }
+    size_t area() const { return empty() ? 0 : (size_t)columns() * rows(); }
+};
+
+inline TerrainRect intersectTerrainRects(const TerrainRect& a, const TerrainRect& b)
+{
+    return TerrainRect{ std::max(a.x0, b.x0), std::max(a.z0, b.z0), std::min(a.x1, b.x1), std::min(a.z1, b.z1) };
+}
+
+inline TerrainRect uniteTerrainRects(const TerrainRect& a, const TerrainRect& b)
+{
+    return TerrainRect{ std::min(a.x0, b.x0), std::min(a.z0, b.z0), std::max(a.x1, b.x1), std::max(a.z1, b.z1) };
+}
+
+/*Overlapping or sharing an edge, so their union wastes little*/
+inline bool terrainRectsTouch(const TerrainRect& a, const TerrainRect& b)
+{
+    return a.x0 <= b.x1 && b.x0 <= a.x1 && a.z0 <= b.z1 && b.z0 <= a.z1;
+}
+
+enum TerrainBrushMode
+{
+    TERRAIN_BRUSH_RAISE,
+    TERRAIN_BRUSH_LOWER,
+    TERRAIN_BRUSH_FLATTEN
+};
+
+/*Where the editor's heights came from, which decides how rebuilt vertices get their frames*/
+enum TerrainHeightSource
+{
+    TERRAIN_HEIGHTS_GENERATED,  /*the noise (and erosion) the editor was given, edited or not*/
+    TERRAIN_HEIGHTS_IMPORTED    /*a heightmap; frames from central differences until the noise replaces it*/
+};
+
+/*Everything changed since the last takeEdits: rectangles whose vertices and splat texels must be
+  rebuilt, and the factor every height was multiplied by (setHeightScale), 1 when unchanged*/
+struct TerrainEditBatch
+{
+    std::vector<TerrainRect> rects;
+    float heightRatio{ 1.0f };
+};
+
+/*Vertex (x, z) heights of a row-major generated grid*/
+inline std::vector<float> terrainHeightsFromVertices(const std::vector<Vertex>& vertices)
+{
+    std::vector<float> heights(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+        heights[i] = vertices[i].vPos.y;
+    return heights;
+}
+
+/*Edits smaller than this many cells stay on the calling thread*/
+const size_t TERRAIN_EDIT_PARALLEL_AREA = size_t(1) << 14;
+
+class TerrainEditor
+{
+public:
+    /*Takes the row-major width x height heights generated with heightScale and perlinG, and the
+      range the splat map's height layers span. The blend range stays fixed while editing so an edit
+      only changes its own splat texels; heights past it clamp to low or high ground. threadCount 0
+      uses every pool thread plus the caller, 1 runs serially. noise must be what the heights were
+      generated with, so regenerated rectangles meet the rest seamlessly, erosion how they were
+      eroded and splat what the splat map was built with. source says whether the heights are that
+      noise's at all.*/
+    TerrainEditor(int width, int height, float heightScale, const std::vector<int>& perlinG, std::vector<float> heights,
+        float blendMinHeight, float blendMaxHeight, unsigned int threadCount = 0, TerrainNoiseSettings noise = TerrainNoiseSettings(),
+        TerrainErosionSettings erosion = TerrainErosionSettings(), TerrainSplatSettings splat = TerrainSplatSettings(),
+        TerrainHeightSource source = TERRAIN_HEIGHTS_GENERATED)
+        : width(width), height(height), heightScale(heightScale), noise(perlinG, noise), erosion(erosion), splat(splat), heights(std::move(heights)),
+        blendMinHeight(blendMinHeight), blendMaxHeight(blendMaxHeight), threadCount(threadCount), source(source)
+    {
+        pyramid.build(this->heights.data(), width, height, threadCount);
+    }
+
+    /*Raise or lower by strength at the centre, or pull toward the centre's height by strength (0-1),
+      with a smooth falloff to nothing at radius. center is in terrain space, where vertex (x, z) sits at
+      (x - width/2, z - height/2).*/
+    void applyBrush(TerrainBrushMode mode, const glm::vec3& center, float radius, float strength)
+    {
+        if (radius <= 0.0f)
+            return;
+        float centerX = center.x + float(width / 2);
+        float centerZ = center.z + float(height / 2);
+        TerrainRect rect = intersectTerrainRects(TerrainRect{ int(std::floor(centerX - radius)), int(std::floor(centerZ - radius)),
+            int(std::ceil(centerX + radius)) + 1, int(std::ceil(centerZ + radius)) + 1 }, bounds());
+        if (rect.empty())
+            return;
+
+        float target = query().heightAt(center);
+        float inverseRadiusSquared = 1.0f / (radius * radius);
+        forEachRow(rect, [&](int z) {
+            float* row = heights.data() + (size_t)z * width;
+            float dz = float(z) - centerZ;
+            for (int x = rect.x0; x < rect.x1; ++x) {
+                float dx = float(x) - centerX;
+                float distanceSquared = (dx * dx + dz * dz) * inverseRadiusSquared;
+                if (distanceSquared >= 1.0f)
+                    continue;
+                float falloff = (1.0f - distanceSquared) * (1.0f - distanceSquared);
+                if (mode == TERRAIN_BRUSH_RAISE)
+                    row[x] += strength * falloff;
+                else if (mode == TERRAIN_BRUSH_LOWER)
+                    row[x] -= strength * falloff;
+                else
+                    row[x] += (target - row[x]) * std::min(1.0f, strength * falloff);
+            }
+        });
+        markHeightsChanged(rect);
+    }
+
+    /*Heights of rect back to the noise, discarding its edits. Erosion is a pass over the whole grid:
+      only regenerating all of it erodes again, a smaller rect comes back as the bare noise.*/
+    void regenerateRect(TerrainRect rect)
+    {
+        rect = intersectTerrainRects(rect, bounds());
+        if (rect.empty())
+            return;
+
+        forEachRow(rect, [&](int z) {
+            float* row = heights.data() + (size_t)z * width;
+            /*Same samples as sampleTerrainHeightRow takes for these columns*/
+            std::vector<float> sampleX(rect.columns()), sampleY(rect.columns());
+            for (int x = rect.x0; x < rect.x1; ++x)
+                sampleX[x - rect.x0] = x / (float)width;
+            noise.sampleRow(sampleX.data(), z / (float)height, sampleY.data(), row + rect.x0, rect.columns());
+            for (int x = rect.x0; x < rect.x1; ++x)
+                row[x] *= heightScale;
+        });
+        if (rect.columns() == width && rect.rows() == height) {
+            if (erosion.enabled())
+                erodeTerrainHeights(heights, width, height, erosion, threadCount);
+            source = TERRAIN_HEIGHTS_GENERATED;
+        }
+        markHeightsChanged(rect);
+    }
+
+    /*A new permutation: the whole grid is regenerated, edits included, and the blend range refit
+      the way the generator sets it*/
+    void setNoise(const std::vector<int>& newPerlinG)
+    {
+        noise = TerrainNoiseSampler(newPerlinG, noise.settings());
+        regenerateRect(bounds());
+        fitBlendRange();
+    }
+
+    /*Scaling keeps the edits: every height, and so the blend range, is multiplied by the ratio of the
+      scales, which leaves the height layers unchanged; slopes and curvature scale with it, so the
+      uploads rebuild the whole splat map. From or to a zero scale there is nothing to
+      scale, and the grid is regenerated.*/
+    void setHeightScale(float scale)
+    {
+        if (scale == heightScale)
+            return;
+        if (heightScale <= 0.0f || scale <= 0.0f) {
+            heightScale = scale;
+            regenerateRect(bounds());
+            fitBlendRange();
+            return;
+        }
+
+        float ratio = scale / heightScale;
+        heightScale = scale;
+        forEachRow(bounds(), [&](int z) {
+            float* row = heights.data() + (size_t)z * width;
+            for (int x = 0; x < width; ++x)
+                row[x] *= ratio;
+        });
+        blendMinHeight *= ratio;
+        blendMaxHeight *= ratio;
+        heightRatio *= ratio;
+        pyramid.scale(ratio);
+        if (!tiledHeights.empty())
+            tiledHeights.scale(ratio, threadCount);
+    }
+
+    /*Keeps a tiled copy of the heights in step with every edit, which query() and the frames of
+      imported heights read instead of the rows; off, the copy is released. Costs a second float per
+      height. A query taken before switching reads the old storage, so take it again.*/
+    void setTiledHeights(bool enabled)
+    {
+        if (enabled == !tiledHeights.empty())
+            return;
+        if (enabled)
+            tiledHeights.assign(heights.data(), width, height, threadCount);
+        else
+            tiledHeights = TiledHeightfield();
+    }
+
+    bool hasEdits() const { return !dirtyRects.empty() || heightRatio != 1.0f; }
+
+    /*Hands the pending edits to the uploads and starts a new batch*/
+    TerrainEditBatch takeEdits()
+    {
+        TerrainEditBatch batch;
+        batch.rects.swap(dirtyRects);
+        batch.heightRatio = heightRatio;
+        heightRatio = 1.0f;
+        return batch;
+    }
+
+    /*-----------REBUILD----------*/
+    /*Vertices of rect, row-major and rect-sized, laid out and framed as generateTerrainVerticesIndices
+      lays out and frames them. With a gradient noise and no erosion the generator's frame is the
+      noise's analytic slope; here it is that slope plus central differences of the edits (the heights
+      minus the noise), which is exactly the generated frame where nothing was edited and follows the
+      edited surface where something was. Otherwise the generator accumulates triangle frames, and so
+      does this over the rect and the ring of vertices around it.*/
+    void buildVertices(const TerrainRect& rect, Vertex* outVertices) const
+    {
+        if (source == TERRAIN_HEIGHTS_GENERATED && noise.hasGradient() && !erosion.enabled())
+            buildVerticesFromNoiseSlope(rect, outVertices);
+        else if (source == TERRAIN_HEIGHTS_GENERATED)
+            buildVerticesFromTriangles(rect, outVertices);
+        else
+            buildVerticesFromDifferences(rect, outVertices);
+    }
+
+    /*Splat texels of rect, row-major and rect-sized, as generateTerrainSplatMap builds them over the
+      blend range*/
+    void buildSplatTexels(const TerrainRect& rect, uint32_t* outTexels) const
+    {
+        TerrainSplatRamps ramps = makeTerrainSplatRamps(splat, blendMinHeight, blendMaxHeight);
+        forEachRow(rect, [&](int z) {
+            buildTerrainSplatRow(heights.data(), width, height, z, rect.x0, rect.x1, ramps, outTexels + (size_t)(z - rect.z0) * rect.columns());
+        });
+    }
+
+    /*Samples of rect quantized over [minHeight, maxHeight], row-major and rect-sized*/
+    void buildHeightfieldSamples(const TerrainRect& rect, float minHeight, float maxHeight, uint16_t* outSamples) const
+    {
+        for (int z = rect.z0; z < rect.z1; ++z) {
+            uint16_t* row = outSamples + (size_t)(z - rect.z0) * rect.columns();
+            for (int x = rect.x0; x < rect.x1; ++x)
+                row[x - rect.x0] = quantizeTerrainHeight(heightAt(x, z), minHeight, maxHeight);
+        }
+    }
+
+    void heightRange(const TerrainRect& rect, float& outMinHeight, float& outMaxHeight) const
+    {
+        outMinHeight = heightAt(rect.x0, rect.z0);
+        outMaxHeight = outMinHeight;
+        for (int z = rect.z0; z < rect.z1; ++z) {
+            for (int x = rect.x0; x < rect.x1; ++x) {
+                outMinHeight = std::min(outMinHeight, heightAt(x, z));
+                outMaxHeight = std::max(outMaxHeight, heightAt(x, z));
+            }
+        }
+    }
+
+    /*-----------QUERIES----------*/
+    float heightAt(int x, int z) const { return heights[(size_t)z * width + x]; }
+
+    /*Queries read the heights, or their tiled copy, in place and see every edit; neither is
+      reallocated, so the view stays valid for the editor's lifetime or until setTiledHeights changes*/
+    TerrainHeightQuery query() const
+    {
+        if (!tiledHeights.empty())
+            return TerrainHeightQuery(tiledHeights);
+        return TerrainHeightQuery(heights.data(), width, height);
+    }
+
+    /*Rays against the same heights through a min/max pyramid kept in step with every edit*/
+    TerrainRaycaster raycaster() const { return TerrainRaycaster(heights.data(), width, height, pyramid); }
+
+    TerrainRect bounds() const { return TerrainRect{ 0, 0, width, height }; }
+    int gridWidth() const { return width; }
+    int gridHeight() const { return height; }
+    float currentHeightScale() const { return heightScale; }
+    const std::vector<float>& gridHeights() const { return heights; }
+
+private:
+    /*Heights changed in rect: the pyramid is refit over it at once, and the frames one vertex around
+      it see them through their neighbours. Touching rectangles are merged until none touch,
+      so a held brush keeps one.*/
+    void markHeightsChanged(const TerrainRect& rect)
+    {
+        pyramid.update(heights.data(), rect.x0, rect.z0, rect.x1, rect.z1, threadCount);
+        if (!tiledHeights.empty())
+            tiledHeights.update(heights.data(), rect.x0, rect.z0, rect.x1, rect.z1);
+        TerrainRect dirty = intersectTerrainRects(TerrainRect{ rect.x0 - 1, rect.z0 - 1, rect.x1 + 1, rect.z1 + 1 }, bounds());
+        for (size_t i = 0; i < dirtyRects.size();) {
+            if (terrainRectsTouch(dirtyRects[i], dirty)) {
+                dirty = uniteTerrainRects(dirtyRects[i], dirty);
+                dirtyRects[i] = dirtyRects.back();
+                dirtyRects.pop_back();
+                i = 0;
+            }
+            else {
+                ++i;
+            }
+        }
+        dirtyRects.push_back(dirty);
+    }
+
+    void setTerrainVertexPosition(int x, int z, Vertex& vertex) const
+    {
+        vertex.vPos = glm::vec3(x - width / 2, heightAt(x, z), z - height / 2);
+        vertex.vTexCoords = glm::vec2(x / (float)width, z / (float)height) * TERRAIN_HEIGHTFIELD_TEX_REPEAT;
+    }
+
+    /*Central differences of the heights, clamped at the grid edges; from the tiled copy when there is
+      one, a tile and its apron at a time, with the same bits*/
+    void buildVerticesFromDifferences(const TerrainRect& rect, Vertex* outVertices) const
+    {
+        if (!tiledHeights.empty()) {
+            unsigned int tileThreads = rect.area() < TERRAIN_EDIT_PARALLEL_AREA ? 1 : threadCount;
+            forEachHeightfieldStencil(tiledHeights, rect.x0, rect.z0, rect.x1, rect.z1, tileThreads,
+                [&](int x, int z, float left, float right, float down, float up, float spanX, float spanZ) {
+                    Vertex& vertex = outVertices[(size_t)(z - rect.z0) * rect.columns() + (x - rect.x0)];
+                    setTerrainVertexPosition(x, z, vertex);
+                    setTerrainFrameFromSlope((right - left) / spanX, (up - down) / spanZ, vertex);
+                });
+            return;
+        }
+        forEachRow(rect, [&](int z) {
+            Vertex* row = outVertices + (size_t)(z - rect.z0) * rect.columns();
+            int down = std::max(z - 1, 0), up = std::min(z + 1, height - 1);
+            for (int x = rect.x0; x < rect.x1; ++x) {
+                int left = std::max(x - 1, 0), right = std::min(x + 1, width - 1);
+                Vertex& vertex = row[x - rect.x0];
+                setTerrainVertexPosition(x, z, vertex);
+                setTerrainFrameFromSlope((heightAt(right, z) - heightAt(left, z)) / float(right - left),
+                    (heightAt(x, up) - heightAt(x, down)) / float(up - down), vertex);
+            }
+        });
+    }
+
+    /*The noise over rect and its one-vertex ring with sampleTerrainHeightRow's scaling, then each
+      vertex's analytic slope corrected by the difference of its neighbours' edits*/
+    void buildVerticesFromNoiseSlope(const TerrainRect& rect, Vertex* outVertices) const
+    {
+        TerrainRect ring = intersectTerrainRects(TerrainRect{ rect.x0 - 1, rect.z0 - 1, rect.x1 + 1, rect.z1 + 1 }, bounds());
+        size_t ringColumns = (size_t)ring.columns();
+        std::vector<float> edits(ring.area()), slopeX(ring.area()), slopeZ(ring.area());
+        forEachRow(ring, [&](int z) {
+            size_t offset = (size_t)(z - ring.z0) * ringColumns;
+            std::vector<float> sampleX(ringColumns), sampleY(ringColumns);
+            for (int x = ring.x0; x < ring.x1; ++x)
+                sampleX[x - ring.x0] = x / (float)width;
+            noise.sampleRow(sampleX.data(), z / (float)height, sampleY.data(), &edits[offset], ring.columns(), &slopeX[offset], &slopeZ[offset]);
+            for (int x = ring.x0; x < ring.x1; ++x) {
+                size_t i = offset + (x - ring.x0);
+                edits[i] = heightAt(x, z) - edits[i] * heightScale;
+                slopeX[i] = slopeX[i] * heightScale / (float)width;
+                slopeZ[i] = slopeZ[i] * heightScale / (float)height;
+            }
+        });
+
+        auto ringAt = [&](const std::vector<float>& values, int x, int z) { return values[(size_t)(z - ring.z0) * ringColumns + (x - ring.x0)]; };
+        forEachRow(rect, [&](int z) {
+            Vertex* row = outVertices + (size_t)(z - rect.z0) * rect.columns();
+            int down = std::max(z - 1, 0), up = std::min(z + 1, height - 1);
+            for (int x = rect.x0; x < rect.x1; ++x) {
+                int left = std::max(x - 1, 0), right = std::min(x + 1, width - 1);
+                Vertex& vertex = row[x - rect.x0];
+                setTerrainVertexPosition(x, z, vertex);
+                setTerrainFrameFromSlope(ringAt(slopeX, x, z) + (ringAt(edits, right, z) - ringAt(edits, left, z)) / float(right - left),
+                    ringAt(slopeZ, x, z) + (ringAt(edits, x, up) - ringAt(edits, x, down)) / float(up - down), vertex);
+            }
+        });
+    }
+
+    /*computeTangentFrames over rect and its one-vertex ring, with the generator's winding: every
+      triangle touching a vertex of rect is in the patch, so rect gets the frames the whole grid gives it*/
+    void buildVerticesFromTriangles(const TerrainRect& rect, Vertex* outVertices) const
+    {
+        TerrainRect ring = intersectTerrainRects(TerrainRect{ rect.x0 - 1, rect.z0 - 1, rect.x1 + 1, rect.z1 + 1 }, bounds());
+        std::vector<Vertex> patch(ring.area());
+        forEachRow(ring, [&](int z) {
+            for (int x = ring.x0; x < ring.x1; ++x)
+                setTerrainVertexPosition(x, z, patch[(size_t)(z - ring.z0) * ring.columns() + (x - ring.x0)]);
+        });
+        std::vector<unsigned int> patchIndices;
+        generateTerrainGridIndices(ring.columns(), ring.rows(), patchIndices);
+        computeTangentFrames(patch, patchIndices, TANGENT_FRAME_ACCUMULATE_NORMALS | TANGENT_FRAME_FLIP_NORMALS, activeSIMDLevel(), threadCount);
+        for (int z = rect.z0; z < rect.z1; ++z)
+            std::copy(patch.begin() + (size_t)(z - ring.z0) * ring.columns() + (rect.x0 - ring.x0),
+                patch.begin() + (size_t)(z - ring.z0) * ring.columns() + (rect.x1 - ring.x0), outVertices + (size_t)(z - rect.z0) * rect.columns());
+    }
+
+    /*Min and max starting at 0, like generateTerrainVerticesIndices*/
+    void fitBlendRange()
+    {
+        heightRange(bounds(), blendMinHeight, blendMaxHeight);
+        blendMinHeight = std::min(blendMinHeight, 0.0f);
+        blendMaxHeight = std::max(blendMaxHeight, 0.0f);
+    }
+
+    /*Rows of rect over the shared pool*/
+    template <typename Fn>
+    void forEachRow(const TerrainRect& rect, Fn&& fn) const
+    {
+        if (rect.empty())
+            return;
+        ThreadPool& pool = sharedThreadPool();
+        size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+        if (rect.area() < TERRAIN_EDIT_PARALLEL_AREA)
+            taskCount = 1;
+        pool.parallelFor((size_t)rect.rows(), taskCount, [&](size_t, size_t firstRow, size_t lastRow) {
+            for (size_t z = firstRow; z < lastRow; ++z)
+                fn(rect.z0 + int(z));
+        });
+    }
+
+    int width;
+    int height;
+    float heightScale;
+    TerrainNoiseSampler noise;
+    TerrainErosionSettings erosion;
+    TerrainSplatSettings splat;
+    std::vector<float> heights;
+    float blendMinHeight;
+    float blendMaxHeight;
+    unsigned int threadCount;
+    TerrainHeightSource source;
+    TerrainHeightPyramid pyramid;
+    /*Empty unless setTiledHeights turned it on*/
+    TiledHeightfield tiledHeights;
+
+    std::vector<TerrainRect> dirtyRects;
+    float heightRatio{ 1.0f };
+};
+
+/*-----------GPU----------*/
+/*Vertices rebuilt per pass of a large rectangle, bounding the scratch copies of a whole-grid upload*/
+const size_t TERRAIN_EDIT_UPLOAD_VERTICES = size_t(1) << 20;
+
+/*What an upload pushed, for the stats*/
+struct TerrainEditUploadStats
+{
+    size_t rects{ 0 };
+    size_t bytes{ 0 };
+    bool requantized{ false };
+};
+
+/*Quantization range of a GPU copy after the edits of a batch: unchanged while every edited height
+  fits, refit exactly (from 0, like the generator) when an edit covers the whole grid, otherwise
+  grown past the overflow by a quarter of the extent so a brush held at the rim does not requantize
+  every frame. Returns true when the range changed and the whole copy must be requantized.*/
+inline bool fitTerrainEditRange(const TerrainEditor& editor, const std::vector<TerrainRect>& rects, float& minHeight, float& maxHeight)
+{
+    bool changed = false;
+    for (const TerrainRect& rect : rects) {
+        float rectMin = 0.f, rectMax = 0.f;
+        editor.heightRange(rect, rectMin, rectMax);
+        if (rect.area() == editor.bounds().area()) {
+            minHeight = std::min(rectMin, 0.0f);
+            maxHeight = std::max(rectMax, 0.0f);
+            return true;
+        }
+        float headroom = 0.25f * (maxHeight - minHeight);
+        if (rectMin < minHeight) {
+            minHeight = rectMin - headroom;
+            changed = true;
+        }
+        if (rectMax > maxHeight) {
+            maxHeight = rectMax + headroom;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/*Rows [rect.z0, rect.z1) of a rect-sized block into a buffer of width-wide rows: one call when the
+  rows are whole, otherwise one per row*/
+inline size_t uploadTerrainRectRows(const TerrainRect& rect, int width, size_t stride, const void* data)
+{
+    const char* bytes = static_cast<const char*>(data);
+    size_t rowBytes = (size_t)rect.columns() * stride;
+    if (rect.columns() == width) {
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)((size_t)rect.z0 * width * stride), (GLsizeiptr)(rowBytes * rect.rows()), bytes);
+        return rowBytes * rect.rows();
+    }
+    for (int z = rect.z0; z < rect.z1; ++z)
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(((size_t)z * width + rect.x0) * stride), (GLsizeiptr)rowBytes, bytes + (size_t)(z - rect.z0) * rowBytes);
+    return rowBytes * rect.rows();
+}
+
+/*Splat texels of the batch's rectangles, or of the whole grid after a height scale change, whose
+  slopes and curvature change everywhere; returns the bytes pushed*/
+inline size_t uploadTerrainSplatEdits(const TerrainEditor& editor, const TerrainEditBatch& edits, TerrainSplatTexture& splat)
+{
+    std::vector<TerrainRect> splatRects = edits.rects;
+    if (edits.heightRatio != 1.0f)
+        splatRects.assign(1, editor.bounds());
+    size_t bytes = 0;
+    std::vector<uint32_t> texels;
+    for (const TerrainRect& rect : splatRects) {
+        texels.resize(rect.area());
+        editor.buildSplatTexels(rect, texels.data());
+        splat.uploadRegion(rect.x0, rect.z0, rect.columns(), rect.rows(), texels.data());
+        bytes += texels.size() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+/*The single terrain as a vertex buffer (Vertex or PackedVertex, as mesh.decode says) plus its splat
+  map. A height scale change rebuilds every vertex, their frames change with it, and every splat
+  texel.*/
+inline TerrainEditUploadStats uploadTerrainEdits(const TerrainEditor& editor, const TerrainEditBatch& edits, const VBO& vbo, MeshHandle& mesh,
+    TerrainSplatTexture& splat)
+{
+    TerrainEditUploadStats stats;
+    std::vector<TerrainRect> vertexRects = edits.rects;
+    bool wholeGrid = edits.heightRatio != 1.0f;
+    if (mesh.decode.packed) {
+        float minHeight = mesh.decode.positionMin.y * edits.heightRatio;
+        float maxHeight = minHeight + mesh.decode.positionExtent.y * edits.heightRatio;
+        stats.requantized = fitTerrainEditRange(editor, edits.rects, minHeight, maxHeight);
+        wholeGrid |= stats.requantized;
+        mesh.decode.positionMin.y = minHeight;
+        mesh.decode.positionExtent.y = std::max(maxHeight - minHeight, 1e-6f);
+    }
+    if (wholeGrid)
+        vertexRects.assign(1, editor.bounds());
+
+    std::vector<Vertex> vertices;
+    std::vector<PackedVertex> packedVertices;
+    vbo.bind();
+    for (const TerrainRect& rect : vertexRects) {
+        int bandRows = std::max(1, int(TERRAIN_EDIT_UPLOAD_VERTICES / (size_t)rect.columns()));
+        for (int z = rect.z0; z < rect.z1; z += bandRows) {
+            TerrainRect band{ rect.x0, z, rect.x1, std::min(z + bandRows, rect.z1) };
+            vertices.resize(band.area());
+            editor.buildVertices(band, vertices.data());
+            if (mesh.decode.packed) {
+                packedVertices = packVertices(vertices.data(), vertices.size(), mesh.decode);
+                stats.bytes += uploadTerrainRectRows(band, editor.gridWidth(), sizeof(PackedVertex), packedVertices.data());
+            }
+            else {
+                stats.bytes += uploadTerrainRectRows(band, editor.gridWidth(), sizeof(Vertex), vertices.data());
+            }
+        }
+    }
+    vbo.unbind();
+
+    stats.bytes += uploadTerrainSplatEdits(editor, edits, splat);
+    stats.rects = edits.rects.size();
+    return stats;
+}
+
+/*The single terrain as a 16-bit heightfield plus its splat map. A height scale change only scales the
+  decode range of the heights; heights past the range requantize the whole texture.*/
+inline TerrainEditUploadStats uploadTerrainEdits(const TerrainEditor& editor, const TerrainEditBatch& edits, TerrainHeightfieldMesh& mesh,
+    TerrainSplatTexture& splat)
+{
+    TerrainEditUploadStats stats;
+    float minHeight = mesh.decodeRange().x * edits.heightRatio;
+    float maxHeight = minHeight + mesh.decodeRange().y * edits.heightRatio;
+    stats.requantized = fitTerrainEditRange(editor, edits.rects, minHeight, maxHeight);
+    stats.rects = edits.rects.size();
+    stats.bytes = uploadTerrainSplatEdits(editor, edits, splat);
+
+    if (stats.requantized) {
+        TerrainHeightfield field;
+        quantizeTerrainHeightfield(editor.gridHeights(), editor.gridWidth(), editor.gridHeight(), minHeight, maxHeight, field);
+        mesh.upload(field);
+        stats.bytes += field.samples.size() * sizeof(uint16_t);
+        return stats;
+    }
+
+    mesh.setDecodeRange(minHeight, maxHeight);
+    std::vector<uint16_t> samples;
+    for (const TerrainRect& rect : edits.rects) {
+        samples.resize(rect.area());
+        editor.buildHeightfieldSamples(rect, minHeight, maxHeight, samples.data());
+        mesh.uploadRegion(rect.x0, rect.z0, rect.columns(), rect.rows(), samples.data());
+        stats.bytes += samples.size() * sizeof(uint16_t);
+    }
+    return stats;
+}
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "SIMDHelper.h"
+#include "ThreadPool.h"
+
+/*Hydraulic and thermal erosion of a row-major float height grid, run on the generated heights before
+  the normals are built. Both give the same heights for the same settings whatever the thread count.
+
+  Hydraulic: droplets run downhill from random spots, picking sediment up where they speed up and
+  dropping it where they slow down. They are spawned in batches over square tiles, each tile's droplets
+  one after another from a random stream of their own, and may wander up to half a tile past their
+  tile. Two tiles a tile apart in both directions then never touch the same heights, so the four tile
+  colours run one after another with every tile of a colour in parallel. Each batch shifts the tile
+  grid so no tile border stays where it was.
+
+  Thermal: material steeper than the talus slides to the 4 neighbours. Each pass reads one grid and
+  writes the other, a row at a time, 8 cells per step with AVX2 and 4 with SSE2, bit for bit the scalar
+  pass.*/
+
+struct TerrainErosionSettings
+{
+    /*-----------HYDRAULIC----------*/
+    int32_t droplets{ 0 };          /*over the whole grid; 0 skips hydraulic erosion*/
+    int32_t batches{ 8 };
+    int32_t tileSize{ 64 };         /*droplets die half a tile past their own*/
+    int32_t dropletLifetime{ 30 };  /*steps of one cell*/
+    int32_t brushRadius{ 3 };       /*cells a droplet erodes around it*/
+    float inertia{ 0.05f };         /*share of the old direction kept each step*/
+    float sedimentCapacity{ 4.0f };
+    float minSedimentCapacity{ 0.01f };
+    float erodeSpeed{ 0.3f };
+    float depositSpeed{ 0.3f };
+    float evaporateSpeed{ 0.01f };
+    float gravity{ 4.0f };
+    /*-----------THERMAL----------*/
+    int32_t thermalPasses{ 0 };     /*0 skips thermal erosion*/
+    float talus{ 0.1f };            /*largest stable height difference between neighbours*/
+    float thermalRate{ 0.5f };      /*0-1, share of the excess over the talus moved per pass*/
+    uint32_t seed{ 0 };
+
+    bool enabled() const { return droplets > 0 || thermalPasses > 0; }
+};
+static_assert(sizeof(TerrainErosionSettings) == 64, "TerrainErosionSettings is hashed as bytes and must have no padding");
+
+/*Integer hash the droplets draw from: a droplet's spawn depends only on the seed, batch, tile and its
+  index, not on which thread runs it*/
+inline uint32_t hashTerrainErosion(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return value;
+}
+
+/*[0, 1) from the top 24 bits*/
+inline float terrainErosionUnit(uint32_t value)
+{
+    return float(value >> 8) * (1.0f / 16777216.0f);
+}
+
+/*-----------HYDRAULIC----------*/
+struct TerrainErosionBrush
+{
+    std::vector<int> offsetX;
+    std::vector<int> offsetZ;
+    std::vector<float> weights;
+};
+
+/*Cells within radius of the centre, weighted by how far inside it they are, weights summing to 1*/
+inline TerrainErosionBrush makeTerrainErosionBrush(int radius)
+{
+    TerrainErosionBrush brush;
+    float weightSum = 0.0f;
+    for (int z = -radius; z <= radius; ++z) {
+        for (int x = -radius; x <= radius; ++x) {
+            float distance = std::sqrt(float(x * x + z * z));
+            if (distance > float(radius))
+                continue;
+            float weight = float(radius) + 1.0f - distance;
+            brush.offsetX.push_back(x);
+            brush.offsetZ.push_back(z);
+            brush.weights.push_back(weight);
+            weightSum += weight;
+        }
+    }
+    for (float& weight : brush.weights)
+        weight /= weightSum;
+    return brush;
+}
+
+/*Grid cells [x0, x1) x [z0, z1) a tile's droplets may read and write*/
+struct TerrainErosionRegion
+{
+    int x0, z0, x1, z1;
+};
+
+/*Height and slope of the bilinear surface at (x, z), inside cell (cellX, cellZ)*/
+inline float sampleTerrainErosionHeight(const float* heights, int width, int cellX, int cellZ, float x, float z, float& outSlopeX, float& outSlopeZ)
+{
+    const float* corner = heights + (size_t)cellZ * width + cellX;
+    float h00 = corner[0], h10 = corner[1], h01 = corner[width], h11 = corner[width + 1];
+    float u = x - float(cellX), v = z - float(cellZ);
+    outSlopeX = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+    outSlopeZ = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+    return h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v) + h01 * (1.0f - u) * v + h11 * u * v;
+}
+
+/*One droplet from (x, z) until it evaporates, stops on flat ground or would leave region with its
+  brush*/
+inline void runTerrainErosionDroplet(float* heights, int width, const TerrainErosionRegion& region, const TerrainErosionBrush& brush,
+    const TerrainErosionSettings& settings, float x, float z)
+{
+    const int margin = std::max(settings.brushRadius, 1);
+    auto inside = [&](int cellX, int cellZ) {
+        return cellX >= region.x0 + margin && cellZ >= region.z0 + margin && cellX < region.x1 - margin && cellZ < region.z1 - margin;
+    };
+
+    float directionX = 0.0f, directionZ = 0.0f;
+    float speed = 1.0f, water = 1.0f, sediment = 0.0f;
+    int cellX = int(x), cellZ = int(z);
+    if (!inside(cellX, cellZ))
+        return;
+
+    for (int step = 0; step < settings.dropletLifetime; ++step) {
+        float slopeX, slopeZ;
+        float height = sampleTerrainErosionHeight(heights, width, cellX, cellZ, x, z, slopeX, slopeZ);
+
+        /*Downhill, keeping some of the old direction, one cell per step*/
+        directionX = directionX * settings.inertia - slopeX * (1.0f - settings.inertia);
+        directionZ = directionZ * settings.inertia - slopeZ * (1.0f - settings.inertia);
+        float length = std::sqrt(directionX * directionX + directionZ * directionZ);
+        if (length <= 0.0f)
+            break;
+        directionX /= length;
+        directionZ /= length;
+
+        float oldX = x, oldZ = z;
+        int oldCellX = cellX, oldCellZ = cellZ;
+        x += directionX;
+        z += directionZ;
+        cellX = int(std::floor(x));
+        cellZ = int(std::floor(z));
+        if (!inside(cellX, cellZ))
+            break;
+
+        float unusedX, unusedZ;
+        float heightChange = sampleTerrainErosionHeight(heights, width, cellX, cellZ, x, z, unusedX, unusedZ) - height;
+        float capacity = std::max(-heightChange * speed * water * settings.sedimentCapacity, settings.minSedimentCapacity);
+
+        if (sediment > capacity || heightChange > 0.0f) {
+            /*Uphill fills the pit behind the droplet as far as it can, otherwise the surplus settles,
+              bilinearly over the old cell's corners*/
+            float deposit = heightChange > 0.0f ? std::min(heightChange, sediment) : (sediment - capacity) * settings.depositSpeed;
+            sediment -= deposit;
+            float u = oldX - float(oldCellX), v = oldZ - float(oldCellZ);
+            float* corner = heights + (size_t)oldCellZ * width + oldCellX;
+            corner[0] += deposit * (1.0f - u) * (1.0f - v);
+            corner[1] += deposit * u * (1.0f - v);
+            corner[width] += deposit * (1.0f - u) * v;
+            corner[width + 1] += deposit * u * v;
+        }
+        else {
+            /*Never more than the drop, so the droplet cannot dig below where it is heading*/
+            float erode = std::min((capacity - sediment) * settings.erodeSpeed, -heightChange);
+            for (size_t i = 0; i < brush.weights.size(); ++i)
+                heights[(size_t)(oldCellZ + brush.offsetZ[i]) * width + oldCellX + brush.offsetX[i]] -= erode * brush.weights[i];
+            sediment += erode;
+        }
+
+        speed = std::sqrt(std::max(speed * speed - heightChange * settings.gravity, 0.0f));
+        water *= 1.0f - settings.evaporateSpeed;
+    }
+}
+
+/*settings.droplets droplets over settings.batches batches. threadCount 0 uses every pool thread plus
+  the caller, 1 runs serially; the heights do not depend on it.*/
+inline void hydraulicErosion(float* heights, int width, int height, const TerrainErosionSettings& settings, unsigned int threadCount = 0)
+{
+    if (settings.droplets <= 0 || width < 2 || height < 2)
+        return;
+    const int batches = std::max(settings.batches, 1);
+    const int tileSize = std::max(settings.tileSize, 4 * (std::max(settings.brushRadius, 1) + 1));
+    const int halo = tileSize / 2;
+    const TerrainErosionBrush brush = makeTerrainErosionBrush(std::max(settings.brushRadius, 0));
+    const uint64_t gridArea = (uint64_t)width * height;
+
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+
+    for (int batch = 0; batch < batches; ++batch) {
+        uint32_t batchKey = hashTerrainErosion(settings.seed ^ hashTerrainErosion(uint32_t(batch) + 0x9e3779b9u));
+        int offsetX = int(hashTerrainErosion(batchKey) % uint32_t(tileSize));
+        int offsetZ = int(hashTerrainErosion(batchKey + 1) % uint32_t(tileSize));
+        int tilesX = (width + offsetX + tileSize - 1) / tileSize;
+        int tilesZ = (height + offsetZ + tileSize - 1) / tileSize;
+        uint64_t batchDroplets = uint64_t(settings.droplets) / batches + (uint64_t(batch) < uint64_t(settings.droplets) % batches ? 1 : 0);
+
+        /*Droplets per tile in proportion to its area inside the grid, through the running total so
+          the batch's count is met exactly*/
+        std::vector<uint32_t> tileDroplets((size_t)tilesX * tilesZ);
+        std::vector<TerrainErosionRegion> tileCells(tileDroplets.size());
+        uint64_t areaBefore = 0;
+        for (int tileZ = 0; tileZ < tilesZ; ++tileZ) {
+            for (int tileX = 0; tileX < tilesX; ++tileX) {
+                TerrainErosionRegion cells{ std::max(tileX * tileSize - offsetX, 0), std::max(tileZ * tileSize - offsetZ, 0),
+                    std::min((tileX + 1) * tileSize - offsetX, width), std::min((tileZ + 1) * tileSize - offsetZ, height) };
+                uint64_t areaAfter = areaBefore + (uint64_t)(cells.x1 - cells.x0) * (cells.z1 - cells.z0);
+                size_t tile = (size_t)tileZ * tilesX + tileX;
+                tileDroplets[tile] = uint32_t(batchDroplets * areaAfter / gridArea - batchDroplets * areaBefore / gridArea);
+                tileCells[tile] = cells;
+                areaBefore = areaAfter;
+            }
+        }
+
+        for (int colour = 0; colour < 4; ++colour) {
+            std::vector<size_t> tiles;
+            for (int tileZ = colour / 2; tileZ < tilesZ; tileZ += 2)
+                for (int tileX = colour % 2; tileX < tilesX; tileX += 2)
+                    tiles.push_back((size_t)tileZ * tilesX + tileX);
+
+            pool.parallelFor(tiles.size(), taskCount, [&](size_t, size_t first, size_t last) {
+                for (size_t t = first; t < last; ++t) {
+                    size_t tile = tiles[t];
+                    const TerrainErosionRegion& cells = tileCells[tile];
+                    TerrainErosionRegion region{ std::max(cells.x0 - halo, 0), std::max(cells.z0 - halo, 0),
+                        std::min(cells.x1 + halo, width), std::min(cells.z1 + halo, height) };
+                    uint32_t tileKey = hashTerrainErosion(batchKey ^ hashTerrainErosion(uint32_t(tile)));
+                    for (uint32_t droplet = 0; droplet < tileDroplets[tile]; ++droplet) {
+                        uint32_t dropletKey = hashTerrainErosion(tileKey + droplet * 2u);
+                        float x = float(cells.x0) + terrainErosionUnit(dropletKey) * float(cells.x1 - cells.x0);
+                        float z = float(cells.z0) + terrainErosionUnit(hashTerrainErosion(dropletKey + 1)) * float(cells.z1 - cells.z0);
+                        runTerrainErosionDroplet(heights, width, region, brush, settings, x, z);
+                    }
+                }
+            });
+        }
+    }
+}
+
+/*-----------THERMAL----------*/
+/*Height difference past the talus, signed like the difference*/
+inline float thermalErosionExcess(float difference, float talus)
+{
+    return difference - std::min(std::max(difference, -talus), talus);
+}
+
+/*Cell x of a thermal pass: every neighbour pair moves rate times its excess downhill, which leaves
+  the total unchanged; thermalErosion passes thermalRate / 8, which cannot overshoot. Neighbours past
+  the edges are the cell itself.*/
+inline float thermalErosionCell(const float* up, const float* row, const float* down, int x, int width, float talus, float rate)
+{
+    float centre = row[x];
+    float left = row[std::max(x - 1, 0)], right = row[std::min(x + 1, width - 1)];
+    float flow = thermalErosionExcess(left - centre, talus) + thermalErosionExcess(right - centre, talus);
+    flow = flow + thermalErosionExcess(up[x] - centre, talus);
+    flow = flow + thermalErosionExcess(down[x] - centre, talus);
+    return centre + flow * rate;
+}
+
+#if defined(SIMD_HAS_X86)
+inline __m128 thermalErosionExcessSSE2(__m128 difference, __m128 talus, __m128 negativeTalus)
+{
+    return _mm_sub_ps(difference, _mm_min_ps(_mm_max_ps(difference, negativeTalus), talus));
+}
+
+/*Cells [1, width - 1) 4 at a time; returns where it stopped*/
+inline int thermalErosionRowSSE2(const float* up, const float* row, const float* down, float* out, int width, float talus, float rate)
+{
+    const __m128 talus4 = _mm_set1_ps(talus), negativeTalus4 = _mm_set1_ps(-talus), rate4 = _mm_set1_ps(rate);
+    int x = 1;
+    for (; x + 4 <= width - 1; x += 4) {
+        __m128 centre = _mm_loadu_ps(row + x);
+        __m128 flow = _mm_add_ps(thermalErosionExcessSSE2(_mm_sub_ps(_mm_loadu_ps(row + x - 1), centre), talus4, negativeTalus4),
+            thermalErosionExcessSSE2(_mm_sub_ps(_mm_loadu_ps(row + x + 1), centre), talus4, negativeTalus4));
+        flow = _mm_add_ps(flow, thermalErosionExcessSSE2(_mm_sub_ps(_mm_loadu_ps(up + x), centre), talus4, negativeTalus4));
+        flow = _mm_add_ps(flow, thermalErosionExcessSSE2(_mm_sub_ps(_mm_loadu_ps(down + x), centre), talus4, negativeTalus4));
+        _mm_storeu_ps(out + x, _mm_add_ps(centre, _mm_mul_ps(flow, rate4)));
+    }
+    return x;
+}
+
+SIMD_TARGET_AVX2 inline __m256 thermalErosionExcessAVX2(__m256 difference, __m256 talus, __m256 negativeTalus)
+{
+    return _mm256_sub_ps(difference, _mm256_min_ps(_mm256_max_ps(difference, negativeTalus), talus));
+}
+
+SIMD_TARGET_AVX2 inline int thermalErosionRowAVX2(const float* up, const float* row, const float* down, float* out, int width, float talus, float rate)
+{
+    const __m256 talus8 = _mm256_set1_ps(talus), negativeTalus8 = _mm256_set1_ps(-talus), rate8 = _mm256_set1_ps(rate);
+    int x = 1;
+    for (; x + 8 <= width - 1; x += 8) {
+        __m256 centre = _mm256_loadu_ps(row + x);
+        __m256 flow = _mm256_add_ps(thermalErosionExcessAVX2(_mm256_sub_ps(_mm256_loadu_ps(row + x - 1), centre), talus8, negativeTalus8),
+            thermalErosionExcessAVX2(_mm256_sub_ps(_mm256_loadu_ps(row + x + 1), centre), talus8, negativeTalus8));
+        flow = _mm256_add_ps(flow, thermalErosionExcessAVX2(_mm256_sub_ps(_mm256_loadu_ps(up + x), centre), talus8, negativeTalus8));
+        flow = _mm256_add_ps(flow, thermalErosionExcessAVX2(_mm256_sub_ps(_mm256_loadu_ps(down + x), centre), talus8, negativeTalus8));
+        _mm256_storeu_ps(out + x, _mm256_add_ps(centre, _mm256_mul_ps(flow, rate8)));
+    }
+    return x;
+}
+#endif
+
+/*One pass over a row: the edge columns and what the vectors leave in scalar*/
+inline void thermalErosionRow(const float* up, const float* row, const float* down, float* out, int width, float talus, float rate, SIMDLevel level)
+{
+    out[0] = thermalErosionCell(up, row, down, 0, width, talus, rate);
+    int x = 1;
+#if defined(SIMD_HAS_X86)
+    if (level == SIMD_AVX2)
+        x = thermalErosionRowAVX2(up, row, down, out, width, talus, rate);
+    else if (level == SIMD_SSE2)
+        x = thermalErosionRowSSE2(up, row, down, out, width, talus, rate);
+#endif
+    for (; x < width; ++x)
+        out[x] = thermalErosionCell(up, row, down, x, width, talus, rate);
+}
+
+/*settings.thermalPasses passes, rows split over the pool; threadCount as hydraulicErosion. level is
+  clamped to what the CPU supports and does not change the result. The passes alternate between
+  heights and a scratch copy and an odd count ends with a copy back, so heights keeps its storage
+  and views of it (the editor's queries) stay valid.*/
+inline void thermalErosion(std::vector<float>& heights, int width, int height, const TerrainErosionSettings& settings, unsigned int threadCount = 0,
+    SIMDLevel level = activeSIMDLevel())
+{
+    if (settings.thermalPasses <= 0 || width < 1 || height < 1)
+        return;
+    level = std::min(level, activeSIMDLevel());
+    const float talus = std::max(settings.talus, 0.0f);
+    const float rate = std::min(std::max(settings.thermalRate, 0.0f), 1.0f) * 0.125f;
+
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    std::vector<float> scratch(heights.size());
+    float* buffers[2] = { heights.data(), scratch.data() };
+    for (int pass = 0; pass < settings.thermalPasses; ++pass) {
+        const float* source = buffers[pass & 1];
+        float* target = buffers[(pass + 1) & 1];
+        pool.parallelFor((size_t)height, taskCount, [&](size_t, size_t firstRow, size_t lastRow) {
+            for (int z = int(firstRow); z < int(lastRow); ++z) {
+                const float* row = source + (size_t)z * width;
+                thermalErosionRow(z > 0 ? row - width : row, row, z < height - 1 ? row + width : row, target + (size_t)z * width, width, talus, rate, level);
+            }
+        });
+    }
+    if (settings.thermalPasses & 1)
+        std::copy(scratch.begin(), scratch.end(), heights.begin());
+}
+
+/*Hydraulic then thermal erosion, as settings asks for*/
+inline void erodeTerrainHeights(std::vector<float>& heights, int width, int height, const TerrainErosionSettings& settings, unsigned int threadCount = 0)
+{
+    hydraulicErosion(heights.data(), width, height, settings, threadCount);
+    thermalErosion(heights, width, height, settings, threadCount);
+}
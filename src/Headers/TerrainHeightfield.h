@@ -0,0 +1,308 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "Vertex.h"
+#include "MeshHandle.h"
+#include "PerlinHelper.h"
+#include "PerlinSIMD.h"
+#include "TerrainErosion.h"
+#include "ThreadPool.h"
+#include "VAO.h"
+#include "VBO.h"
+#include "EBO.h"
+
+/*Heightfield terrain: the single terrain as a 16-bit height texture plus one small grid patch drawn
+  instanced across it. The vertex shaders rebuild position, UV, normal and tangent from texelFetch of
+  the heights, so the GPU keeps 2 bytes per terrain vertex instead of a Vertex, and regenerating the
+  terrain is a single texture upload. The splat map (TerrainSplatMap.h) is a texture of its own,
+  as with the vertex buffer.*/
+
+/*Texture unit the vertex shaders read the heights from; 0-10 are taken by the terrain material*/
+const int TERRAIN_HEIGHTFIELD_TEXTURE_UNIT = 11;
+
+/*Patch lattice coordinate attribute*/
+const GLuint TERRAIN_HEIGHTFIELD_GRID_LOCATION = 11;
+
+/*UV repeats across the terrain, as generateTerrainVerticesIndices lays them out*/
+const float TERRAIN_HEIGHTFIELD_TEX_REPEAT = 4.0f;
+
+/*Row-major heights quantized to 0..65535 over [minHeight, maxHeight]*/
+struct TerrainHeightfield
+{
+    int width{ 0 };
+    int height{ 0 };
+    float minHeight{ 0.0f };
+    float maxHeight{ 0.0f };
+    std::vector<uint16_t> samples;
+};
+
+inline uint16_t quantizeTerrainHeight(float height, float minHeight, float maxHeight)
+{
+    float normalized = maxHeight > minHeight ? (height - minHeight) / (maxHeight - minHeight) : 0.0f;
+    normalized = std::max(0.0f, std::min(1.0f, normalized));
+    return uint16_t(normalized * 65535.0f + 0.5f);
+}
+
+inline float decodeTerrainHeight(const TerrainHeightfield& field, int x, int z)
+{
+    x = std::max(0, std::min(field.width - 1, x));
+    z = std::max(0, std::min(field.height - 1, z));
+    return field.minHeight + field.samples[(size_t)z * field.width + x] / 65535.0f * (field.maxHeight - field.minHeight);
+}
+
+/*The float heights generateTerrainVerticesIndices would give the same grid, eroded the same way,
+  row-major, and their range with min and max starting at 0 like its height range does. threadCount 0
+  uses every pool thread plus the caller.*/
+inline void generateTerrainHeights(int width, int height, float heightScale, std::vector<int>& perlinG, std::vector<float>& heights,
+    float& outMinHeight, float& outMaxHeight, unsigned int threadCount = 0, TerrainNoiseSettings noise = TerrainNoiseSettings(),
+    TerrainErosionSettings erosion = TerrainErosionSettings())
+{
+    TerrainNoiseSampler noiseSampler(perlinG, noise);
+
+    heights.resize((size_t)width * height);
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    std::vector<float> taskMinHeight(taskCount, 0.f), taskMaxHeight(taskCount, 0.f);
+    pool.parallelFor((size_t)height, taskCount, [&](size_t task, size_t firstRow, size_t lastRow) {
+        std::vector<float> sampleX(width), sampleY(width);
+        for (int x = 0; x < width; ++x)
+            sampleX[x] = x / (float)width;
+        float minHeight = 0.f, maxHeight = 0.f;
+        for (int z = int(firstRow); z < int(lastRow); ++z) {
+            float* row = heights.data() + (size_t)z * width;
+            sampleTerrainHeightRow(z, width, height, heightScale, noiseSampler, sampleX.data(), sampleY.data(), row);
+            for (int x = 0; x < width; ++x) {
+                minHeight = std::min(minHeight, row[x]);
+                maxHeight = std::max(maxHeight, row[x]);
+            }
+        }
+        taskMinHeight[task] = minHeight;
+        taskMaxHeight[task] = maxHeight;
+    });
+
+    if (erosion.enabled()) {
+        erodeTerrainHeights(heights, width, height, erosion, threadCount);
+        pool.parallelFor((size_t)height, taskCount, [&](size_t task, size_t firstRow, size_t lastRow) {
+            float minHeight = 0.f, maxHeight = 0.f;
+            for (size_t i = firstRow * width; i < lastRow * width; ++i) {
+                minHeight = std::min(minHeight, heights[i]);
+                maxHeight = std::max(maxHeight, heights[i]);
+            }
+            taskMinHeight[task] = minHeight;
+            taskMaxHeight[task] = maxHeight;
+        });
+    }
+    outMinHeight = *std::min_element(taskMinHeight.begin(), taskMinHeight.end());
+    outMaxHeight = *std::max_element(taskMaxHeight.begin(), taskMaxHeight.end());
+}
+
+/*Row-major float heights into 16 bits over [minHeight, maxHeight]*/
+inline void quantizeTerrainHeightfield(const std::vector<float>& heights, int width, int height, float minHeight, float maxHeight, TerrainHeightfield& field,
+    unsigned int threadCount = 0)
+{
+    field.width = width;
+    field.height = height;
+    field.minHeight = minHeight;
+    field.maxHeight = maxHeight;
+    field.samples.resize((size_t)width * height);
+
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    pool.parallelFor((size_t)height, taskCount, [&](size_t, size_t firstRow, size_t lastRow) {
+        for (size_t i = firstRow * width; i < lastRow * width; ++i)
+            field.samples[i] = quantizeTerrainHeight(heights[i], minHeight, maxHeight);
+    });
+}
+
+/*The heights generateTerrainVerticesIndices would give the same grid, straight into 16 bits over
+  their own range. Float heights first, the quantization needs the range of the whole grid.*/
+inline void generateTerrainHeightfield(int width, int height, float heightScale, std::vector<int>& perlinG, TerrainHeightfield& field,
+    unsigned int threadCount = 0)
+{
+    std::vector<float> heights;
+    float minHeight = 0.f, maxHeight = 0.f;
+    generateTerrainHeights(width, height, heightScale, perlinG, heights, minHeight, maxHeight, threadCount);
+    quantizeTerrainHeightfield(heights, width, height, minHeight, maxHeight, field, threadCount);
+}
+
+/*Vertex (x, z) as the vertex shaders rebuild it: central differences of the clamped neighbours give
+  the normal, the x difference Gram-Schmidted against it the tangent, and B = cross(N, T) as
+  computeTangentFrames writes it*/
+inline Vertex reconstructTerrainHeightfieldVertex(const TerrainHeightfield& field, int x, int z)
+{
+    int left = std::max(x - 1, 0), right = std::min(x + 1, field.width - 1);
+    int down = std::max(z - 1, 0), up = std::min(z + 1, field.height - 1);
+    glm::vec3 dx(float(right - left), decodeTerrainHeight(field, right, z) - decodeTerrainHeight(field, left, z), 0.0f);
+    glm::vec3 dz(0.0f, decodeTerrainHeight(field, x, up) - decodeTerrainHeight(field, x, down), float(up - down));
+
+    Vertex vertex;
+    vertex.vPos = glm::vec3(float(x - field.width / 2), decodeTerrainHeight(field, x, z), float(z - field.height / 2));
+    vertex.vTexCoords = glm::vec2(x / (float)field.width, z / (float)field.height) * TERRAIN_HEIGHTFIELD_TEX_REPEAT;
+    vertex.vNormals = glm::normalize(glm::cross(dz, dx));
+    vertex.vTangent = glm::normalize(dx - glm::dot(dx, vertex.vNormals) * vertex.vNormals);
+    vertex.vBiTangent = glm::cross(vertex.vNormals, vertex.vTangent);
+    return vertex;
+}
+
+/*Bytes on the GPU: the heights plus the shared patch's lattice and 16-bit indices*/
+inline size_t terrainHeightfieldGPUBytes(int width, int height, int patchQuads)
+{
+    size_t patchVertices = (size_t)(patchQuads + 1) * (patchQuads + 1);
+    size_t patchIndices = (size_t)patchQuads * patchQuads * 6;
+    return (size_t)width * height * sizeof(uint16_t) + patchVertices * sizeof(glm::vec2) + patchIndices * indexTypeSize(selectIndexType(patchVertices));
+}
+
+/*-----------GPU----------*/
+class TerrainHeightfieldMesh
+{
+public:
+    /*patchQuads x patchQuads quads per instance of the shared patch*/
+    explicit TerrainHeightfieldMesh(int inPatchQuads = 32)
+        : patchQuads(std::max(1, inPatchQuads))
+    {
+        int side = patchQuads + 1;
+        std::vector<glm::vec2> lattice((size_t)side * side);
+        for (int z = 0; z < side; ++z)
+            for (int x = 0; x < side; ++x)
+                lattice[(size_t)z * side + x] = glm::vec2(float(x), float(z));
+        std::vector<unsigned int> indices;
+        generateTerrainGridIndices(side, side, indices);
+
+        patchVAO = std::make_unique<VAO>();
+        patchVBO = std::make_unique<VBO>();
+        patchEBO = std::make_unique<EBO>();
+        patchVAO->bind();
+        patchVBO->bind();
+        glBufferData(GL_ARRAY_BUFFER, lattice.size() * sizeof(glm::vec2), lattice.data(), GL_STATIC_DRAW);
+        patchEBO->bind();
+        patch = uploadIndexBuffer(indices.data(), indices.size(), lattice.size());
+        glVertexAttribPointer(TERRAIN_HEIGHTFIELD_GRID_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glEnableVertexAttribArray(TERRAIN_HEIGHTFIELD_GRID_LOCATION);
+        patchVAO->unbind();
+        patchVBO->unbind();
+        patchEBO->unbind();
+    }
+
+    /*Delete copy constructor and copy assignment operators*/
+    TerrainHeightfieldMesh(const TerrainHeightfieldMesh&) = delete;
+    TerrainHeightfieldMesh& operator=(const TerrainHeightfieldMesh&) = delete;
+
+    ~TerrainHeightfieldMesh()
+    {
+        if (texture)
+            glDeleteTextures(1, &texture);
+    }
+
+    /*One glTexSubImage2D when the size is unchanged, otherwise the texture is reallocated*/
+    void upload(const TerrainHeightfield& field)
+    {
+        createTexture();
+
+        /*Rows of an odd width are not 4-byte aligned*/
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        if (field.width == width && field.height == height) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_SHORT, field.samples.data());
+        }
+        else {
+            width = field.width;
+            height = field.height;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width, height, 0, GL_RED, GL_UNSIGNED_SHORT, field.samples.data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        setDecodeRange(field.minHeight, field.maxHeight);
+    }
+
+    /*An uninitialized width x height texture decoding over [minHeight, maxHeight], for grids streamed
+      in with uploadRegion instead of held whole in a TerrainHeightfield*/
+    void allocate(int inWidth, int inHeight, float minHeight, float maxHeight)
+    {
+        createTexture();
+        width = inWidth;
+        height = inHeight;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width, height, 0, GL_RED, GL_UNSIGNED_SHORT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        setDecodeRange(minHeight, maxHeight);
+    }
+
+    /*Texels [x, x + columns) x [z, z + rows) from a tightly packed block quantized over the current
+      decode range, for edits of an uploaded grid*/
+    void uploadRegion(int x, int z, int columns, int rows, const uint16_t* samples)
+    {
+        if (!texture)
+            return;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, z, columns, rows, GL_RED, GL_UNSIGNED_SHORT, samples);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    /*Only the decode uniform changes: scaling every height scales the range and keeps the samples*/
+    void setDecodeRange(float minHeight, float maxHeight)
+    {
+        heightRange = glm::vec2(minHeight, maxHeight - minHeight);
+    }
+
+    /*Binds the heights to TERRAIN_HEIGHTFIELD_TEXTURE_UNIT and draws every patch in one instanced
+      call; the caller's shader needs the uniforms below set first*/
+    void draw() const
+    {
+        if (!texture)
+            return;
+        glActiveTexture(GL_TEXTURE0 + TERRAIN_HEIGHTFIELD_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        patchVAO->bind();
+        drawMeshElementsInstanced(patch, GLsizei(patchCount()));
+        patchVAO->unbind();
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    GLuint textureID() const { return texture; }
+    int gridWidth() const { return width; }
+    int gridHeight() const { return height; }
+    int quadsPerPatch() const { return patchQuads; }
+
+    /*Patches across x; instance i covers patch (i % patchesPerRow, i / patchesPerRow)*/
+    int patchesPerRow() const { return width > 1 ? (width - 2) / patchQuads + 1 : 0; }
+    size_t patchCount() const { return height > 1 ? (size_t)patchesPerRow() * ((height - 2) / patchQuads + 1) : 0; }
+
+    /*Minimum height and max - min, for decoding the unorm16 samples*/
+    const glm::vec2& decodeRange() const { return heightRange; }
+
+    /*Triangles submitted per draw, including the ones clamped flat past the far edges*/
+    size_t triangleCount() const { return patchCount() * size_t(patch.indexCount) / 3; }
+
+    size_t gpuBytes() const { return terrainHeightfieldGPUBytes(width, height, patchQuads); }
+
+private:
+    int patchQuads{ 32 };
+    int width{ 0 };
+    int height{ 0 };
+    glm::vec2 heightRange{ 0.0f };
+    GLuint texture{ 0 };
+    std::unique_ptr<VAO> patchVAO;
+    std::unique_ptr<VBO> patchVBO;
+    std::unique_ptr<EBO> patchEBO;
+    MeshHandle patch;
+
+    /*Creates the texture on first use and leaves it bound*/
+    void createTexture()
+    {
+        if (!texture) {
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "Vertex.h"
+
+/*CDLOD over a square terrain grid of (quads + 1)^2 row-major vertices, quads a power of two.
+
+  A level-L quadtree node covers leafQuads * 2^L quads and is always drawn as the same leafQuads^2
+  patch with stride 2^L, so one index list per level serves every node through the draw's base
+  vertex. Each level's list is ordered quadrant by quadrant, so a node whose children are only
+  partly selected draws its remaining quadrants as contiguous sub-ranges.
+
+  Nodes are picked by distance to the camera: level L is used within lodRange(L), which doubles
+  per level. Vertices that the next coarser level drops carry the height difference to the coarse
+  surface, and the vertex shaders move them onto it over the last morphFraction of the range, so
+  levels neither pop nor crack: a node beside a coarser one is fully morphed along their edge.*/
+
+/*Attribute location of the per-vertex morph height delta (9 is the packed tangent frame)*/
+const GLuint TERRAIN_MORPH_DELTA_LOCATION = 10;
+
+struct TerrainLODSettings
+{
+    int leafQuads{ 8 };                 /*quads per patch side, a power of two*/
+    float lodDistanceRatio{ 2.0f };     /*level 0 range in patch widths*/
+    float morphFraction{ 0.3f };        /*part of each range over which vertices morph to the next level*/
+};
+
+/*A node (or some of its quadrants) to draw: indexCount indices of level's list from firstIndex,
+  offset by baseVertex*/
+struct TerrainLODNodeDraw
+{
+    int level{ 0 };
+    size_t firstIndex{ 0 };
+    GLsizei indexCount{ 0 };
+    GLint baseVertex{ 0 };
+};
+
+/*What the vertex shaders need to morph a level: the grid stride of its vertices and the distance
+  range over which the dropped vertices slide onto the next level*/
+struct TerrainLODMorphParams
+{
+    int stride{ 1 };
+    glm::vec2 morphRange{ 0.0f };
+};
+
+struct TerrainLODStats
+{
+    size_t nodes{ 0 };
+    size_t culledNodes{ 0 };
+    size_t triangles{ 0 };
+    size_t fullTriangles{ 0 };      /*what the same chunks cost at full density*/
+};
+
+/*-----------FRUSTUM----------*/
+/*Planes of a view-projection matrix (Gribb/Hartmann), inside where dot(plane, (p, 1)) >= 0*/
+struct TerrainFrustum
+{
+    glm::vec4 planes[6];
+};
+
+inline TerrainFrustum makeTerrainFrustum(const glm::mat4& viewProj)
+{
+    glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+    glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+    glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+    TerrainFrustum frustum;
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+    return frustum;
+}
+
+/*Conservative: false only when the box is fully outside one plane*/
+inline bool frustumIntersectsAABB(const TerrainFrustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    for (const glm::vec4& plane : frustum.planes) {
+        glm::vec3 farthest(plane.x >= 0.0f ? boundsMax.x : boundsMin.x, plane.y >= 0.0f ? boundsMax.y : boundsMin.y, plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+        if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+inline bool sphereIntersectsAABB(const glm::vec3& center, float radius, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 closest = glm::clamp(center, boundsMin, boundsMax);
+    glm::vec3 offset = closest - center;
+    return glm::dot(offset, offset) <= radius * radius;
+}
+
+/*-----------LAYOUT----------*/
+class TerrainLODLayout
+{
+public:
+    TerrainLODLayout() {}
+
+    /*gridQuads and settings.leafQuads are rounded down to powers of two, leafQuads to at most gridQuads*/
+    TerrainLODLayout(int gridQuads, float gridSpacing, const TerrainLODSettings& inSettings)
+        : settings(inSettings), spacing(gridSpacing)
+    {
+        quads = floorPowerOfTwo(std::max(1, gridQuads));
+        settings.leafQuads = std::min(floorPowerOfTwo(std::max(2, settings.leafQuads)), std::max(2, quads));
+        side = quads + 1;
+        levels = 1;
+        while ((settings.leafQuads << (levels - 1)) < quads)
+            ++levels;
+
+        /*Quadrant by quadrant, each quadrant row by row with the terrain's winding*/
+        int half = settings.leafQuads / 2;
+        for (int level = 0; level < levels; ++level) {
+            int stride = 1 << level;
+            levelFirstIndex.push_back(indices.size());
+            for (int quadrant = 0; quadrant < 4; ++quadrant) {
+                int quadrantX = (quadrant & 1) * half, quadrantZ = (quadrant >> 1) * half;
+                for (int z = quadrantZ; z < quadrantZ + half; ++z) {
+                    for (int x = quadrantX; x < quadrantX + half; ++x) {
+                        unsigned int topLeft = unsigned(z * stride * side + x * stride);
+                        unsigned int topRight = topLeft + stride;
+                        unsigned int bottomLeft = topLeft + unsigned(stride * side);
+                        unsigned int bottomRight = bottomLeft + stride;
+
+                        indices.push_back(topLeft);
+                        indices.push_back(bottomRight);
+                        indices.push_back(bottomLeft);
+
+                        indices.push_back(topLeft);
+                        indices.push_back(topRight);
+                        indices.push_back(bottomRight);
+                    }
+                }
+            }
+        }
+
+        for (int level = 0; level < levels; ++level)
+            levelFirstNode.push_back(levelFirstNode.empty() ? 0 : levelFirstNode.back() + nodesPerSide(level - 1) * nodesPerSide(level - 1));
+        nodeCount = levelFirstNode.back() + nodesPerSide(levels - 1) * nodesPerSide(levels - 1);
+    }
+
+    int levelCount() const { return levels; }
+    int gridSide() const { return side; }
+    size_t boundsCount() const { return nodeCount; }
+
+    /*Patch index lists of every level, placed at indexOffset in the shared index buffer*/
+    const std::vector<unsigned int>& patchIndices() const { return indices; }
+
+    /*Nodes across the grid at level*/
+    int nodesPerSide(int level) const
+    {
+        return quads / (settings.leafQuads << level);
+    }
+
+    /*Camera distance up to which level is drawn; the coarsest level is drawn at any distance*/
+    float lodRange(int level) const
+    {
+        return settings.lodDistanceRatio * settings.leafQuads * spacing * float(2 << level);
+    }
+
+    TerrainLODMorphParams morphParams(int level) const
+    {
+        TerrainLODMorphParams params;
+        params.stride = 1 << level;
+        if (level == levels - 1) {
+            /*Nothing coarser to morph to*/
+            params.morphRange = glm::vec2(1e30f, 2e30f);
+            return params;
+        }
+        float end = lodRange(level);
+        float start = level == 0 ? 0.0f : lodRange(level - 1);
+        params.morphRange = glm::vec2(end - settings.morphFraction * (end - start), end);
+        return params;
+    }
+
+    /*Per vertex, the height change that puts it on the surface of the first coarser level that drops
+      it: the midpoint of the coarse edge it splits, or of the quad diagonal the winding uses.
+      Vertices every level keeps get 0.*/
+    void computeMorphDeltas(const Vertex* vertices, std::vector<float>& deltas) const
+    {
+        deltas.assign((size_t)side * side, 0.0f);
+        auto height = [&](int x, int z) { return vertices[(size_t)z * side + x].vPos.y; };
+        for (int z = 0; z < side; ++z) {
+            for (int x = 0; x < side; ++x) {
+                int stride = 1;
+                while (stride < (1 << (levels - 1)) && (x % (2 * stride)) == 0 && (z % (2 * stride)) == 0)
+                    stride *= 2;
+                if ((x % (2 * stride)) == 0 && (z % (2 * stride)) == 0)
+                    continue;
+                bool oddX = (x % (2 * stride)) != 0, oddZ = (z % (2 * stride)) != 0;
+                float target;
+                if (oddX && oddZ)
+                    target = 0.5f * (height(x - stride, z - stride) + height(x + stride, z + stride));
+                else if (oddX)
+                    target = 0.5f * (height(x - stride, z) + height(x + stride, z));
+                else
+                    target = 0.5f * (height(x, z - stride) + height(x, z + stride));
+                deltas[(size_t)z * side + x] = target - height(x, z);
+            }
+        }
+    }
+
+    /*Height range of every node, finest level first; morphed heights stay inside it*/
+    void computeNodeBounds(const Vertex* vertices, std::vector<glm::vec2>& bounds) const
+    {
+        bounds.assign(nodeCount, glm::vec2(0.0f));
+        int leafNodes = nodesPerSide(0);
+        for (int nodeZ = 0; nodeZ < leafNodes; ++nodeZ) {
+            for (int nodeX = 0; nodeX < leafNodes; ++nodeX) {
+                glm::vec2 range(vertices[(size_t)nodeZ * settings.leafQuads * side + nodeX * settings.leafQuads].vPos.y);
+                for (int z = nodeZ * settings.leafQuads; z <= (nodeZ + 1) * settings.leafQuads; ++z) {
+                    for (int x = nodeX * settings.leafQuads; x <= (nodeX + 1) * settings.leafQuads; ++x) {
+                        float y = vertices[(size_t)z * side + x].vPos.y;
+                        range.x = std::min(range.x, y);
+                        range.y = std::max(range.y, y);
+                    }
+                }
+                bounds[(size_t)nodeZ * leafNodes + nodeX] = range;
+            }
+        }
+        for (int level = 1; level < levels; ++level) {
+            int levelNodes = nodesPerSide(level), childNodes = nodesPerSide(level - 1);
+            for (int nodeZ = 0; nodeZ < levelNodes; ++nodeZ) {
+                for (int nodeX = 0; nodeX < levelNodes; ++nodeX) {
+                    glm::vec2 range(bounds[levelFirstNode[level - 1] + (size_t)(2 * nodeZ) * childNodes + 2 * nodeX]);
+                    for (int child = 1; child < 4; ++child) {
+                        glm::vec2 childRange = bounds[levelFirstNode[level - 1] + (size_t)(2 * nodeZ + (child >> 1)) * childNodes + 2 * nodeX + (child & 1)];
+                        range.x = std::min(range.x, childRange.x);
+                        range.y = std::max(range.y, childRange.y);
+                    }
+                    bounds[levelFirstNode[level] + (size_t)nodeZ * levelNodes + nodeX] = range;
+                }
+            }
+        }
+    }
+
+    /*Quadtree selection for one grid whose vertex (0, 0) sits at gridOrigin (xz), appending to draws.
+      indexOffset is where patchIndices() starts in the bound index buffer.*/
+    void selectNodes(const glm::vec2& gridOrigin, const std::vector<glm::vec2>& bounds, const glm::vec3& lodCenter, const TerrainFrustum& frustum,
+        size_t indexOffset, std::vector<TerrainLODNodeDraw>& draws, TerrainLODStats& stats) const
+    {
+        stats.fullTriangles += (size_t)quads * quads * 2;
+        selectNode(levels - 1, 0, 0, gridOrigin, bounds, lodCenter, frustum, indexOffset, draws, stats);
+    }
+
+private:
+    TerrainLODSettings settings;
+    float spacing{ 1.0f };
+    int quads{ 1 };
+    int side{ 2 };
+    int levels{ 1 };
+    size_t nodeCount{ 0 };
+    std::vector<unsigned int> indices;
+    std::vector<size_t> levelFirstIndex;
+    std::vector<size_t> levelFirstNode;
+
+    static int floorPowerOfTwo(int value)
+    {
+        int power = 1;
+        while (power * 2 <= value)
+            power *= 2;
+        return power;
+    }
+
+    void nodeAABB(int level, int nodeX, int nodeZ, const glm::vec2& gridOrigin, const std::vector<glm::vec2>& bounds, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+    {
+        float nodeSize = float(settings.leafQuads << level) * spacing;
+        glm::vec2 heights = bounds[levelFirstNode[level] + (size_t)nodeZ * nodesPerSide(level) + nodeX];
+        boundsMin = glm::vec3(gridOrigin.x + nodeX * nodeSize, heights.x, gridOrigin.y + nodeZ * nodeSize);
+        boundsMax = glm::vec3(boundsMin.x + nodeSize, heights.y, boundsMin.z + nodeSize);
+    }
+
+    /*Quadrants [firstQuadrant, firstQuadrant + quadrantCount) of a node at its own level*/
+    void addNodeDraw(int level, int nodeX, int nodeZ, int firstQuadrant, int quadrantCount, size_t indexOffset,
+        std::vector<TerrainLODNodeDraw>& draws, TerrainLODStats& stats) const
+    {
+        size_t quadrantIndices = (size_t)(settings.leafQuads / 2) * (settings.leafQuads / 2) * 6;
+        int nodeQuads = settings.leafQuads << level;
+
+        TerrainLODNodeDraw draw;
+        draw.level = level;
+        draw.firstIndex = indexOffset + levelFirstIndex[level] + quadrantIndices * firstQuadrant;
+        draw.indexCount = GLsizei(quadrantIndices * quadrantCount);
+        draw.baseVertex = GLint(nodeZ * nodeQuads * side + nodeX * nodeQuads);
+        draws.push_back(draw);
+
+        ++stats.nodes;
+        stats.triangles += (size_t)draw.indexCount / 3;
+    }
+
+    void selectNode(int level, int nodeX, int nodeZ, const glm::vec2& gridOrigin, const std::vector<glm::vec2>& bounds, const glm::vec3& lodCenter,
+        const TerrainFrustum& frustum, size_t indexOffset, std::vector<TerrainLODNodeDraw>& draws, TerrainLODStats& stats) const
+    {
+        glm::vec3 boundsMin, boundsMax;
+        nodeAABB(level, nodeX, nodeZ, gridOrigin, bounds, boundsMin, boundsMax);
+        if (!frustumIntersectsAABB(frustum, boundsMin, boundsMax)) {
+            ++stats.culledNodes;
+            return;
+        }
+        if (level == 0 || !sphereIntersectsAABB(lodCenter, lodRange(level - 1), boundsMin, boundsMax)) {
+            addNodeDraw(level, nodeX, nodeZ, 0, 4, indexOffset, draws, stats);
+            return;
+        }
+
+        /*Children in range of the finer level recurse; the others are drawn as quadrants of this node,
+          merged while they are consecutive*/
+        int runStart = -1;
+        for (int child = 0; child < 4; ++child) {
+            int childX = 2 * nodeX + (child & 1), childZ = 2 * nodeZ + (child >> 1);
+            glm::vec3 childMin, childMax;
+            nodeAABB(level - 1, childX, childZ, gridOrigin, bounds, childMin, childMax);
+            bool refine = sphereIntersectsAABB(lodCenter, lodRange(level - 1), childMin, childMax);
+            bool visible = refine || frustumIntersectsAABB(frustum, childMin, childMax);
+            if (!refine && visible) {
+                if (runStart < 0)
+                    runStart = child;
+                continue;
+            }
+            if (runStart >= 0) {
+                addNodeDraw(level, nodeX, nodeZ, runStart, child - runStart, indexOffset, draws, stats);
+                runStart = -1;
+            }
+            if (refine)
+                selectNode(level - 1, childX, childZ, gridOrigin, bounds, lodCenter, frustum, indexOffset, draws, stats);
+            else
+                ++stats.culledNodes;
+        }
+        if (runStart >= 0)
+            addNodeDraw(level, nodeX, nodeZ, runStart, 4 - runStart, indexOffset, draws, stats);
+    }
+};
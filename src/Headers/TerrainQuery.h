@@ -0,0 +1,249 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "../includes/glm/glm.hpp"
+#include "SIMDHelper.h"
+#include "TiledHeightfield.h"
+
+/*Height and normal queries against the single terrain's float height grid: a view of the grid the
+  terrain editor keeps, so the camera, instancing and scattering read the live heights, edits
+  included, without copies. Batches are answered 8 queries per step with AVX2 gathers and 4 with SSE2;
+  every level matches the scalar query bit for bit. The grid may also be the editor's tiled mirror of
+  it, which reads the same heights in the same bits.
+
+  Vertex (x, z) of the grid sits at (x - width/2, z - height/2). A query is the bilinear surface of
+  its cell, positions past the edges are clamped to them, and the normal is that surface's, from its
+  slopes along x and z.*/
+
+class TerrainHeightQuery
+{
+public:
+    TerrainHeightQuery() = default;
+
+    /*heights is row-major width x height and must outlive the query*/
+    TerrainHeightQuery(const float* heights, int width, int height)
+        : heights(heights), width(width), height(height)
+    {
+    }
+
+    /*The same grid in 8x8 tiles, which must outlive the query and not be reassigned while it is used*/
+    TerrainHeightQuery(const TiledHeightfield& tiledHeights)
+        : heights(tiledHeights.data()), tiled(&tiledHeights), width(tiledHeights.gridWidth()), height(tiledHeights.gridHeight())
+    {
+    }
+
+    bool valid() const { return heights && width > 1 && height > 1; }
+
+    /*Inside the grid's x/z extent*/
+    bool covers(const glm::vec3& position) const
+    {
+        float gridX = position.x + float(width / 2), gridZ = position.z + float(height / 2);
+        return valid() && gridX >= 0.0f && gridZ >= 0.0f && gridX <= float(width - 1) && gridZ <= float(height - 1);
+    }
+
+    float heightAt(const glm::vec3& position) const
+    {
+        float outHeight;
+        sampleFloat(position.x, position.z, outHeight, nullptr);
+        return outHeight;
+    }
+
+    glm::vec3 normalAt(const glm::vec3& position) const
+    {
+        float outHeight;
+        glm::vec3 normal;
+        sampleFloat(position.x, position.z, outHeight, &normal);
+        return normal;
+    }
+
+    /*outHeights[i] at (x[i], z[i]) for count queries, and outNormals[i] unless it is null. level is
+      clamped to what the CPU supports.*/
+    void sample(const float* x, const float* z, float* outHeights, glm::vec3* outNormals, size_t count, SIMDLevel level = activeSIMDLevel()) const
+    {
+        if (!valid())
+            return;
+        level = std::min(level, activeSIMDLevel());
+        size_t i = 0;
+#if defined(SIMD_HAS_X86)
+        if (level == SIMD_AVX2)
+            i = sampleAVX2(x, z, outHeights, outNormals, count);
+        else if (level == SIMD_SSE2)
+            i = sampleSSE2(x, z, outHeights, outNormals, count);
+#endif
+        for (; i < count; ++i)
+            sampleFloat(x[i], z[i], outHeights[i], outNormals ? outNormals + i : nullptr);
+    }
+
+    int gridWidth() const { return width; }
+    int gridHeight() const { return height; }
+
+private:
+    /*-----------SCALAR----------*/
+    /*The reference every SIMD level reproduces operation for operation*/
+    void sampleFloat(float x, float z, float& outHeight, glm::vec3* outNormal) const
+    {
+        if (!valid()) {
+            outHeight = 0.0f;
+            if (outNormal)
+                *outNormal = glm::vec3(0.0f, 1.0f, 0.0f);
+            return;
+        }
+        float gridX = std::min(std::max(x + float(width / 2), 0.0f), float(width - 1));
+        float gridZ = std::min(std::max(z + float(height / 2), 0.0f), float(height - 1));
+        int cellX = std::min(int(gridX), width - 2), cellZ = std::min(int(gridZ), height - 2);
+        float fracX = gridX - float(cellX), fracZ = gridZ - float(cellZ);
+
+        float h00, h10, h01, h11;
+        cellCorners(cellX, cellZ, h00, h10, h01, h11);
+        float rowX = h10 - h00, nextRowX = h11 - h01;
+        float top = h00 + rowX * fracX, bottom = h01 + nextRowX * fracX;
+        outHeight = top + (bottom - top) * fracZ;
+        if (!outNormal)
+            return;
+
+        float columnZ = h01 - h00, nextColumnZ = h11 - h10;
+        float slopeX = rowX + (nextRowX - rowX) * fracZ;
+        float slopeZ = columnZ + (nextColumnZ - columnZ) * fracX;
+        float inverseLength = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+        *outNormal = glm::vec3(-slopeX * inverseLength, inverseLength, -slopeZ * inverseLength);
+    }
+
+#if defined(SIMD_HAS_X86)
+    /*-----------SSE2----------*/
+    /*SSE2 has no gather and no 32-bit min or multiply, so the cells are found per lane and the four
+      corners loaded one by one; the interpolation runs 4 wide. Returns how many queries it answered.*/
+    size_t sampleSSE2(const float* x, const float* z, float* outHeights, glm::vec3* outNormals, size_t count) const
+    {
+        const __m128 halfWidth = _mm_set1_ps(float(width / 2)), halfHeight = _mm_set1_ps(float(height / 2));
+        const __m128 maxX = _mm_set1_ps(float(width - 1)), maxZ = _mm_set1_ps(float(height - 1));
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), signBit = _mm_set1_ps(-0.0f);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 gridX = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(x + i), halfWidth), zero), maxX);
+            __m128 gridZ = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(z + i), halfHeight), zero), maxZ);
+            alignas(16) int cellX[4], cellZ[4];
+            _mm_store_si128((__m128i*)cellX, _mm_cvttps_epi32(gridX));
+            _mm_store_si128((__m128i*)cellZ, _mm_cvttps_epi32(gridZ));
+            alignas(16) float h00[4], h10[4], h01[4], h11[4];
+            for (int lane = 0; lane < 4; ++lane) {
+                cellX[lane] = std::min(cellX[lane], width - 2);
+                cellZ[lane] = std::min(cellZ[lane], height - 2);
+                cellCorners(cellX[lane], cellZ[lane], h00[lane], h10[lane], h01[lane], h11[lane]);
+            }
+            __m128 fracX = _mm_sub_ps(gridX, _mm_cvtepi32_ps(_mm_load_si128((const __m128i*)cellX)));
+            __m128 fracZ = _mm_sub_ps(gridZ, _mm_cvtepi32_ps(_mm_load_si128((const __m128i*)cellZ)));
+
+            __m128 c00 = _mm_load_ps(h00), c10 = _mm_load_ps(h10), c01 = _mm_load_ps(h01), c11 = _mm_load_ps(h11);
+            __m128 rowX = _mm_sub_ps(c10, c00), nextRowX = _mm_sub_ps(c11, c01);
+            __m128 top = _mm_add_ps(c00, _mm_mul_ps(rowX, fracX)), bottom = _mm_add_ps(c01, _mm_mul_ps(nextRowX, fracX));
+            _mm_storeu_ps(outHeights + i, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fracZ)));
+            if (!outNormals)
+                continue;
+
+            __m128 columnZ = _mm_sub_ps(c01, c00), nextColumnZ = _mm_sub_ps(c11, c10);
+            __m128 slopeX = _mm_add_ps(rowX, _mm_mul_ps(_mm_sub_ps(nextRowX, rowX), fracZ));
+            __m128 slopeZ = _mm_add_ps(columnZ, _mm_mul_ps(_mm_sub_ps(nextColumnZ, columnZ), fracX));
+            __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX), one), _mm_mul_ps(slopeZ, slopeZ));
+            __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+            alignas(16) float normalX[4], normalY[4], normalZ[4];
+            _mm_store_ps(normalX, _mm_xor_ps(_mm_mul_ps(slopeX, inverseLength), signBit));
+            _mm_store_ps(normalY, inverseLength);
+            _mm_store_ps(normalZ, _mm_xor_ps(_mm_mul_ps(slopeZ, inverseLength), signBit));
+            for (int lane = 0; lane < 4; ++lane)
+                outNormals[i + lane] = glm::vec3(normalX[lane], normalY[lane], normalZ[lane]);
+        }
+        return i;
+    }
+
+    /*-----------AVX2----------*/
+    /*The four corners of 8 cells come from four gathers off the cell's index*/
+    SIMD_TARGET_AVX2 size_t sampleAVX2(const float* x, const float* z, float* outHeights, glm::vec3* outNormals, size_t count) const
+    {
+        const __m256 halfWidth = _mm256_set1_ps(float(width / 2)), halfHeight = _mm256_set1_ps(float(height / 2));
+        const __m256 maxX = _mm256_set1_ps(float(width - 1)), maxZ = _mm256_set1_ps(float(height - 1));
+        const __m256i lastCellX = _mm256_set1_epi32(width - 2), lastCellZ = _mm256_set1_epi32(height - 2);
+        const __m256i rowStride = _mm256_set1_epi32(width), one32 = _mm256_set1_epi32(1);
+        const __m256i tilesPerRow = _mm256_set1_epi32(tiled ? tiled->tilesPerRow() : 0);
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), signBit = _mm256_set1_ps(-0.0f);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 gridX = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(x + i), halfWidth), zero), maxX);
+            __m256 gridZ = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(z + i), halfHeight), zero), maxZ);
+            __m256i cellX = _mm256_min_epi32(_mm256_cvttps_epi32(gridX), lastCellX);
+            __m256i cellZ = _mm256_min_epi32(_mm256_cvttps_epi32(gridZ), lastCellZ);
+            __m256 fracX = _mm256_sub_ps(gridX, _mm256_cvtepi32_ps(cellX));
+            __m256 fracZ = _mm256_sub_ps(gridZ, _mm256_cvtepi32_ps(cellZ));
+
+            /*32-bit element indices reach 2^31 heights, far past any grid that fits in memory*/
+            __m256 c00, c10, c01, c11;
+            if (tiled) {
+                __m256i nextCellX = _mm256_add_epi32(cellX, one32), nextCellZ = _mm256_add_epi32(cellZ, one32);
+                c00 = _mm256_i32gather_ps(heights, tiledIndexAVX2(cellX, cellZ, tilesPerRow), 4);
+                c10 = _mm256_i32gather_ps(heights, tiledIndexAVX2(nextCellX, cellZ, tilesPerRow), 4);
+                c01 = _mm256_i32gather_ps(heights, tiledIndexAVX2(cellX, nextCellZ, tilesPerRow), 4);
+                c11 = _mm256_i32gather_ps(heights, tiledIndexAVX2(nextCellX, nextCellZ, tilesPerRow), 4);
+            }
+            else {
+                __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(cellZ, rowStride), cellX);
+                __m256i nextRowIndex = _mm256_add_epi32(index, rowStride);
+                c00 = _mm256_i32gather_ps(heights, index, 4);
+                c10 = _mm256_i32gather_ps(heights, _mm256_add_epi32(index, one32), 4);
+                c01 = _mm256_i32gather_ps(heights, nextRowIndex, 4);
+                c11 = _mm256_i32gather_ps(heights, _mm256_add_epi32(nextRowIndex, one32), 4);
+            }
+
+            __m256 rowX = _mm256_sub_ps(c10, c00), nextRowX = _mm256_sub_ps(c11, c01);
+            __m256 top = _mm256_add_ps(c00, _mm256_mul_ps(rowX, fracX)), bottom = _mm256_add_ps(c01, _mm256_mul_ps(nextRowX, fracX));
+            _mm256_storeu_ps(outHeights + i, _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), fracZ)));
+            if (!outNormals)
+                continue;
+
+            __m256 columnZ = _mm256_sub_ps(c01, c00), nextColumnZ = _mm256_sub_ps(c11, c10);
+            __m256 slopeX = _mm256_add_ps(rowX, _mm256_mul_ps(_mm256_sub_ps(nextRowX, rowX), fracZ));
+            __m256 slopeZ = _mm256_add_ps(columnZ, _mm256_mul_ps(_mm256_sub_ps(nextColumnZ, columnZ), fracX));
+            __m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(slopeX, slopeX), one), _mm256_mul_ps(slopeZ, slopeZ));
+            __m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+            alignas(32) float normalX[8], normalY[8], normalZ[8];
+            _mm256_store_ps(normalX, _mm256_xor_ps(_mm256_mul_ps(slopeX, inverseLength), signBit));
+            _mm256_store_ps(normalY, inverseLength);
+            _mm256_store_ps(normalZ, _mm256_xor_ps(_mm256_mul_ps(slopeZ, inverseLength), signBit));
+            for (int lane = 0; lane < 8; ++lane)
+                outNormals[i + lane] = glm::vec3(normalX[lane], normalY[lane], normalZ[lane]);
+        }
+        return i;
+    }
+
+    /*TiledHeightfield::index for 8 cells at once*/
+    static SIMD_TARGET_AVX2 __m256i tiledIndexAVX2(__m256i cellX, __m256i cellZ, __m256i tilesPerRow)
+    {
+        const __m256i inTile = _mm256_set1_epi32(TILED_HEIGHTFIELD_TILE - 1);
+        __m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(cellZ, TILED_HEIGHTFIELD_TILE_SHIFT), tilesPerRow),
+            _mm256_srli_epi32(cellX, TILED_HEIGHTFIELD_TILE_SHIFT));
+        __m256i cell = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(cellZ, inTile), TILED_HEIGHTFIELD_TILE_SHIFT), _mm256_and_si256(cellX, inTile));
+        return _mm256_add_epi32(_mm256_slli_epi32(tile, 2 * TILED_HEIGHTFIELD_TILE_SHIFT), cell);
+    }
+#endif
+
+    void cellCorners(int cellX, int cellZ, float& h00, float& h10, float& h01, float& h11) const
+    {
+        if (tiled) {
+            tiled->cellCorners(cellX, cellZ, h00, h10, h01, h11);
+            return;
+        }
+        const float* corner = heights + (size_t)cellZ * width + cellX;
+        h00 = corner[0];
+        h10 = corner[1];
+        h01 = corner[width];
+        h11 = corner[width + 1];
+    }
+
+    const float* heights{ nullptr };
+    /*Set when heights is a TiledHeightfield's tiles rather than rows*/
+    const TiledHeightfield* tiled{ nullptr };
+    int width{ 0 };
+    int height{ 0 };
+};
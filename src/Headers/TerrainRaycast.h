@@ -0,0 +1,377 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "../includes/glm/glm.hpp"
+#include "ThreadPool.h"
+
+/*Ray and segment queries against the single terrain's float height grid, for picking, line of sight
+  and sun visibility. The surface is the bilinear one TerrainHeightQuery samples. A min/max pyramid
+  over the grid's cells lets a ray skip every node it passes above, and so descends only where it
+  comes close to the ground instead of testing each cell it crosses.
+
+  Vertex (x, z) of the grid sits at (x - width/2, z - height/2); ray origins and hit positions are in
+  that space.*/
+
+/*direction need not be normalized; hits further than maxDistance along it are ignored*/
+struct TerrainRay
+{
+    glm::vec3 origin{ 0.0f };
+    glm::vec3 direction{ 0.0f, -1.0f, 0.0f };
+    float maxDistance{ std::numeric_limits<float>::infinity() };
+};
+
+struct TerrainRayHit
+{
+    bool hit{ false };
+    float distance{ 0.0f };
+    glm::vec3 position{ 0.0f };
+};
+
+/*A ray in grid space, where vertex (x, z) sits at (x, z), with a unit direction and t in world units*/
+struct TerrainGridRay
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float maxDistance;
+};
+
+/*False for a zero direction, which hits nothing*/
+inline bool makeTerrainGridRay(const TerrainRay& ray, int width, int height, TerrainGridRay& outRay)
+{
+    float length = glm::length(ray.direction);
+    if (!(length > 0.0f) || !(ray.maxDistance >= 0.0f))
+        return false;
+    outRay.origin = glm::vec3(ray.origin.x + float(width / 2), ray.origin.y, ray.origin.z + float(height / 2));
+    outRay.direction = ray.direction / length;
+    outRay.maxDistance = ray.maxDistance;
+    return true;
+}
+
+/*Where ray is over [x0, x1] x [z0, z1] within [0, maxDistance]; false when it never is*/
+inline bool terrainRaySpan(const TerrainGridRay& ray, float x0, float z0, float x1, float z1, float& outEnter, float& outExit)
+{
+    float enter = 0.0f, exit = ray.maxDistance;
+    const float lower[2] = { x0, z0 }, upper[2] = { x1, z1 };
+    const float origin[2] = { ray.origin.x, ray.origin.z }, direction[2] = { ray.direction.x, ray.direction.z };
+    for (int axis = 0; axis < 2; ++axis) {
+        if (direction[axis] == 0.0f) {
+            if (origin[axis] < lower[axis] || origin[axis] > upper[axis])
+                return false;
+            continue;
+        }
+        float inverse = 1.0f / direction[axis];
+        float t0 = (lower[axis] - origin[axis]) * inverse, t1 = (upper[axis] - origin[axis]) * inverse;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        enter = std::max(enter, t0);
+        exit = std::min(exit, t1);
+    }
+    outEnter = enter;
+    outExit = exit;
+    return enter <= exit;
+}
+
+/*First t where ray meets the bilinear surface of cell (cellX, cellZ), or where it already starts
+  below it. Over the cell the surface height along the ray is quadratic in t, so the crossing is the
+  smallest root of (ray height - surface height) in the cell's span.*/
+inline bool intersectTerrainCell(const float* heights, int width, const TerrainGridRay& ray, int cellX, int cellZ, float& outDistance)
+{
+    float enter, exit;
+    if (!terrainRaySpan(ray, float(cellX), float(cellZ), float(cellX + 1), float(cellZ + 1), enter, exit))
+        return false;
+
+    const float* corner = heights + (size_t)cellZ * width + cellX;
+    float h00 = corner[0], h10 = corner[1], h01 = corner[width], h11 = corner[width + 1];
+    float rowX = h10 - h00, columnZ = h01 - h00, twist = h00 - h10 - h01 + h11;
+    float fracX = std::min(std::max(ray.origin.x + ray.direction.x * enter - float(cellX), 0.0f), 1.0f);
+    float fracZ = std::min(std::max(ray.origin.z + ray.direction.z * enter - float(cellZ), 0.0f), 1.0f);
+    float dx = ray.direction.x, dz = ray.direction.z;
+
+    /*gap(s) = a + b s + c s^2 is the ray's height above the surface s past enter*/
+    float a = ray.origin.y + ray.direction.y * enter - (h00 + rowX * fracX + columnZ * fracZ + twist * fracX * fracZ);
+    float b = ray.direction.y - (rowX * dx + columnZ * dz + twist * (fracX * dz + fracZ * dx));
+    float c = -twist * dx * dz;
+    if (a <= 0.0f) {
+        outDistance = enter;
+        return true;
+    }
+
+    float span = exit - enter, root = std::numeric_limits<float>::infinity();
+    if (c == 0.0f) {
+        if (b < 0.0f)
+            root = -a / b;
+    }
+    else {
+        float discriminant = b * b - 4.0f * a * c;
+        if (discriminant < 0.0f)
+            return false;
+        /*The cancellation-free pair of roots*/
+        float q = -0.5f * (b + std::copysign(std::sqrt(discriminant), b));
+        float roots[2] = { q / c, q != 0.0f ? a / q : std::numeric_limits<float>::infinity() };
+        for (float candidate : roots)
+            if (candidate >= 0.0f && candidate < root)
+                root = candidate;
+    }
+    if (!(root <= span))
+        return false;
+    outDistance = enter + root;
+    return true;
+}
+
+/*One level of the pyramid: the lowest and highest height under each node, row-major*/
+struct TerrainPyramidLevel
+{
+    int width{ 0 };
+    int height{ 0 };
+    std::vector<float> minHeights;
+    std::vector<float> maxHeights;
+};
+
+/*How far lineOfSight lifts its segment, in height units: endpoints on the surface, and segments
+  grazing a flat or planar stretch of it, would otherwise meet it within rounding. Well above the
+  rounding of heights in the thousands.*/
+const float TERRAIN_SIGHT_TOLERANCE = 1e-3f;
+
+/*Edits smaller than this many cells update the pyramid on the calling thread*/
+const size_t TERRAIN_PYRAMID_PARALLEL_AREA = size_t(1) << 14;
+
+/*Level 0 holds the corner range of every grid cell, each level above the range of 2x2 nodes below,
+  up to a single root. It stores ranges only and is rebuilt from the heights it was built over.*/
+class TerrainHeightPyramid
+{
+public:
+    /*threadCount 0 uses every pool thread plus the caller, 1 runs serially*/
+    void build(const float* heights, int width, int height, unsigned int threadCount = 0)
+    {
+        gridWidth = width;
+        gridHeight = height;
+        levels.clear();
+        if (width < 2 || height < 2)
+            return;
+        int levelWidth = width - 1, levelHeight = height - 1;
+        while (true) {
+            TerrainPyramidLevel level;
+            level.width = levelWidth;
+            level.height = levelHeight;
+            level.minHeights.resize((size_t)levelWidth * levelHeight);
+            level.maxHeights.resize(level.minHeights.size());
+            levels.push_back(std::move(level));
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+            levelWidth = (levelWidth + 1) / 2;
+            levelHeight = (levelHeight + 1) / 2;
+        }
+        update(heights, 0, 0, width, height, threadCount);
+    }
+
+    /*Heights of vertices [x0, x1) x [z0, z1) changed: the cells around them and the nodes above*/
+    void update(const float* heights, int x0, int z0, int x1, int z1, unsigned int threadCount = 0)
+    {
+        if (levels.empty())
+            return;
+        int cellX0 = std::max(x0 - 1, 0), cellZ0 = std::max(z0 - 1, 0);
+        int cellX1 = std::min(x1, gridWidth - 1), cellZ1 = std::min(z1, gridHeight - 1);
+        if (cellX1 <= cellX0 || cellZ1 <= cellZ0)
+            return;
+
+        TerrainPyramidLevel& cells = levels[0];
+        forEachRow(cellZ0, cellZ1, size_t(cellX1 - cellX0) * (cellZ1 - cellZ0), threadCount, [&](int z) {
+            const float* row = heights + (size_t)z * gridWidth;
+            for (int x = cellX0; x < cellX1; ++x) {
+                float h00 = row[x], h10 = row[x + 1], h01 = row[x + gridWidth], h11 = row[x + gridWidth + 1];
+                cells.minHeights[(size_t)z * cells.width + x] = std::min(std::min(h00, h10), std::min(h01, h11));
+                cells.maxHeights[(size_t)z * cells.width + x] = std::max(std::max(h00, h10), std::max(h01, h11));
+            }
+        });
+
+        for (size_t level = 1; level < levels.size(); ++level) {
+            const TerrainPyramidLevel& below = levels[level - 1];
+            TerrainPyramidLevel& above = levels[level];
+            cellX0 >>= 1;
+            cellZ0 >>= 1;
+            cellX1 = (cellX1 + 1) >> 1;
+            cellZ1 = (cellZ1 + 1) >> 1;
+            forEachRow(cellZ0, cellZ1, size_t(cellX1 - cellX0) * (cellZ1 - cellZ0), threadCount, [&](int z) {
+                for (int x = cellX0; x < cellX1; ++x) {
+                    float lowest = std::numeric_limits<float>::infinity(), highest = -lowest;
+                    for (int childZ = 2 * z; childZ < std::min(2 * z + 2, below.height); ++childZ) {
+                        for (int childX = 2 * x; childX < std::min(2 * x + 2, below.width); ++childX) {
+                            lowest = std::min(lowest, below.minHeights[(size_t)childZ * below.width + childX]);
+                            highest = std::max(highest, below.maxHeights[(size_t)childZ * below.width + childX]);
+                        }
+                    }
+                    above.minHeights[(size_t)z * above.width + x] = lowest;
+                    above.maxHeights[(size_t)z * above.width + x] = highest;
+                }
+            });
+        }
+    }
+
+    /*Every height was multiplied by ratio > 0; the order of heights, and so every node's extremes,
+      scales with them exactly*/
+    void scale(float ratio)
+    {
+        for (TerrainPyramidLevel& level : levels) {
+            for (size_t i = 0; i < level.minHeights.size(); ++i) {
+                level.minHeights[i] *= ratio;
+                level.maxHeights[i] *= ratio;
+            }
+        }
+    }
+
+    bool empty() const { return levels.empty(); }
+    const std::vector<TerrainPyramidLevel>& pyramidLevels() const { return levels; }
+
+private:
+    template <typename Fn>
+    static void forEachRow(int z0, int z1, size_t area, unsigned int threadCount, Fn&& fn)
+    {
+        ThreadPool& pool = sharedThreadPool();
+        size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+        if (area < TERRAIN_PYRAMID_PARALLEL_AREA)
+            taskCount = 1;
+        pool.parallelFor(size_t(z1 - z0), taskCount, [&](size_t, size_t firstRow, size_t lastRow) {
+            for (size_t z = firstRow; z < lastRow; ++z)
+                fn(z0 + int(z));
+        });
+    }
+
+    int gridWidth{ 0 };
+    int gridHeight{ 0 };
+    std::vector<TerrainPyramidLevel> levels;
+};
+
+/*Rays traced through the pyramid, nearest node first: a node the ray passes entirely above is
+  skipped with everything under it, and one it passes entirely below ends a line-of-sight test
+  without finding the crossing. A view like TerrainHeightQuery: heights and pyramid must outlive it
+  and stay in step.*/
+class TerrainRaycaster
+{
+public:
+    TerrainRaycaster() = default;
+
+    TerrainRaycaster(const float* heights, int width, int height, const TerrainHeightPyramid& pyramid)
+        : heights(heights), width(width), height(height), pyramid(&pyramid)
+    {
+    }
+
+    bool valid() const { return heights && pyramid && !pyramid->empty(); }
+
+    TerrainRayHit raycast(const TerrainRay& ray) const
+    {
+        TerrainRayHit hit;
+        TerrainGridRay gridRay;
+        if (!valid() || !makeTerrainGridRay(ray, width, height, gridRay))
+            return hit;
+        float distance;
+        if (!traverse(gridRay, false, distance))
+            return hit;
+        hit.hit = true;
+        hit.distance = distance;
+        hit.position = ray.origin + gridRay.direction * distance;
+        return hit;
+    }
+
+    /*outHits[i] for rays[i], count rays split over the shared pool; threadCount 0 uses every pool
+      thread plus the caller, 1 runs serially*/
+    void raycast(const TerrainRay* rays, TerrainRayHit* outHits, size_t count, unsigned int threadCount = 0) const
+    {
+        ThreadPool& pool = sharedThreadPool();
+        size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+        pool.parallelFor(count, taskCount, [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+                outHits[i] = raycast(rays[i]);
+        });
+    }
+
+    /*Nothing of the terrain between from and to, which may lie on the surface: the segment is tested
+      TERRAIN_SIGHT_TOLERANCE above them, so it must dip below the surface to be blocked*/
+    bool lineOfSight(const glm::vec3& from, const glm::vec3& to) const
+    {
+        TerrainRay ray;
+        ray.origin = from + glm::vec3(0.0f, TERRAIN_SIGHT_TOLERANCE, 0.0f);
+        ray.direction = to - from;
+        ray.maxDistance = glm::length(ray.direction);
+        TerrainGridRay gridRay;
+        float distance;
+        if (!valid() || !makeTerrainGridRay(ray, width, height, gridRay))
+            return true;
+        return !traverse(gridRay, true, distance);
+    }
+
+    /*outVisible[i] for the segment fromPoints[i] to toPoints[i], over the pool like raycast; with a
+      single to point for every segment, e.g. toward the sun, pass toCount 1*/
+    void lineOfSight(const glm::vec3* fromPoints, const glm::vec3* toPoints, size_t toCount, bool* outVisible, size_t count,
+        unsigned int threadCount = 0) const
+    {
+        ThreadPool& pool = sharedThreadPool();
+        size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+        pool.parallelFor(count, taskCount, [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+                outVisible[i] = lineOfSight(fromPoints[i], toPoints[toCount == 1 ? 0 : i]);
+        });
+    }
+
+private:
+    struct Node
+    {
+        int level;
+        int x;
+        int z;
+    };
+
+    /*Nearest hit, or with anyHit the first proof of one, whose distance is then not the nearest*/
+    bool traverse(const TerrainGridRay& ray, bool anyHit, float& outDistance) const
+    {
+        const std::vector<TerrainPyramidLevel>& levels = pyramid->pyramidLevels();
+        /*Each descent pops one node and pushes at most four*/
+        Node stack[3 * 32 + 1];
+        int top = 0;
+        stack[top++] = Node{ int(levels.size()) - 1, 0, 0 };
+        /*The child the ray enters a node through comes first, the opposite one last; a ray crosses at
+          most one of the other two*/
+        int nearX = ray.direction.x < 0.0f ? 1 : 0, nearZ = ray.direction.z < 0.0f ? 1 : 0;
+
+        while (top > 0) {
+            Node node = stack[--top];
+            float x0 = float(node.x << node.level), z0 = float(node.z << node.level);
+            float x1 = float(std::min((node.x + 1) << node.level, width - 1));
+            float z1 = float(std::min((node.z + 1) << node.level, height - 1));
+            float enter, exit;
+            if (!terrainRaySpan(ray, x0, z0, x1, z1, enter, exit))
+                continue;
+
+            const TerrainPyramidLevel& level = levels[node.level];
+            size_t index = (size_t)node.z * level.width + node.x;
+            float enterY = ray.origin.y + ray.direction.y * enter, exitY = ray.origin.y + ray.direction.y * exit;
+            if (std::min(enterY, exitY) > level.maxHeights[index])
+                continue;
+            if (anyHit && std::max(enterY, exitY) < level.minHeights[index]) {
+                outDistance = enter;
+                return true;
+            }
+            if (node.level == 0) {
+                if (intersectTerrainCell(heights, width, ray, node.x, node.z, outDistance))
+                    return true;
+                continue;
+            }
+
+            const TerrainPyramidLevel& children = levels[node.level - 1];
+            const int order[4][2] = { { 1 - nearX, 1 - nearZ }, { nearX, 1 - nearZ }, { 1 - nearX, nearZ }, { nearX, nearZ } };
+            for (const int* offset : order) {
+                int childX = 2 * node.x + offset[0], childZ = 2 * node.z + offset[1];
+                if (childX < children.width && childZ < children.height)
+                    stack[top++] = Node{ node.level - 1, childX, childZ };
+            }
+        }
+        return false;
+    }
+
+    const float* heights{ nullptr };
+    int width{ 0 };
+    int height{ 0 };
+    const TerrainHeightPyramid* pyramid{ nullptr };
+};
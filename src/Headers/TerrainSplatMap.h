@@ -0,0 +1,288 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "../includes/GLAD/glad.h"
+#include "../includes/glm/glm.hpp"
+#include "SIMDHelper.h"
+#include "ThreadPool.h"
+
+/*Splat map: four terrain layer weights per grid vertex packed into one RGBA8 texel, in place of a
+  float blend map that could only hold the normalized height. R and G split the ground into low and
+  high by height over the blend range, B takes steep slopes and A concave cells (valley floors,
+  hollows). The weights of a texel sum to 1 before quantization; the terrain shader renormalizes
+  them. Slope and curvature come from the same one-cell central differences as the vertex frames, so
+  a texel depends on its heights and their four neighbours only.*/
+
+/*Layers per texel; a texel is a uint32 with R in the low byte, uploaded as GL_UNSIGNED_INT_8_8_8_8_REV
+  so the bytes land in RGBA order on any host*/
+const int TERRAIN_SPLAT_LAYERS = 4;
+
+/*Which layers the terrain shader lights with its second material set, the rest take the first:
+  high ground and steep slopes are rock, low ground and hollows mud*/
+const glm::vec4 TERRAIN_SPLAT_SECOND_SET(0.0f, 1.0f, 1.0f, 0.0f);
+
+/*Ramps of the slope and curvature layers. Slope is rise per cell, curvature the height the four
+  neighbours average above the cell times 4 (the discrete Laplacian); a layer fades in from its start
+  and is full from its end, and a ramp whose end is not past its start is off. The defaults suit the
+  50-cell scene, whose slopes reach about 0.35 and hollows 0.3.*/
+struct TerrainSplatSettings
+{
+    float slopeStart{ 0.2f };
+    float slopeEnd{ 0.45f };
+    float curvatureStart{ 0.05f };
+    float curvatureEnd{ 0.25f };
+};
+
+/*The settings and a blend range as the kernels consume them: offsets and reciprocals of the ramps,
+  0 for a ramp that is off*/
+struct TerrainSplatRamps
+{
+    float minHeight;
+    float heightInverse;
+    float slopeStart;
+    float slopeInverse;
+    float curvatureStart;
+    float curvatureInverse;
+};
+
+inline TerrainSplatRamps makeTerrainSplatRamps(const TerrainSplatSettings& settings, float minHeight, float maxHeight)
+{
+    TerrainSplatRamps ramps;
+    ramps.minHeight = minHeight;
+    ramps.heightInverse = maxHeight > minHeight ? 1.0f / (maxHeight - minHeight) : 0.0f;
+    ramps.slopeStart = settings.slopeStart;
+    ramps.slopeInverse = settings.slopeEnd > settings.slopeStart ? 1.0f / (settings.slopeEnd - settings.slopeStart) : 0.0f;
+    ramps.curvatureStart = settings.curvatureStart;
+    ramps.curvatureInverse = settings.curvatureEnd > settings.curvatureStart ? 1.0f / (settings.curvatureEnd - settings.curvatureStart) : 0.0f;
+    return ramps;
+}
+
+inline float terrainSplatRamp(float value, float start, float inverse)
+{
+    return std::max(0.0f, std::min(1.0f, (value - start) * inverse));
+}
+
+inline uint32_t packTerrainSplatWeight(float weight)
+{
+    return uint32_t(weight * 255.0f + 0.5f);
+}
+
+/*Texel of the cell at row[x]; up and down are the rows either side (the row itself past the edges)
+  and inverseSpanZ 1 over the rows between them*/
+inline uint32_t terrainSplatTexel(const float* up, const float* row, const float* down, int x, int width, float inverseSpanZ, const TerrainSplatRamps& ramps)
+{
+    int left = std::max(x - 1, 0), right = std::min(x + 1, width - 1);
+    float centre = row[x];
+    float slopeX = (row[right] - row[left]) * (right - left == 2 ? 0.5f : 1.0f);
+    float slopeZ = (up[x] - down[x]) * inverseSpanZ;
+    float slope = std::sqrt(slopeX * slopeX + slopeZ * slopeZ);
+    float curvature = ((row[left] + row[right]) + (down[x] + up[x])) - centre * 4.0f;
+
+    float steep = terrainSplatRamp(slope, ramps.slopeStart, ramps.slopeInverse);
+    float concave = terrainSplatRamp(curvature, ramps.curvatureStart, ramps.curvatureInverse) * (1.0f - steep);
+    float ground = (1.0f - steep) - concave;
+    float high = ground * terrainSplatRamp(centre, ramps.minHeight, ramps.heightInverse);
+    float low = ground - high;
+    return packTerrainSplatWeight(low) | (packTerrainSplatWeight(high) << 8) | (packTerrainSplatWeight(steep) << 16) | (packTerrainSplatWeight(concave) << 24);
+}
+
+#if defined(SIMD_HAS_X86)
+inline __m128 terrainSplatRampSSE2(__m128 value, __m128 start, __m128 inverse)
+{
+    return _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_sub_ps(value, start), inverse)));
+}
+
+inline __m128i packTerrainSplatWeightSSE2(__m128 weight)
+{
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(weight, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+/*Cells [x, x1) of the interior columns 4 at a time, out[x - x0] for cell x; returns where it stopped*/
+inline int terrainSplatRowSSE2(const float* up, const float* row, const float* down, int x, int x0, int x1, int width, float inverseSpanZ,
+    const TerrainSplatRamps& ramps, uint32_t* out)
+{
+    const __m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f), four = _mm_set1_ps(4.0f), spanZ = _mm_set1_ps(inverseSpanZ);
+    const __m128 minHeight = _mm_set1_ps(ramps.minHeight), heightInverse = _mm_set1_ps(ramps.heightInverse);
+    const __m128 slopeStart = _mm_set1_ps(ramps.slopeStart), slopeInverse = _mm_set1_ps(ramps.slopeInverse);
+    const __m128 curvatureStart = _mm_set1_ps(ramps.curvatureStart), curvatureInverse = _mm_set1_ps(ramps.curvatureInverse);
+    int end = std::min(x1, width - 1);
+    for (; x + 4 <= end; x += 4) {
+        __m128 centre = _mm_loadu_ps(row + x), left = _mm_loadu_ps(row + x - 1), right = _mm_loadu_ps(row + x + 1);
+        __m128 above = _mm_loadu_ps(up + x), below = _mm_loadu_ps(down + x);
+        __m128 slopeX = _mm_mul_ps(_mm_sub_ps(right, left), half);
+        __m128 slopeZ = _mm_mul_ps(_mm_sub_ps(above, below), spanZ);
+        __m128 slope = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX), _mm_mul_ps(slopeZ, slopeZ)));
+        __m128 curvature = _mm_sub_ps(_mm_add_ps(_mm_add_ps(left, right), _mm_add_ps(below, above)), _mm_mul_ps(centre, four));
+
+        __m128 steep = terrainSplatRampSSE2(slope, slopeStart, slopeInverse);
+        __m128 flat = _mm_sub_ps(one, steep);
+        __m128 concave = _mm_mul_ps(terrainSplatRampSSE2(curvature, curvatureStart, curvatureInverse), flat);
+        __m128 ground = _mm_sub_ps(flat, concave);
+        __m128 high = _mm_mul_ps(ground, terrainSplatRampSSE2(centre, minHeight, heightInverse));
+        __m128 low = _mm_sub_ps(ground, high);
+        __m128i texels = _mm_or_si128(_mm_or_si128(packTerrainSplatWeightSSE2(low), _mm_slli_epi32(packTerrainSplatWeightSSE2(high), 8)),
+            _mm_or_si128(_mm_slli_epi32(packTerrainSplatWeightSSE2(steep), 16), _mm_slli_epi32(packTerrainSplatWeightSSE2(concave), 24)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (x - x0)), texels);
+    }
+    return x;
+}
+
+SIMD_TARGET_AVX2 inline __m256 terrainSplatRampAVX2(__m256 value, __m256 start, __m256 inverse)
+{
+    return _mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_sub_ps(value, start), inverse)));
+}
+
+SIMD_TARGET_AVX2 inline __m256i packTerrainSplatWeightAVX2(__m256 weight)
+{
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(weight, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+SIMD_TARGET_AVX2 inline int terrainSplatRowAVX2(const float* up, const float* row, const float* down, int x, int x0, int x1, int width, float inverseSpanZ,
+    const TerrainSplatRamps& ramps, uint32_t* out)
+{
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), four = _mm256_set1_ps(4.0f), spanZ = _mm256_set1_ps(inverseSpanZ);
+    const __m256 minHeight = _mm256_set1_ps(ramps.minHeight), heightInverse = _mm256_set1_ps(ramps.heightInverse);
+    const __m256 slopeStart = _mm256_set1_ps(ramps.slopeStart), slopeInverse = _mm256_set1_ps(ramps.slopeInverse);
+    const __m256 curvatureStart = _mm256_set1_ps(ramps.curvatureStart), curvatureInverse = _mm256_set1_ps(ramps.curvatureInverse);
+    int end = std::min(x1, width - 1);
+    for (; x + 8 <= end; x += 8) {
+        __m256 centre = _mm256_loadu_ps(row + x), left = _mm256_loadu_ps(row + x - 1), right = _mm256_loadu_ps(row + x + 1);
+        __m256 above = _mm256_loadu_ps(up + x), below = _mm256_loadu_ps(down + x);
+        __m256 slopeX = _mm256_mul_ps(_mm256_sub_ps(right, left), half);
+        __m256 slopeZ = _mm256_mul_ps(_mm256_sub_ps(above, below), spanZ);
+        __m256 slope = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(slopeX, slopeX), _mm256_mul_ps(slopeZ, slopeZ)));
+        __m256 curvature = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(left, right), _mm256_add_ps(below, above)), _mm256_mul_ps(centre, four));
+
+        __m256 steep = terrainSplatRampAVX2(slope, slopeStart, slopeInverse);
+        __m256 flat = _mm256_sub_ps(one, steep);
+        __m256 concave = _mm256_mul_ps(terrainSplatRampAVX2(curvature, curvatureStart, curvatureInverse), flat);
+        __m256 ground = _mm256_sub_ps(flat, concave);
+        __m256 high = _mm256_mul_ps(ground, terrainSplatRampAVX2(centre, minHeight, heightInverse));
+        __m256 low = _mm256_sub_ps(ground, high);
+        __m256i texels = _mm256_or_si256(_mm256_or_si256(packTerrainSplatWeightAVX2(low), _mm256_slli_epi32(packTerrainSplatWeightAVX2(high), 8)),
+            _mm256_or_si256(_mm256_slli_epi32(packTerrainSplatWeightAVX2(steep), 16), _mm256_slli_epi32(packTerrainSplatWeightAVX2(concave), 24)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (x - x0)), texels);
+    }
+    return x;
+}
+#endif
+
+/*Texels of columns [x0, x1) of a row into out[0, x1 - x0), with up and down and inverseSpanZ as
+  terrainSplatTexel takes them: the edge columns and what the vectors leave in scalar, the same bits
+  at every level*/
+inline void terrainSplatRow(const float* up, const float* row, const float* down, int width, float inverseSpanZ, int x0, int x1,
+    const TerrainSplatRamps& ramps, uint32_t* out, SIMDLevel level)
+{
+    int x = x0;
+    if (x == 0 && x < x1) {
+        out[0] = terrainSplatTexel(up, row, down, 0, width, inverseSpanZ, ramps);
+        ++x;
+    }
+#if defined(SIMD_HAS_X86)
+    if (level == SIMD_AVX2)
+        x = terrainSplatRowAVX2(up, row, down, x, x0, x1, width, inverseSpanZ, ramps, out);
+    else if (level == SIMD_SSE2)
+        x = terrainSplatRowSSE2(up, row, down, x, x0, x1, width, inverseSpanZ, ramps, out);
+#endif
+    for (; x < x1; ++x)
+        out[x - x0] = terrainSplatTexel(up, row, down, x, width, inverseSpanZ, ramps);
+}
+
+/*Columns [x0, x1) of row z of a row-major width x height grid*/
+inline void buildTerrainSplatRow(const float* heights, int width, int height, int z, int x0, int x1, const TerrainSplatRamps& ramps, uint32_t* out,
+    SIMDLevel level = activeSIMDLevel())
+{
+    const float* row = heights + (size_t)z * width;
+    const float* up = z < height - 1 ? row + width : row;
+    const float* down = z > 0 ? row - width : row;
+    terrainSplatRow(up, row, down, width, up != row && down != row ? 0.5f : 1.0f, x0, x1, ramps, out, level);
+}
+
+/*The whole grid's texels, row-major, with the height layers over [minHeight, maxHeight]. Rows are
+  split over the shared pool; threadCount 0 uses every pool thread plus the caller. level is clamped
+  to what the CPU supports and does not change the result.*/
+inline void generateTerrainSplatMap(const float* heights, int width, int height, float minHeight, float maxHeight, const TerrainSplatSettings& settings,
+    std::vector<uint32_t>& outTexels, unsigned int threadCount = 0, SIMDLevel level = activeSIMDLevel())
+{
+    outTexels.resize((size_t)width * height);
+    level = std::min(level, activeSIMDLevel());
+    TerrainSplatRamps ramps = makeTerrainSplatRamps(settings, minHeight, maxHeight);
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    pool.parallelFor((size_t)height, taskCount, [&](size_t, size_t firstRow, size_t lastRow) {
+        for (int z = int(firstRow); z < int(lastRow); ++z)
+            buildTerrainSplatRow(heights, width, height, z, 0, width, ramps, outTexels.data() + (size_t)z * width, level);
+    });
+}
+
+/*-----------GPU----------*/
+class TerrainSplatTexture
+{
+public:
+    TerrainSplatTexture() = default;
+
+    /*Delete copy constructor and copy assignment operators*/
+    TerrainSplatTexture(const TerrainSplatTexture&) = delete;
+    TerrainSplatTexture& operator=(const TerrainSplatTexture&) = delete;
+
+    ~TerrainSplatTexture()
+    {
+        if (texture)
+            glDeleteTextures(1, &texture);
+    }
+
+    /*One glTexSubImage2D when the size is unchanged, otherwise the texture is reallocated*/
+    void upload(const uint32_t* texels, int inWidth, int inHeight)
+    {
+        if (!texture) {
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            /*One texel per grid vertex over the whole terrain: nothing to repeat, and the edges must
+              not blend with the far side*/
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (inWidth == width && inHeight == height) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, texels);
+        }
+        else {
+            width = inWidth;
+            height = inHeight;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, texels);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    /*An uninitialized width x height texture, for maps built a band at a time with uploadRegion*/
+    void allocate(int inWidth, int inHeight)
+    {
+        /*Forgetting the size makes upload reallocate*/
+        width = 0;
+        height = 0;
+        upload(nullptr, inWidth, inHeight);
+    }
+
+    /*Texels [x, x + columns) x [z, z + rows) from a tightly packed block, for edits*/
+    void uploadRegion(int x, int z, int columns, int rows, const uint32_t* texels)
+    {
+        if (!texture)
+            return;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, z, columns, rows, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, texels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    GLuint textureID() const { return texture; }
+    size_t gpuBytes() const { return (size_t)width * height * sizeof(uint32_t); }
+
+private:
+    int width{ 0 };
+    int height{ 0 };
+    GLuint texture{ 0 };
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+/*Fixed-size pool of worker threads. Callers of parallelFor help run queued tasks while they wait,
+  so parallel helpers can be called from inside pool tasks without deadlocking.*/
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount())
+    {
+        threadCount = std::max(1u, threadCount);
+        for (unsigned int i = 0; i < threadCount; ++i)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    /*Delete copy constructor and copy assignment operators*/
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /*Destructor, finishes queued tasks before joining*/
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    static unsigned int defaultThreadCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    unsigned int size() const
+    {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    /*Queue a task and get its result through a future*/
+    template <typename Fn>
+    auto submit(Fn&& fn) -> std::future<decltype(fn())>
+    {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        std::future<Result> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    /*Split [0, count) into taskCount contiguous ranges and run fn(taskIndex, begin, end) on each.
+      Blocks until every range is done; the calling thread runs the first range itself.*/
+    template <typename Fn>
+    void parallelFor(size_t count, size_t taskCount, Fn&& fn)
+    {
+        if (count == 0)
+            return;
+        taskCount = std::max<size_t>(1, std::min(taskCount, count));
+        if (taskCount == 1) {
+            fn(size_t(0), size_t(0), count);
+            return;
+        }
+
+        size_t remaining = taskCount - 1;
+        std::mutex doneMutex;
+        std::condition_variable doneCondition;
+
+        for (size_t t = 1; t < taskCount; ++t) {
+            size_t begin = count * t / taskCount;
+            size_t end = count * (t + 1) / taskCount;
+            enqueue([&fn, &remaining, &doneMutex, &doneCondition, t, begin, end]() {
+                fn(t, begin, end);
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--remaining == 0)
+                    doneCondition.notify_all();
+            });
+        }
+
+        fn(size_t(0), size_t(0), count / taskCount);
+
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (remaining == 0)
+                    break;
+            }
+            if (runPendingTask())
+                continue;
+            std::unique_lock<std::mutex> lock(doneMutex);
+            doneCondition.wait_for(lock, std::chrono::milliseconds(1), [&remaining]() { return remaining == 0; });
+        }
+    }
+
+    /*Same as above with one range per worker plus the caller*/
+    template <typename Fn>
+    void parallelFor(size_t count, Fn&& fn)
+    {
+        parallelFor(count, size_t(size()) + 1, std::forward<Fn>(fn));
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+
+    void enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push_back(std::move(task));
+        }
+        queueCondition.notify_one();
+    }
+
+    bool runPendingTask()
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (tasks.empty())
+                return false;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    void workerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+/*Process-wide pool shared by the loaders and generators*/
+inline ThreadPool& sharedThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "../includes/glm/glm.hpp"
+#include "ThreadPool.h"
+
+/*Float heights stored in 8x8 tiles instead of rows: a tile is 256 bytes, four cache lines, with its
+  rows 8 floats each, so a cell's neighbours in z are 32 bytes away instead of a whole grid row. Kernels
+  that read a neighbourhood around scattered cells, like bilinear queries and erosion droplets, touch a
+  few lines instead of one per row of the footprint, and a stencil pass can copy a tile with a one-cell
+  apron into a small scratch block and run on that. Grids sweeping whole rows in order are already
+  served well by the row-major layout the uploads, the editor and the cache use, which is one
+  conversion away either way. The editor can keep one in step with its rows for its queries and the
+  frames of imported heights (TerrainEditor::setTiledHeights).*/
+
+const int TILED_HEIGHTFIELD_TILE_SHIFT = 3;
+const int TILED_HEIGHTFIELD_TILE = 1 << TILED_HEIGHTFIELD_TILE_SHIFT;
+const int TILED_HEIGHTFIELD_TILE_CELLS = TILED_HEIGHTFIELD_TILE * TILED_HEIGHTFIELD_TILE;
+/*A tile and the ring of neighbours a 3x3 stencil reads around it*/
+const int TILED_HEIGHTFIELD_APRON_SIDE = TILED_HEIGHTFIELD_TILE + 2;
+
+class TiledHeightfield
+{
+public:
+    TiledHeightfield() = default;
+
+    /*Row-major width x height heights, tiles split over the pool; threadCount 0 uses every pool thread
+      plus the caller, 1 runs serially. Cells of the last tiles past the grid are 0.*/
+    void assign(const float* heights, int inWidth, int inHeight, unsigned int threadCount = 0)
+    {
+        resize(inWidth, inHeight);
+        forEachTileRow(threadCount, [&](int tileZ) {
+            for (int tileX = 0; tileX < tilesX; ++tileX) {
+                float* tile = tileData(tileX, tileZ);
+                int x0 = tileX << TILED_HEIGHTFIELD_TILE_SHIFT, z0 = tileZ << TILED_HEIGHTFIELD_TILE_SHIFT;
+                int columns = std::min(TILED_HEIGHTFIELD_TILE, width - x0), rows = std::min(TILED_HEIGHTFIELD_TILE, height - z0);
+                for (int z = 0; z < rows; ++z)
+                    std::copy(heights + (size_t)(z0 + z) * width + x0, heights + (size_t)(z0 + z) * width + x0 + columns, tile + z * TILED_HEIGHTFIELD_TILE);
+            }
+        });
+    }
+
+    /*Cells [x0, x1) x [z0, z1) again from the same row-major heights assign took, after an edit.
+      Serial: edits are small, and their callers already split bigger work over the pool.*/
+    void update(const float* heights, int x0, int z0, int x1, int z1)
+    {
+        for (int z = z0; z < z1; ++z) {
+            const float* row = heights + (size_t)z * width;
+            for (int x = x0; x < x1;) {
+                int runEnd = std::min(x1, ((x >> TILED_HEIGHTFIELD_TILE_SHIFT) + 1) << TILED_HEIGHTFIELD_TILE_SHIFT);
+                std::copy(row + x, row + runEnd, samples.data() + index(x, z));
+                x = runEnd;
+            }
+        }
+    }
+
+    /*Every height multiplied by ratio, as the row-major grid it mirrors*/
+    void scale(float ratio, unsigned int threadCount = 0)
+    {
+        forEachTileRow(threadCount, [&](int tileZ) {
+            float* tile = tileData(0, tileZ);
+            for (size_t i = 0; i < (size_t)tilesX * TILED_HEIGHTFIELD_TILE_CELLS; ++i)
+                tile[i] *= ratio;
+        });
+    }
+
+    /*Back to the row-major layout, e.g. for an upload*/
+    void copyTo(float* outHeights, unsigned int threadCount = 0) const
+    {
+        forEachTileRow(threadCount, [&](int tileZ) {
+            for (int tileX = 0; tileX < tilesX; ++tileX) {
+                const float* tile = tileData(tileX, tileZ);
+                int x0 = tileX << TILED_HEIGHTFIELD_TILE_SHIFT, z0 = tileZ << TILED_HEIGHTFIELD_TILE_SHIFT;
+                int columns = std::min(TILED_HEIGHTFIELD_TILE, width - x0), rows = std::min(TILED_HEIGHTFIELD_TILE, height - z0);
+                for (int z = 0; z < rows; ++z)
+                    std::copy(tile + z * TILED_HEIGHTFIELD_TILE, tile + z * TILED_HEIGHTFIELD_TILE + columns, outHeights + (size_t)(z0 + z) * width + x0);
+            }
+        });
+    }
+
+    size_t index(int x, int z) const
+    {
+        size_t tile = (size_t)(z >> TILED_HEIGHTFIELD_TILE_SHIFT) * tilesX + (x >> TILED_HEIGHTFIELD_TILE_SHIFT);
+        return tile * TILED_HEIGHTFIELD_TILE_CELLS + ((z & (TILED_HEIGHTFIELD_TILE - 1)) << TILED_HEIGHTFIELD_TILE_SHIFT) + (x & (TILED_HEIGHTFIELD_TILE - 1));
+    }
+
+    float at(int x, int z) const { return samples[index(x, z)]; }
+    float& at(int x, int z) { return samples[index(x, z)]; }
+
+    /*Heights at the four corners of cell (cellX, cellZ), which must be inside the grid*/
+    void cellCorners(int cellX, int cellZ, float& h00, float& h10, float& h01, float& h11) const
+    {
+        if ((cellX & (TILED_HEIGHTFIELD_TILE - 1)) != TILED_HEIGHTFIELD_TILE - 1 && (cellZ & (TILED_HEIGHTFIELD_TILE - 1)) != TILED_HEIGHTFIELD_TILE - 1) {
+            /*The whole cell in one tile*/
+            const float* corner = samples.data() + index(cellX, cellZ);
+            h00 = corner[0];
+            h10 = corner[1];
+            h01 = corner[TILED_HEIGHTFIELD_TILE];
+            h11 = corner[TILED_HEIGHTFIELD_TILE + 1];
+        }
+        else {
+            h00 = at(cellX, cellZ);
+            h10 = at(cellX + 1, cellZ);
+            h01 = at(cellX, cellZ + 1);
+            h11 = at(cellX + 1, cellZ + 1);
+        }
+    }
+
+    /*Height of the bilinear surface at grid position (gridX, gridZ), clamped to the grid, with the
+      same operations as TerrainHeightQuery so both give the same bits*/
+    float heightAt(float gridX, float gridZ) const
+    {
+        gridX = std::min(std::max(gridX, 0.0f), float(width - 1));
+        gridZ = std::min(std::max(gridZ, 0.0f), float(height - 1));
+        int cellX = std::min(int(gridX), width - 2), cellZ = std::min(int(gridZ), height - 2);
+        float fracX = gridX - float(cellX), fracZ = gridZ - float(cellZ);
+
+        float h00, h10, h01, h11;
+        cellCorners(cellX, cellZ, h00, h10, h01, h11);
+        float rowX = h10 - h00, nextRowX = h11 - h01;
+        float top = h00 + rowX * fracX, bottom = h01 + nextRowX * fracX;
+        return top + (bottom - top) * fracZ;
+    }
+
+    /*Tile (tileX, tileZ) with a one-cell apron into a TILED_HEIGHTFIELD_APRON_SIDE^2 block, row-major.
+      Cells past the grid edges repeat the edge, as the clamped stencils read them.*/
+    void gatherApron(int tileX, int tileZ, float* outBlock) const
+    {
+        int x0 = (tileX << TILED_HEIGHTFIELD_TILE_SHIFT) - 1, z0 = (tileZ << TILED_HEIGHTFIELD_TILE_SHIFT) - 1;
+        const float* tile = tileData(tileX, tileZ);
+        if (x0 >= 0 && z0 >= 0 && x0 + TILED_HEIGHTFIELD_APRON_SIDE <= width && z0 + TILED_HEIGHTFIELD_APRON_SIDE <= height) {
+            /*Away from the edges: whole rows of this tile and the neighbours' facing rows and columns*/
+            const int last = TILED_HEIGHTFIELD_TILE - 1, side = TILED_HEIGHTFIELD_APRON_SIDE;
+            const float* down = tileData(tileX, tileZ - 1) + last * TILED_HEIGHTFIELD_TILE;
+            const float* up = tileData(tileX, tileZ + 1);
+            const float* left = tileData(tileX - 1, tileZ) + last;
+            const float* right = tileData(tileX + 1, tileZ);
+            outBlock[0] = tileData(tileX - 1, tileZ - 1)[TILED_HEIGHTFIELD_TILE_CELLS - 1];
+            outBlock[side - 1] = tileData(tileX + 1, tileZ - 1)[last * TILED_HEIGHTFIELD_TILE];
+            outBlock[(side - 1) * side] = tileData(tileX - 1, tileZ + 1)[last];
+            outBlock[side * side - 1] = tileData(tileX + 1, tileZ + 1)[0];
+            std::copy(down, down + TILED_HEIGHTFIELD_TILE, outBlock + 1);
+            std::copy(up, up + TILED_HEIGHTFIELD_TILE, outBlock + (side - 1) * side + 1);
+            for (int z = 0; z < TILED_HEIGHTFIELD_TILE; ++z) {
+                float* row = outBlock + (z + 1) * side;
+                row[0] = left[z * TILED_HEIGHTFIELD_TILE];
+                std::copy(tile + z * TILED_HEIGHTFIELD_TILE, tile + (z + 1) * TILED_HEIGHTFIELD_TILE, row + 1);
+                row[side - 1] = right[z * TILED_HEIGHTFIELD_TILE];
+            }
+            return;
+        }
+        for (int z = 0; z < TILED_HEIGHTFIELD_APRON_SIDE; ++z) {
+            float* row = outBlock + z * TILED_HEIGHTFIELD_APRON_SIDE;
+            int gridZ = std::min(std::max(z0 + z, 0), height - 1);
+            bool insideTile = z > 0 && z <= TILED_HEIGHTFIELD_TILE && z0 + z < height;
+            for (int x = 0; x < TILED_HEIGHTFIELD_APRON_SIDE; ++x) {
+                int gridX = std::min(std::max(x0 + x, 0), width - 1);
+                bool inside = insideTile && x > 0 && x <= TILED_HEIGHTFIELD_TILE && x0 + x < width;
+                row[x] = inside ? tile[(z - 1) * TILED_HEIGHTFIELD_TILE + x - 1] : at(gridX, gridZ);
+            }
+        }
+    }
+
+    int gridWidth() const { return width; }
+    int gridHeight() const { return height; }
+    int tilesPerRow() const { return tilesX; }
+    int tilesPerColumn() const { return tilesZ; }
+
+    bool empty() const { return samples.empty(); }
+    const float* data() const { return samples.data(); }
+    const float* tileData(int tileX, int tileZ) const { return samples.data() + ((size_t)tileZ * tilesX + tileX) * TILED_HEIGHTFIELD_TILE_CELLS; }
+    float* tileData(int tileX, int tileZ) { return samples.data() + ((size_t)tileZ * tilesX + tileX) * TILED_HEIGHTFIELD_TILE_CELLS; }
+
+    /*Rows of tiles [0, tilesPerColumn()) split over the pool, fn(tileZ) for each*/
+    template <typename Fn>
+    void forEachTileRow(unsigned int threadCount, Fn&& fn) const
+    {
+        ThreadPool& pool = sharedThreadPool();
+        size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+        pool.parallelFor((size_t)tilesZ, taskCount, [&](size_t, size_t first, size_t last) {
+            for (size_t tileZ = first; tileZ < last; ++tileZ)
+                fn(int(tileZ));
+        });
+    }
+
+private:
+    int width{ 0 };
+    int height{ 0 };
+    int tilesX{ 0 };
+    int tilesZ{ 0 };
+    std::vector<float> samples;
+
+    void resize(int inWidth, int inHeight)
+    {
+        width = inWidth;
+        height = inHeight;
+        tilesX = (width + TILED_HEIGHTFIELD_TILE - 1) >> TILED_HEIGHTFIELD_TILE_SHIFT;
+        tilesZ = (height + TILED_HEIGHTFIELD_TILE - 1) >> TILED_HEIGHTFIELD_TILE_SHIFT;
+        samples.assign((size_t)tilesX * tilesZ * TILED_HEIGHTFIELD_TILE_CELLS, 0.0f);
+    }
+};
+
+/*-----------STENCILS----------*/
+/*Normal of a height cell from central differences of its clamped neighbours, as the heightfield vertex
+  shaders and reconstructTerrainHeightfieldVertex build it; spanX and spanZ are the neighbour distances*/
+inline glm::vec3 heightfieldStencilNormal(float left, float right, float down, float up, float spanX, float spanZ)
+{
+    return glm::normalize(glm::vec3(-(right - left) / spanX, 1.0f, -(up - down) / spanZ));
+}
+
+/*Row-major normals of row-major heights, rows split over the pool; threadCount 0 uses every pool thread
+  plus the caller*/
+inline void computeHeightfieldNormals(const float* heights, int width, int height, glm::vec3* outNormals, unsigned int threadCount = 0)
+{
+    if (width < 2 || height < 2)
+        return;
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    pool.parallelFor((size_t)height, taskCount, [&](size_t, size_t firstRow, size_t lastRow) {
+        for (int z = int(firstRow); z < int(lastRow); ++z) {
+            int down = std::max(z - 1, 0), up = std::min(z + 1, height - 1);
+            const float* row = heights + (size_t)z * width;
+            const float* downRow = heights + (size_t)down * width;
+            const float* upRow = heights + (size_t)up * width;
+            float spanZ = float(up - down);
+            for (int x = 0; x < width; ++x) {
+                int left = std::max(x - 1, 0), right = std::min(x + 1, width - 1);
+                outNormals[(size_t)z * width + x] = heightfieldStencilNormal(row[left], row[right], downRow[x], upRow[x], float(right - left), spanZ);
+            }
+        }
+    });
+}
+
+/*fn(x, z, left, right, down, up, spanX, spanZ) for every cell of [x0, x1) x [z0, z1) with its clamped
+  central-difference neighbours and their distances, read one tile at a time through its apron block.
+  Rows of tiles are split over the pool; threadCount 0 uses every pool thread plus the caller.*/
+template <typename Fn>
+inline void forEachHeightfieldStencil(const TiledHeightfield& heights, int x0, int z0, int x1, int z1, unsigned int threadCount, Fn&& fn)
+{
+    int width = heights.gridWidth(), height = heights.gridHeight();
+    if (width < 2 || height < 2 || x1 <= x0 || z1 <= z0)
+        return;
+    int firstTileX = x0 >> TILED_HEIGHTFIELD_TILE_SHIFT, lastTileX = (x1 - 1) >> TILED_HEIGHTFIELD_TILE_SHIFT;
+    int firstTileZ = z0 >> TILED_HEIGHTFIELD_TILE_SHIFT, lastTileZ = (z1 - 1) >> TILED_HEIGHTFIELD_TILE_SHIFT;
+    ThreadPool& pool = sharedThreadPool();
+    size_t taskCount = threadCount ? threadCount : size_t(pool.size()) + 1;
+    pool.parallelFor(size_t(lastTileZ - firstTileZ + 1), taskCount, [&](size_t, size_t first, size_t last) {
+        float block[TILED_HEIGHTFIELD_APRON_SIDE * TILED_HEIGHTFIELD_APRON_SIDE];
+        for (int tileZ = firstTileZ + int(first); tileZ < firstTileZ + int(last); ++tileZ) {
+            int tileZ0 = tileZ << TILED_HEIGHTFIELD_TILE_SHIFT;
+            int rowBegin = std::max(z0, tileZ0), rowEnd = std::min(z1, tileZ0 + TILED_HEIGHTFIELD_TILE);
+            for (int tileX = firstTileX; tileX <= lastTileX; ++tileX) {
+                heights.gatherApron(tileX, tileZ, block);
+                int tileX0 = tileX << TILED_HEIGHTFIELD_TILE_SHIFT;
+                int columnBegin = std::max(x0, tileX0), columnEnd = std::min(x1, tileX0 + TILED_HEIGHTFIELD_TILE);
+                for (int z = rowBegin; z < rowEnd; ++z) {
+                    float spanZ = float(std::min(z + 1, height - 1) - std::max(z - 1, 0));
+                    const float* row = block + (z - tileZ0 + 1) * TILED_HEIGHTFIELD_APRON_SIDE + 1;
+                    for (int x = columnBegin; x < columnEnd; ++x) {
+                        const float* cell = row + (x - tileX0);
+                        float spanX = float(std::min(x + 1, width - 1) - std::max(x - 1, 0));
+                        fn(x, z, cell[-1], cell[1], cell[-TILED_HEIGHTFIELD_APRON_SIDE], cell[TILED_HEIGHTFIELD_APRON_SIDE], spanX, spanZ);
+                    }
+                }
+            }
+        }
+    });
+}
+
+/*The same normals from tiled heights, written row-major; identical to computeHeightfieldNormals bit
+  for bit*/
+inline void computeHeightfieldNormals(const TiledHeightfield& heights, glm::vec3* outNormals, unsigned int threadCount = 0)
+{
+    int width = heights.gridWidth();
+    forEachHeightfieldStencil(heights, 0, 0, width, heights.gridHeight(), threadCount,
+        [&](int x, int z, float left, float right, float down, float up, float spanX, float spanZ) {
+            outNormals[(size_t)z * width + x] = heightfieldStencilNormal(left, right, down, up, spanX, spanZ);
+        });
+}
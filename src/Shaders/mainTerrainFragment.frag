@@ -16,7 +16,15 @@ struct Terrain
     sampler2D AOMap2;
     sampler2D roughnessMap2;
 
-    sampler2D blendMap;
+    /*RGBA8 layer weights (TerrainSplatMap.h): low ground, high ground, steep slopes, hollows*/
+    sampler2D splatMap;
+    /*1 for each layer lit with the second material set, 0 for the first*/
+    vec4 splatSecondSet;
+    /*The streamed chunks have no splat map: their low, high and steep weights come from the fragment's
+      height and slope over these ramps (start, 1 / length, as TerrainSplatRamps), without hollows*/
+    bool splatFromSurface;
+    vec2 splatHeightRamp;
+    vec2 splatSlopeRamp;
 
     bool hasSpecularMap;
 
@@ -56,6 +64,7 @@ in VS_OUT {
 	vec3 outNormal;
 	vec3 outFragPos;
 	vec2 outTexCoords;
+	vec2 outSplatCoords;
 	vec4 outFragPosLightSpace;
 	vec3 outTangentLightDir;
 	vec3 outTangentViewPos;
@@ -78,6 +87,7 @@ uniform Terrain terrainInstance;
 vec3 calculateDirectionalLight(DirectionalLight dirLight, vec3 normal, vec3 viewDir, vec3 lightDirection, Terrain terrain, bool isSecondSet);
 float calculateShadows(vec4 outFragPosLightSpace, vec3 lightDirection);
 vec3 calculatePointLight(PointLight pointLight, vec3 normal, vec3 fragPos, vec3 viewDir, Terrain terrain, bool isSecondSet);
+vec4 surfaceSplat(Terrain terrain);
 
 void main()
 {
@@ -92,7 +102,8 @@ void main()
     vec3 result1 = calculateDirectionalLight(dirLight, normal, viewDir, lightDirection, terrainInstance, false) + calculatePointLight(pointLight, normal, fragIns.outFragPos, viewDir, terrainInstance, false); 
     vec3 result2 = calculateDirectionalLight(dirLight, normal, viewDir, lightDirection, terrainInstance, true) + calculatePointLight(pointLight, normal, fragIns.outFragPos, viewDir, terrainInstance, true);
 
-    float blendFactor = texture(terrainInstance.blendMap, fragIns.outTexCoords).r;
+    vec4 splat = terrainInstance.splatFromSurface ? surfaceSplat(terrainInstance) : texture(terrainInstance.splatMap, fragIns.outSplatCoords);
+    float blendFactor = dot(splat, terrainInstance.splatSecondSet) / max(dot(splat, vec4(1.0)), 1e-4);
     vec4 intermFragColor = vec4(vec3(mix(result1, result2, blendFactor)), 1.f);
 
      float fogDensity = 0.00045f;
@@ -293,4 +304,14 @@ vec3 calculatePointLight(PointLight pointLight, vec3 normal, vec3 fragPos, vec3
     specular *= attenuation;
 
     return ambient + diffuse + specular;
-}
\ No newline at end of file
+}
+
+/*terrainSplatTexel's layers from the interpolated normal (-dh/dx, 1, -dh/dz) and the height*/
+vec4 surfaceSplat(Terrain terrain)
+{
+    vec3 surfaceNormal = normalize(fragIns.outNormal);
+    float slope = length(surfaceNormal.xz) / max(surfaceNormal.y, 1e-4);
+    float steep = clamp((slope - terrain.splatSlopeRamp.x) * terrain.splatSlopeRamp.y, 0.0, 1.0);
+    float high = (1.0 - steep) * clamp((fragIns.outFragPos.y - terrain.splatHeightRamp.x) * terrain.splatHeightRamp.y, 0.0, 1.0);
+    return vec4(1.0 - steep - high, high, steep, 0.0);
+}
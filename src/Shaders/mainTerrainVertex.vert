@@ -6,12 +6,14 @@ layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBiTangent;
 layout (location = 5) in mat4 aInstanceMatrix;
+layout (location = 9) in vec4 aQTangent;
 
 out VS_OUT
 {
 	vec3 outNormal;
 	vec3 outFragPos;
 	vec2 outTexCoords;
+	vec2 outSplatCoords;
 	vec4 outFragPosLightSpace;
 	vec3 outTangentLightDir;
 	vec3 outTangentViewPos;
@@ -29,34 +31,74 @@ uniform mat4 lightSpaceMatrix;
 uniform vec3 vertexLightDirection;
 uniform bool isInstanced;
 
+/*PackedVertex decode: aPos is unorm16 in the mesh AABB and the tangent frame comes from aQTangent*/
+uniform bool isPackedVertex;
+uniform vec3 packedPositionMin;
+uniform vec3 packedPositionExtent;
+
+/*CDLOD morph of the streamed terrain chunks (TerrainLOD.h): vertices the next coarser level drops
+  slide onto its surface with camera distance. gl_VertexID includes the draw's base vertex, so it is
+  the vertex's index in the chunk grid.*/
+layout (location = 10) in float aMorphDelta;
+uniform bool isTerrainMorph;
+uniform int terrainMorphSide;
+uniform int terrainMorphStride;
+uniform vec2 terrainMorphRange;
+uniform vec3 terrainMorphCenter;
+
+/*Heightfield terrain (TerrainHeightfield.h): no vertex buffer but the shared patch lattice in aGridPos;
+  gl_InstanceID picks the patch and the vertex is rebuilt from texelFetch of the 16-bit heights*/
+layout (location = 11) in vec2 aGridPos;
+uniform bool isHeightfieldTerrain;
+uniform sampler2D terrainHeightfield;
+uniform int heightfieldWidth;
+uniform int heightfieldHeight;
+uniform int heightfieldPatchQuads;
+uniform int heightfieldPatchesPerRow;
+uniform vec2 heightfieldRange;
+uniform float heightfieldTexRepeat;
+
+/*The single terrain's splat map has a texel per grid vertex: vertex (x, z) sits at (x - width/2, z - height/2)
+  and samples its texel's centre, whichever path drew it*/
+uniform vec2 splatGridSize;
+
 uniform float uTime;
 uniform float noiseScale;
 uniform float heightScale;
 
 float SimpleNoise(vec2 p);
 vec2 SimpleNoiseGradient(vec2 p);
+void decodeVertex(out vec3 position, out vec3 normal, out vec3 tangent, out vec3 biTangent, out vec2 texCoords);
+vec3 morphTerrainVertex(vec3 position);
+float sampleHeightfield(ivec2 grid);
+void decodeHeightfieldVertex(out vec3 position, out vec3 normal, out vec3 tangent, out vec3 biTangent, out vec2 texCoords);
 
 
 void main()
 {
+	vec3 vPos, vNormal, vTangent, vBiTangent;
+	vec2 vTexCoords;
+	decodeVertex(vPos, vNormal, vTangent, vBiTangent, vTexCoords);
+	vPos = morphTerrainVertex(vPos);
 
-	vec3 modPos = aPos;
-	float noise = SimpleNoise(aPos.xz * noiseScale + vec2(uTime));
-	modPos = aPos + vec3(0.f, noise * heightScale, 0.f);
+	vec3 modPos = vPos;
+	float noise = SimpleNoise(vPos.xz * noiseScale + vec2(uTime));
+	modPos = vPos + vec3(0.f, noise * heightScale, 0.f);
 
 	mat4 finalModelMat = isInstanced ? aInstanceMatrix : modelMat;
-    vertOuts.outFragPos = vec3(finalModelMat * vec4(aPos, 1.0));
-    vertOuts.outNormal = mat3(transpose(inverse(finalModelMat))) * aNormal;
-	vertOuts.outTexCoords = aTexCoords;
+    vertOuts.outFragPos = vec3(finalModelMat * vec4(vPos, 1.0));
+    vertOuts.outNormal = mat3(transpose(inverse(finalModelMat))) * vNormal;
+	vertOuts.outTexCoords = vTexCoords;
+	vertOuts.outSplatCoords = (vPos.xz + floor(splatGridSize / 2.0) + 0.5) / splatGridSize;
 	vertOuts.outFragPosLightSpace = lightSpaceMatrix * vec4(vertOuts.outFragPos, 1.f);
 	vec3 normVertexLightDirection = normalize(vertexLightDirection);
 
 	/*NORMAL MAPPING*/
-	vertOuts.outTangent = aTangent;
-	vertOuts.outBiTangent = aBiTangent;
+	vertOuts.outTangent = vTangent;
+	vertOuts.outBiTangent = vBiTangent;
 	mat3 normalMatrix = transpose(inverse(mat3(finalModelMat)));
-	vec3 T = normalize(normalMatrix * aTangent);
-	vec3 N = normalize(normalMatrix * aNormal);
+	vec3 T = normalize(normalMatrix * vTangent);
+	vec3 N = normalize(normalMatrix * vNormal);
 	T = normalize(T - dot(T, N) * N);
 	vec3 B = cross(N, T);
 
@@ -64,7 +106,7 @@ void main()
 	vertOuts.outTangentLightDir = TBNMatrix * (normVertexLightDirection);
     vertOuts.outTangentViewPos = TBNMatrix * (viewPos - vertOuts.outFragPos);
 
-    gl_Position = projMat * viewMat * finalModelMat * vec4(aPos, 1.f);
+    gl_Position = projMat * viewMat * finalModelMat * vec4(vPos, 1.f);
 }
 
 float SimpleNoise(vec2 p)
@@ -80,4 +122,65 @@ vec2 SimpleNoiseGradient(vec2 p)
         SimpleNoise(p + e) - SimpleNoise(p - e),
         SimpleNoise(p + vec2(0.0, eps)) - SimpleNoise(p - vec2(0.0, eps))
     ) / (2.0 * eps);
-}
\ No newline at end of file
+}
+
+void decodeVertex(out vec3 position, out vec3 normal, out vec3 tangent, out vec3 biTangent, out vec2 texCoords)
+{
+	if (isHeightfieldTerrain)
+	{
+		decodeHeightfieldVertex(position, normal, tangent, biTangent, texCoords);
+		return;
+	}
+
+	texCoords = aTexCoords;
+	if (!isPackedVertex)
+	{
+		position = aPos;
+		normal = aNormal;
+		tangent = aTangent;
+		biTangent = aBiTangent;
+		return;
+	}
+
+	position = packedPositionMin + aPos * packedPositionExtent;
+	vec4 q = normalize(aQTangent / 32767.0);
+	tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+	normal = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+	biTangent = cross(normal, tangent) * (q.w < 0.0 ? -1.0 : 1.0);
+}
+
+vec3 morphTerrainVertex(vec3 position)
+{
+	if (!isTerrainMorph)
+		return position;
+	ivec2 grid = ivec2(gl_VertexID % terrainMorphSide, gl_VertexID / terrainMorphSide) / terrainMorphStride;
+	if (((grid.x | grid.y) & 1) == 0)
+		return position;
+	float morph = clamp((distance(position, terrainMorphCenter) - terrainMorphRange.x) / (terrainMorphRange.y - terrainMorphRange.x), 0.0, 1.0);
+	return position + vec3(0.0, morph * aMorphDelta, 0.0);
+}
+
+float sampleHeightfield(ivec2 grid)
+{
+	grid = clamp(grid, ivec2(0), ivec2(heightfieldWidth - 1, heightfieldHeight - 1));
+	return heightfieldRange.x + texelFetch(terrainHeightfield, grid, 0).r * heightfieldRange.y;
+}
+
+/*Same frame as reconstructTerrainHeightfieldVertex: central differences for the normal, the x
+  difference orthogonalized for the tangent. Patches past the far edges clamp to it and collapse.*/
+void decodeHeightfieldVertex(out vec3 position, out vec3 normal, out vec3 tangent, out vec3 biTangent, out vec2 texCoords)
+{
+	ivec2 lastTexel = ivec2(heightfieldWidth - 1, heightfieldHeight - 1);
+	ivec2 patchOrigin = ivec2(gl_InstanceID % heightfieldPatchesPerRow, gl_InstanceID / heightfieldPatchesPerRow) * heightfieldPatchQuads;
+	ivec2 grid = min(patchOrigin + ivec2(aGridPos), lastTexel);
+	ivec2 low = max(grid - 1, ivec2(0));
+	ivec2 high = min(grid + 1, lastTexel);
+
+	vec3 dx = vec3(float(high.x - low.x), sampleHeightfield(ivec2(high.x, grid.y)) - sampleHeightfield(ivec2(low.x, grid.y)), 0.0);
+	vec3 dz = vec3(0.0, sampleHeightfield(ivec2(grid.x, high.y)) - sampleHeightfield(ivec2(grid.x, low.y)), float(high.y - low.y));
+	position = vec3(float(grid.x - heightfieldWidth / 2), sampleHeightfield(grid), float(grid.y - heightfieldHeight / 2));
+	normal = normalize(cross(dz, dx));
+	tangent = normalize(dx - dot(dx, normal) * normal);
+	biTangent = cross(normal, tangent);
+	texCoords = vec2(grid) / vec2(heightfieldWidth, heightfieldHeight) * heightfieldTexRepeat;
+}
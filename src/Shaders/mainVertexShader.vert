@@ -6,6 +6,7 @@ layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBiTangent;
 layout (location = 5) in mat4 aInstanceMatrix;
+layout (location = 9) in vec4 aQTangent;
 
 out VS_OUT
 {
@@ -29,22 +30,32 @@ uniform mat4 lightSpaceMatrix;
 uniform vec3 vertexLightDirection;
 uniform bool isInstanced;
 
+/*PackedVertex decode: aPos is unorm16 in the mesh AABB and the tangent frame comes from aQTangent*/
+uniform bool isPackedVertex;
+uniform vec3 packedPositionMin;
+uniform vec3 packedPositionExtent;
+
+void decodeVertex(out vec3 position, out vec3 normal, out vec3 tangent, out vec3 biTangent);
+
 void main()
 {
+	vec3 vPos, vNormal, vTangent, vBiTangent;
+	decodeVertex(vPos, vNormal, vTangent, vBiTangent);
+
 	mat4 finalModelMat = isInstanced ? aInstanceMatrix : modelMat;
-    vertOuts.outFragPos = vec3(finalModelMat * vec4(aPos, 1.0));
-    vertOuts.outNormal = mat3(transpose(inverse(finalModelMat))) * aNormal;
+    vertOuts.outFragPos = vec3(finalModelMat * vec4(vPos, 1.0));
+    vertOuts.outNormal = mat3(transpose(inverse(finalModelMat))) * vNormal;
 	vertOuts.outTexCoords = aTexCoords;
 	vertOuts.outFragPosLightSpace = lightSpaceMatrix * vec4(vertOuts.outFragPos, 1.f);
 	/*CGPT: Check for whether it's -normalize(dir) or +normalize(dir) negation*/
 	vec3 normVertexLightDirection = normalize(vertexLightDirection);
 
 	/*NORMAL MAPPING*/
-	vertOuts.outTangent = aTangent;
-	vertOuts.outBiTangent = aBiTangent;
+	vertOuts.outTangent = vTangent;
+	vertOuts.outBiTangent = vBiTangent;
 	mat3 normalMatrix = transpose(inverse(mat3(finalModelMat)));
-	vec3 T = normalize(normalMatrix * aTangent);
-	vec3 N = normalize(normalMatrix * aNormal);
+	vec3 T = normalize(normalMatrix * vTangent);
+	vec3 N = normalize(normalMatrix * vNormal);
 	T = normalize(T - dot(T, N) * N);
 	vec3 B = cross(N, T);
 
@@ -52,5 +63,23 @@ void main()
 	vertOuts.outTangentLightDir = TBNMatrix * (normVertexLightDirection);
     vertOuts.outTangentViewPos = TBNMatrix * (viewPos - vertOuts.outFragPos);
 
-    gl_Position = projMat * viewMat * finalModelMat * vec4(aPos, 1.f);
+    gl_Position = projMat * viewMat * finalModelMat * vec4(vPos, 1.f);
+}
+
+void decodeVertex(out vec3 position, out vec3 normal, out vec3 tangent, out vec3 biTangent)
+{
+	if (!isPackedVertex)
+	{
+		position = aPos;
+		normal = aNormal;
+		tangent = aTangent;
+		biTangent = aBiTangent;
+		return;
+	}
+
+	position = packedPositionMin + aPos * packedPositionExtent;
+	vec4 q = normalize(aQTangent / 32767.0);
+	tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+	normal = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+	biTangent = cross(normal, tangent) * (q.w < 0.0 ? -1.0 : 1.0);
 }
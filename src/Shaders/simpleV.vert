@@ -1,10 +1,58 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+/*PackedVertex decode: aPos is unorm16 in the mesh AABB*/
+uniform bool isPackedVertex;
+uniform vec3 packedPositionMin;
+uniform vec3 packedPositionExtent;
+
+/*Terrain chunk LOD morph, same as mainTerrainVertex.vert so every pass sees the same surface*/
+layout (location = 10) in float aMorphDelta;
+uniform bool isTerrainMorph;
+uniform int terrainMorphSide;
+uniform int terrainMorphStride;
+uniform vec2 terrainMorphRange;
+uniform vec3 terrainMorphCenter;
+
+/*Heightfield terrain position, same as mainTerrainVertex.vert*/
+layout (location = 11) in vec2 aGridPos;
+uniform bool isHeightfieldTerrain;
+uniform sampler2D terrainHeightfield;
+uniform int heightfieldWidth;
+uniform int heightfieldHeight;
+uniform int heightfieldPatchQuads;
+uniform int heightfieldPatchesPerRow;
+uniform vec2 heightfieldRange;
+
 uniform mat4 lightSpaceMatrix;
 uniform mat4 modelMat;
 
+vec3 morphTerrainVertex(vec3 position);
+vec3 heightfieldPosition();
+
 void main()
 {
-    gl_Position = lightSpaceMatrix * modelMat * vec4(aPos, 1.0);
-}  
\ No newline at end of file
+    vec3 position = morphTerrainVertex(isPackedVertex ? packedPositionMin + aPos * packedPositionExtent : aPos);
+    if (isHeightfieldTerrain)
+        position = heightfieldPosition();
+    gl_Position = lightSpaceMatrix * modelMat * vec4(position, 1.0);
+}
+
+vec3 morphTerrainVertex(vec3 position)
+{
+    if (!isTerrainMorph)
+        return position;
+    ivec2 grid = ivec2(gl_VertexID % terrainMorphSide, gl_VertexID / terrainMorphSide) / terrainMorphStride;
+    if (((grid.x | grid.y) & 1) == 0)
+        return position;
+    float morph = clamp((distance(position, terrainMorphCenter) - terrainMorphRange.x) / (terrainMorphRange.y - terrainMorphRange.x), 0.0, 1.0);
+    return position + vec3(0.0, morph * aMorphDelta, 0.0);
+}
+
+vec3 heightfieldPosition()
+{
+    ivec2 patchOrigin = ivec2(gl_InstanceID % heightfieldPatchesPerRow, gl_InstanceID / heightfieldPatchesPerRow) * heightfieldPatchQuads;
+    ivec2 grid = min(patchOrigin + ivec2(aGridPos), ivec2(heightfieldWidth - 1, heightfieldHeight - 1));
+    float height = heightfieldRange.x + texelFetch(terrainHeightfield, grid, 0).r * heightfieldRange.y;
+    return vec3(float(grid.x - heightfieldWidth / 2), height, float(grid.y - heightfieldHeight / 2));
+}